@@ -1152,10 +1152,6 @@ LOGFUNCTION_VOID( CL_FlushMemory, (void), (), "CLIENTSTATE" ) {
 #else
 void CL_FlushMemory( void ) {
 #endif
-#ifdef NEW_FILESYSTEM
-	FS_ReadCache_AdvanceStage();
-#endif
-
 	// shutdown all the client stuff
 	CL_ShutdownAll();
 
@@ -0,0 +1,1157 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+Copyright (C) 2017-2023 Noah Metzger (chomenor@gmail.com)
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+
+// Headless load generator for benchmarking the dedicated server. Opens a number of
+// simulated client connections using the engine netchan and message code, completes
+// the connection handshake, and streams usercmds while counting received snapshots.
+//
+// Snapshots are acknowledged but not decoded, so the server delta compresses against
+// them the same way it would for a real client.
+//
+// Example (server running on the same machine with a map loaded):
+//   stef-loadgen -server 127.0.0.1:27960 -clients 32 -duration 60
+
+#include "../../qcommon/q_shared.h"
+#include "../../qcommon/qcommon.h"
+
+#include <setjmp.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#define LG_MAX_CLIENTS 1024
+#define LG_CMD_BACKUP 64
+#define LG_CMD_MASK ( LG_CMD_BACKUP - 1 )
+#define LG_RETRANSMIT_TIME 1000
+#define LG_TIMEOUT_TIME 10000
+
+typedef enum {
+	LG_CHALLENGING,		// sending getchallenge
+	LG_CONNECTING,		// sending connect
+	LG_CONNECTED,		// netchan established, waiting for gamestate
+	LG_PRIMED,			// gamestate received, sending usercmds, waiting for first snapshot
+	LG_ACTIVE,			// receiving snapshots
+	LG_FAILED
+} lgState_t;
+
+typedef struct {
+	int socket;
+	int clientNum;
+	lgState_t state;
+	int qport;
+	int challenge;
+	int clientChallenge;
+	netchan_t netchan;
+
+	// server message state
+	int serverId;
+	int serverMessageSequence;
+	int serverCommandSequence;
+	int snapshotMessageNum;		// message sequence of last received snapshot
+	int snapshotServerTime;
+	int snapshotReceiveTime;
+
+	// reliable commands to server
+	int reliableSequence;
+	int reliableAcknowledge;
+	char reliableCommands[MAX_RELIABLE_COMMANDS][MAX_STRING_CHARS];
+
+	// usercmd generation
+	usercmd_t cmds[LG_CMD_BACKUP];
+	int cmdNumber;
+	int packetCmdNumber[PACKET_BACKUP];
+	int nextCmdTime;
+	int nextPacketTime;
+	float yaw;
+
+	// timing
+	int startTime;
+	int lastSendTime;
+	int lastReceiveTime;
+	int connectTime;		// time connectResponse received
+	int gamestateTime;		// time gamestate received
+	int activeTime;			// time first snapshot received
+
+	// statistics
+	int64_t bytesIn;
+	int64_t bytesOut;
+	int packetsIn;
+	int packetsOut;
+	int snapshots;
+	int gamestates;
+	int intervalSnapshots;
+	int64_t intervalBytesIn;
+	int64_t intervalBytesOut;
+	char failReason[MAX_STRING_CHARS];
+} lgClient_t;
+
+typedef struct {
+	// options
+	netadr_t serverAddress;
+	struct sockaddr_in serverSockaddr;
+	int numClients;
+	int duration;
+	int cmdRate;
+	int packetRate;
+	int packetDup;
+	int rate;
+	int snaps;
+	int stagger;
+	int reportInterval;
+	qboolean sameIP;
+	char namePrefix[32];
+
+	// state
+	lgClient_t *clients;
+	lgClient_t *current;		// client sending the current packet
+	jmp_buf abortParse;
+	qboolean abortParseValid;
+	int startTime;
+} lgGlobals_t;
+
+static lgGlobals_t lg;
+
+/* ******************************************************************************** */
+// Engine Support
+/* ******************************************************************************** */
+
+cvar_t *com_timescale;
+cvar_t *sv_packetdelay;
+cvar_t *cl_packetdelay;
+cvar_t *cl_shownet;
+
+extern cvar_t *qport;
+
+/*
+==================
+Com_Printf
+==================
+*/
+void QDECL Com_Printf( const char *fmt, ... ) {
+	va_list argptr;
+	va_start( argptr, fmt );
+	vprintf( fmt, argptr );
+	va_end( argptr );
+}
+
+/*
+==================
+Com_Error
+
+Errors raised while parsing a server message fail the current client only.
+==================
+*/
+void NORETURN QDECL Com_Error( errorParm_t level, const char *fmt, ... ) {
+	char buffer[MAX_STRING_CHARS];
+	va_list argptr;
+
+	va_start( argptr, fmt );
+	Q_vsnprintf( buffer, sizeof( buffer ), fmt, argptr );
+	va_end( argptr );
+
+	if ( lg.abortParseValid && lg.current ) {
+		Q_strncpyz( lg.current->failReason, buffer, sizeof( lg.current->failReason ) );
+		longjmp( lg.abortParse, 1 );
+	}
+
+	fprintf( stderr, "ERROR: %s\n", buffer );
+	exit( 1 );
+}
+
+/*
+==================
+Cvar_Get
+
+Only used for netchan settings, which are left at their defaults.
+==================
+*/
+cvar_t *Cvar_Get( const char *var_name, const char *value, int flags ) {
+	cvar_t *var = (cvar_t *)calloc( 1, sizeof( *var ) );
+	var->name = strdup( var_name );
+	var->string = strdup( value );
+	var->value = Q_atof( value );
+	var->integer = atoi( value );
+	var->flags = flags;
+	return var;
+}
+
+void Cvar_SetDescription( cvar_t *var, const char *var_description ) {
+}
+
+int Cmd_Argc( void ) {
+	return 0;
+}
+
+const char *Cmd_Argv( int arg ) {
+	return "";
+}
+
+void *S_Malloc( int size ) {
+	return malloc( size );
+}
+
+void Z_Free( void *ptr ) {
+	free( ptr );
+}
+
+#ifdef STEF_NET_BATCHED_SEND
+void Sys_BeginPacketBatch( void ) {
+}
+
+void Sys_FlushPacketBatch( void ) {
+}
+#endif
+
+/*
+==================
+Sys_Milliseconds
+==================
+*/
+int Sys_Milliseconds( void ) {
+	return (int)( Sys_Microseconds() / 1000 );
+}
+
+/*
+==================
+Sys_Microseconds
+==================
+*/
+int64_t Sys_Microseconds( void ) {
+	static int64_t base;
+	struct timespec ts;
+	int64_t now;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	now = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+	if ( !base ) {
+		// start at one second so a zero timestamp can mean "not reached yet"
+		base = now - 1000000;
+	}
+	return now - base;
+}
+
+/*
+==================
+Sys_StringToAdr
+
+Only IPv4 is supported.
+==================
+*/
+qboolean Sys_StringToAdr( const char *s, netadr_t *a, netadrtype_t family ) {
+	struct addrinfo hints;
+	struct addrinfo *res;
+
+	Com_Memset( &hints, 0, sizeof( hints ) );
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	if ( getaddrinfo( s, NULL, &hints, &res ) || !res ) {
+		return qfalse;
+	}
+
+	Com_Memset( a, 0, sizeof( *a ) );
+	a->type = NA_IP;
+	Com_Memcpy( a->ipv._4, &( (struct sockaddr_in *)res->ai_addr )->sin_addr, 4 );
+	freeaddrinfo( res );
+	return qtrue;
+}
+
+qboolean Sys_IsLANAddress( const netadr_t *adr ) {
+	return adr->ipv._4[0] == 127 ? qtrue : qfalse;
+}
+
+const char *NET_AdrToString( const netadr_t *a ) {
+	static char s[NET_ADDRSTRMAXLEN];
+	Com_sprintf( s, sizeof( s ), "%i.%i.%i.%i:%i", a->ipv._4[0], a->ipv._4[1], a->ipv._4[2],
+			a->ipv._4[3], (unsigned short)BigShort( a->port ) );
+	return s;
+}
+
+/*
+==================
+Sys_SendPacket
+
+Each client socket is connected to the server, so the destination is implicit.
+==================
+*/
+void Sys_SendPacket( int length, const void *data, const netadr_t *to ) {
+	lgClient_t *cl = lg.current;
+	if ( !cl || cl->socket < 0 ) {
+		return;
+	}
+
+	if ( send( cl->socket, data, length, 0 ) < 0 ) {
+		if ( errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNREFUSED ) {
+			fprintf( stderr, "WARNING: client %i send failed: %s\n", cl->clientNum, strerror( errno ) );
+		}
+		return;
+	}
+
+	cl->bytesOut += length;
+	cl->intervalBytesOut += length;
+	++cl->packetsOut;
+	cl->lastSendTime = Sys_Milliseconds();
+}
+
+/* ******************************************************************************** */
+// Client Connection
+/* ******************************************************************************** */
+
+/*
+==================
+LG_SetCurrent
+
+Selects the client for Sys_SendPacket and error reporting. The netchan writes the
+global net_qport value into each packet header, so it is switched to match as well.
+==================
+*/
+static void LG_SetCurrent( lgClient_t *cl ) {
+	lg.current = cl;
+	qport->integer = cl->qport;
+}
+
+/*
+==================
+LG_Fail
+==================
+*/
+static void LG_Fail( lgClient_t *cl, const char *reason ) {
+	if ( cl->state != LG_FAILED ) {
+		Q_strncpyz( cl->failReason, reason, sizeof( cl->failReason ) );
+		Com_Printf( "client %i: %s\n", cl->clientNum, reason );
+		cl->state = LG_FAILED;
+	}
+}
+
+/*
+==================
+LG_OpenSocket
+
+When targeting a loopback server, each client binds a different 127.x.x.x address
+by default so the server's per-IP connection limit doesn't apply.
+==================
+*/
+static qboolean LG_OpenSocket( lgClient_t *cl ) {
+	int sock = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	if ( sock < 0 ) {
+		return qfalse;
+	}
+
+	if ( !lg.sameIP && lg.serverAddress.ipv._4[0] == 127 ) {
+		struct sockaddr_in local;
+		int index = cl->clientNum + 1;
+		Com_Memset( &local, 0, sizeof( local ) );
+		local.sin_family = AF_INET;
+		local.sin_addr.s_addr = htonl( ( 127u << 24 ) | ( (unsigned int)( index / 250 ) << 8 ) | (unsigned int)( index % 250 + 2 ) );
+		if ( bind( sock, (struct sockaddr *)&local, sizeof( local ) ) < 0 ) {
+			close( sock );
+			return qfalse;
+		}
+	}
+
+	if ( connect( sock, (struct sockaddr *)&lg.serverSockaddr, sizeof( lg.serverSockaddr ) ) < 0 ) {
+		close( sock );
+		return qfalse;
+	}
+
+	fcntl( sock, F_SETFL, fcntl( sock, F_GETFL, 0 ) | O_NONBLOCK );
+	cl->socket = sock;
+	return qtrue;
+}
+
+/*
+==================
+LG_SendHandshake
+
+Sends getchallenge or connect request depending on current state.
+==================
+*/
+static void LG_SendHandshake( lgClient_t *cl ) {
+	LG_SetCurrent( cl );
+
+	if ( cl->state == LG_CHALLENGING ) {
+		NET_OutOfBandPrint( NS_CLIENT, &lg.serverAddress, "getchallenge %d %s", cl->clientChallenge, GAMENAME_FOR_MASTER );
+	} else if ( cl->state == LG_CONNECTING ) {
+		char info[MAX_INFO_STRING];
+		Com_sprintf( info, sizeof( info ), "\\name\\%s%03i\\rate\\%i\\snaps\\%i\\model\\munro/default"
+				"\\protocol\\%i\\qport\\%i\\challenge\\%i\\client\\stef-loadgen", lg.namePrefix, cl->clientNum,
+				lg.rate, lg.snaps, NEW_PROTOCOL_VERSION, cl->qport, cl->challenge );
+		NET_OutOfBandPrint( NS_CLIENT, &lg.serverAddress, "connect \"%s\"", info );
+	}
+}
+
+/*
+==================
+LG_AddReliableCommand
+==================
+*/
+static void LG_AddReliableCommand( lgClient_t *cl, const char *cmd ) {
+	if ( cl->reliableSequence - cl->reliableAcknowledge >= MAX_RELIABLE_COMMANDS ) {
+		return;
+	}
+	++cl->reliableSequence;
+	Q_strncpyz( cl->reliableCommands[cl->reliableSequence & ( MAX_RELIABLE_COMMANDS - 1 )], cmd,
+			sizeof( cl->reliableCommands[0] ) );
+}
+
+/*
+==================
+LG_CreateCmd
+
+Generates a usercmd for the current time. Movement follows a slow turning and strafing
+pattern with occasional firing, so the server simulates a moving player.
+==================
+*/
+static void LG_CreateCmd( lgClient_t *cl, int time ) {
+	usercmd_t *cmd = &cl->cmds[++cl->cmdNumber & LG_CMD_MASK];
+	int phase = ( time / 1000 + cl->clientNum ) % 8;
+
+	Com_Memset( cmd, 0, sizeof( *cmd ) );
+	cmd->serverTime = cl->snapshotServerTime + ( time - cl->snapshotReceiveTime );
+
+	cl->yaw += ( phase & 1 ) ? 1.5f : -1.0f;
+	cmd->angles[YAW] = ANGLE2SHORT( cl->yaw );
+	cmd->angles[PITCH] = ANGLE2SHORT( 10.0f * sin( time * 0.001 ) );
+	cmd->forwardmove = phase < 6 ? 127 : -127;
+	cmd->rightmove = ( phase & 2 ) ? 127 : ( phase & 4 ) ? -127 : 0;
+	if ( phase == 3 && ( time & 1023 ) < 200 ) {
+		cmd->upmove = 127;
+	}
+	if ( phase >= 5 ) {
+		cmd->buttons |= BUTTON_ATTACK;
+	}
+	cmd->weapon = 1;
+}
+
+/*
+==================
+LG_WritePacket
+
+Based on CL_WritePacket.
+==================
+*/
+static void LG_WritePacket( lgClient_t *cl ) {
+	msg_t buf;
+	byte data[MAX_MSGLEN_BUF];
+	usercmd_t nullcmd;
+	usercmd_t *oldcmd = &nullcmd;
+	int oldPacketNum;
+	int count;
+	int i;
+
+	Com_Memset( &nullcmd, 0, sizeof( nullcmd ) );
+	MSG_Init( &buf, data, MAX_MSGLEN );
+	MSG_Bitstream( &buf );
+
+	MSG_WriteLong( &buf, cl->serverId );
+	MSG_WriteLong( &buf, cl->serverMessageSequence );
+	MSG_WriteLong( &buf, cl->serverCommandSequence );
+
+	// write any unacknowledged clientCommands
+	for ( i = cl->reliableAcknowledge + 1; i - cl->reliableSequence <= 0; ++i ) {
+		MSG_WriteByte( &buf, clc_clientCommand );
+		MSG_WriteLong( &buf, i );
+		MSG_WriteString( &buf, cl->reliableCommands[i & ( MAX_RELIABLE_COMMANDS - 1 )] );
+	}
+
+	// send all usercmds since packetDup packets ago
+	oldPacketNum = ( cl->netchan.outgoingSequence - 1 - lg.packetDup ) & PACKET_MASK;
+	count = cl->cmdNumber - cl->packetCmdNumber[oldPacketNum];
+	if ( count > MAX_PACKET_USERCMDS ) {
+		count = MAX_PACKET_USERCMDS;
+	}
+	if ( cl->state >= LG_PRIMED && count >= 1 ) {
+		// only request a delta if the last message received contained a snapshot
+		if ( cl->snapshotMessageNum != cl->serverMessageSequence ) {
+			MSG_WriteByte( &buf, clc_moveNoDelta );
+		} else {
+			MSG_WriteByte( &buf, clc_move );
+		}
+
+		MSG_WriteByte( &buf, count );
+		for ( i = 0; i < count; ++i ) {
+			usercmd_t *cmd = &cl->cmds[( cl->cmdNumber - count + i + 1 ) & LG_CMD_MASK];
+			MSG_WriteDeltaUsercmd( &buf, oldcmd, cmd );
+			oldcmd = cmd;
+		}
+	}
+
+	cl->packetCmdNumber[cl->netchan.outgoingSequence & PACKET_MASK] = cl->cmdNumber;
+	MSG_WriteByte( &buf, clc_EOF );
+
+	LG_SetCurrent( cl );
+	Netchan_Transmit( &cl->netchan, buf.cursize, buf.data );
+}
+
+/* ******************************************************************************** */
+// Server Message Parsing
+/* ******************************************************************************** */
+
+/*
+==================
+LG_SetServerId
+
+Updates serverId from systeminfo string.
+==================
+*/
+static void LG_SetServerId( lgClient_t *cl, const char *systemInfo ) {
+	const char *value = Info_ValueForKey( systemInfo, "sv_serverid" );
+	if ( *value ) {
+		cl->serverId = atoi( value );
+	}
+}
+
+/*
+==================
+LG_ParseCommandString
+==================
+*/
+static void LG_ParseCommandString( lgClient_t *cl, msg_t *msg ) {
+	int seq = MSG_ReadLong( msg );
+	const char *s = MSG_ReadString( msg );
+
+	if ( cl->serverCommandSequence - seq >= 0 ) {
+		return;
+	}
+	cl->serverCommandSequence = seq;
+
+	if ( !strncmp( s, "disconnect", 10 ) ) {
+		LG_Fail( cl, va( "server %s", s ) );
+	} else if ( !strncmp( s, "cs 1 ", 5 ) ) {
+		// systeminfo update after map_restart carries the new serverId
+		const char *info = strchr( s + 5, '"' );
+		LG_SetServerId( cl, info ? info + 1 : s + 5 );
+	}
+}
+
+/*
+==================
+LG_ParseGamestate
+
+Based on CL_ParseGamestate. Configstrings other than systeminfo and entity baselines
+are read and discarded.
+==================
+*/
+static void LG_ParseGamestate( lgClient_t *cl, msg_t *msg ) {
+	entityState_t nullstate;
+	entityState_t baseline;
+	int cmd;
+	int time;
+
+	Com_Memset( &nullstate, 0, sizeof( nullstate ) );
+	cl->serverCommandSequence = MSG_ReadLong( msg );
+
+	while ( 1 ) {
+		cmd = MSG_ReadByte( msg );
+		if ( cmd == svc_EOF ) {
+			break;
+		}
+
+		if ( cmd == svc_configstring ) {
+			int index = MSG_ReadShort( msg );
+			const char *s = MSG_ReadBigString( msg );
+			if ( index < 0 || index >= MAX_CONFIGSTRINGS ) {
+				Com_Error( ERR_DROP, "%s: configstring > MAX_CONFIGSTRINGS", __func__ );
+			}
+			if ( index == CS_SYSTEMINFO ) {
+				LG_SetServerId( cl, s );
+			}
+		} else if ( cmd == svc_baseline ) {
+			int newnum = MSG_ReadEntitynum( msg );
+			if ( newnum < 0 || newnum >= MAX_GENTITIES ) {
+				Com_Error( ERR_DROP, "%s: baseline number out of range: %i", __func__, newnum );
+			}
+			MSG_ReadDeltaEntity( msg, &nullstate, &baseline, newnum );
+		} else {
+			Com_Error( ERR_DROP, "%s: bad command byte", __func__ );
+		}
+	}
+
+	MSG_ReadLong( msg );	// clientNum
+	MSG_ReadLong( msg );	// checksumFeed
+
+	// usercmd times count from zero until the first snapshot arrives
+	time = Sys_Milliseconds();
+	++cl->gamestates;
+	if ( !cl->gamestateTime ) {
+		cl->gamestateTime = time;
+	}
+	cl->state = LG_PRIMED;
+	cl->snapshotMessageNum = 0;
+	cl->snapshotServerTime = 0;
+	cl->snapshotReceiveTime = time;
+	cl->nextCmdTime = time;
+}
+
+/*
+==================
+LG_ParseServerMessage
+
+Based on CL_ParseServerMessage. Parsing stops at the snapshot, since only the header
+is needed to generate usercmd times and acknowledge the message.
+==================
+*/
+static void LG_ParseServerMessage( lgClient_t *cl, msg_t *msg ) {
+	int cmd;
+
+	MSG_Bitstream( msg );
+	cl->reliableAcknowledge = MSG_ReadLong( msg );
+	if ( cl->reliableSequence - cl->reliableAcknowledge > MAX_RELIABLE_COMMANDS
+			|| cl->reliableSequence - cl->reliableAcknowledge < 0 ) {
+		cl->reliableAcknowledge = cl->reliableSequence;
+	}
+
+	while ( cl->state != LG_FAILED ) {
+		if ( msg->readcount > msg->cursize ) {
+			Com_Error( ERR_DROP, "%s: read past end of server message", __func__ );
+		}
+
+		cmd = MSG_ReadByte( msg );
+		if ( cmd == svc_EOF ) {
+			break;
+		}
+
+		switch ( cmd ) {
+		case svc_nop:
+			break;
+		case svc_serverCommand:
+			LG_ParseCommandString( cl, msg );
+			break;
+		case svc_gamestate:
+			LG_ParseGamestate( cl, msg );
+			break;
+		case svc_snapshot:
+			if ( cl->state >= LG_PRIMED ) {
+				int time = Sys_Milliseconds();
+				cl->snapshotServerTime = MSG_ReadLong( msg );
+				cl->snapshotReceiveTime = time;
+				cl->snapshotMessageNum = cl->serverMessageSequence;
+				++cl->snapshots;
+				++cl->intervalSnapshots;
+				if ( cl->state == LG_PRIMED ) {
+					cl->state = LG_ACTIVE;
+					cl->activeTime = time;
+				}
+			}
+			return;
+		case svc_download:
+			Com_Error( ERR_DROP, "%s: server requested download", __func__ );
+		default:
+			Com_Error( ERR_DROP, "%s: illegible server message", __func__ );
+		}
+	}
+}
+
+/*
+==================
+LG_ConnectionlessPacket
+==================
+*/
+static void LG_ConnectionlessPacket( lgClient_t *cl, msg_t *msg ) {
+	char line[MAX_STRING_CHARS];
+	char command[64];
+	int arg1 = 0, arg2 = 0;
+
+	MSG_BeginReadingOOB( msg );
+	MSG_ReadLong( msg );
+	Q_strncpyz( line, MSG_ReadStringLine( msg ), sizeof( line ) );
+	if ( sscanf( line, "%63s %i %i", command, &arg1, &arg2 ) < 1 ) {
+		return;
+	}
+
+	if ( !Q_stricmp( command, "challengeResponse" ) ) {
+		if ( cl->state != LG_CHALLENGING || arg2 != cl->clientChallenge ) {
+			return;
+		}
+		cl->challenge = arg1;
+		cl->state = LG_CONNECTING;
+		LG_SendHandshake( cl );
+	} else if ( !Q_stricmp( command, "connectResponse" ) ) {
+		if ( cl->state != LG_CONNECTING || arg1 != cl->challenge ) {
+			return;
+		}
+		Netchan_Setup( NS_CLIENT, &cl->netchan, &lg.serverAddress, cl->qport, cl->challenge, qfalse );
+		cl->state = LG_CONNECTED;
+		cl->connectTime = Sys_Milliseconds();
+		LG_WritePacket( cl );
+	} else if ( !Q_stricmp( command, "print" ) ) {
+		if ( cl->state <= LG_CONNECTING ) {
+			Q_strncpyz( line, MSG_ReadStringLine( msg ), sizeof( line ) );
+			LG_Fail( cl, va( "connection refused: %s", line ) );
+		}
+	}
+}
+
+/*
+==================
+LG_PacketEvent
+==================
+*/
+static void LG_PacketEvent( lgClient_t *cl, byte *data, int length ) {
+	msg_t msg;
+
+	cl->bytesIn += length;
+	cl->intervalBytesIn += length;
+	++cl->packetsIn;
+	cl->lastReceiveTime = Sys_Milliseconds();
+
+	MSG_Init( &msg, data, MAX_MSGLEN );
+	msg.cursize = length;
+
+	LG_SetCurrent( cl );
+	lg.abortParseValid = qtrue;
+	if ( setjmp( lg.abortParse ) ) {
+		lg.abortParseValid = qfalse;
+		cl->state = LG_FAILED;
+		Com_Printf( "client %i: %s\n", cl->clientNum, cl->failReason );
+		return;
+	}
+
+	if ( length >= 4 && *(int32_t *)data == -1 ) {
+		LG_ConnectionlessPacket( cl, &msg );
+	} else if ( cl->state >= LG_CONNECTED && cl->state != LG_FAILED && length >= 4 ) {
+		if ( Netchan_Process( &cl->netchan, &msg ) ) {
+			cl->serverMessageSequence = LittleLong( *(int32_t *)msg.data );
+			LG_ParseServerMessage( cl, &msg );
+		}
+	}
+
+	lg.abortParseValid = qfalse;
+}
+
+/*
+==================
+LG_ClientFrame
+
+Handles retransmits, usercmd generation, and packet sending for one client.
+==================
+*/
+static void LG_ClientFrame( lgClient_t *cl, int time ) {
+	if ( cl->state == LG_FAILED ) {
+		return;
+	}
+
+	if ( cl->state <= LG_CONNECTING ) {
+		if ( time - cl->startTime > LG_TIMEOUT_TIME ) {
+			LG_Fail( cl, "timed out connecting" );
+		} else if ( time - cl->lastSendTime >= LG_RETRANSMIT_TIME ) {
+			LG_SendHandshake( cl );
+		}
+		return;
+	}
+
+	if ( time - cl->lastReceiveTime > LG_TIMEOUT_TIME ) {
+		LG_Fail( cl, "server connection timed out" );
+		return;
+	}
+
+	if ( cl->netchan.unsentFragments ) {
+		LG_SetCurrent( cl );
+		Netchan_TransmitNextFragment( &cl->netchan );
+	}
+
+	if ( cl->state >= LG_PRIMED ) {
+		while ( time - cl->nextCmdTime >= 0 ) {
+			LG_CreateCmd( cl, time );
+			cl->nextCmdTime += 1000 / lg.cmdRate;
+		}
+	}
+
+	if ( time - cl->nextPacketTime >= 0 ) {
+		LG_WritePacket( cl );
+		cl->nextPacketTime = time + 1000 / lg.packetRate;
+	}
+}
+
+/*
+==================
+LG_StartClient
+==================
+*/
+static void LG_StartClient( lgClient_t *cl, int time ) {
+	cl->state = LG_CHALLENGING;
+	if ( !LG_OpenSocket( cl ) ) {
+		LG_Fail( cl, va( "failed to open socket: %s", strerror( errno ) ) );
+		return;
+	}
+
+	cl->qport = ( rand() & 0xffff ) ^ cl->clientNum;
+	cl->clientChallenge = ( ( rand() << 16 ) ^ rand() ) & 0x7fffffff;
+	cl->startTime = time;
+	cl->lastReceiveTime = time;
+	cl->nextCmdTime = time;
+	cl->nextPacketTime = time;
+	cl->yaw = (float)( cl->clientNum * 37 % 360 );
+	LG_SendHandshake( cl );
+}
+
+/*
+==================
+LG_Disconnect
+
+Sends disconnect command several times, like CL_Disconnect, in case of packet loss.
+==================
+*/
+static void LG_Disconnect( lgClient_t *cl ) {
+	int i;
+
+	if ( cl->state >= LG_CONNECTED && cl->state != LG_FAILED ) {
+		LG_AddReliableCommand( cl, "disconnect" );
+		for ( i = 0; i < 3; ++i ) {
+			LG_WritePacket( cl );
+		}
+	}
+
+	if ( cl->socket >= 0 ) {
+		close( cl->socket );
+		cl->socket = -1;
+	}
+}
+
+/* ******************************************************************************** */
+// Reporting
+/* ******************************************************************************** */
+
+/*
+==================
+LG_PrintInterval
+==================
+*/
+static void LG_PrintInterval( int time, int elapsed ) {
+	int active = 0, failed = 0;
+	int snapshots = 0;
+	int64_t bytesIn = 0, bytesOut = 0;
+	int i;
+
+	for ( i = 0; i < lg.numClients; ++i ) {
+		lgClient_t *cl = &lg.clients[i];
+		if ( cl->state == LG_ACTIVE ) {
+			++active;
+		} else if ( cl->state == LG_FAILED ) {
+			++failed;
+		}
+		snapshots += cl->intervalSnapshots;
+		bytesIn += cl->intervalBytesIn;
+		bytesOut += cl->intervalBytesOut;
+		cl->intervalSnapshots = 0;
+		cl->intervalBytesIn = 0;
+		cl->intervalBytesOut = 0;
+	}
+
+	if ( elapsed <= 0 ) {
+		return;
+	}
+
+	Com_Printf( "%6.1fs  active %4i/%-4i failed %-4i snaps/s %8.1f (%5.1f per client)  in %8.1f KB/s  out %7.1f KB/s\n",
+			( time - lg.startTime ) / 1000.0, active, lg.numClients, failed,
+			snapshots * 1000.0 / elapsed, active ? snapshots * 1000.0 / elapsed / active : 0.0,
+			bytesIn / 1.024 / elapsed, bytesOut / 1.024 / elapsed );
+}
+
+/*
+==================
+LG_PrintLatency
+==================
+*/
+static void LG_PrintLatency( const char *label, int offset ) {
+	int count = 0, total = 0, min = 0, max = 0;
+	int i;
+
+	for ( i = 0; i < lg.numClients; ++i ) {
+		const lgClient_t *cl = &lg.clients[i];
+		int value = *(const int *)( (const byte *)cl + offset );
+		if ( value ) {
+			value -= cl->startTime;
+			if ( !count || value < min ) {
+				min = value;
+			}
+			if ( !count || value > max ) {
+				max = value;
+			}
+			total += value;
+			++count;
+		}
+	}
+
+	if ( count ) {
+		Com_Printf( "  %-16s %4i clients  min %5i ms  avg %5i ms  max %5i ms\n", label, count, min, total / count, max );
+	} else {
+		Com_Printf( "  %-16s    0 clients\n", label );
+	}
+}
+
+/*
+==================
+LG_PrintSummary
+==================
+*/
+static void LG_PrintSummary( int time ) {
+	int64_t bytesIn = 0, bytesOut = 0;
+	int packetsIn = 0, packetsOut = 0;
+	int snapshots = 0, gamestates = 0, active = 0;
+	double activeSeconds = 0.0;
+	int i;
+
+	for ( i = 0; i < lg.numClients; ++i ) {
+		const lgClient_t *cl = &lg.clients[i];
+		bytesIn += cl->bytesIn;
+		bytesOut += cl->bytesOut;
+		packetsIn += cl->packetsIn;
+		packetsOut += cl->packetsOut;
+		snapshots += cl->snapshots;
+		gamestates += cl->gamestates;
+		if ( cl->activeTime ) {
+			++active;
+			activeSeconds += ( time - cl->activeTime ) / 1000.0;
+		}
+	}
+
+	Com_Printf( "\nSummary (%i clients, %.1f seconds):\n", lg.numClients, ( time - lg.startTime ) / 1000.0 );
+	Com_Printf( "  clients reaching active state: %i\n", active );
+	Com_Printf( "  gamestates received: %i\n", gamestates );
+	Com_Printf( "  snapshots received: %i (%.2f per client per second while active)\n", snapshots,
+			activeSeconds > 0.0 ? snapshots / activeSeconds : 0.0 );
+	Com_Printf( "  received: %i packets, %lli bytes (%.1f KB/s)\n", packetsIn, (long long)bytesIn,
+			bytesIn / 1.024 / ( time - lg.startTime ) );
+	Com_Printf( "  sent: %i packets, %lli bytes (%.1f KB/s)\n", packetsOut, (long long)bytesOut,
+			bytesOut / 1.024 / ( time - lg.startTime ) );
+	Com_Printf( "Handshake latency from first request:\n" );
+	LG_PrintLatency( "connected", offsetof( lgClient_t, connectTime ) );
+	LG_PrintLatency( "gamestate", offsetof( lgClient_t, gamestateTime ) );
+	LG_PrintLatency( "first snapshot", offsetof( lgClient_t, activeTime ) );
+}
+
+/* ******************************************************************************** */
+// Main
+/* ******************************************************************************** */
+
+/*
+==================
+LG_Usage
+==================
+*/
+static void LG_Usage( void ) {
+	printf( "usage: stef-loadgen [options]\n"
+			"  -server <address[:port]>  server address (default 127.0.0.1:27960)\n"
+			"  -clients <count>          number of simulated clients (default 8)\n"
+			"  -duration <seconds>       test duration, 0 to run until interrupted (default 30)\n"
+			"  -cmdrate <hz>             usercmds generated per second (default 125)\n"
+			"  -packetrate <hz>          packets sent per second (default 30)\n"
+			"  -packetdup <count>        previous packets to repeat usercmds from (default 1)\n"
+			"  -rate <bytes>             client rate setting (default 90000)\n"
+			"  -snaps <count>            client snaps setting (default 40)\n"
+			"  -stagger <msec>           delay between starting each client (default 50)\n"
+			"  -interval <msec>          statistics report interval (default 1000)\n"
+			"  -name <prefix>            player name prefix (default loadgen)\n"
+			"  -sameip                   connect all clients from the same loopback address\n"
+			"\n"
+			"Clients use distinct 127.x.x.x source addresses by default when connecting to a\n"
+			"loopback server. With -sameip, raise sv_maxclientsPerIP on the server. Handshakes\n"
+			"from one address are also rate limited by the server to a burst of 10 packets and\n"
+			"then 1 per second, so only about 5 clients connect immediately.\n" );
+}
+
+/*
+==================
+LG_ParseArgs
+==================
+*/
+static qboolean LG_ParseArgs( int argc, char **argv ) {
+	const char *server = "127.0.0.1";
+	int i;
+
+	lg.numClients = 8;
+	lg.duration = 30;
+	lg.cmdRate = 125;
+	lg.packetRate = 30;
+	lg.packetDup = 1;
+	lg.rate = 90000;
+	lg.snaps = 40;
+	lg.stagger = 50;
+	lg.reportInterval = 1000;
+	Q_strncpyz( lg.namePrefix, "loadgen", sizeof( lg.namePrefix ) );
+
+	for ( i = 1; i < argc; ++i ) {
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if ( !Q_stricmp( arg, "-sameip" ) ) {
+			lg.sameIP = qtrue;
+			continue;
+		}
+		if ( !value ) {
+			return qfalse;
+		}
+		++i;
+
+		if ( !Q_stricmp( arg, "-server" ) ) {
+			server = value;
+		} else if ( !Q_stricmp( arg, "-clients" ) ) {
+			lg.numClients = atoi( value );
+		} else if ( !Q_stricmp( arg, "-duration" ) ) {
+			lg.duration = atoi( value );
+		} else if ( !Q_stricmp( arg, "-cmdrate" ) ) {
+			lg.cmdRate = atoi( value );
+		} else if ( !Q_stricmp( arg, "-packetrate" ) ) {
+			lg.packetRate = atoi( value );
+		} else if ( !Q_stricmp( arg, "-packetdup" ) ) {
+			lg.packetDup = atoi( value );
+		} else if ( !Q_stricmp( arg, "-rate" ) ) {
+			lg.rate = atoi( value );
+		} else if ( !Q_stricmp( arg, "-snaps" ) ) {
+			lg.snaps = atoi( value );
+		} else if ( !Q_stricmp( arg, "-stagger" ) ) {
+			lg.stagger = atoi( value );
+		} else if ( !Q_stricmp( arg, "-interval" ) ) {
+			lg.reportInterval = atoi( value );
+		} else if ( !Q_stricmp( arg, "-name" ) ) {
+			Q_strncpyz( lg.namePrefix, value, sizeof( lg.namePrefix ) );
+		} else {
+			return qfalse;
+		}
+	}
+
+	lg.numClients = Com_Clamp( 1, LG_MAX_CLIENTS, lg.numClients );
+	lg.cmdRate = Com_Clamp( 1, 1000, lg.cmdRate );
+	lg.packetRate = Com_Clamp( 1, 1000, lg.packetRate );
+	lg.packetDup = Com_Clamp( 0, 5, lg.packetDup );
+	lg.stagger = Com_Clamp( 0, 10000, lg.stagger );
+	lg.reportInterval = Com_Clamp( 100, 60000, lg.reportInterval );
+
+	if ( !NET_StringToAdr( server, &lg.serverAddress, NA_IP ) || lg.serverAddress.type != NA_IP ) {
+		fprintf( stderr, "ERROR: bad server address '%s'\n", server );
+		return qfalse;
+	}
+
+	Com_Memset( &lg.serverSockaddr, 0, sizeof( lg.serverSockaddr ) );
+	lg.serverSockaddr.sin_family = AF_INET;
+	Com_Memcpy( &lg.serverSockaddr.sin_addr, lg.serverAddress.ipv._4, 4 );
+	lg.serverSockaddr.sin_port = lg.serverAddress.port;
+	return qtrue;
+}
+
+/*
+==================
+main
+==================
+*/
+int main( int argc, char **argv ) {
+	struct pollfd *pollfds;
+	int started = 0;
+	int lastReport;
+	int i;
+
+	if ( !LG_ParseArgs( argc, argv ) ) {
+		LG_Usage();
+		return 1;
+	}
+
+	com_timescale = Cvar_Get( "timescale", "1", 0 );
+	sv_packetdelay = Cvar_Get( "sv_packetdelay", "0", 0 );
+	cl_packetdelay = Cvar_Get( "cl_packetdelay", "0", 0 );
+	cl_shownet = Cvar_Get( "cl_shownet", "0", 0 );
+	Netchan_Init( 0 );
+	srand( (unsigned int)time( NULL ) );
+
+	lg.clients = (lgClient_t *)calloc( lg.numClients, sizeof( lgClient_t ) );
+	pollfds = (struct pollfd *)calloc( lg.numClients, sizeof( struct pollfd ) );
+	if ( !lg.clients || !pollfds ) {
+		fprintf( stderr, "ERROR: out of memory\n" );
+		return 1;
+	}
+	for ( i = 0; i < lg.numClients; ++i ) {
+		lg.clients[i].clientNum = i;
+		lg.clients[i].socket = -1;
+		lg.clients[i].state = LG_FAILED;
+	}
+
+	Com_Printf( "Connecting %i clients to %s\n", lg.numClients, NET_AdrToString( &lg.serverAddress ) );
+	lg.startTime = Sys_Milliseconds();
+	lastReport = lg.startTime;
+
+	while ( 1 ) {
+		int time = Sys_Milliseconds();
+		int count = 0;
+
+		if ( lg.duration > 0 && time - lg.startTime >= lg.duration * 1000 ) {
+			break;
+		}
+
+		// start clients at staggered intervals
+		while ( started < lg.numClients && time - lg.startTime >= started * lg.stagger ) {
+			LG_StartClient( &lg.clients[started], time );
+			++started;
+		}
+
+		for ( i = 0; i < started; ++i ) {
+			LG_ClientFrame( &lg.clients[i], time );
+		}
+
+		if ( time - lastReport >= lg.reportInterval ) {
+			LG_PrintInterval( time, time - lastReport );
+			lastReport = time;
+		}
+
+		// wait for packets
+		for ( i = 0; i < started; ++i ) {
+			pollfds[i].fd = lg.clients[i].state != LG_FAILED ? lg.clients[i].socket : -1;
+			pollfds[i].events = POLLIN;
+			pollfds[i].revents = 0;
+			if ( pollfds[i].fd >= 0 ) {
+				++count;
+			}
+		}
+		if ( !count && started >= lg.numClients ) {
+			Com_Printf( "All clients failed.\n" );
+			break;
+		}
+		if ( poll( pollfds, started, 1 ) <= 0 ) {
+			continue;
+		}
+
+		for ( i = 0; i < started; ++i ) {
+			lgClient_t *cl = &lg.clients[i];
+			byte data[MAX_MSGLEN_BUF];
+			int length;
+
+			if ( !( pollfds[i].revents & POLLIN ) ) {
+				continue;
+			}
+			while ( cl->state != LG_FAILED && ( length = recv( cl->socket, data, MAX_PACKETLEN, 0 ) ) >= 0 ) {
+				LG_PacketEvent( cl, data, length );
+			}
+		}
+	}
+
+	for ( i = 0; i < started; ++i ) {
+		LG_Disconnect( &lg.clients[i] );
+	}
+
+	LG_PrintSummary( Sys_Milliseconds() );
+	return 0;
+}
@@ -33,6 +33,13 @@ void Record_ProcessSnapshot( void );
 void Record_ProcessGameShutdown( void );
 qboolean Record_ProcessClientConnect( const netadr_t *address, const char *userinfo, int challenge, int qport, qboolean compat );
 qboolean Record_ProcessPacketEvent( const netadr_t *address, msg_t *msg, int qport );
+#ifdef STEF_RECORD_RELAY
+qboolean Record_RelayModeActive( void );
+qboolean Record_ProcessRelayFrame( int msec );
+#endif
+#ifdef STEF_RECORD_ENTITY_TRACKER
+void Record_ProcessEntityLink( int entityNum );
+#endif
 #endif
 
 #ifdef STEF_LUA_SERVER
@@ -70,6 +77,10 @@ qboolean SV_Lua_PacketCommand( const netadr_t *from );
 void SV_Lua_HandleClientUserinfo( int clientNum, char *buffer, int bufSize );
 #endif
 
+#ifdef STEF_STATUS_CACHE
+void SV_StatusCache_Invalidate( void );
+#endif
+
 #ifdef STEF_GAMESTATE_OVERFLOW_FIX
 void SV_CalculateMaxBaselines( client_t *client, msg_t msg );
 #endif
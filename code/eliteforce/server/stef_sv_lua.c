@@ -310,6 +310,9 @@ static int SV_Lua_UpdateEngineConfigstring( lua_State *L ) {
 	} else if ( strcmp( val, sv.configstrings[index] ) ) {
 		Z_Free( sv.configstrings[index] );
 		sv.configstrings[index] = CopyString( val );
+#ifdef STEF_STATUS_CACHE
+		SV_StatusCache_Invalidate();
+#endif
 #ifdef STEF_SERVER_RECORD
 		Record_ProcessConfigstring( index, val );
 #endif
@@ -345,6 +348,55 @@ static int SV_Lua_ExecClientCmd( lua_State *L ) {
 	return 0;
 }
 
+#ifdef STEF_SV_PERF
+/*
+=================
+SV_Lua_GetPerfStats
+
+Returns table of server frame timing statistics, in microseconds.
+
+Result fields:
+- frames: number of frames in the statistics window
+- overruns: frames exceeding the 1000/sv_fps frame time since last reset
+- budget: current frame time budget
+- phases: table indexed by phase name ("frame", "game", "bots", etc.), where each
+  entry contains "last", "p50", "p99", and "max" fields
+=================
+*/
+static int SV_Lua_GetPerfStats( lua_State *L ) {
+	int windowFrames, overruns, budget;
+	int i;
+
+	SV_Perf_GetFrameInfo( &windowFrames, &overruns, &budget );
+	lua_newtable( L );
+	lua_pushinteger( L, windowFrames );
+	lua_setfield( L, -2, "frames" );
+	lua_pushinteger( L, overruns );
+	lua_setfield( L, -2, "overruns" );
+	lua_pushinteger( L, budget );
+	lua_setfield( L, -2, "budget" );
+
+	lua_newtable( L );
+	for ( i = 0; i < SV_PERF_NUM_PHASES; ++i ) {
+		svPerfStats_t stats;
+		SV_Perf_GetStats( (svPerfPhase_t)i, &stats );
+		lua_newtable( L );
+		lua_pushinteger( L, stats.last );
+		lua_setfield( L, -2, "last" );
+		lua_pushinteger( L, stats.p50 );
+		lua_setfield( L, -2, "p50" );
+		lua_pushinteger( L, stats.p99 );
+		lua_setfield( L, -2, "p99" );
+		lua_pushinteger( L, stats.max );
+		lua_setfield( L, -2, "max" );
+		lua_setfield( L, -2, stats.name );
+	}
+	lua_setfield( L, -2, "phases" );
+
+	return 1;
+}
+#endif
+
 /*
 =================
 SV_Lua_SetupInterace
@@ -369,6 +421,9 @@ static void SV_Lua_SetupInterface( lua_State *L ) {
 	ADD_FUNCTION( "send_gamestate", SV_Lua_SendGamestate );
 	ADD_FUNCTION( "update_engine_configstring", SV_Lua_UpdateEngineConfigstring );
 	ADD_FUNCTION( "exec_client_cmd", SV_Lua_ExecClientCmd );
+#ifdef STEF_SV_PERF
+	ADD_FUNCTION( "get_perf_stats", SV_Lua_GetPerfStats );
+#endif
 
 	#define ADD_STRING_CONSTANT( name, value ) \
 		lua_pushstring( L, value ); \
@@ -0,0 +1,337 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+Copyright (C) 2017-2023 Noah Metzger (chomenor@gmail.com)
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+
+// Server frame profiler. Measures time spent in each phase of the server frame in
+// microseconds, and keeps a histogram of the most recent frames for each phase.
+
+#ifdef STEF_SV_PERF
+#include "../../server/server.h"
+
+// number of frames in the rolling window
+#define PERF_WINDOW 1024
+
+// histogram buckets are exact below 8 usec, then split each power of two into 8 steps
+#define PERF_SUB_BUCKETS 8
+#define PERF_BUCKETS ( 30 * PERF_SUB_BUCKETS )
+
+typedef struct {
+	int depth;
+	int64_t startTime;
+	int64_t accumulated;
+
+	unsigned int samples[PERF_WINDOW];
+	unsigned int histogram[PERF_BUCKETS];
+} perfPhase_t;
+
+typedef struct {
+	perfPhase_t phases[SV_PERF_NUM_PHASES];
+	int frameCount;		// total committed frames since reset
+	int overruns;		// frames exceeding sv_fps frame time since reset
+} perfState_t;
+
+static perfState_t perf;
+
+static const char *perfPhaseNames[SV_PERF_NUM_PHASES] = {
+	"frame",
+	"game",
+	"bots",
+	"pings",
+	"snapshot_build",
+	"snapshot_encode",
+	"transmit",
+	"record",
+	"lua",
+};
+
+/* ******************************************************************************** */
+// Histogram
+/* ******************************************************************************** */
+
+/*
+==================
+SV_Perf_BucketForValue
+==================
+*/
+static int SV_Perf_BucketForValue( unsigned int value ) {
+	int exponent = 0;
+	int bucket;
+
+	if ( value < PERF_SUB_BUCKETS ) {
+		return (int)value;
+	}
+
+	while ( ( value >> exponent ) >= PERF_SUB_BUCKETS * 2 ) {
+		++exponent;
+	}
+
+	bucket = ( exponent + 1 ) * PERF_SUB_BUCKETS + (int)( ( value >> exponent ) - PERF_SUB_BUCKETS );
+	return bucket < PERF_BUCKETS ? bucket : PERF_BUCKETS - 1;
+}
+
+/*
+==================
+SV_Perf_BucketMaxValue
+
+Returns highest value that falls in bucket.
+==================
+*/
+static unsigned int SV_Perf_BucketMaxValue( int bucket ) {
+	int exponent;
+	unsigned int base;
+
+	if ( bucket < PERF_SUB_BUCKETS ) {
+		return (unsigned int)bucket;
+	}
+
+	exponent = bucket / PERF_SUB_BUCKETS - 1;
+	base = (unsigned int)( bucket % PERF_SUB_BUCKETS + PERF_SUB_BUCKETS );
+	return ( ( base + 1 ) << exponent ) - 1;
+}
+
+/*
+==================
+SV_Perf_Percentile
+
+Returns upper bound of the histogram bucket containing the given percentile.
+==================
+*/
+static unsigned int SV_Perf_Percentile( const perfPhase_t *phase, int count, int percent ) {
+	int target = ( count * percent + 99 ) / 100;
+	int total = 0;
+	int i;
+
+	if ( target < 1 ) {
+		target = 1;
+	}
+
+	for ( i = 0; i < PERF_BUCKETS; ++i ) {
+		total += phase->histogram[i];
+		if ( total >= target ) {
+			return SV_Perf_BucketMaxValue( i );
+		}
+	}
+
+	return 0;
+}
+
+/* ******************************************************************************** */
+// Measurement
+/* ******************************************************************************** */
+
+/*
+==================
+SV_Perf_Begin
+
+Starts timing a phase. Calls can be nested, in which case the phase is timed from the
+outermost begin to the matching end. Phases can also overlap, so a phase nested inside
+another (e.g. Lua events called from the game VM) is counted in both.
+==================
+*/
+void SV_Perf_Begin( svPerfPhase_t phase ) {
+	perfPhase_t *p = &perf.phases[phase];
+	if ( p->depth++ == 0 ) {
+		p->startTime = Sys_Microseconds();
+	}
+}
+
+/*
+==================
+SV_Perf_End
+==================
+*/
+void SV_Perf_End( svPerfPhase_t phase ) {
+	perfPhase_t *p = &perf.phases[phase];
+	if ( p->depth > 0 && --p->depth == 0 ) {
+		p->accumulated += Sys_Microseconds() - p->startTime;
+	}
+}
+
+/*
+==================
+SV_Perf_ClearActive
+
+Discards any phases still in progress, which can be left over if an error interrupted a frame.
+==================
+*/
+static void SV_Perf_ClearActive( void ) {
+	int i;
+
+	for ( i = 0; i < SV_PERF_NUM_PHASES; ++i ) {
+		perf.phases[i].depth = 0;
+		perf.phases[i].startTime = 0;
+	}
+}
+
+/*
+==================
+SV_Perf_BeginFrame
+
+Called at the start of each server frame, before any phases are started.
+==================
+*/
+void SV_Perf_BeginFrame( void ) {
+	SV_Perf_ClearActive();
+}
+
+/*
+==================
+SV_Perf_CommitFrame
+
+Adds time accumulated for each phase since the previous commit to the histograms.
+Called at the end of server frames that ran the game simulation, so work done by calls
+that didn't advance the game (e.g. extra snapshots on listen servers) is included with
+the next game frame.
+==================
+*/
+void SV_Perf_CommitFrame( void ) {
+	int slot = perf.frameCount % PERF_WINDOW;
+	int i;
+
+	for ( i = 0; i < SV_PERF_NUM_PHASES; ++i ) {
+		perfPhase_t *p = &perf.phases[i];
+		unsigned int value = p->accumulated > 0x7fffffff ? 0x7fffffff : (unsigned int)p->accumulated;
+
+		if ( perf.frameCount >= PERF_WINDOW ) {
+			--p->histogram[SV_Perf_BucketForValue( p->samples[slot] )];
+		}
+		p->samples[slot] = value;
+		++p->histogram[SV_Perf_BucketForValue( value )];
+		p->accumulated = 0;
+	}
+
+	if ( sv_fps->integer > 0 && perf.phases[SV_PERF_FRAME].samples[slot] > 1000000u / sv_fps->integer ) {
+		++perf.overruns;
+	}
+
+	++perf.frameCount;
+}
+
+/*
+==================
+SV_Perf_GetStats
+
+Retrieves statistics for phase over the current window, in microseconds.
+Returns qfalse if no frames have been recorded.
+==================
+*/
+qboolean SV_Perf_GetStats( svPerfPhase_t phase, svPerfStats_t *stats ) {
+	const perfPhase_t *p = &perf.phases[phase];
+	int count = perf.frameCount < PERF_WINDOW ? perf.frameCount : PERF_WINDOW;
+	int i;
+
+	Com_Memset( stats, 0, sizeof( *stats ) );
+	stats->name = perfPhaseNames[phase];
+	if ( !count ) {
+		return qfalse;
+	}
+
+	stats->last = p->samples[( perf.frameCount - 1 ) % PERF_WINDOW];
+	stats->p50 = SV_Perf_Percentile( p, count, 50 );
+	stats->p99 = SV_Perf_Percentile( p, count, 99 );
+	for ( i = 0; i < count; ++i ) {
+		if ( p->samples[i] > stats->max ) {
+			stats->max = p->samples[i];
+		}
+	}
+
+	return qtrue;
+}
+
+/*
+==================
+SV_Perf_GetFrameInfo
+
+Retrieves number of frames in the current window, total overruns since reset, and
+current frame time budget in microseconds.
+==================
+*/
+void SV_Perf_GetFrameInfo( int *windowFrames, int *overruns, int *budget ) {
+	*windowFrames = perf.frameCount < PERF_WINDOW ? perf.frameCount : PERF_WINDOW;
+	*overruns = perf.overruns;
+	*budget = sv_fps->integer > 0 ? 1000000 / sv_fps->integer : 0;
+}
+
+/*
+==================
+SV_Perf_Reset
+==================
+*/
+static void SV_Perf_Reset( void ) {
+	int i;
+
+	perf.frameCount = 0;
+	perf.overruns = 0;
+	SV_Perf_ClearActive();
+	for ( i = 0; i < SV_PERF_NUM_PHASES; ++i ) {
+		perfPhase_t *p = &perf.phases[i];
+		p->accumulated = 0;
+		Com_Memset( p->samples, 0, sizeof( p->samples ) );
+		Com_Memset( p->histogram, 0, sizeof( p->histogram ) );
+	}
+}
+
+/* ******************************************************************************** */
+// Console Command
+/* ******************************************************************************** */
+
+/*
+==================
+SV_Perf_Cmd
+
+Prints frame phase statistics, or resets them with "sv_perf reset".
+==================
+*/
+static void SV_Perf_Cmd( void ) {
+	int windowFrames, overruns, budget;
+	int i;
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		SV_Perf_Reset();
+		Com_Printf( "Server frame statistics reset.\n" );
+		return;
+	}
+
+	SV_Perf_GetFrameInfo( &windowFrames, &overruns, &budget );
+	if ( !windowFrames ) {
+		Com_Printf( "No server frames recorded.\n" );
+		return;
+	}
+
+	Com_Printf( "Last %i frames, budget %i usec, %i overruns since reset\n", windowFrames, budget, overruns );
+	Com_Printf( "phase               last      p50      p99      max (usec)\n" );
+	for ( i = 0; i < SV_PERF_NUM_PHASES; ++i ) {
+		svPerfStats_t stats;
+		SV_Perf_GetStats( (svPerfPhase_t)i, &stats );
+		Com_Printf( "%-16s %7u  %7u  %7u  %7u\n", stats.name, stats.last, stats.p50, stats.p99, stats.max );
+	}
+}
+
+/*
+==================
+SV_Perf_Init
+==================
+*/
+void SV_Perf_Init( void ) {
+	Cmd_AddCommand( "sv_perf", SV_Perf_Cmd );
+}
+#endif
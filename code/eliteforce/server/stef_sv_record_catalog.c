@@ -0,0 +1,751 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+Copyright (C) 2017-2023 Noah Metzger (chomenor@gmail.com)
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+
+#ifdef STEF_SERVER_RECORD
+#include "stef_sv_record_local.h"
+
+#ifdef STEF_RECORD_CATALOG
+#include "../../filesystem/fscore/fscore.h"
+#include <time.h>
+
+// Each completed record file gets a sidecar metadata file with the same name and a .meta
+// extension. The metadata is text, with one info string per line: a "record" line with map
+// and time information, followed by a "player" line for each client session.
+//
+// The catalog index (records/catalog.idx) holds the contents of every metadata file in the
+// records directory, so it can be searched without opening each file. It is updated
+// incrementally, only reading metadata files that were added or changed since the last update.
+
+#define RECORD_METADATA_VERSION 1
+#define RECORD_METADATA_MAX_SIZE ( 256 * 1024 )
+
+#define RECORD_CATALOG_PATH "records/catalog.idx"
+#define RECORD_CATALOG_MAGIC 0x54414352	// "RCAT"
+#define RECORD_CATALOG_VERSION 1
+
+/* ******************************************************************************** */
+// Metadata Writing
+/* ******************************************************************************** */
+
+typedef struct {
+	int clientNum;
+	qboolean bot;
+	qboolean active;	// session hasn't ended yet
+	int score;
+	char name[MAX_NAME_LENGTH];
+	char keys[MAX_INFO_STRING];
+} record_metadata_player_t;
+
+struct record_metadata_s {
+	char map[MAX_QPATH];
+	unsigned int startTime;
+
+	record_metadata_player_t *players;
+	int playerCount;
+	int playerSize;
+};
+
+/*
+==================
+Record_Metadata_AppendValue
+
+Appends key and value to info string line, replacing characters that would break parsing.
+==================
+*/
+static void Record_Metadata_AppendValue( char *line, int size, const char *key, const char *value ) {
+	char buffer[MAX_INFO_STRING];
+	char *p;
+
+	Q_strncpyz( buffer, value, sizeof( buffer ) );
+	for ( p = buffer; *p; ++p ) {
+		if ( *p == '\\' || *p == '\n' || *p == '\r' ) {
+			*p = ' ';
+		}
+	}
+
+	Q_strcat( line, size, va( "\\%s\\%s", key, buffer ) );
+}
+
+/*
+==================
+Record_Metadata_Create
+==================
+*/
+record_metadata_t *Record_Metadata_Create( void ) {
+	record_metadata_t *metadata = (record_metadata_t *)Record_Calloc( sizeof( *metadata ) );
+	Q_strncpyz( metadata->map, Cvar_VariableString( "mapname" ), sizeof( metadata->map ) );
+	metadata->startTime = (unsigned int)time( NULL );
+	return metadata;
+}
+
+/*
+==================
+Record_Metadata_Free
+==================
+*/
+void Record_Metadata_Free( record_metadata_t *metadata ) {
+	if ( metadata->players ) {
+		Record_Free( metadata->players );
+	}
+	Record_Free( metadata );
+}
+
+/*
+==================
+Record_Metadata_AddPlayer
+
+Starts a player session when client enters the recording.
+==================
+*/
+void Record_Metadata_AddPlayer( record_metadata_t *metadata, int clientNum ) {
+	client_t *cl = &svs.clients[clientNum];
+	record_metadata_player_t *player;
+	const char *keys = sv_recordCatalogKeys->string;
+	const char *token;
+
+	if ( metadata->playerCount >= metadata->playerSize ) {
+		record_metadata_player_t *oldPlayers = metadata->players;
+		metadata->playerSize = metadata->playerSize ? metadata->playerSize * 2 : 32;
+		metadata->players = (record_metadata_player_t *)Record_Calloc( sizeof( *metadata->players ) * metadata->playerSize );
+		if ( oldPlayers ) {
+			Com_Memcpy( metadata->players, oldPlayers, sizeof( *metadata->players ) * metadata->playerCount );
+			Record_Free( oldPlayers );
+		}
+	}
+
+	player = &metadata->players[metadata->playerCount++];
+	player->clientNum = clientNum;
+	player->bot = cl->netchan.remoteAddress.type == NA_BOT ? qtrue : qfalse;
+	player->active = qtrue;
+	Q_strncpyz( player->name, cl->name, sizeof( player->name ) );
+
+	// Copy configured userinfo keys
+	while ( 1 ) {
+		token = COM_ParseExt( &keys, qfalse );
+		if ( !*token ) {
+			break;
+		}
+		if ( *Info_ValueForKey( cl->userinfo, token ) ) {
+			Record_Metadata_AppendValue( player->keys, sizeof( player->keys ), token,
+					Info_ValueForKey( cl->userinfo, token ) );
+		}
+	}
+}
+
+/*
+==================
+Record_Metadata_EndPlayer
+
+Ends the current session for client, using the last recorded playerstate for the score.
+==================
+*/
+void Record_Metadata_EndPlayer( record_metadata_t *metadata, int clientNum, playerState_t *ps ) {
+	int i;
+	for ( i = metadata->playerCount - 1; i >= 0; --i ) {
+		record_metadata_player_t *player = &metadata->players[i];
+		if ( player->clientNum == clientNum && player->active ) {
+			// Use latest name in case it changed during the session
+			if ( *svs.clients[clientNum].name ) {
+				Q_strncpyz( player->name, svs.clients[clientNum].name, sizeof( player->name ) );
+			}
+			player->score = Record_PlayerstateScore( ps );
+			player->active = qfalse;
+			return;
+		}
+	}
+}
+
+/*
+==================
+Record_Metadata_Write
+
+Writes metadata file. Any sessions still active should be ended first.
+==================
+*/
+void Record_Metadata_Write( record_metadata_t *metadata, const char *path, int duration ) {
+	fileHandle_t fp = FS_SV_FOpenFileWrite( path );
+	char line[MAX_INFO_STRING * 2];
+	int i;
+
+	if ( !fp ) {
+		Record_Printf( RP_ALL, "Record_Metadata_Write: failed to open %s\n", path );
+		return;
+	}
+
+	*line = '\0';
+	Record_Metadata_AppendValue( line, sizeof( line ), "type", "record" );
+	Record_Metadata_AppendValue( line, sizeof( line ), "version", va( "%i", RECORD_METADATA_VERSION ) );
+	Record_Metadata_AppendValue( line, sizeof( line ), "map", metadata->map );
+	Record_Metadata_AppendValue( line, sizeof( line ), "start", va( "%u", metadata->startTime ) );
+	Record_Metadata_AppendValue( line, sizeof( line ), "end", va( "%u", (unsigned int)time( NULL ) ) );
+	Record_Metadata_AppendValue( line, sizeof( line ), "duration", va( "%i", duration ) );
+	Record_Metadata_AppendValue( line, sizeof( line ), "scores1", sv.configstrings[Record_TeamScoreConfigstring( 0 )] );
+	Record_Metadata_AppendValue( line, sizeof( line ), "scores2", sv.configstrings[Record_TeamScoreConfigstring( 1 )] );
+	Q_strcat( line, sizeof( line ), "\n" );
+	FS_Write( line, strlen( line ), fp );
+
+	for ( i = 0; i < metadata->playerCount; ++i ) {
+		record_metadata_player_t *player = &metadata->players[i];
+		*line = '\0';
+		Record_Metadata_AppendValue( line, sizeof( line ), "type", "player" );
+		Record_Metadata_AppendValue( line, sizeof( line ), "client", va( "%i", player->clientNum ) );
+		Record_Metadata_AppendValue( line, sizeof( line ), "name", player->name );
+		Record_Metadata_AppendValue( line, sizeof( line ), "score", va( "%i", player->score ) );
+		if ( player->bot ) {
+			Record_Metadata_AppendValue( line, sizeof( line ), "bot", "1" );
+		}
+		Q_strcat( line, sizeof( line ), player->keys );
+		Q_strcat( line, sizeof( line ), "\n" );
+		FS_Write( line, strlen( line ), fp );
+	}
+
+	FS_FCloseFile( fp );
+}
+
+/* ******************************************************************************** */
+// Catalog Index
+/* ******************************************************************************** */
+
+typedef struct {
+	char *path;		// metadata file path within records directory
+	unsigned int timestamp;
+	unsigned int size;
+	char *metadata;
+} record_catalog_entry_t;
+
+typedef struct {
+	record_catalog_entry_t *entries;
+	int count;
+	int size;
+} record_catalog_t;
+
+typedef struct {
+	char *path;
+	unsigned int timestamp;
+	unsigned int size;
+} record_catalog_file_t;
+
+typedef struct {
+	record_catalog_file_t *files;
+	int count;
+	int size;
+} record_catalog_file_list_t;
+
+typedef struct {
+	record_catalog_file_list_t metadataFiles;
+	record_catalog_file_list_t recordFiles;
+} record_catalog_scan_t;
+
+/*
+==================
+Record_Catalog_CopyString
+==================
+*/
+static char *Record_Catalog_CopyString( const char *string ) {
+	char *copy = (char *)Record_Calloc( strlen( string ) + 1 );
+	strcpy( copy, string );
+	return copy;
+}
+
+/*
+==================
+Record_Catalog_AddEntry
+
+Takes ownership of path and metadata.
+==================
+*/
+static void Record_Catalog_AddEntry( record_catalog_t *catalog, char *path, unsigned int timestamp,
+		unsigned int size, char *metadata ) {
+	record_catalog_entry_t *entry;
+	if ( catalog->count >= catalog->size ) {
+		record_catalog_entry_t *oldEntries = catalog->entries;
+		catalog->size = catalog->size ? catalog->size * 2 : 256;
+		catalog->entries = (record_catalog_entry_t *)Record_Calloc( sizeof( *catalog->entries ) * catalog->size );
+		if ( oldEntries ) {
+			Com_Memcpy( catalog->entries, oldEntries, sizeof( *catalog->entries ) * catalog->count );
+			Record_Free( oldEntries );
+		}
+	}
+
+	entry = &catalog->entries[catalog->count++];
+	entry->path = path;
+	entry->timestamp = timestamp;
+	entry->size = size;
+	entry->metadata = metadata;
+}
+
+/*
+==================
+Record_Catalog_Free
+==================
+*/
+static void Record_Catalog_Free( record_catalog_t *catalog ) {
+	int i;
+	for ( i = 0; i < catalog->count; ++i ) {
+		if ( catalog->entries[i].path ) {
+			Record_Free( catalog->entries[i].path );
+		}
+		if ( catalog->entries[i].metadata ) {
+			Record_Free( catalog->entries[i].metadata );
+		}
+	}
+	if ( catalog->entries ) {
+		Record_Free( catalog->entries );
+	}
+	Com_Memset( catalog, 0, sizeof( *catalog ) );
+}
+
+/*
+==================
+Record_Catalog_CompareEntries
+==================
+*/
+static int Record_Catalog_CompareEntries( const void *entry1, const void *entry2 ) {
+	return strcmp( ( (const record_catalog_entry_t *)entry1 )->path, ( (const record_catalog_entry_t *)entry2 )->path );
+}
+
+/*
+==================
+Record_Catalog_FindEntry
+==================
+*/
+static record_catalog_entry_t *Record_Catalog_FindEntry( record_catalog_t *catalog, const char *path ) {
+	record_catalog_entry_t key;
+	if ( !catalog->count ) {
+		return NULL;
+	}
+	key.path = (char *)path;
+	return (record_catalog_entry_t *)bsearch( &key, catalog->entries, catalog->count, sizeof( *catalog->entries ),
+			Record_Catalog_CompareEntries );
+}
+
+/*
+==================
+Record_Catalog_ReadFile
+
+Returns null terminated file contents, or NULL on error. Result must be freed with Record_Free.
+==================
+*/
+static char *Record_Catalog_ReadFile( const char *path, unsigned int maxSize, unsigned int *sizeOut ) {
+	fileHandle_t fp;
+	long size = FS_SV_FOpenFileRead( path, &fp );
+	char *data;
+
+	if ( !fp ) {
+		return NULL;
+	}
+	if ( size < 0 || (unsigned long)size > maxSize ) {
+		FS_FCloseFile( fp );
+		return NULL;
+	}
+
+	data = (char *)Record_Calloc( size + 1 );
+	if ( FS_Read( data, size, fp ) != size ) {
+		Record_Free( data );
+		FS_FCloseFile( fp );
+		return NULL;
+	}
+
+	FS_FCloseFile( fp );
+	if ( sizeOut ) {
+		*sizeOut = (unsigned int)size;
+	}
+	return data;
+}
+
+/*
+==================
+Record_Catalog_Load
+
+Loads existing catalog index. Leaves catalog empty if the index doesn't exist or is invalid.
+==================
+*/
+static void Record_Catalog_Load( record_catalog_t *catalog ) {
+	record_data_stream_t stream;
+	unsigned int size = 0;
+	int i, count;
+
+	Com_Memset( &stream, 0, sizeof( stream ) );
+	stream.data = Record_Catalog_ReadFile( RECORD_CATALOG_PATH, 0x7fffffff, &size );
+	if ( !stream.data ) {
+		return;
+	}
+	stream.size = size;
+
+	stream.abortSet = qtrue;
+	if ( setjmp( stream.abort ) ) {
+		Record_Printf( RP_ALL, "Invalid catalog index; rebuilding\n" );
+		Record_Catalog_Free( catalog );
+		Record_Free( stream.data );
+		return;
+	}
+
+	if ( *(int *)Record_Stream_ReadStatic( 4, &stream ) != RECORD_CATALOG_MAGIC ||
+			*(int *)Record_Stream_ReadStatic( 4, &stream ) != RECORD_CATALOG_VERSION ) {
+		Record_Stream_Error( &stream, "Record_Catalog_Load: unsupported catalog index" );
+	}
+
+	count = *(int *)Record_Stream_ReadStatic( 4, &stream );
+	for ( i = 0; i < count; ++i ) {
+		char *path = Record_DecodeString( &stream );
+		unsigned int timestamp = *(unsigned int *)Record_Stream_ReadStatic( 4, &stream );
+		unsigned int fileSize = *(unsigned int *)Record_Stream_ReadStatic( 4, &stream );
+		char *metadata = Record_DecodeString( &stream );
+		Record_Catalog_AddEntry( catalog, Record_Catalog_CopyString( path ), timestamp, fileSize,
+				Record_Catalog_CopyString( metadata ) );
+	}
+
+	stream.abortSet = qfalse;
+	Record_Free( stream.data );
+
+	qsort( catalog->entries, catalog->count, sizeof( *catalog->entries ), Record_Catalog_CompareEntries );
+}
+
+/*
+==================
+Record_Catalog_Save
+==================
+*/
+static void Record_Catalog_Save( record_catalog_t *catalog ) {
+	record_data_stream_t stream;
+	fileHandle_t fp;
+	unsigned int size = 12;
+	int i;
+
+	for ( i = 0; i < catalog->count; ++i ) {
+		size += 8 + strlen( catalog->entries[i].path ) + 1;
+		size += 8 + strlen( catalog->entries[i].metadata ) + 1;
+	}
+
+	Com_Memset( &stream, 0, sizeof( stream ) );
+	stream.data = (char *)Record_Calloc( size );
+	stream.size = size;
+
+	Record_Stream_WriteValue( RECORD_CATALOG_MAGIC, 4, &stream );
+	Record_Stream_WriteValue( RECORD_CATALOG_VERSION, 4, &stream );
+	Record_Stream_WriteValue( catalog->count, 4, &stream );
+	for ( i = 0; i < catalog->count; ++i ) {
+		Record_EncodeString( catalog->entries[i].path, &stream );
+		Record_Stream_WriteValue( (int)catalog->entries[i].timestamp, 4, &stream );
+		Record_Stream_WriteValue( (int)catalog->entries[i].size, 4, &stream );
+		Record_EncodeString( catalog->entries[i].metadata, &stream );
+	}
+
+	fp = FS_SV_FOpenFileWrite( RECORD_CATALOG_PATH );
+	if ( fp ) {
+		FS_Write( stream.data, stream.position, fp );
+		FS_FCloseFile( fp );
+	} else {
+		Record_Printf( RP_ALL, "Failed to write catalog index\n" );
+	}
+
+	Record_Free( stream.data );
+}
+
+/* ******************************************************************************** */
+// Directory Scanning
+/* ******************************************************************************** */
+
+/*
+==================
+Record_Catalog_AddFile
+==================
+*/
+static void Record_Catalog_AddFile( record_catalog_file_list_t *list, iterate_data_t *file_data ) {
+	record_catalog_file_t *file;
+	if ( list->count >= list->size ) {
+		record_catalog_file_t *oldFiles = list->files;
+		list->size = list->size ? list->size * 2 : 256;
+		list->files = (record_catalog_file_t *)Record_Calloc( sizeof( *list->files ) * list->size );
+		if ( oldFiles ) {
+			Com_Memcpy( list->files, oldFiles, sizeof( *list->files ) * list->count );
+			Record_Free( oldFiles );
+		}
+	}
+
+	file = &list->files[list->count++];
+	file->path = Record_Catalog_CopyString( file_data->qpath_with_mod_dir );
+	file->timestamp = file_data->os_timestamp;
+	file->size = file_data->filesize;
+}
+
+/*
+==================
+Record_Catalog_IterateFile
+==================
+*/
+static void Record_Catalog_IterateFile( iterate_data_t *file_data, void *context ) {
+	record_catalog_scan_t *scan = (record_catalog_scan_t *)context;
+	const char *extension = COM_GetExtension( file_data->qpath_with_mod_dir );
+
+	if ( !Q_stricmp( extension, "meta" ) ) {
+		Record_Catalog_AddFile( &scan->metadataFiles, file_data );
+	} else if ( !Q_stricmp( extension, "rec" ) && Q_stricmp( file_data->qpath_with_mod_dir, "current.rec" ) ) {
+		Record_Catalog_AddFile( &scan->recordFiles, file_data );
+	}
+}
+
+/*
+==================
+Record_Catalog_CompareFiles
+==================
+*/
+static int Record_Catalog_CompareFiles( const void *file1, const void *file2 ) {
+	return strcmp( ( (const record_catalog_file_t *)file1 )->path, ( (const record_catalog_file_t *)file2 )->path );
+}
+
+/*
+==================
+Record_Catalog_FreeFileList
+==================
+*/
+static void Record_Catalog_FreeFileList( record_catalog_file_list_t *list ) {
+	int i;
+	for ( i = 0; i < list->count; ++i ) {
+		Record_Free( list->files[i].path );
+	}
+	if ( list->files ) {
+		Record_Free( list->files );
+	}
+}
+
+/*
+==================
+Record_Catalog_Update
+
+Updates catalog to match the metadata files currently in the records directory, and saves
+the index if anything changed.
+==================
+*/
+static void Record_Catalog_Update( record_catalog_t *catalog ) {
+	record_catalog_scan_t scan;
+	record_catalog_t updated;
+	char osPath[FS_MAX_PATH];
+	fsc_ospath_t *fscOsPath;
+	int added = 0;
+	int unchanged = 0;
+	int missing = 0;
+	int i;
+
+	Com_Memset( &scan, 0, sizeof( scan ) );
+	Com_Memset( &updated, 0, sizeof( updated ) );
+
+	if ( FS_GeneratePathWritedir( "records", NULL, FS_ALLOW_DIRECTORIES, 0, osPath, sizeof( osPath ) ) ) {
+		fscOsPath = FSC_StringToOSPath( osPath );
+		FSC_IterateDirectory( fscOsPath, Record_Catalog_IterateFile, &scan );
+		FSC_Free( fscOsPath );
+	}
+
+	if ( scan.metadataFiles.count ) {
+		qsort( scan.metadataFiles.files, scan.metadataFiles.count, sizeof( *scan.metadataFiles.files ),
+				Record_Catalog_CompareFiles );
+	}
+
+	// Reuse existing entries where the metadata file hasn't changed
+	for ( i = 0; i < scan.metadataFiles.count; ++i ) {
+		record_catalog_file_t *file = &scan.metadataFiles.files[i];
+		record_catalog_entry_t *entry = Record_Catalog_FindEntry( catalog, file->path );
+		char *metadata;
+
+		if ( entry && entry->timestamp == file->timestamp && entry->size == file->size ) {
+			// Path is left in place because the old catalog is still being searched
+			Record_Catalog_AddEntry( &updated, Record_Catalog_CopyString( entry->path ), entry->timestamp,
+					entry->size, entry->metadata );
+			entry->metadata = NULL;
+			++unchanged;
+			continue;
+		}
+
+		metadata = Record_Catalog_ReadFile( va( "records/%s", file->path ), RECORD_METADATA_MAX_SIZE, NULL );
+		if ( !metadata ) {
+			Record_Printf( RP_ALL, "Failed to read metadata file %s\n", file->path );
+			continue;
+		}
+		Record_Catalog_AddEntry( &updated, Record_Catalog_CopyString( file->path ), file->timestamp,
+				file->size, metadata );
+		++added;
+	}
+
+	// Count record files without metadata
+	for ( i = 0; i < scan.recordFiles.count; ++i ) {
+		record_catalog_file_t key;
+		char metadataPath[FS_MAX_PATH];
+		COM_StripExtension( scan.recordFiles.files[i].path, metadataPath, sizeof( metadataPath ) );
+		Q_strcat( metadataPath, sizeof( metadataPath ), ".meta" );
+		key.path = metadataPath;
+		if ( !scan.metadataFiles.count || !bsearch( &key, scan.metadataFiles.files, scan.metadataFiles.count,
+				sizeof( *scan.metadataFiles.files ), Record_Catalog_CompareFiles ) ) {
+			++missing;
+		}
+	}
+
+	if ( added || unchanged != catalog->count ) {
+		Record_Catalog_Save( &updated );
+	}
+
+	Record_Printf( RP_ALL, "Catalog: %i records (%i added or changed, %i removed)\n", updated.count, added,
+			catalog->count - unchanged );
+	if ( missing ) {
+		Record_Printf( RP_ALL, "%i record files have no metadata and are not cataloged\n", missing );
+	}
+
+	Record_Catalog_Free( catalog );
+	*catalog = updated;
+	Record_Catalog_FreeFileList( &scan.metadataFiles );
+	Record_Catalog_FreeFileList( &scan.recordFiles );
+}
+
+/* ******************************************************************************** */
+// Catalog Command
+/* ******************************************************************************** */
+
+/*
+==================
+Record_Catalog_GetLine
+
+Copies line from metadata and returns position of next line, or NULL at end.
+==================
+*/
+static const char *Record_Catalog_GetLine( const char *metadata, char *line, int size ) {
+	const char *end = strchr( metadata, '\n' );
+	int length = end ? (int)( end - metadata ) : (int)strlen( metadata );
+	if ( !*metadata ) {
+		return NULL;
+	}
+	if ( length >= size ) {
+		length = size - 1;
+	}
+	Com_Memcpy( line, metadata, length );
+	line[length] = '\0';
+	return end ? end + 1 : metadata + strlen( metadata );
+}
+
+/*
+==================
+Record_Catalog_EntryMatches
+
+Returns qtrue if every filter term appears in the entry path or metadata.
+==================
+*/
+static qboolean Record_Catalog_EntryMatches( record_catalog_entry_t *entry, int firstArg ) {
+	qboolean match = qtrue;
+	unsigned int size;
+	char *text;
+	int i;
+
+	if ( Cmd_Argc() <= firstArg ) {
+		return qtrue;
+	}
+
+	// Search with color codes removed from names
+	size = strlen( entry->path ) + strlen( entry->metadata ) + 2;
+	text = (char *)Record_Calloc( size );
+	Com_sprintf( text, size, "%s\n%s", entry->path, entry->metadata );
+	Q_CleanStr( text );
+
+	for ( i = firstArg; i < Cmd_Argc(); ++i ) {
+		if ( !Q_stristr( text, Cmd_Argv( i ) ) ) {
+			match = qfalse;
+			break;
+		}
+	}
+
+	Record_Free( text );
+	return match;
+}
+
+/*
+==================
+Record_Catalog_PrintEntry
+==================
+*/
+static void Record_Catalog_PrintEntry( record_catalog_entry_t *entry ) {
+	char line[MAX_INFO_STRING * 2];
+	char players[1024];
+	char map[MAX_QPATH];
+	int duration = 0;
+	const char *position = entry->metadata;
+
+	*players = '\0';
+	*map = '\0';
+
+	while ( ( position = Record_Catalog_GetLine( position, line, sizeof( line ) ) ) != NULL ) {
+		const char *type = Info_ValueForKey( line, "type" );
+		if ( !Q_stricmp( type, "record" ) ) {
+			Q_strncpyz( map, Info_ValueForKey( line, "map" ), sizeof( map ) );
+			duration = atoi( Info_ValueForKey( line, "duration" ) );
+		} else if ( !Q_stricmp( type, "player" ) && !atoi( Info_ValueForKey( line, "bot" ) ) ) {
+			char name[MAX_NAME_LENGTH];
+			Q_strncpyz( name, Info_ValueForKey( line, "name" ), sizeof( name ) );
+			Q_CleanStr( name );
+			if ( *players ) {
+				Q_strcat( players, sizeof( players ), ", " );
+			}
+			Q_strcat( players, sizeof( players ), name );
+		}
+	}
+
+	Record_Printf( RP_ALL, "%s map(%s) duration(%i:%02i) players(%s)\n", entry->path, map,
+			duration / 60000, ( duration / 1000 ) % 60, players );
+}
+
+/*
+==================
+Record_Catalog_Cmd
+==================
+*/
+void Record_Catalog_Cmd( void ) {
+	record_catalog_t catalog;
+	int firstArg = 1;
+	qboolean list = qfalse;
+	int matches = 0;
+	int i;
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "list" ) ) {
+		list = qtrue;
+		firstArg = 2;
+	} else if ( Cmd_Argc() > 1 && Q_stricmp( Cmd_Argv( 1 ), "update" ) ) {
+		Record_Printf( RP_ALL, "Usage: record_catalog [update | list [search terms...]]\n"
+				"Example: record_catalog list ctf_voy1 playername\n" );
+		return;
+	}
+
+	Com_Memset( &catalog, 0, sizeof( catalog ) );
+	Record_Catalog_Load( &catalog );
+	Record_Catalog_Update( &catalog );
+
+	if ( list ) {
+		for ( i = 0; i < catalog.count; ++i ) {
+			if ( Record_Catalog_EntryMatches( &catalog.entries[i], firstArg ) ) {
+				Record_Catalog_PrintEntry( &catalog.entries[i] );
+				++matches;
+			}
+		}
+		Record_Printf( RP_ALL, "%i matching records\n", matches );
+	}
+
+	Record_Catalog_Free( &catalog );
+}
+#endif
+
+#endif
@@ -86,14 +86,37 @@ Record_Stream_ReadStatic
 ==================
 */
 char *Record_Stream_ReadStatic( int size, record_data_stream_t *stream ) {
-	char *output = stream->data + stream->position;
+	char *output;
 	if ( stream->position + size > stream->size || stream->position + size < stream->position ) {
+#ifdef STEF_RECORD_STREAMING_READER
+		if ( !stream->refill || size < 0 || !stream->refill( stream, size ) )
+#endif
 		Record_Stream_Error( stream, "Record_Stream_ReadStatic: stream overflow" );
 	}
+	output = stream->data + stream->position;
 	stream->position += size;
 	return output;
 }
 
+/*
+==================
+Record_Stream_AtEnd
+
+Returns qtrue if no more data can be read from stream.
+==================
+*/
+qboolean Record_Stream_AtEnd( record_data_stream_t *stream ) {
+	if ( stream->position < stream->size ) {
+		return qfalse;
+	}
+#ifdef STEF_RECORD_STREAMING_READER
+	if ( stream->refill && stream->refill( stream, 1 ) ) {
+		return qfalse;
+	}
+#endif
+	return qtrue;
+}
+
 /*
 ==================
 Record_Stream_ReadBuffer
@@ -222,6 +245,26 @@ void Record_SetPlayerstateFollowFlag( playerState_t *ps ) {
 	ps->pm_flags |= PMF_FOLLOW;
 }
 
+/*
+==================
+Record_PlayerstateScore
+==================
+*/
+int Record_PlayerstateScore( const playerState_t *ps ) {
+	return ps->persistant[0];	// 0=PERS_SCORE
+}
+
+/*
+==================
+Record_TeamScoreConfigstring
+
+Returns configstring index holding score for team 0 (red/first place) or 1 (blue/second place).
+==================
+*/
+int Record_TeamScoreConfigstring( int team ) {
+	return team ? 7 : 6;	// 6=CS_SCORES1, 7=CS_SCORES2
+}
+
 /* ******************************************************************************** */
 // Message printing
 /* ******************************************************************************** */
@@ -408,6 +451,221 @@ static void Record_DecodeStructure( qboolean byte_pass, unsigned int *state, uns
 	}
 }
 
+#ifdef STEF_RECORD_FIELD_ENCODING
+// ***** Field Encoding *****
+
+// Protocol 8 encodes each changed word as a varint header, containing the distance from the
+// previous changed word and a mode bit, followed by a varint value. In xor mode the value is
+// the xor of the old and new words. In delta mode it is the zigzag encoded difference between
+// the integer values, or for float fields where both values are whole numbers, between the
+// numbers themselves. The encoder uses whichever mode is shorter, and the structure ends
+// with a zero header.
+
+typedef enum {
+	RF_INT,
+	RF_FLOAT
+} record_field_type_t;
+
+#define RECORD_VEC3_FIELD( type, field ) \
+	offsetof( type, field[0] ), offsetof( type, field[1] ), offsetof( type, field[2] )
+
+static const int recordPlayerstateFloatFields[] = {
+	RECORD_VEC3_FIELD( playerState_t, origin ),
+	RECORD_VEC3_FIELD( playerState_t, velocity ),
+#ifndef ELITEFORCE
+	RECORD_VEC3_FIELD( playerState_t, grapplePoint ),
+#endif
+	RECORD_VEC3_FIELD( playerState_t, viewangles ),
+};
+
+static const int recordEntitystateFloatFields[] = {
+	RECORD_VEC3_FIELD( entityState_t, pos.trBase ),
+	RECORD_VEC3_FIELD( entityState_t, pos.trDelta ),
+	RECORD_VEC3_FIELD( entityState_t, apos.trBase ),
+	RECORD_VEC3_FIELD( entityState_t, apos.trDelta ),
+	RECORD_VEC3_FIELD( entityState_t, origin ),
+	RECORD_VEC3_FIELD( entityState_t, origin2 ),
+	RECORD_VEC3_FIELD( entityState_t, angles ),
+	RECORD_VEC3_FIELD( entityState_t, angles2 ),
+};
+
+static byte recordPlayerstateFieldTypes[sizeof( playerState_t ) / 4];
+static byte recordEntitystateFieldTypes[sizeof( entityState_t ) / 4];
+static qboolean recordFieldTypesInitialized;
+
+/*
+==================
+Record_InitFieldTypes
+==================
+*/
+static void Record_InitFieldTypes( void ) {
+	int i;
+	if ( recordFieldTypesInitialized ) {
+		return;
+	}
+	for ( i = 0; i < ARRAY_LEN( recordPlayerstateFloatFields ); ++i ) {
+		recordPlayerstateFieldTypes[recordPlayerstateFloatFields[i] / 4] = RF_FLOAT;
+	}
+	for ( i = 0; i < ARRAY_LEN( recordEntitystateFloatFields ); ++i ) {
+		recordEntitystateFieldTypes[recordEntitystateFloatFields[i] / 4] = RF_FLOAT;
+	}
+	recordFieldTypesInitialized = qtrue;
+}
+
+/*
+==================
+Record_Stream_WriteVarint
+==================
+*/
+static void Record_Stream_WriteVarint( unsigned int value, record_data_stream_t *stream ) {
+	unsigned char buffer[5];
+	int length = 0;
+	while ( value >= 128 ) {
+		buffer[length++] = ( value & 127 ) | 128;
+		value >>= 7;
+	}
+	buffer[length++] = value;
+	Record_Stream_Write( buffer, length, stream );
+}
+
+/*
+==================
+Record_Stream_ReadVarint
+==================
+*/
+static unsigned int Record_Stream_ReadVarint( record_data_stream_t *stream ) {
+	unsigned int value = 0;
+	int shift;
+	for ( shift = 0; shift < 35; shift += 7 ) {
+		unsigned char data = *(unsigned char *)Record_Stream_ReadStatic( 1, stream );
+		value |= (unsigned int)( data & 127 ) << shift;
+		if ( !( data & 128 ) ) {
+			return value;
+		}
+	}
+	Record_Stream_Error( stream, "Record_Stream_ReadVarint: invalid varint" );
+	return 0;
+}
+
+/*
+==================
+Record_VarintLength
+==================
+*/
+static int Record_VarintLength( unsigned int value ) {
+	int length = 1;
+	while ( value >= 128 ) {
+		value >>= 7;
+		++length;
+	}
+	return length;
+}
+
+/*
+==================
+Record_FloatToWhole
+
+Returns qtrue if float bits represent a whole number that converts to and from an integer
+exactly, excluding negative zero.
+==================
+*/
+static qboolean Record_FloatToWhole( unsigned int bits, int *output ) {
+	floatint_t value;
+	value.u = bits;
+	if ( !( value.f > -16777216.0f && value.f < 16777216.0f ) ) {
+		return qfalse;
+	}
+	*output = (int)value.f;
+	value.f = (float)*output;
+	return value.u == bits ? qtrue : qfalse;
+}
+
+/*
+==================
+Record_EncodeFields
+
+Sets state equal to source, and writes field encoded delta change to stream.
+==================
+*/
+static void Record_EncodeFields( unsigned int *state, unsigned int *source, int size, const byte *types,
+		record_data_stream_t *stream ) {
+	int previous = -1;
+	int i;
+
+	for ( i = 0; i < size; ++i ) {
+		unsigned int value;
+		unsigned int delta = 0;
+		qboolean useDelta = qfalse;
+
+		if ( state[i] == source[i] ) {
+			continue;
+		}
+
+		value = state[i] ^ source[i];
+		if ( types && types[i] == RF_FLOAT ) {
+			int oldWhole, newWhole;
+			if ( Record_FloatToWhole( state[i], &oldWhole ) && Record_FloatToWhole( source[i], &newWhole ) ) {
+				int difference = newWhole - oldWhole;
+				delta = ( (unsigned int)difference << 1 ) ^ (unsigned int)( difference >> 31 );
+				useDelta = Record_VarintLength( delta ) < Record_VarintLength( value ) ? qtrue : qfalse;
+			}
+		} else {
+			int difference = (int)( source[i] - state[i] );
+			delta = ( (unsigned int)difference << 1 ) ^ (unsigned int)( difference >> 31 );
+			useDelta = Record_VarintLength( delta ) < Record_VarintLength( value ) ? qtrue : qfalse;
+		}
+
+		Record_Stream_WriteVarint( ( (unsigned int)( i - previous ) << 1 ) | ( useDelta ? 1 : 0 ), stream );
+		Record_Stream_WriteVarint( useDelta ? delta : value, stream );
+		state[i] = source[i];
+		previous = i;
+	}
+
+	Record_Stream_WriteVarint( 0, stream );
+}
+
+/*
+==================
+Record_DecodeFields
+==================
+*/
+static void Record_DecodeFields( unsigned int *state, int size, const byte *types, record_data_stream_t *stream ) {
+	int index = -1;
+
+	while ( 1 ) {
+		unsigned int header = Record_Stream_ReadVarint( stream );
+		unsigned int distance = header >> 1;
+		unsigned int value;
+
+		if ( !header ) {
+			break;
+		}
+		if ( distance < 1 || distance >= (unsigned int)( size - index ) ) {
+			Record_Stream_Error( stream, "Record_DecodeFields: out of bounds" );
+		}
+		index += distance;
+		value = Record_Stream_ReadVarint( stream );
+
+		if ( !( header & 1 ) ) {
+			state[index] ^= value;
+		} else {
+			int difference = (int)( ( value >> 1 ) ^ ( 0u - ( value & 1 ) ) );
+			if ( types && types[index] == RF_FLOAT ) {
+				floatint_t result;
+				int whole;
+				if ( !Record_FloatToWhole( state[index], &whole ) ) {
+					Record_Stream_Error( stream, "Record_DecodeFields: invalid float delta" );
+				}
+				result.f = (float)( whole + difference );
+				state[index] = result.u;
+			} else {
+				state[index] += (unsigned int)difference;
+			}
+		}
+	}
+}
+#endif
+
 // ***** Playerstates *****
 
 /*
@@ -416,6 +674,14 @@ Record_EncodePlayerstate
 ==================
 */
 void Record_EncodePlayerstate(playerState_t *state, playerState_t *source, record_data_stream_t *stream) {
+#ifdef STEF_RECORD_FIELD_ENCODING
+	if ( stream->fieldEncoding ) {
+		Record_InitFieldTypes();
+		Record_EncodeFields( (unsigned int *)state, (unsigned int *)source, sizeof( *state ) / 4,
+				recordPlayerstateFieldTypes, stream );
+		return;
+	}
+#endif
 	Record_EncodeStructure(qtrue, (unsigned int *)state, (unsigned int *)source, sizeof(*state)/4, stream);
 	Record_EncodeStructure(qfalse, (unsigned int *)state, (unsigned int *)source, sizeof(*state)/4, stream); }
 
@@ -425,6 +691,13 @@ Record_DecodePlayerstate
 ==================
 */
 void Record_DecodePlayerstate(playerState_t *state, record_data_stream_t *stream) {
+#ifdef STEF_RECORD_FIELD_ENCODING
+	if ( stream->fieldEncoding ) {
+		Record_InitFieldTypes();
+		Record_DecodeFields( (unsigned int *)state, sizeof( *state ) / 4, recordPlayerstateFieldTypes, stream );
+		return;
+	}
+#endif
 	Record_DecodeStructure(qtrue, (unsigned int *)state, sizeof(*state)/4, stream);
 	Record_DecodeStructure(qfalse, (unsigned int *)state, sizeof(*state)/4, stream); }
 
@@ -436,6 +709,14 @@ Record_EncodeEntitystate
 ==================
 */
 void Record_EncodeEntitystate( entityState_t *state, entityState_t *source, record_data_stream_t *stream ) {
+#ifdef STEF_RECORD_FIELD_ENCODING
+	if ( stream->fieldEncoding ) {
+		Record_InitFieldTypes();
+		Record_EncodeFields( (unsigned int *)state, (unsigned int *)source, sizeof( *state ) / 4,
+				recordEntitystateFieldTypes, stream );
+		return;
+	}
+#endif
 	Record_EncodeStructure( qtrue, (unsigned int *)state, (unsigned int *)source, sizeof( *state ) / 4, stream );
 	Record_EncodeStructure( qfalse, (unsigned int *)state, (unsigned int *)source, sizeof( *state ) / 4, stream );
 }
@@ -446,6 +727,13 @@ Record_DecodeEntitystate
 ==================
 */
 void Record_DecodeEntitystate( entityState_t *state, record_data_stream_t *stream ) {
+#ifdef STEF_RECORD_FIELD_ENCODING
+	if ( stream->fieldEncoding ) {
+		Record_InitFieldTypes();
+		Record_DecodeFields( (unsigned int *)state, sizeof( *state ) / 4, recordEntitystateFieldTypes, stream );
+		return;
+	}
+#endif
 	Record_DecodeStructure( qtrue, (unsigned int *)state, sizeof( *state ) / 4, stream );
 	Record_DecodeStructure( qfalse, (unsigned int *)state, sizeof( *state ) / 4, stream );
 }
@@ -525,6 +813,12 @@ Record_EncodeVisibilityState
 */
 void Record_EncodeVisibilityState( record_visibility_state_t *state, record_visibility_state_t *source,
 		record_data_stream_t *stream ) {
+#ifdef STEF_RECORD_FIELD_ENCODING
+	if ( stream->fieldEncoding ) {
+		Record_EncodeFields( (unsigned int *)state, (unsigned int *)source, sizeof( *state ) / 4, NULL, stream );
+		return;
+	}
+#endif
 	Record_EncodeStructure( qfalse, (unsigned int *)state, (unsigned int *)source, sizeof( *state ) / 4, stream );
 }
 
@@ -534,6 +828,12 @@ Record_DecodeVisibilityState
 ==================
 */
 void Record_DecodeVisibilityState( record_visibility_state_t *state, record_data_stream_t *stream ) {
+#ifdef STEF_RECORD_FIELD_ENCODING
+	if ( stream->fieldEncoding ) {
+		Record_DecodeFields( (unsigned int *)state, sizeof( *state ) / 4, NULL, stream );
+		return;
+	}
+#endif
 	Record_DecodeStructure( qfalse, (unsigned int *)state, sizeof( *state ) / 4, stream );
 }
 
@@ -546,6 +846,12 @@ Record_EncodeUsercmd
 ==================
 */
 void Record_EncodeUsercmd( record_usercmd_t *state, record_usercmd_t *source, record_data_stream_t *stream ) {
+#ifdef STEF_RECORD_FIELD_ENCODING
+	if ( stream->fieldEncoding ) {
+		Record_EncodeFields( (unsigned int *)state, (unsigned int *)source, sizeof( *state ) / 4, NULL, stream );
+		return;
+	}
+#endif
 	Record_EncodeStructure( qfalse, (unsigned int *)state, (unsigned int *)source, sizeof( *state ) / 4, stream );
 }
 
@@ -555,6 +861,12 @@ Record_DecodeUsercmd
 ==================
 */
 void Record_DecodeUsercmd( record_usercmd_t *state, record_data_stream_t *stream ) {
+#ifdef STEF_RECORD_FIELD_ENCODING
+	if ( stream->fieldEncoding ) {
+		Record_DecodeFields( (unsigned int *)state, sizeof( *state ) / 4, NULL, stream );
+		return;
+	}
+#endif
 	Record_DecodeStructure( qfalse, (unsigned int *)state, sizeof( *state ) / 4, stream );
 }
 
@@ -607,6 +919,12 @@ Record_EncodeUsercmd
 ==================
 */
 void Record_EncodeUsercmd( usercmd_t *state, usercmd_t *source, record_data_stream_t *stream ) {
+#ifdef STEF_RECORD_FIELD_ENCODING
+	if ( stream->fieldEncoding ) {
+		Record_EncodeFields( (unsigned int *)state, (unsigned int *)source, sizeof( *state ) / 4, NULL, stream );
+		return;
+	}
+#endif
 	Record_EncodeStructure( qfalse, (unsigned int *)state, (unsigned int *)source, sizeof( *state ) / 4, stream );
 }
 
@@ -616,10 +934,122 @@ Record_DecodeUsercmd
 ==================
 */
 void Record_DecodeUsercmd( usercmd_t *state, record_data_stream_t *stream ) {
+#ifdef STEF_RECORD_FIELD_ENCODING
+	if ( stream->fieldEncoding ) {
+		Record_DecodeFields( (unsigned int *)state, sizeof( *state ) / 4, NULL, stream );
+		return;
+	}
+#endif
 	Record_DecodeStructure( qfalse, (unsigned int *)state, sizeof( *state ) / 4, stream );
 }
 #endif
 
+/* ******************************************************************************** */
+// Stream Header
+/* ******************************************************************************** */
+
+/*
+==================
+Record_EncodeStreamHeader
+
+Writes the protocol and max clients which begin the record stream.
+==================
+*/
+void Record_EncodeStreamHeader( int maxClients, record_data_stream_t *stream ) {
+#ifdef ELITEFORCE
+	Record_Stream_WriteValue( RECORD_PROTOCOL, 4, stream );
+#else
+	Record_Stream_WriteValue( sizeof( RECORD_PROTOCOL ) - 1, 4, stream ); // version length
+	Record_Stream_Write( RECORD_PROTOCOL, sizeof( RECORD_PROTOCOL ) - 1, stream ); // version value
+	Record_Stream_WriteValue( 0, 4, stream ); // aux info length (zero)
+#endif
+	Record_Stream_WriteValue( maxClients, 4, stream );
+}
+
+/* ******************************************************************************** */
+// Keyframes
+/* ******************************************************************************** */
+
+// Keyframes contain the full record state, encoded as deltas from an empty state, so
+// the reader can start decoding from the middle of the record stream.
+
+/*
+==================
+Record_EncodeKeyframe
+==================
+*/
+void Record_EncodeKeyframe( record_state_t *rs, record_keyframe_t *keyframe, record_data_stream_t *stream ) {
+	record_entityset_t *emptyEntities = (record_entityset_t *)Record_Calloc( sizeof( *emptyEntities ) );
+	int i;
+
+	Record_EncodeEntityset( emptyEntities, &keyframe->baselines, stream );
+	Com_Memset( emptyEntities, 0, sizeof( *emptyEntities ) );
+	Record_EncodeEntityset( emptyEntities, &rs->entities, stream );
+	Record_Free( emptyEntities );
+
+	for ( i = 0; i < MAX_CONFIGSTRINGS; ++i ) {
+		if ( *rs->configstrings[i] ) {
+			Record_Stream_WriteValue( i, 2, stream );
+			Record_EncodeString( rs->configstrings[i], stream );
+		}
+	}
+	Record_Stream_WriteValue( -1, 2, stream );
+	Record_EncodeString( rs->currentServercmd, stream );
+
+	for ( i = 0; i < rs->maxClients; ++i ) {
+		record_state_client_t empty;
+		Com_Memset( &empty, 0, sizeof( empty ) );
+		Record_Stream_WriteValue( keyframe->activeClients[i], 1, stream );
+		Record_Stream_WriteValue( keyframe->instanceCounts[i], 2, stream );
+		Record_EncodePlayerstate( &empty.playerstate, &rs->clients[i].playerstate, stream );
+		Record_EncodeVisibilityState( &empty.visibility, &rs->clients[i].visibility, stream );
+		Record_EncodeUsercmd( &empty.usercmd, &rs->clients[i].usercmd, stream );
+	}
+}
+
+/*
+==================
+Record_DecodeKeyframe
+
+Replaces all existing data in record state.
+==================
+*/
+void Record_DecodeKeyframe( record_state_t *rs, record_keyframe_t *keyframe, record_data_stream_t *stream ) {
+	int i;
+
+	Com_Memset( keyframe, 0, sizeof( *keyframe ) );
+	Record_DecodeEntityset( &keyframe->baselines, stream );
+	Com_Memset( &rs->entities, 0, sizeof( rs->entities ) );
+	Record_DecodeEntityset( &rs->entities, stream );
+
+	for ( i = 0; i < MAX_CONFIGSTRINGS; ++i ) {
+		Z_Free( rs->configstrings[i] );
+		rs->configstrings[i] = CopyString( "" );
+	}
+	while ( 1 ) {
+		int index = *(unsigned short *)Record_Stream_ReadStatic( 2, stream );
+		if ( index == 0xffff ) {
+			break;
+		}
+		if ( index >= MAX_CONFIGSTRINGS ) {
+			Record_Stream_Error( stream, "Record_DecodeKeyframe: invalid configstring index" );
+		}
+		Z_Free( rs->configstrings[index] );
+		rs->configstrings[index] = CopyString( Record_DecodeString( stream ) );
+	}
+	Z_Free( rs->currentServercmd );
+	rs->currentServercmd = CopyString( Record_DecodeString( stream ) );
+
+	Com_Memset( rs->clients, 0, sizeof( *rs->clients ) * rs->maxClients );
+	for ( i = 0; i < rs->maxClients; ++i ) {
+		keyframe->activeClients[i] = *(char *)Record_Stream_ReadStatic( 1, stream );
+		keyframe->instanceCounts[i] = *(unsigned short *)Record_Stream_ReadStatic( 2, stream );
+		Record_DecodePlayerstate( &rs->clients[i].playerstate, stream );
+		Record_DecodeVisibilityState( &rs->clients[i].visibility, stream );
+		Record_DecodeUsercmd( &rs->clients[i].usercmd, stream );
+	}
+}
+
 /* ******************************************************************************** */
 // Entity Set Building
 /* ******************************************************************************** */
@@ -672,6 +1102,191 @@ void Record_GetCurrentBaselines( record_entityset_t *target ) {
 	}
 }
 
+#ifdef STEF_RECORD_ENTITY_TRACKER
+/* ******************************************************************************** */
+// Entity Tracker
+/* ******************************************************************************** */
+
+// The tracker holds the current entity set and the entities that changed since the previous
+// snapshot, so the writer and spectators don't need to copy and compare the full set themselves.
+// Entities can't become linked without SV_LinkEntity, but the game modifies entity states
+// (e.g. events) without relinking, so entities active in the previous update are always
+// rechecked along with any that were linked or unlinked.
+
+record_entity_tracker_t *recordEntityTracker;
+
+// Persists across tracker allocations, so frame numbers held by consumers never repeat
+static int recordEntityTrackerFrame;
+
+/*
+==================
+Record_EntityTracker_MarkEntity
+==================
+*/
+void Record_EntityTracker_MarkEntity( int entityNum ) {
+	if ( recordEntityTracker && entityNum >= 0 && entityNum < MAX_GENTITIES ) {
+		Record_Bit_Set( recordEntityTracker->touched, entityNum );
+	}
+}
+
+/*
+==================
+Record_EntityTracker_CheckEntity
+==================
+*/
+static void Record_EntityTracker_CheckEntity( record_entity_tracker_t *tracker, int entityNum ) {
+	sharedEntity_t *ent = 0;
+	qboolean wasActive = Record_Bit_Get( tracker->entities.activeFlags, entityNum ) ? qtrue : qfalse;
+
+	if ( entityNum < sv.num_entities ) {
+		ent = SV_GentityNum( entityNum );
+		if ( !ent->r.linked ) {
+			ent = 0;
+		} else if ( ent->s.number != entityNum ) {
+			Record_Printf( RP_DEBUG, "Record_EntityTracker_CheckEntity: bad ent->s.number\n" );
+			ent = 0;
+		}
+	}
+
+	if ( !ent ) {
+		if ( !wasActive ) {
+			return;
+		}
+		Record_Bit_Unset( tracker->entities.activeFlags, entityNum );
+	} else {
+		if ( wasActive && !memcmp( &tracker->entities.entities[entityNum], &ent->s, sizeof( ent->s ) ) ) {
+			return;
+		}
+		tracker->entities.entities[entityNum] = ent->s;
+		Record_Bit_Set( tracker->entities.activeFlags, entityNum );
+	}
+
+	tracker->changedFrame[entityNum] = tracker->frame;
+	tracker->changes[tracker->changeCount++] = entityNum;
+}
+
+/*
+==================
+Record_EntityTracker_Update
+==================
+*/
+static void Record_EntityTracker_Update( record_entity_tracker_t *tracker, qboolean full ) {
+	int i, j;
+
+	tracker->frame = ++recordEntityTrackerFrame;
+	tracker->changeCount = 0;
+
+	if ( sv.num_entities > MAX_GENTITIES ) {
+		Record_Printf( RP_ALL, "Record_EntityTracker_Update: sv.num_entities > MAX_GENTITIES\n" );
+		return;
+	}
+
+	for ( i = 0; i < ( MAX_GENTITIES + 31 ) / 32; ++i ) {
+		unsigned int candidates = full ? ~0u :
+				(unsigned int)( tracker->touched[i] | tracker->entities.activeFlags[i] );
+		for ( j = 0; candidates; ++j, candidates >>= 1 ) {
+			if ( candidates & 1 ) {
+				Record_EntityTracker_CheckEntity( tracker, i * 32 + j );
+			}
+		}
+	}
+
+	memset( tracker->touched, 0, sizeof( tracker->touched ) );
+}
+
+/*
+==================
+Record_EntityTracker_BeginFrame
+
+Called at the start of record snapshot processing.
+==================
+*/
+void Record_EntityTracker_BeginFrame( void ) {
+	if ( recordEntityTracker ) {
+		recordEntityTracker->updated = qfalse;
+	}
+}
+
+/*
+==================
+Record_EntityTracker_EndFrame
+
+Called at the end of record snapshot processing. Frees the tracker if nothing used it.
+==================
+*/
+void Record_EntityTracker_EndFrame( void ) {
+	if ( recordEntityTracker && !recordEntityTracker->updated ) {
+		Record_Free( recordEntityTracker );
+		recordEntityTracker = 0;
+	}
+}
+
+/*
+==================
+Record_EntityTracker_Get
+
+Returns tracker updated for the current snapshot.
+==================
+*/
+record_entity_tracker_t *Record_EntityTracker_Get( void ) {
+	qboolean full = qfalse;
+	if ( !recordEntityTracker ) {
+		recordEntityTracker = (record_entity_tracker_t *)Record_Calloc( sizeof( *recordEntityTracker ) );
+		full = qtrue;
+	}
+	if ( !recordEntityTracker->updated ) {
+		Record_EntityTracker_Update( recordEntityTracker, full );
+		recordEntityTracker->updated = qtrue;
+	}
+	return recordEntityTracker;
+}
+
+/*
+==================
+Record_EncodeEntityChanges
+
+Equivalent to Record_EncodeEntityset with the tracker entities as source, but only valid
+if state already matches the tracker entities from the previous update.
+==================
+*/
+void Record_EncodeEntityChanges( record_entityset_t *state, record_entity_tracker_t *tracker,
+		record_data_stream_t *stream ) {
+	int i;
+	for ( i = 0; i < tracker->changeCount; ++i ) {
+		int entityNum = tracker->changes[i];
+		if ( !Record_Bit_Get( tracker->entities.activeFlags, entityNum ) ) {
+			Record_Stream_WriteValue( entityNum | ( 1 << 12 ), 2, stream );
+			Record_Bit_Unset( state->activeFlags, entityNum );
+		} else {
+			Record_Stream_WriteValue( entityNum | ( 2 << 12 ), 2, stream );
+			Record_EncodeEntitystate( &state->entities[entityNum], &tracker->entities.entities[entityNum], stream );
+			Record_Bit_Set( state->activeFlags, entityNum );
+		}
+	}
+
+	// Finished
+	Record_Stream_WriteValue( -1, 2, stream );
+}
+
+/*
+==================
+Record_CopyEntityChanges
+
+Updates target, which must hold the tracker entities as of targetFrame (or 0 for
+unknown state), to match the current tracker entities.
+==================
+*/
+void Record_CopyEntityChanges( record_entityset_t *target, int targetFrame, record_entity_tracker_t *tracker ) {
+	int i;
+	memcpy( target->activeFlags, tracker->entities.activeFlags, sizeof( target->activeFlags ) );
+	for ( i = 0; i < MAX_GENTITIES; ++i ) {
+		if ( tracker->changedFrame[i] > targetFrame && Record_Bit_Get( tracker->entities.activeFlags, i ) ) {
+			target->entities[i] = tracker->entities.entities[i];
+		}
+	}
+}
+#endif
+
 /* ******************************************************************************** */
 // Visibility Building
 /* ******************************************************************************** */
@@ -856,38 +1471,60 @@ static void Record_CalculateCurrentVisibility( int clientNum, record_visibility_
 
 /*
 ==================
-Record_GetCurrentVisibility
+Record_SetSnapshotVisibility
 
-Try to get visibility from previously calculated snapshot, but if not available
-(e.g. due to rate limited client) run the calculation directly
+Converts snapshot areabits and entity list to visibility state. Returns qfalse on error.
 ==================
 */
-void Record_GetCurrentVisibility( int clientNum, record_visibility_state_t *target ) {
+static qboolean Record_SetSnapshotVisibility( int areabytes, const byte *areabits, int numEntities,
+		entityState_t *const *ents, record_visibility_state_t *target ) {
 	int i;
-	client_t *client = &svs.clients[clientNum];
-	clientSnapshot_t *frame = &client->frames[ ( client->netchan.outgoingSequence - 1 ) & PACKET_MASK ];
-	if ( !svs.currFrame || svs.currFrame->frameNum != frame->frameNum ) {
-		Record_CalculateCurrentVisibility( clientNum, target );
-		return;
-	}
 
 	memset( target, 0, sizeof( *target ) );
 
-	target->areaVisibilitySize = frame->areabytes;
+	target->areaVisibilitySize = areabytes;
 	for ( i = 0; i < MAX_MAP_AREA_BYTES / sizeof( int ); i++ ) {
-		( (int *)target->areaVisibility )[i] = ( (int *)frame->areabits )[i] ^ -1;
+		( (int *)target->areaVisibility )[i] = ( (const int *)areabits )[i] ^ -1;
 	}
 
-	for ( i = 0; i < frame->num_entities; ++i ) {
-		int num = frame->ents[i]->number;
+	for ( i = 0; i < numEntities; ++i ) {
+		int num = ents[i]->number;
 		if ( num < 0 || num >= MAX_GENTITIES ) {
 			Record_Printf( RP_ALL, "Record_GetCurrentVisibility: invalid entity number\n" );
-			Record_CalculateCurrentVisibility( clientNum, target );
-			return;
+			return qfalse;
 		}
 		Record_Bit_Set( target->entVisibility, num );
 	}
 
+	return qtrue;
+}
+
+/*
+==================
+Record_GetCurrentVisibility
+
+Try to get visibility from previously calculated snapshot, but if not available
+(e.g. due to rate limited client) run the calculation directly
+==================
+*/
+void Record_GetCurrentVisibility( int clientNum, record_visibility_state_t *target ) {
+#ifdef STEF_SNAPSHOT_VIS_CACHE
+	// shared with snapshot building, and calculated here if the client wasn't sent a snapshot
+	const svClientVisibility_t *vis = SV_GetClientVisibility( clientNum, SV_VIS_IGNORE_CLIENTMASK_ERROR );
+	if ( !vis || !Record_SetSnapshotVisibility( vis->areabytes, vis->areabits, vis->num_entities, vis->ents, target ) ) {
+		Record_CalculateCurrentVisibility( clientNum, target );
+		return;
+	}
+#else
+	client_t *client = &svs.clients[clientNum];
+	clientSnapshot_t *frame = &client->frames[ ( client->netchan.outgoingSequence - 1 ) & PACKET_MASK ];
+	if ( !svs.currFrame || svs.currFrame->frameNum != frame->frameNum ||
+			!Record_SetSnapshotVisibility( frame->areabytes, frame->areabits, frame->num_entities, frame->ents, target ) ) {
+		Record_CalculateCurrentVisibility( clientNum, target );
+		return;
+	}
+#endif
+
 	if ( sv_recordVerifyData->integer ) {
 		record_visibility_state_t testVisibility;
 		Record_CalculateCurrentVisibility( clientNum, &testVisibility );
@@ -1027,8 +1664,20 @@ void Record_WriteSnapshotMessage( record_entityset_t *entities, record_visibilit
 		record_entityset_t *deltaEntities, record_visibility_state_t *deltaVisibility, playerState_t *deltaPs,
 		record_entityset_t *baselines, int baselineCutoff, int lastClientCommand, int deltaFrame, int snapFlags,
 		int svTime, msg_t *msg ) {
-	int i;
+	Record_WriteSnapshotHeader( lastClientCommand, deltaFrame, snapFlags, svTime, msg );
+	Record_WriteSnapshotContent( entities, visibility, ps, deltaFrame ? deltaEntities : 0,
+			deltaFrame ? deltaVisibility : 0, deltaFrame ? deltaPs : 0, baselines, baselineCutoff, msg );
+}
 
+/*
+==================
+Record_WriteSnapshotHeader
+
+Writes the part of the snapshot message that varies between recipients of the same
+snapshot content.
+==================
+*/
+void Record_WriteSnapshotHeader( int lastClientCommand, int deltaFrame, int snapFlags, int svTime, msg_t *msg ) {
 	MSG_WriteByte( msg, svc_snapshot );
 
 #ifdef ELITEFORCE
@@ -1044,6 +1693,20 @@ void Record_WriteSnapshotMessage( record_entityset_t *entities, record_visibilit
 
 	// Write snapflags
 	MSG_WriteByte( msg, snapFlags );
+}
+
+/*
+==================
+Record_WriteSnapshotContent
+
+Writes area visibility, playerstate, and entities following the snapshot header.
+For non-delta snapshot, set deltaEntities, deltaVisibility, and deltaPs to null.
+==================
+*/
+void Record_WriteSnapshotContent( record_entityset_t *entities, record_visibility_state_t *visibility, playerState_t *ps,
+		record_entityset_t *deltaEntities, record_visibility_state_t *deltaVisibility, playerState_t *deltaPs,
+		record_entityset_t *baselines, int baselineCutoff, msg_t *msg ) {
+	int i;
 
 	// Write area visibility
 	{
@@ -1062,7 +1725,7 @@ void Record_WriteSnapshotMessage( record_entityset_t *entities, record_visibilit
 	for ( i = 0; i < MAX_GENTITIES; ++i ) {
 		if ( Record_Bit_Get( entities->activeFlags, i ) && Record_Bit_Get( visibility->entVisibility, i ) ) {
 			// Active and visible entity
-			if ( deltaFrame && Record_Bit_Get( deltaEntities->activeFlags, i ) && Record_Bit_Get( deltaVisibility->entVisibility, i ) ) {
+			if ( deltaEntities && Record_Bit_Get( deltaEntities->activeFlags, i ) && Record_Bit_Get( deltaVisibility->entVisibility, i ) ) {
 				// Keep entity (delta from previous entity)
 				MSG_WriteDeltaEntity( msg, &deltaEntities->entities[i], &entities->entities[i], qfalse );
 			} else {
@@ -1075,7 +1738,7 @@ void Record_WriteSnapshotMessage( record_entityset_t *entities, record_visibilit
 					MSG_WriteDeltaEntity( msg, &nullstate, &entities->entities[i], qtrue );
 				}
 			}
-		} else if ( deltaFrame && Record_Bit_Get( deltaEntities->activeFlags, i ) && Record_Bit_Get( deltaVisibility->entVisibility, i ) ) {
+		} else if ( deltaEntities && Record_Bit_Get( deltaEntities->activeFlags, i ) && Record_Bit_Get( deltaVisibility->entVisibility, i ) ) {
 			// Remove entity
 			MSG_WriteBits( msg, i, GENTITYNUM_BITS );
 			MSG_WriteBits( msg, 1, 1 );
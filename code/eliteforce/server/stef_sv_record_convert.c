@@ -23,6 +23,9 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #ifdef STEF_SERVER_RECORD
 #include "stef_sv_record_local.h"
+#ifdef STEF_RECORD_STREAMING_READER
+#include "../../filesystem/fscore/fscore.h"
+#endif
 
 /* ******************************************************************************** */
 // Record Demo Writer
@@ -76,6 +79,26 @@ static void Record_CloseDemoWriter( record_demo_writer_t *rdw ) {
 	FS_FCloseFile( rdw->demofile );
 }
 
+/*
+==================
+Record_InitDemoMessage
+==================
+*/
+static void Record_InitDemoMessage( msg_t *msg, byte *buffer ) {
+#ifdef ELITEFORCE
+	if ( sv_recordConvertLegacyProtocol->integer ) {
+		MSG_InitOOB( msg, buffer, MAX_MSGLEN );
+		msg->compat = qtrue;
+	} else
+#endif
+	MSG_Init( msg, buffer, MAX_MSGLEN );
+
+#ifdef ELITEFORCE
+	if ( !sv_recordConvertLegacyProtocol->integer )
+#endif
+	MSG_WriteLong( msg, 0 );
+}
+
 /*
 ==================
 Record_FinishDemoMessage
@@ -112,19 +135,7 @@ static void Record_WriteDemoGamestate( record_entityset_t *baselines, char **con
 	rdw->haveDelta = qfalse;
 	rdw->baselines = *baselines;
 
-#ifdef ELITEFORCE
-	if ( sv_recordConvertLegacyProtocol->integer ) {
-		MSG_InitOOB( &msg, buffer, MAX_MSGLEN );
-		msg.compat = qtrue;
-	} else
-#endif
-	MSG_Init( &msg, buffer, MAX_MSGLEN );
-
-#ifdef ELITEFORCE
-	if ( !sv_recordConvertLegacyProtocol->integer )
-#endif
-	MSG_WriteLong( &msg, 0 );
-
+	Record_InitDemoMessage( &msg, buffer );
 	Record_WriteGamestateMessage( baselines, configstrings, clientNum, rdw->serverCommandSequence,
 			&msg, &rdw->baselineCutoff );
 
@@ -148,45 +159,32 @@ static void Record_WriteDemoSvcmd( char *command, record_demo_writer_t *rdw ) {
 
 /*
 ==================
-Record_WriteDemoSnapshot
+Record_EncodeDemoSnapshot
 
 Based on sv.snapshot.c->SV_SendClientSnapshot
+Writes snapshot to message without writing it to the demo file, so it can be called
+from worker threads.
 ==================
 */
-static void Record_WriteDemoSnapshot( record_entityset_t *entities, record_visibility_state_t *visibility,
-		playerState_t *ps, int svTime, record_demo_writer_t *rdw ) {
+static void Record_EncodeDemoSnapshot( record_entityset_t *entities, record_visibility_state_t *visibility,
+		playerState_t *ps, int svTime, record_demo_writer_t *rdw, msg_t *msg ) {
 	int i;
-	byte buffer[MAX_MSGLEN_BUF];
-	msg_t msg;
-
-#ifdef ELITEFORCE
-	if ( sv_recordConvertLegacyProtocol->integer ) {
-		MSG_InitOOB( &msg, buffer, MAX_MSGLEN );
-		msg.compat = qtrue;
-	} else
-#endif
-	MSG_Init( &msg, buffer, MAX_MSGLEN );
-
-#ifdef ELITEFORCE
-	if ( !sv_recordConvertLegacyProtocol->integer )
-#endif
-	MSG_WriteLong( &msg, 0 );
 
 	// send any reliable server commands
 	for ( i = 0; i < rdw->pendingCommandCount; ++i ) {
-		MSG_WriteByte( &msg, svc_serverCommand );
-		MSG_WriteLong( &msg, ++rdw->serverCommandSequence );
-		MSG_WriteString( &msg, rdw->pendingCommands[i] );
+		MSG_WriteByte( msg, svc_serverCommand );
+		MSG_WriteLong( msg, ++rdw->serverCommandSequence );
+		MSG_WriteString( msg, rdw->pendingCommands[i] );
 	}
 	rdw->pendingCommandCount = 0;
 
 	// Write the snapshot
 	if ( rdw->haveDelta ) {
 		Record_WriteSnapshotMessage( entities, visibility, ps, &rdw->deltaEntities, &rdw->deltaVisibility,
-				&rdw->deltaPlayerstate, &rdw->baselines, rdw->baselineCutoff, 0, 1, rdw->snapflags, svTime, &msg );
+				&rdw->deltaPlayerstate, &rdw->baselines, rdw->baselineCutoff, 0, 1, rdw->snapflags, svTime, msg );
 	} else {
 		Record_WriteSnapshotMessage( entities, visibility, ps, 0, 0, 0, &rdw->baselines, rdw->baselineCutoff, 0, 0,
-				rdw->snapflags, svTime, &msg );
+				rdw->snapflags, svTime, msg );
 	}
 
 	// Store delta for next frame
@@ -194,7 +192,20 @@ static void Record_WriteDemoSnapshot( record_entityset_t *entities, record_visib
 	rdw->deltaVisibility = *visibility;
 	rdw->deltaPlayerstate = *ps;
 	rdw->haveDelta = qtrue;
+}
+
+/*
+==================
+Record_WriteDemoSnapshot
+==================
+*/
+static void Record_WriteDemoSnapshot( record_entityset_t *entities, record_visibility_state_t *visibility,
+		playerState_t *ps, int svTime, record_demo_writer_t *rdw ) {
+	byte buffer[MAX_MSGLEN_BUF];
+	msg_t msg;
 
+	Record_InitDemoMessage( &msg, buffer );
+	Record_EncodeDemoSnapshot( entities, visibility, ps, svTime, rdw, &msg );
 	Record_FinishDemoMessage( &msg, rdw );
 }
 
@@ -215,11 +226,32 @@ typedef struct {
 	record_data_stream_t stream;
 	record_state_t *rs;
 
+#ifdef STEF_RECORD_STREAMING_READER
+	record_file_reader_t *file;
+#endif
+
 	record_command_t command;
 	int time;
 	int clientNum;
+#ifdef STEF_RECORD_FIELD_ENCODING
+	int configstringIndex;
+
+	// Payload of the last misc command or keyframe, valid until the next stream read
+	char *payload;
+	int payloadSize;
+	int keyframeTime;
+#endif
+
+	// Seek index, if present
+	char *seekIndex;
+	int seekIndexCount;
+	int seekIndexStartTime;
+
+	// Set by Record_StreamReader_SeekKeyframe
+	record_keyframe_t keyframe;
 } record_stream_reader_t;
 
+#ifndef STEF_RECORD_STREAMING_READER
 /*
 ==================
 Record_StreamReader_LoadFile
@@ -239,7 +271,114 @@ static qboolean Record_StreamReader_LoadFile( fileHandle_t fp, record_data_strea
 	FS_Seek( fp, 0, FS_SEEK_SET );
 	FS_Read( stream->data, stream->size, fp );
 	stream->position = 0;
+
+#ifdef STEF_RECORD_ASYNC_WRITER
+	if ( !Record_File_Decompress( stream ) ) {
+		Record_Free( stream->data );
+		return qfalse;
+	}
+#endif
+	return qtrue;
+}
+#endif
+
+/*
+==================
+Record_StreamReader_GetSize
+
+Returns total size of record stream.
+==================
+*/
+static unsigned int Record_StreamReader_GetSize( record_stream_reader_t *rsr ) {
+#ifdef STEF_RECORD_STREAMING_READER
+	return Record_File_GetSize( rsr->file );
+#else
+	return rsr->stream.size;
+#endif
+}
+
+/*
+==================
+Record_StreamReader_ReadRange
+
+Reads data from record stream offset without affecting the current stream position.
+Returns qtrue on success.
+==================
+*/
+static qboolean Record_StreamReader_ReadRange( record_stream_reader_t *rsr, unsigned int offset,
+		void *output, unsigned int size ) {
+#ifdef STEF_RECORD_STREAMING_READER
+	return Record_File_ReadRange( rsr->file, offset, output, size );
+#else
+	if ( offset > rsr->stream.size || size > rsr->stream.size - offset ) {
+		return qfalse;
+	}
+	Com_Memcpy( output, rsr->stream.data + offset, size );
 	return qtrue;
+#endif
+}
+
+/*
+==================
+Record_StreamReader_FreeSource
+==================
+*/
+static void Record_StreamReader_FreeSource( record_stream_reader_t *rsr ) {
+#ifdef STEF_RECORD_STREAMING_READER
+	Record_File_CloseReader( rsr->file );
+#else
+	Record_Free( rsr->stream.data );
+#endif
+	if ( rsr->seekIndex ) {
+		Record_Free( rsr->seekIndex );
+	}
+}
+
+/*
+==================
+Record_StreamReader_LoadSeekIndex
+
+Locates seek index at end of stream. Files that were not closed normally, such as orphan
+files left after a crash, won't have an index.
+==================
+*/
+static void Record_StreamReader_LoadSeekIndex( record_stream_reader_t *rsr ) {
+	unsigned int size = Record_StreamReader_GetSize( rsr );
+	unsigned int trailer[2];
+	unsigned int offset;
+	unsigned int count;
+	char header[9];
+
+	if ( size < 25 || !Record_StreamReader_ReadRange( rsr, size - 8, trailer, sizeof( trailer ) ) ||
+			trailer[1] != RECORD_SEEK_INDEX_MAGIC ) {
+		Record_Printf( RP_DEBUG, "record stream has no seek index\n" );
+		return;
+	}
+
+	offset = trailer[0];
+	if ( offset > size - 17 || !Record_StreamReader_ReadRange( rsr, offset, header, sizeof( header ) ) ||
+			header[0] != RC_SEEK_INDEX ) {
+		Record_Printf( RP_ALL, "Record_StreamReader_LoadSeekIndex: invalid index offset\n" );
+		return;
+	}
+	count = *(unsigned int *)( header + 5 );
+	if ( count != ( size - offset - 17 ) / 8 || ( size - offset - 17 ) % 8 ) {
+		Record_Printf( RP_ALL, "Record_StreamReader_LoadSeekIndex: invalid index size\n" );
+		return;
+	}
+
+	if ( count ) {
+		rsr->seekIndex = (char *)Record_Calloc( count * 8 );
+		if ( !Record_StreamReader_ReadRange( rsr, offset + 9, rsr->seekIndex, count * 8 ) ) {
+			Record_Printf( RP_ALL, "Record_StreamReader_LoadSeekIndex: failed to read index\n" );
+			Record_Free( rsr->seekIndex );
+			rsr->seekIndex = NULL;
+			return;
+		}
+	}
+	rsr->seekIndexStartTime = *(int *)( header + 1 );
+	rsr->seekIndexCount = (int)count;
+	Record_Printf( RP_DEBUG, "record stream seek index loaded with %i keyframes\n", rsr->seekIndexCount );
 }
 
 /*
@@ -251,17 +390,28 @@ If qtrue returned, stream needs to be freed by Record_StreamReader_Close
 ==================
 */
 static qboolean Record_StreamReader_Init( record_stream_reader_t *rsr, const char *path ) {
+#ifndef STEF_RECORD_STREAMING_READER
 	fileHandle_t fp = 0;
+#endif
 #ifdef ELITEFORCE
 	int protocol;
 #else
 	int size;
 	char *protocol;
 #endif
+	qboolean haveSeekIndex;
 	int maxClients;
 
 	Com_Memset( rsr, 0, sizeof( *rsr ) );
 
+#ifdef STEF_RECORD_STREAMING_READER
+	rsr->file = Record_File_OpenReader( path );
+	if ( !rsr->file ) {
+		Record_Printf( RP_ALL, "Record_StreamReader_Init: failed to open source file\n" );
+		return qfalse;
+	}
+	Record_File_AttachStream( rsr->file, &rsr->stream );
+#else
 	FS_SV_FOpenFileRead( path, &fp );
 	if ( !fp ) {
 		Record_Printf( RP_ALL, "Record_StreamReader_Init: failed to open source file\n" );
@@ -274,35 +424,56 @@ static qboolean Record_StreamReader_Init( record_stream_reader_t *rsr, const cha
 		return qfalse;
 	}
 	FS_FCloseFile( fp );
+#endif
 
-	if ( rsr->stream.size < 8 ) {
+	if ( Record_StreamReader_GetSize( rsr ) < 8 ) {
 		Record_Printf( RP_ALL, "Record_StreamReader_Init: invalid source file length\n" );
-		Record_Free( rsr->stream.data );
+		Record_StreamReader_FreeSource( rsr );
 		return qfalse;
 	}
 
 	// verify protocol version
 #ifdef ELITEFORCE
 	protocol = *(int *)Record_Stream_ReadStatic( 4, &rsr->stream );
-	if ( protocol != RECORD_PROTOCOL ) {
+	if ( protocol != RECORD_PROTOCOL && protocol != RECORD_PROTOCOL_LEGACY
+#ifdef STEF_RECORD_FIELD_ENCODING
+			&& protocol != RECORD_PROTOCOL_WORD_ENCODING
+#endif
+			) {
 		Record_Printf( RP_ALL, "Record_StreamReader_Init: record stream has wrong protocol (got %i, expected %i)\n",
 				protocol, RECORD_PROTOCOL );
-		Record_Free( rsr->stream.data );
+		Record_StreamReader_FreeSource( rsr );
 		return qfalse;
 	}
+	haveSeekIndex = protocol != RECORD_PROTOCOL_LEGACY ? qtrue : qfalse;
+#ifdef STEF_RECORD_FIELD_ENCODING
+	rsr->stream.fieldEncoding = protocol == RECORD_PROTOCOL ? qtrue : qfalse;
+#endif
 #else
 	size = *(int *)Record_Stream_ReadStatic( 4, &rsr->stream );
-	if ( size != sizeof( RECORD_PROTOCOL ) - 1 ) {
+	if ( size != sizeof( RECORD_PROTOCOL ) - 1 && size != sizeof( RECORD_PROTOCOL_LEGACY ) - 1
+#ifdef STEF_RECORD_FIELD_ENCODING
+			&& size != sizeof( RECORD_PROTOCOL_WORD_ENCODING ) - 1
+#endif
+			) {
 		Record_Printf( RP_ALL, "Record_StreamReader_Init: record stream has wrong protocol length\n" );
-		Record_Free( rsr->stream.data );
+		Record_StreamReader_FreeSource( rsr );
 		return qfalse;
 	}
 	protocol = Record_Stream_ReadStatic( size, &rsr->stream );
-	if ( memcmp( protocol, RECORD_PROTOCOL, size ) ) {
+	if ( memcmp( protocol, RECORD_PROTOCOL, size ) && memcmp( protocol, RECORD_PROTOCOL_LEGACY, size )
+#ifdef STEF_RECORD_FIELD_ENCODING
+			&& memcmp( protocol, RECORD_PROTOCOL_WORD_ENCODING, size )
+#endif
+			) {
 		Record_Printf( RP_ALL, "Record_StreamReader_Init: record stream has wrong protocol string\n" );
-		Record_Free( rsr->stream.data );
+		Record_StreamReader_FreeSource( rsr );
 		return qfalse;
 	}
+	haveSeekIndex = memcmp( protocol, RECORD_PROTOCOL_LEGACY, size ) ? qtrue : qfalse;
+#ifdef STEF_RECORD_FIELD_ENCODING
+	rsr->stream.fieldEncoding = memcmp( protocol, RECORD_PROTOCOL, size ) ? qfalse : qtrue;
+#endif
 	// read past optional auxiliary field
 	size = *(int *)Record_Stream_ReadStatic( 4, &rsr->stream );
 	Record_Stream_ReadStatic( size, &rsr->stream );
@@ -311,11 +482,14 @@ static qboolean Record_StreamReader_Init( record_stream_reader_t *rsr, const cha
 	maxClients = *(int *)Record_Stream_ReadStatic( 4, &rsr->stream );
 	if ( maxClients < 1 || maxClients > RECORD_MAX_CLIENTS ) {
 		Record_Printf( RP_ALL, "Record_StreamReader_Init: bad maxClients\n" );
-		Record_Free( rsr->stream.data );
+		Record_StreamReader_FreeSource( rsr );
 		return qfalse;
 	}
 
 	rsr->rs = Record_AllocateState( maxClients );
+	if ( haveSeekIndex ) {
+		Record_StreamReader_LoadSeekIndex( rsr );
+	}
 	Record_Printf( RP_DEBUG, "stream reader initialized with %i maxClients\n", maxClients );
 	return qtrue;
 }
@@ -326,7 +500,7 @@ Record_StreamReader_Close
 ==================
 */
 static void Record_StreamReader_Close( record_stream_reader_t *rsr ) {
-	Record_Free( rsr->stream.data );
+	Record_StreamReader_FreeSource( rsr );
 	Record_FreeState( rsr->rs );
 }
 
@@ -350,7 +524,7 @@ Returns qtrue on success, qfalse on error or end of stream
 ==================
 */
 static qboolean Record_StreamReader_Advance( record_stream_reader_t *rsr ) {
-	if ( rsr->stream.position >= rsr->stream.size ) {
+	if ( Record_Stream_AtEnd( &rsr->stream ) ) {
 		return qfalse;
 	}
 	rsr->command = (record_command_t)*(unsigned char *)Record_Stream_ReadStatic( 1, &rsr->stream );
@@ -361,7 +535,12 @@ static qboolean Record_StreamReader_Advance( record_stream_reader_t *rsr ) {
 			if ( size == 255 ) {
 				size = *(unsigned short *)Record_Stream_ReadStatic( 2, &rsr->stream );
 			}
+#ifdef STEF_RECORD_FIELD_ENCODING
+			rsr->payload = Record_Stream_ReadStatic( size, &rsr->stream );
+			rsr->payloadSize = size;
+#else
 			Record_Stream_ReadStatic( size, &rsr->stream );
+#endif
 			break;
 		}
 
@@ -385,6 +564,9 @@ static qboolean Record_StreamReader_Advance( record_stream_reader_t *rsr ) {
 			char *string = Record_DecodeString( &rsr->stream );
 			Z_Free( rsr->rs->configstrings[index] );
 			rsr->rs->configstrings[index] = CopyString( string );
+#ifdef STEF_RECORD_FIELD_ENCODING
+			rsr->configstringIndex = index;
+#endif
 			break;
 		}
 		case RC_STATE_CURRENT_SERVERCMD: {
@@ -406,6 +588,32 @@ static qboolean Record_StreamReader_Advance( record_stream_reader_t *rsr ) {
 		case RC_EVENT_MAP_RESTART:
 			break;
 
+		case RC_STATE_KEYFRAME: {
+			// state is already current when reading sequentially, so just skip it
+			int size;
+#ifdef STEF_RECORD_FIELD_ENCODING
+			rsr->keyframeTime = *(int *)Record_Stream_ReadStatic( 4, &rsr->stream );
+			size = *(int *)Record_Stream_ReadStatic( 4, &rsr->stream );
+			rsr->payload = Record_Stream_ReadStatic( size, &rsr->stream );
+			rsr->payloadSize = size;
+#else
+			Record_Stream_ReadStatic( 4, &rsr->stream );
+			size = *(int *)Record_Stream_ReadStatic( 4, &rsr->stream );
+			Record_Stream_ReadStatic( size, &rsr->stream );
+#endif
+			break;
+		}
+		case RC_SEEK_INDEX: {
+			unsigned int count;
+			Record_Stream_ReadStatic( 4, &rsr->stream );
+			count = *(unsigned int *)Record_Stream_ReadStatic( 4, &rsr->stream );
+			if ( count > Record_StreamReader_GetSize( rsr ) / 8 ) {
+				Record_Stream_Error( &rsr->stream, "Record_StreamReader_Advance: invalid seek index" );
+			}
+			Record_Stream_ReadStatic( count * 8 + 8, &rsr->stream );
+			break;
+		}
+
 		default:
 			Record_Printf( RP_ALL, "Record_StreamReader_Advance: unknown command %i\n", rsr->command );
 			return qfalse;
@@ -414,6 +622,63 @@ static qboolean Record_StreamReader_Advance( record_stream_reader_t *rsr ) {
 	return qtrue;
 }
 
+/*
+==================
+Record_StreamReader_SeekKeyframe
+
+Moves stream to the last keyframe at or before the given server time, and replaces record
+state with the keyframe contents. Returns qfalse if there is no suitable keyframe, in which
+case the stream is unchanged.
+==================
+*/
+static qboolean Record_StreamReader_SeekKeyframe( record_stream_reader_t *rsr, int time ) {
+	record_data_stream_t keyframeStream;
+	unsigned int offset;
+	int selected = -1;
+	int size;
+	int i;
+
+	for ( i = 0; i < rsr->seekIndexCount; ++i ) {
+		if ( *(int *)( rsr->seekIndex + i * 8 + 4 ) > time ) {
+			break;
+		}
+		selected = i;
+	}
+	if ( selected < 0 ) {
+		return qfalse;
+	}
+
+	offset = *(unsigned int *)( rsr->seekIndex + selected * 8 );
+	if ( offset >= Record_StreamReader_GetSize( rsr ) ) {
+		Record_Stream_Error( &rsr->stream, "Record_StreamReader_SeekKeyframe: invalid keyframe offset" );
+	}
+#ifdef STEF_RECORD_STREAMING_READER
+	if ( !Record_File_SeekStream( &rsr->stream, offset ) ) {
+		Record_Stream_Error( &rsr->stream, "Record_StreamReader_SeekKeyframe: failed to seek stream" );
+	}
+#else
+	rsr->stream.position = offset;
+#endif
+	if ( *(unsigned char *)Record_Stream_ReadStatic( 1, &rsr->stream ) != RC_STATE_KEYFRAME ) {
+		Record_Stream_Error( &rsr->stream, "Record_StreamReader_SeekKeyframe: keyframe not found at offset" );
+	}
+	rsr->time = *(int *)Record_Stream_ReadStatic( 4, &rsr->stream );
+	size = *(int *)Record_Stream_ReadStatic( 4, &rsr->stream );
+
+	// decode from a copy limited to the keyframe payload
+	keyframeStream = rsr->stream;
+	keyframeStream.data = Record_Stream_ReadStatic( size, &rsr->stream );
+	keyframeStream.position = 0;
+	keyframeStream.size = size;
+#ifdef STEF_RECORD_STREAMING_READER
+	keyframeStream.refill = NULL;
+#endif
+	Record_DecodeKeyframe( rsr->rs, &rsr->keyframe, &keyframeStream );
+
+	rsr->command = RC_STATE_KEYFRAME;
+	return qtrue;
+}
+
 /* ******************************************************************************** */
 // Record Conversion
 /* ******************************************************************************** */
@@ -433,8 +698,100 @@ typedef struct {
 	record_stream_reader_t rsr;
 	record_demo_writer_t rdw;
 	int frameCount;
+
+	// Time range in msec relative to first snapshot in record, or -1 for no limit
+	int startTime;
+	int endTime;
+	qboolean haveRecordStartTime;
+	int recordStartTime;
+
+	qboolean sessionActive;		// Selected client instance is in game
+	qboolean sessionEnded;
 } record_conversion_handler_t;
 
+/*
+==================
+Record_Convert_CheckFiring
+
+Adds 'firing' and 'ceased' messages to demo for sv_recordConvertWeptiming.
+==================
+*/
+#ifdef ELITEFORCE
+static void Record_Convert_CheckFiring( record_usercmd_t *recordUsercmd, int *firingTime, record_demo_writer_t *rdw ) {
+	usercmd_t usercmd;
+	Record_UnpackUsercmd( recordUsercmd, &usercmd );
+#else
+static void Record_Convert_CheckFiring( usercmd_t *recordUsercmd, int *firingTime, record_demo_writer_t *rdw ) {
+	usercmd_t usercmd = *recordUsercmd;
+#endif
+
+	if ( Record_UsercmdIsFiringWeapon( &usercmd ) ) {
+		if ( !*firingTime ) {
+			Record_WriteDemoSvcmd( "print \"Firing\n\"", rdw );
+			*firingTime = usercmd.serverTime;
+		}
+	} else {
+		if ( *firingTime ) {
+			char buffer[128];
+			Com_sprintf( buffer, sizeof( buffer ), "print \"Ceased %i\n\"", usercmd.serverTime - *firingTime );
+			Record_WriteDemoSvcmd( buffer, rdw );
+			*firingTime = 0;
+		}
+	}
+}
+
+/*
+==================
+Record_Convert_GetPlayerstate
+
+Returns playerstate to write to demo for client.
+==================
+*/
+static playerState_t Record_Convert_GetPlayerstate( record_state_t *rs, int clientNum ) {
+	playerState_t ps = rs->clients[clientNum].playerstate;
+	if ( sv_recordConvertSimulateFollow->integer ) {
+		Record_SetPlayerstateFollowFlag( &ps );
+	}
+	return ps;
+}
+
+/*
+==================
+Record_Convert_SeekStart
+
+Jumps to the last keyframe before start time, if start time is set and the record has a
+seek index, and determines whether the selected session is already in progress.
+==================
+*/
+static void Record_Convert_SeekStart( record_conversion_handler_t *rch ) {
+	record_stream_reader_t *rsr = &rch->rsr;
+	int instances;
+
+	if ( rch->startTime <= 0 || !rsr->seekIndexCount ) {
+		return;
+	}
+	if ( !Record_StreamReader_SeekKeyframe( rsr, rsr->seekIndexStartTime + rch->startTime ) ) {
+		return;
+	}
+
+	rch->haveRecordStartTime = qtrue;
+	rch->recordStartTime = rsr->seekIndexStartTime;
+	rch->baselines = rsr->keyframe.baselines;
+	Record_Printf( RP_DEBUG, "seeking to keyframe at %.1f seconds\n",
+			( rsr->time - rsr->seekIndexStartTime ) / 1000.0f );
+
+	instances = rsr->keyframe.instanceCounts[rch->clientNum];
+	if ( instances <= rch->instanceWait ) {
+		rch->instanceWait -= instances;
+	} else if ( instances - 1 == rch->instanceWait && rsr->keyframe.activeClients[rch->clientNum] ) {
+		rch->instanceWait = 0;
+		rch->sessionActive = qtrue;
+	} else {
+		// session ended before the start time
+		rch->sessionEnded = qtrue;
+	}
+}
+
 /*
 ==================
 Record_Convert_Process
@@ -446,18 +803,32 @@ static void Record_Convert_Process( record_conversion_handler_t *rch ) {
 		return;
 	}
 
-	while ( Record_StreamReader_Advance( &rch->rsr ) ) {
+	Record_Convert_SeekStart( rch );
+
+	while ( rch->state != CSTATE_FINISHED && !rch->sessionEnded && Record_StreamReader_Advance( &rch->rsr ) ) {
 		switch ( rch->rsr.command ) {
 			case RC_EVENT_BASELINES:
 				rch->baselines = rch->rsr.rs->entities;
 				break;
 
 			case RC_EVENT_SNAPSHOT:
+				if ( !rch->haveRecordStartTime ) {
+					rch->haveRecordStartTime = qtrue;
+					rch->recordStartTime = rch->rsr.time;
+				}
+				if ( rch->state == CSTATE_CONVERTING && rch->endTime >= 0 &&
+						rch->rsr.time - rch->recordStartTime > rch->endTime ) {
+					rch->state = CSTATE_FINISHED;
+					break;
+				}
+				if ( rch->state == CSTATE_NOT_STARTED && rch->sessionActive &&
+						rch->rsr.time - rch->recordStartTime >= rch->startTime ) {
+					// Start encoding at the first snapshot within time range
+					Record_WriteDemoGamestate( &rch->baselines, rch->rsr.rs->configstrings, rch->clientNum, &rch->rdw );
+					rch->state = CSTATE_CONVERTING;
+				}
 				if ( rch->state == CSTATE_CONVERTING ) {
-					playerState_t ps = rch->rsr.rs->clients[rch->clientNum].playerstate;
-					if ( sv_recordConvertSimulateFollow->integer ) {
-						Record_SetPlayerstateFollowFlag( &ps );
-					}
+					playerState_t ps = Record_Convert_GetPlayerstate( rch->rsr.rs, rch->clientNum );
 					Record_WriteDemoSnapshot( &rch->rsr.rs->entities, &rch->rsr.rs->clients[rch->clientNum].visibility,
 							&ps, rch->rsr.time, &rch->rdw );
 					++rch->frameCount;
@@ -473,35 +844,7 @@ static void Record_Convert_Process( record_conversion_handler_t *rch ) {
 			case RC_STATE_USERCMD:
 				if ( rch->state == CSTATE_CONVERTING && rch->rsr.clientNum == rch->clientNum &&
 						sv_recordConvertWeptiming->integer ) {
-#ifdef ELITEFORCE
-					usercmd_t usercmd;
-					Record_UnpackUsercmd( &rch->rsr.rs->clients[rch->clientNum].usercmd, &usercmd );
-					if ( Record_UsercmdIsFiringWeapon( &usercmd ) ) {
-#else
-					usercmd_t *usercmd = &rch->rsr.rs->clients[rch->clientNum].usercmd;
-					if ( Record_UsercmdIsFiringWeapon( usercmd ) ) {
-#endif
-						if ( !rch->firingTime ) {
-							Record_WriteDemoSvcmd( "print \"Firing\n\"", &rch->rdw );
-#ifdef ELITEFORCE
-							rch->firingTime = usercmd.serverTime;
-#else
-							rch->firingTime = usercmd->serverTime;
-#endif
-						}
-					} else {
-						if ( rch->firingTime ) {
-							char buffer[128];
-							Com_sprintf( buffer, sizeof( buffer ), "print \"Ceased %i\n\"",
-#ifdef ELITEFORCE
-									usercmd.serverTime - rch->firingTime );
-#else
-									usercmd->serverTime - rch->firingTime );
-#endif
-							Record_WriteDemoSvcmd( buffer, &rch->rdw );
-							rch->firingTime = 0;
-						}
-					}
+					Record_Convert_CheckFiring( &rch->rsr.rs->clients[rch->clientNum].usercmd, &rch->firingTime, &rch->rdw );
 				}
 				break;
 
@@ -512,21 +855,27 @@ static void Record_Convert_Process( record_conversion_handler_t *rch ) {
 				break;
 
 			case RC_EVENT_CLIENT_ENTER_WORLD:
-				if ( rch->state == CSTATE_NOT_STARTED && rch->rsr.clientNum == rch->clientNum ) {
+				if ( !rch->sessionActive && rch->rsr.clientNum == rch->clientNum ) {
 					if ( rch->instanceWait ) {
 						--rch->instanceWait;
 					} else {
-						// Start encoding
-						Record_WriteDemoGamestate( &rch->baselines, rch->rsr.rs->configstrings, rch->clientNum, &rch->rdw );
-						rch->state = CSTATE_CONVERTING;
+						rch->sessionActive = qtrue;
+						if ( rch->startTime <= 0 ) {
+							// Start encoding
+							Record_WriteDemoGamestate( &rch->baselines, rch->rsr.rs->configstrings, rch->clientNum, &rch->rdw );
+							rch->state = CSTATE_CONVERTING;
+						}
 					}
 				}
 				break;
 
 			case RC_EVENT_CLIENT_DISCONNECT:
-				if ( rch->state == CSTATE_CONVERTING && rch->rsr.clientNum == rch->clientNum ) {
+				if ( rch->sessionActive && rch->rsr.clientNum == rch->clientNum ) {
 					// Stop encoding
-					rch->state = CSTATE_FINISHED;
+					rch->sessionEnded = qtrue;
+					if ( rch->state == CSTATE_CONVERTING ) {
+						rch->state = CSTATE_FINISHED;
+					}
 				}
 				break;
 
@@ -543,7 +892,7 @@ static void Record_Convert_Process( record_conversion_handler_t *rch ) {
 Record_Convert_Run
 ==================
 */
-static void Record_Convert_Run( const char *path, int clientNum, int instance ) {
+static void Record_Convert_Run( const char *path, int clientNum, int instance, int startTime, int endTime ) {
 #ifdef ELITEFORCE
 	const char *output_path = sv_recordConvertLegacyProtocol->integer ? "demos/output.efdemo" : "demos/output.dm_26";
 #else
@@ -554,11 +903,19 @@ static void Record_Convert_Run( const char *path, int clientNum, int instance )
 	rch = (record_conversion_handler_t *)Record_Calloc( sizeof( *rch ) );
 	rch->clientNum = clientNum;
 	rch->instanceWait = instance;
+	rch->startTime = startTime;
+	rch->endTime = endTime;
 
 	if ( !Record_StreamReader_Init( &rch->rsr, path ) ) {
 		Record_Free( rch );
 		return;
 	}
+	if ( clientNum < 0 || clientNum >= rch->rsr.rs->maxClients ) {
+		Record_Printf( RP_ALL, "invalid client number\n" );
+		Record_StreamReader_Close( &rch->rsr );
+		Record_Free( rch );
+		return;
+	}
 
 	if ( !Record_InitializeDemoWriter( &rch->rdw, output_path ) ) {
 		Record_StreamReader_Close( &rch->rsr );
@@ -590,13 +947,28 @@ Record_Convert_Cmd
 */
 void Record_Convert_Cmd( void ) {
 	char path[128];
+	int startTime = -1;
+	int endTime = -1;
 
 	if ( Cmd_Argc() < 2 ) {
-		Record_Printf( RP_ALL, "Usage: record_convert <path within 'records' directory> <client> <instance>\n"
-				"Example: record_convert source.rec 0 0\n" );
+		Record_Printf( RP_ALL, "Usage: record_convert <path within 'records' directory> <client> <instance>"
+				" [start seconds] [end seconds]\n"
+				"Example: record_convert source.rec 0 0\n"
+				"Start and end times are relative to the beginning of the record file.\n" );
 		return;
 	}
 
+	if ( Cmd_Argc() > 4 ) {
+		startTime = (int)( atof( Cmd_Argv( 4 ) ) * 1000.0 );
+	}
+	if ( Cmd_Argc() > 5 ) {
+		endTime = (int)( atof( Cmd_Argv( 5 ) ) * 1000.0 );
+		if ( endTime < startTime ) {
+			Record_Printf( RP_ALL, "End time must not be before start time\n" );
+			return;
+		}
+	}
+
 	Com_sprintf( path, sizeof( path ), "records/%s", Cmd_Argv( 1 ) );
 	COM_DefaultExtension( path, sizeof( path ), ".rec" );
 	if ( strstr( path, ".." ) ) {
@@ -604,30 +976,388 @@ void Record_Convert_Cmd( void ) {
 		return;
 	}
 
-	Record_Convert_Run( path, atoi( Cmd_Argv( 2 ) ), atoi( Cmd_Argv( 3 ) ) );
+	Record_Convert_Run( path, atoi( Cmd_Argv( 2 ) ), atoi( Cmd_Argv( 3 ) ), startTime, endTime );
 }
 
+#ifdef STEF_RECORD_CONVERT_ALL
 /* ******************************************************************************** */
-// Record Scanning
+// Multi-POV Conversion
 /* ******************************************************************************** */
 
+typedef struct {
+	record_conversion_state_t state;	// State of current instance
+	qboolean inGame;
+	int firingTime;
+	int frameCount;
+	char path[MAX_QPATH];
+	record_demo_writer_t rdw;
+
+	// Snapshot encoded during current frame
+	qboolean snapshotPending;
+	msg_t msg;
+	byte buffer[MAX_MSGLEN_BUF];
+} record_pov_session_t;
+
+typedef struct {
+	record_stream_reader_t rsr;
+	record_entityset_t baselines;
+	char outputBase[MAX_QPATH];
+	int demoCount;
+
+	// Time range in msec relative to first snapshot in record, or -1 for no limit
+	int startTime;
+	int endTime;
+	qboolean haveRecordStartTime;
+	int recordStartTime;
+	qboolean reachedEndTime;
+
+	// Sessions are allocated when a client first enters the world, since each one is fairly large
+	record_pov_session_t *sessions[RECORD_MAX_CLIENTS];
+	int instanceCounts[RECORD_MAX_CLIENTS];
+	int pendingSessions[RECORD_MAX_CLIENTS];
+	int pendingCount;
+} record_multi_conversion_t;
+
 /*
 ==================
-Record_Scan_ProcessStream
+Record_ConvertAll_GetSession
+
+Returns session for client, allocating it if necessary.
 ==================
 */
-static void Record_Scan_ProcessStream( record_stream_reader_t *rsr ) {
-	int instance_counts[RECORD_MAX_CLIENTS];
-
-	rsr->stream.abortSet = qtrue;
-	if ( setjmp( rsr->stream.abort ) ) {
-		return;
+static record_pov_session_t *Record_ConvertAll_GetSession( record_multi_conversion_t *rmc, int clientNum ) {
+	if ( !rmc->sessions[clientNum] ) {
+		rmc->sessions[clientNum] = (record_pov_session_t *)Record_Calloc( sizeof( *rmc->sessions[clientNum] ) );
 	}
+	return rmc->sessions[clientNum];
+}
 
-	Com_Memset( instance_counts, 0, sizeof( instance_counts ) );
+/*
+==================
+Record_ConvertAll_StartDemo
 
-	while ( Record_StreamReader_Advance( rsr ) ) {
-		switch ( rsr->command ) {
+Opens demo file for current client instance and writes gamestate.
+==================
+*/
+static void Record_ConvertAll_StartDemo( record_multi_conversion_t *rmc, int clientNum ) {
+	record_pov_session_t *session = rmc->sessions[clientNum];
+#ifdef ELITEFORCE
+	const char *extension = sv_recordConvertLegacyProtocol->integer ? "efdemo" : "dm_26";
+#else
+	const char *extension = "dm_" XSTRING( OLD_PROTOCOL_VERSION );
+#endif
+
+	Com_sprintf( session->path, sizeof( session->path ), "demos/%s_%i_%i.%s", rmc->outputBase, clientNum,
+			rmc->instanceCounts[clientNum] - 1, extension );
+	if ( !Record_InitializeDemoWriter( &session->rdw, session->path ) ) {
+		session->state = CSTATE_FINISHED;
+		return;
+	}
+
+	Record_WriteDemoGamestate( &rmc->baselines, rmc->rsr.rs->configstrings, clientNum, &session->rdw );
+	session->state = CSTATE_CONVERTING;
+	session->firingTime = 0;
+	session->frameCount = 0;
+}
+
+/*
+==================
+Record_ConvertAll_EndDemo
+==================
+*/
+static void Record_ConvertAll_EndDemo( record_multi_conversion_t *rmc, int clientNum, qboolean complete ) {
+	record_pov_session_t *session = rmc->sessions[clientNum];
+
+	if ( !session ) {
+		return;
+	}
+	if ( session->state == CSTATE_CONVERTING ) {
+		Record_CloseDemoWriter( &session->rdw );
+		Record_Printf( RP_ALL, "%i frames written to %s%s\n", session->frameCount, session->path,
+				complete ? "" : " (incomplete)" );
+		++rmc->demoCount;
+	}
+	session->state = CSTATE_FINISHED;
+}
+
+/*
+==================
+Record_ConvertAll_EncodeJob
+
+Encodes pending snapshot for one session. Only touches the session's own demo writer
+and message, so it can be called from worker threads.
+==================
+*/
+static void Record_ConvertAll_EncodeJob( int index, void *context ) {
+	record_multi_conversion_t *rmc = (record_multi_conversion_t *)context;
+	int clientNum = rmc->pendingSessions[index];
+	record_pov_session_t *session = rmc->sessions[clientNum];
+	playerState_t ps = Record_Convert_GetPlayerstate( rmc->rsr.rs, clientNum );
+
+	Record_InitDemoMessage( &session->msg, session->buffer );
+	Record_EncodeDemoSnapshot( &rmc->rsr.rs->entities, &rmc->rsr.rs->clients[clientNum].visibility, &ps,
+			rmc->rsr.time, &session->rdw, &session->msg );
+}
+
+/*
+==================
+Record_ConvertAll_WriteSnapshots
+
+Encodes current snapshot for each active demo, then writes the messages in client order.
+==================
+*/
+static void Record_ConvertAll_WriteSnapshots( record_multi_conversion_t *rmc ) {
+	int i;
+
+	if ( !rmc->pendingCount ) {
+		return;
+	}
+
+#ifdef STEF_THREADS
+	Stef_Jobs_Run( rmc->pendingCount, Record_ConvertAll_EncodeJob, rmc, sv_recordConvertThreads->integer );
+#else
+	for ( i = 0; i < rmc->pendingCount; ++i ) {
+		Record_ConvertAll_EncodeJob( i, rmc );
+	}
+#endif
+
+	for ( i = 0; i < rmc->pendingCount; ++i ) {
+		record_pov_session_t *session = rmc->sessions[rmc->pendingSessions[i]];
+		Record_FinishDemoMessage( &session->msg, &session->rdw );
+		++session->frameCount;
+	}
+	rmc->pendingCount = 0;
+}
+
+/*
+==================
+Record_ConvertAll_SeekStart
+
+Jumps to the last keyframe before start time, if start time is set and the record has a
+seek index, and marks clients that are already in game.
+==================
+*/
+static void Record_ConvertAll_SeekStart( record_multi_conversion_t *rmc ) {
+	record_stream_reader_t *rsr = &rmc->rsr;
+	int i;
+
+	if ( rmc->startTime <= 0 || !rsr->seekIndexCount ) {
+		return;
+	}
+	if ( !Record_StreamReader_SeekKeyframe( rsr, rsr->seekIndexStartTime + rmc->startTime ) ) {
+		return;
+	}
+
+	rmc->haveRecordStartTime = qtrue;
+	rmc->recordStartTime = rsr->seekIndexStartTime;
+	rmc->baselines = rsr->keyframe.baselines;
+
+	for ( i = 0; i < rsr->rs->maxClients; ++i ) {
+		rmc->instanceCounts[i] = rsr->keyframe.instanceCounts[i];
+		if ( rsr->keyframe.activeClients[i] ) {
+			Record_ConvertAll_GetSession( rmc, i )->inGame = qtrue;
+		}
+	}
+}
+
+/*
+==================
+Record_ConvertAll_Process
+==================
+*/
+static void Record_ConvertAll_Process( record_multi_conversion_t *rmc ) {
+	record_stream_reader_t *rsr = &rmc->rsr;
+	int i;
+
+	rsr->stream.abortSet = qtrue;
+	if ( setjmp( rsr->stream.abort ) ) {
+		return;
+	}
+
+	Record_ConvertAll_SeekStart( rmc );
+
+	while ( Record_StreamReader_Advance( rsr ) ) {
+		record_pov_session_t *session = rmc->sessions[rsr->clientNum];
+
+		switch ( rsr->command ) {
+			case RC_EVENT_BASELINES:
+				rmc->baselines = rsr->rs->entities;
+				break;
+
+			case RC_EVENT_SNAPSHOT:
+				if ( !rmc->haveRecordStartTime ) {
+					rmc->haveRecordStartTime = qtrue;
+					rmc->recordStartTime = rsr->time;
+				}
+				if ( rmc->endTime >= 0 && rsr->time - rmc->recordStartTime > rmc->endTime ) {
+					rmc->reachedEndTime = qtrue;
+					rsr->stream.abortSet = qfalse;
+					return;
+				}
+				if ( rsr->time - rmc->recordStartTime < rmc->startTime ) {
+					break;
+				}
+				for ( i = 0; i < rsr->rs->maxClients; ++i ) {
+					record_pov_session_t *current = rmc->sessions[i];
+					if ( !current ) {
+						continue;
+					}
+					if ( current->inGame && current->state == CSTATE_NOT_STARTED ) {
+						// Start encoding at the first snapshot within time range
+						Record_ConvertAll_StartDemo( rmc, i );
+					}
+					if ( current->state == CSTATE_CONVERTING ) {
+						rmc->pendingSessions[rmc->pendingCount++] = i;
+					}
+				}
+				Record_ConvertAll_WriteSnapshots( rmc );
+				break;
+
+			case RC_EVENT_SERVERCMD:
+				if ( session && session->state == CSTATE_CONVERTING ) {
+					Record_WriteDemoSvcmd( rsr->rs->currentServercmd, &session->rdw );
+				}
+				break;
+
+			case RC_STATE_USERCMD:
+				if ( session && session->state == CSTATE_CONVERTING && sv_recordConvertWeptiming->integer ) {
+					Record_Convert_CheckFiring( &rsr->rs->clients[rsr->clientNum].usercmd, &session->firingTime,
+							&session->rdw );
+				}
+				break;
+
+			case RC_EVENT_MAP_RESTART:
+				for ( i = 0; i < rsr->rs->maxClients; ++i ) {
+					if ( rmc->sessions[i] && rmc->sessions[i]->state == CSTATE_CONVERTING ) {
+						Record_WriteDemoMapRestart( &rmc->sessions[i]->rdw );
+					}
+				}
+				break;
+
+			case RC_EVENT_CLIENT_ENTER_WORLD:
+				Record_ConvertAll_EndDemo( rmc, rsr->clientNum, qfalse );
+				session = Record_ConvertAll_GetSession( rmc, rsr->clientNum );
+				session->inGame = qtrue;
+				session->state = CSTATE_NOT_STARTED;
+				++rmc->instanceCounts[rsr->clientNum];
+				if ( rmc->startTime <= 0 ) {
+					// Start encoding
+					Record_ConvertAll_StartDemo( rmc, rsr->clientNum );
+				}
+				break;
+
+			case RC_EVENT_CLIENT_DISCONNECT:
+				// Stop encoding
+				Record_ConvertAll_EndDemo( rmc, rsr->clientNum, qtrue );
+				if ( session ) {
+					session->inGame = qfalse;
+				}
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	rsr->stream.abortSet = qfalse;
+}
+
+/*
+==================
+Record_ConvertAll_Run
+==================
+*/
+static void Record_ConvertAll_Run( const char *path, const char *outputBase, int startTime, int endTime ) {
+	record_multi_conversion_t *rmc = (record_multi_conversion_t *)Record_Calloc( sizeof( *rmc ) );
+	int i;
+
+	Q_strncpyz( rmc->outputBase, outputBase, sizeof( rmc->outputBase ) );
+	rmc->startTime = startTime;
+	rmc->endTime = endTime;
+
+	if ( !Record_StreamReader_Init( &rmc->rsr, path ) ) {
+		Record_Free( rmc );
+		return;
+	}
+	Record_ConvertAll_Process( rmc );
+
+	for ( i = 0; i < rmc->rsr.rs->maxClients; ++i ) {
+		Record_ConvertAll_EndDemo( rmc, i, rmc->reachedEndTime );
+		if ( rmc->sessions[i] ) {
+			Record_Free( rmc->sessions[i] );
+		}
+	}
+	Record_Printf( RP_ALL, "%i demos written\n", rmc->demoCount );
+
+	Record_StreamReader_Close( &rmc->rsr );
+	Record_Free( rmc );
+}
+
+/*
+==================
+Record_ConvertAll_Cmd
+==================
+*/
+void Record_ConvertAll_Cmd( void ) {
+	char path[128];
+	char outputBase[MAX_QPATH];
+	int startTime = -1;
+	int endTime = -1;
+
+	if ( Cmd_Argc() < 2 ) {
+		Record_Printf( RP_ALL, "Usage: record_convert_all <path within 'records' directory>"
+				" [start seconds] [end seconds]\n"
+				"Example: record_convert_all source.rec\n"
+				"Writes a demo for each client session, decoding the record file once.\n" );
+		return;
+	}
+
+	if ( Cmd_Argc() > 2 ) {
+		startTime = (int)( atof( Cmd_Argv( 2 ) ) * 1000.0 );
+	}
+	if ( Cmd_Argc() > 3 ) {
+		endTime = (int)( atof( Cmd_Argv( 3 ) ) * 1000.0 );
+		if ( endTime < startTime ) {
+			Record_Printf( RP_ALL, "End time must not be before start time\n" );
+			return;
+		}
+	}
+
+	Com_sprintf( path, sizeof( path ), "records/%s", Cmd_Argv( 1 ) );
+	COM_DefaultExtension( path, sizeof( path ), ".rec" );
+	if ( strstr( path, ".." ) ) {
+		Record_Printf( RP_ALL, "Invalid path\n" );
+		return;
+	}
+
+	// output files are named after the record file, in the top level of the demos directory
+	COM_StripExtension( COM_SkipPath( path ), outputBase, sizeof( outputBase ) );
+
+	Record_ConvertAll_Run( path, outputBase, startTime, endTime );
+}
+#endif
+
+/* ******************************************************************************** */
+// Record Scanning
+/* ******************************************************************************** */
+
+/*
+==================
+Record_Scan_ProcessStream
+==================
+*/
+static void Record_Scan_ProcessStream( record_stream_reader_t *rsr ) {
+	int instance_counts[RECORD_MAX_CLIENTS];
+
+	rsr->stream.abortSet = qtrue;
+	if ( setjmp( rsr->stream.abort ) ) {
+		return;
+	}
+
+	Com_Memset( instance_counts, 0, sizeof( instance_counts ) );
+
+	while ( Record_StreamReader_Advance( rsr ) ) {
+		switch ( rsr->command ) {
 			case RC_EVENT_CLIENT_ENTER_WORLD:
 				Record_Printf( RP_ALL, "client(%i) instance(%i)\n", rsr->clientNum,
 						instance_counts[rsr->clientNum] );
@@ -655,11 +1385,99 @@ static void Record_Scan_Run( const char *path ) {
 	}
 
 	Record_Scan_ProcessStream( rsr );
+	if ( rsr->seekIndexCount ) {
+		Record_Printf( RP_ALL, "%i keyframes, last at %.1f seconds\n", rsr->seekIndexCount,
+				( *(int *)( rsr->seekIndex + ( rsr->seekIndexCount - 1 ) * 8 + 4 ) - rsr->seekIndexStartTime ) / 1000.0f );
+	}
 
 	Record_StreamReader_Close( rsr );
 	Record_Free( rsr );
 }
 
+#ifdef STEF_RECORD_STREAMING_READER
+typedef struct {
+	char **paths;
+	int count;
+	int size;
+} record_scan_list_t;
+
+/*
+==================
+Record_Scan_AddFile
+==================
+*/
+static void Record_Scan_AddFile( iterate_data_t *file_data, void *context ) {
+	record_scan_list_t *list = (record_scan_list_t *)context;
+
+	if ( Q_stricmp( COM_GetExtension( file_data->qpath_with_mod_dir ), "rec" ) ) {
+		return;
+	}
+
+	if ( list->count >= list->size ) {
+		char **oldPaths = list->paths;
+		list->size = list->size ? list->size * 2 : 64;
+		list->paths = (char **)Record_Calloc( sizeof( *list->paths ) * list->size );
+		if ( oldPaths ) {
+			Com_Memcpy( list->paths, oldPaths, sizeof( *list->paths ) * list->count );
+			Record_Free( oldPaths );
+		}
+	}
+
+	list->paths[list->count] = (char *)Record_Calloc( strlen( file_data->qpath_with_mod_dir ) + 1 );
+	strcpy( list->paths[list->count], file_data->qpath_with_mod_dir );
+	++list->count;
+}
+
+/*
+==================
+Record_Scan_ComparePaths
+==================
+*/
+static int Record_Scan_ComparePaths( const void *path1, const void *path2 ) {
+	return strcmp( *(const char **)path1, *(const char **)path2 );
+}
+
+/*
+==================
+Record_Scan_Directory
+
+Scans each record file in directory and subdirectories in sorted order. Only one file is
+open at a time. Returns qfalse if no record files were found.
+==================
+*/
+static qboolean Record_Scan_Directory( const char *path ) {
+	record_scan_list_t list;
+	char osPath[FS_MAX_PATH];
+	fsc_ospath_t *fscOsPath;
+	int i;
+
+	if ( !FS_GeneratePathWritedir( path, NULL, FS_ALLOW_DIRECTORIES, 0, osPath, sizeof( osPath ) ) ) {
+		return qfalse;
+	}
+
+	Com_Memset( &list, 0, sizeof( list ) );
+	fscOsPath = FSC_StringToOSPath( osPath );
+	FSC_IterateDirectory( fscOsPath, Record_Scan_AddFile, &list );
+	FSC_Free( fscOsPath );
+
+	if ( !list.count ) {
+		return qfalse;
+	}
+
+	qsort( list.paths, list.count, sizeof( *list.paths ), Record_Scan_ComparePaths );
+	for ( i = 0; i < list.count; ++i ) {
+		char filePath[FS_MAX_PATH];
+		Com_sprintf( filePath, sizeof( filePath ), "%s/%s", path, list.paths[i] );
+		Record_Printf( RP_ALL, "==== %s ====\n", filePath );
+		Record_Scan_Run( filePath );
+		Record_Free( list.paths[i] );
+	}
+
+	Record_Free( list.paths );
+	return qtrue;
+}
+#endif
+
 /*
 ==================
 Record_Scan_Cmd
@@ -669,19 +1487,716 @@ void Record_Scan_Cmd( void ) {
 	char path[128];
 
 	if ( Cmd_Argc() < 2 ) {
+#ifdef STEF_RECORD_STREAMING_READER
+		Record_Printf( RP_ALL, "Usage: record_scan <file or directory within 'records' directory>\n"
+				"Example: record_scan source.rec\n" );
+#else
 		Record_Printf( RP_ALL, "Usage: record_scan <path within 'records' directory>\n"
 				"Example: record_scan source.rec\n" );
+#endif
 		return;
 	}
 
 	Com_sprintf( path, sizeof( path ), "records/%s", Cmd_Argv( 1 ) );
-	COM_DefaultExtension( path, sizeof( path ), ".rec" );
 	if ( strstr( path, ".." ) ) {
 		Record_Printf( RP_ALL, "Invalid path\n" );
 		return;
 	}
 
+#ifdef STEF_RECORD_STREAMING_READER
+	if ( Record_Scan_Directory( path ) ) {
+		return;
+	}
+#endif
+
+	COM_DefaultExtension( path, sizeof( path ), ".rec" );
 	Record_Scan_Run( path );
 }
 
+#ifdef STEF_RECORD_FIELD_ENCODING
+/* ******************************************************************************** */
+// Record Upgrade
+/* ******************************************************************************** */
+
+// Rewrites an older record file in the current protocol. Each state command is decoded
+// and encoded again from an output copy of the record state, and keyframes are decoded
+// and encoded again with a new seek index.
+
+#define RECORD_UPGRADE_BUFFER_SIZE ( 4 * 1024 * 1024 )
+#define RECORD_UPGRADE_FLUSH_SIZE ( 1024 * 1024 )
+
+typedef struct {
+	record_stream_reader_t rsr;
+	record_state_t *rs;				// state matching output stream
+	record_state_t *keyframeState;
+	record_keyframe_t keyframe;
+
+#ifdef STEF_RECORD_ASYNC_WRITER
+	record_file_writer_t *fileWriter;
+#else
+	fileHandle_t file;
+#endif
+	record_data_stream_t stream;
+	record_data_stream_t keyframeStream;
+	unsigned int fileOffset;
+
+	qboolean haveSnapshot;
+	int firstSnapshotTime;
+	record_seek_entry_t *seekIndex;
+	int seekIndexCount;
+	int seekIndexSize;
+} record_upgrade_t;
+
+/*
+==================
+Record_Upgrade_Flush
+==================
+*/
+static void Record_Upgrade_Flush( record_upgrade_t *ru ) {
+#ifdef STEF_RECORD_ASYNC_WRITER
+	Record_File_Write( ru->fileWriter, ru->stream.data, ru->stream.position );
+#else
+	FS_Write( ru->stream.data, ru->stream.position, ru->file );
+#endif
+	ru->fileOffset += ru->stream.position;
+	ru->stream.position = 0;
+}
+
+/*
+==================
+Record_Upgrade_WriteKeyframe
+==================
+*/
+static void Record_Upgrade_WriteKeyframe( record_upgrade_t *ru ) {
+	record_data_stream_t sourceStream = ru->rsr.stream;
+
+	// decode from a copy limited to the keyframe payload
+	sourceStream.data = ru->rsr.payload;
+	sourceStream.position = 0;
+	sourceStream.size = ru->rsr.payloadSize;
+#ifdef STEF_RECORD_STREAMING_READER
+	sourceStream.refill = NULL;
+#endif
+	sourceStream.abortSet = qfalse;
+	Record_DecodeKeyframe( ru->keyframeState, &ru->keyframe, &sourceStream );
+
+	ru->keyframeStream.position = 0;
+	Record_EncodeKeyframe( ru->keyframeState, &ru->keyframe, &ru->keyframeStream );
+
+	if ( ru->seekIndexCount >= ru->seekIndexSize ) {
+		record_seek_entry_t *oldIndex = ru->seekIndex;
+		ru->seekIndexSize = ru->seekIndexSize ? ru->seekIndexSize * 2 : 256;
+		ru->seekIndex = (record_seek_entry_t *)Record_Calloc( sizeof( *ru->seekIndex ) * ru->seekIndexSize );
+		if ( oldIndex ) {
+			Com_Memcpy( ru->seekIndex, oldIndex, sizeof( *ru->seekIndex ) * ru->seekIndexCount );
+			Record_Free( oldIndex );
+		}
+	}
+	ru->seekIndex[ru->seekIndexCount].offset = ru->fileOffset + ru->stream.position;
+	ru->seekIndex[ru->seekIndexCount].time = ru->rsr.keyframeTime;
+	++ru->seekIndexCount;
+
+	Record_Stream_WriteValue( RC_STATE_KEYFRAME, 1, &ru->stream );
+	Record_Stream_WriteValue( ru->rsr.keyframeTime, 4, &ru->stream );
+	Record_Stream_WriteValue( ru->keyframeStream.position, 4, &ru->stream );
+	Record_Upgrade_Flush( ru );
+#ifdef STEF_RECORD_ASYNC_WRITER
+	Record_File_Write( ru->fileWriter, ru->keyframeStream.data, ru->keyframeStream.position );
+#else
+	FS_Write( ru->keyframeStream.data, ru->keyframeStream.position, ru->file );
+#endif
+	ru->fileOffset += ru->keyframeStream.position;
+}
+
+/*
+==================
+Record_Upgrade_WriteSeekIndex
+==================
+*/
+static void Record_Upgrade_WriteSeekIndex( record_upgrade_t *ru ) {
+	unsigned int indexOffset;
+	int i;
+
+	Record_Upgrade_Flush( ru );
+	indexOffset = ru->fileOffset;
+
+	Record_Stream_WriteValue( RC_SEEK_INDEX, 1, &ru->stream );
+	Record_Stream_WriteValue( ru->firstSnapshotTime, 4, &ru->stream );
+	Record_Stream_WriteValue( ru->seekIndexCount, 4, &ru->stream );
+	for ( i = 0; i < ru->seekIndexCount; ++i ) {
+		Record_Stream_WriteValue( ru->seekIndex[i].offset, 4, &ru->stream );
+		Record_Stream_WriteValue( ru->seekIndex[i].time, 4, &ru->stream );
+		if ( ru->stream.position > RECORD_UPGRADE_FLUSH_SIZE ) {
+			Record_Upgrade_Flush( ru );
+		}
+	}
+	Record_Stream_WriteValue( indexOffset, 4, &ru->stream );
+	Record_Stream_WriteValue( RECORD_SEEK_INDEX_MAGIC, 4, &ru->stream );
+	Record_Upgrade_Flush( ru );
+}
+
+/*
+==================
+Record_Upgrade_ProcessCommand
+==================
+*/
+static void Record_Upgrade_ProcessCommand( record_upgrade_t *ru ) {
+	record_stream_reader_t *rsr = &ru->rsr;
+	int clientNum = rsr->clientNum;
+
+	switch ( rsr->command ) {
+		case RC_MISC_COMMAND:
+			Record_Stream_WriteValue( RC_MISC_COMMAND, 1, &ru->stream );
+			if ( rsr->payloadSize >= 255 ) {
+				Record_Stream_WriteValue( 255, 1, &ru->stream );
+				Record_Stream_WriteValue( rsr->payloadSize, 2, &ru->stream );
+			} else {
+				Record_Stream_WriteValue( rsr->payloadSize, 1, &ru->stream );
+			}
+			Record_Stream_Write( rsr->payload, rsr->payloadSize, &ru->stream );
+			break;
+
+		case RC_STATE_ENTITY_SET:
+			Record_Stream_WriteValue( RC_STATE_ENTITY_SET, 1, &ru->stream );
+			Record_EncodeEntityset( &ru->rs->entities, &rsr->rs->entities, &ru->stream );
+			break;
+		case RC_STATE_PLAYERSTATE:
+			Record_Stream_WriteValue( RC_STATE_PLAYERSTATE, 1, &ru->stream );
+			Record_Stream_WriteValue( clientNum, 1, &ru->stream );
+			Record_EncodePlayerstate( &ru->rs->clients[clientNum].playerstate,
+					&rsr->rs->clients[clientNum].playerstate, &ru->stream );
+			break;
+		case RC_STATE_VISIBILITY:
+			Record_Stream_WriteValue( RC_STATE_VISIBILITY, 1, &ru->stream );
+			Record_Stream_WriteValue( clientNum, 1, &ru->stream );
+			Record_EncodeVisibilityState( &ru->rs->clients[clientNum].visibility,
+					&rsr->rs->clients[clientNum].visibility, &ru->stream );
+			break;
+		case RC_STATE_USERCMD:
+			Record_Stream_WriteValue( RC_STATE_USERCMD, 1, &ru->stream );
+			Record_Stream_WriteValue( clientNum, 1, &ru->stream );
+			Record_EncodeUsercmd( &ru->rs->clients[clientNum].usercmd,
+					&rsr->rs->clients[clientNum].usercmd, &ru->stream );
+			break;
+		case RC_STATE_CONFIGSTRING:
+			Record_Stream_WriteValue( RC_STATE_CONFIGSTRING, 1, &ru->stream );
+			Record_Stream_WriteValue( rsr->configstringIndex, 2, &ru->stream );
+			Record_EncodeString( rsr->rs->configstrings[rsr->configstringIndex], &ru->stream );
+			break;
+		case RC_STATE_CURRENT_SERVERCMD:
+			Record_Stream_WriteValue( RC_STATE_CURRENT_SERVERCMD, 1, &ru->stream );
+			Record_EncodeString( rsr->rs->currentServercmd, &ru->stream );
+			break;
+
+		case RC_EVENT_SNAPSHOT:
+			if ( !ru->haveSnapshot ) {
+				ru->haveSnapshot = qtrue;
+				ru->firstSnapshotTime = rsr->time;
+			}
+			Record_Stream_WriteValue( RC_EVENT_SNAPSHOT, 1, &ru->stream );
+			Record_Stream_WriteValue( rsr->time, 4, &ru->stream );
+			break;
+		case RC_EVENT_SERVERCMD:
+		case RC_EVENT_CLIENT_ENTER_WORLD:
+		case RC_EVENT_CLIENT_DISCONNECT:
+			Record_Stream_WriteValue( rsr->command, 1, &ru->stream );
+			Record_Stream_WriteValue( clientNum, 1, &ru->stream );
+			break;
+		case RC_EVENT_BASELINES:
+		case RC_EVENT_MAP_RESTART:
+			Record_Stream_WriteValue( rsr->command, 1, &ru->stream );
+			break;
+
+		case RC_STATE_KEYFRAME:
+			Record_Upgrade_WriteKeyframe( ru );
+			break;
+		case RC_SEEK_INDEX:
+			// replaced by new index at end of file
+			break;
+
+		default:
+			break;
+	}
+
+	if ( ru->stream.position > RECORD_UPGRADE_FLUSH_SIZE ) {
+		Record_Upgrade_Flush( ru );
+	}
+}
+
+/*
+==================
+Record_Upgrade_ProcessStream
+
+Returns qtrue if the whole source stream was converted.
+==================
+*/
+static qboolean Record_Upgrade_ProcessStream( record_upgrade_t *ru ) {
+	ru->rsr.stream.abortSet = qtrue;
+	if ( setjmp( ru->rsr.stream.abort ) ) {
+		return qfalse;
+	}
+	ru->stream.abortSet = qtrue;
+	if ( setjmp( ru->stream.abort ) ) {
+		return qfalse;
+	}
+	ru->keyframeStream.abortSet = qtrue;
+	if ( setjmp( ru->keyframeStream.abort ) ) {
+		return qfalse;
+	}
+
+	while ( Record_StreamReader_Advance( &ru->rsr ) ) {
+		Record_Upgrade_ProcessCommand( ru );
+	}
+	Record_Upgrade_WriteSeekIndex( ru );
+
+	ru->rsr.stream.abortSet = qfalse;
+	ru->stream.abortSet = qfalse;
+	ru->keyframeStream.abortSet = qfalse;
+	return qtrue;
+}
+
+/*
+==================
+Record_Upgrade_Run
+==================
+*/
+static void Record_Upgrade_Run( const char *path, const char *outputPath ) {
+	record_upgrade_t *ru = (record_upgrade_t *)Record_Calloc( sizeof( *ru ) );
+	int maxClients;
+	qboolean success;
+
+	if ( !Record_StreamReader_Init( &ru->rsr, path ) ) {
+		Record_Free( ru );
+		return;
+	}
+	if ( ru->rsr.stream.fieldEncoding ) {
+		Record_Printf( RP_ALL, "Record file is already using the current protocol\n" );
+		Record_StreamReader_Close( &ru->rsr );
+		Record_Free( ru );
+		return;
+	}
+
+#ifdef STEF_RECORD_ASYNC_WRITER
+	ru->fileWriter = Record_File_OpenWriter( outputPath, sv_recordCompress->integer ? qtrue : qfalse );
+	if ( !ru->fileWriter ) {
+#else
+	ru->file = FS_SV_FOpenFileWrite( outputPath );
+	if ( !ru->file ) {
+#endif
+		Record_Printf( RP_ALL, "Record_Upgrade_Run: failed to open output file\n" );
+		Record_StreamReader_Close( &ru->rsr );
+		Record_Free( ru );
+		return;
+	}
+
+	maxClients = ru->rsr.rs->maxClients;
+	ru->rs = Record_AllocateState( maxClients );
+	ru->keyframeState = Record_AllocateState( maxClients );
+	ru->stream.data = (char *)Record_Calloc( RECORD_UPGRADE_BUFFER_SIZE );
+	ru->stream.size = RECORD_UPGRADE_BUFFER_SIZE;
+	ru->stream.fieldEncoding = qtrue;
+	ru->keyframeStream.data = (char *)Record_Calloc( RECORD_KEYFRAME_BUFFER_SIZE );
+	ru->keyframeStream.size = RECORD_KEYFRAME_BUFFER_SIZE;
+	ru->keyframeStream.fieldEncoding = qtrue;
+
+	// Write the protocol and max clients
+	Record_EncodeStreamHeader( maxClients, &ru->stream );
+
+	success = Record_Upgrade_ProcessStream( ru );
+	if ( ru->stream.position ) {
+		Record_Upgrade_Flush( ru );
+	}
+
+#ifdef STEF_RECORD_ASYNC_WRITER
+	Record_File_CloseWriter( ru->fileWriter );
+#else
+	FS_FCloseFile( ru->file );
+#endif
+
+	if ( success ) {
+		Record_Printf( RP_ALL, "Wrote %s (%u bytes, %i keyframes)\n", outputPath, ru->fileOffset, ru->seekIndexCount );
+	} else {
+		Record_Printf( RP_ALL, "Record_Upgrade_Run: failed to convert record stream\n" );
+		FS_SV_Rename( outputPath, va( "%s.failed", outputPath ) );
+	}
+
+	Record_Free( ru->stream.data );
+	Record_Free( ru->keyframeStream.data );
+	if ( ru->seekIndex ) {
+		Record_Free( ru->seekIndex );
+	}
+	Record_FreeState( ru->rs );
+	Record_FreeState( ru->keyframeState );
+	Record_StreamReader_Close( &ru->rsr );
+	Record_Free( ru );
+}
+
+/*
+==================
+Record_Upgrade_Cmd
+==================
+*/
+void Record_Upgrade_Cmd( void ) {
+	char path[128];
+	char outputPath[128];
+	char base[128];
+
+	if ( Cmd_Argc() < 2 ) {
+		Record_Printf( RP_ALL, "Usage: record_upgrade <path within 'records' directory>\n"
+				"Example: record_upgrade source.rec\n"
+				"Writes a copy of an older record file in the current protocol, as source-upgraded.rec.\n" );
+		return;
+	}
+
+	Com_sprintf( path, sizeof( path ), "records/%s", Cmd_Argv( 1 ) );
+	COM_DefaultExtension( path, sizeof( path ), ".rec" );
+	if ( strstr( path, ".." ) ) {
+		Record_Printf( RP_ALL, "Invalid path\n" );
+		return;
+	}
+
+	COM_StripExtension( path, base, sizeof( base ) );
+	Com_sprintf( outputPath, sizeof( outputPath ), "%s-upgraded.rec", base );
+
+	Record_Upgrade_Run( path, outputPath );
+}
+
+/* ******************************************************************************** */
+// Record Benchmark
+/* ******************************************************************************** */
+
+// Encodes each state change in a record file with both the word and field encodings, and
+// reports the encoded size and encode/decode time for each.
+//
+// State changes are collected into batches, and each encoding runs over a whole batch per
+// timer read, since single operations are too short to time. Batches are stored in the word
+// encoding, so rebuilding the encoder input from the batch is timed separately and subtracted
+// from the encode time.
+
+#define RECORD_BENCHMARK_BUFFER_SIZE ( 4 * 1024 * 1024 )
+#define RECORD_BENCHMARK_BATCH_SIZE ( 1024 * 1024 )
+#define RECORD_BENCHMARK_BATCH_COMMANDS 16384
+
+typedef struct {
+	int command;
+	int clientNum;
+} record_benchmark_command_t;
+
+typedef struct {
+	const char *name;
+	record_data_stream_t stream;
+	record_state_t *inputState;
+	record_state_t *encodeState;
+	record_state_t *decodeState;
+	unsigned int bytes;
+	int64_t encodeTime;
+	int64_t decodeTime;
+	int mismatches;
+} record_benchmark_encoding_t;
+
+typedef struct {
+	record_stream_reader_t rsr;
+	record_benchmark_encoding_t encodings[2];
+
+	// Current batch of state changes
+	record_data_stream_t batch;
+	record_state_t *batchState;
+	record_benchmark_command_t commands[RECORD_BENCHMARK_BATCH_COMMANDS];
+	int commandCount;
+
+	// Time to rebuild the encoder input from batches, which is included in encodeTime
+	record_state_t *replayState;
+	int64_t replayTime;
+
+	int snapshots;
+	int lastSnapshotTime;
+	int64_t duration;
+} record_benchmark_t;
+
+/*
+==================
+Record_Benchmark_EncodeCommand
+
+Encodes the difference from state to source for the given state command, and updates state.
+==================
+*/
+static void Record_Benchmark_EncodeCommand( const record_benchmark_command_t *cmd, record_state_t *state,
+		record_state_t *source, record_data_stream_t *stream ) {
+	int clientNum = cmd->clientNum;
+
+	switch ( cmd->command ) {
+		case RC_STATE_ENTITY_SET:
+			Record_EncodeEntityset( &state->entities, &source->entities, stream );
+			break;
+		case RC_STATE_PLAYERSTATE:
+			Record_EncodePlayerstate( &state->clients[clientNum].playerstate,
+					&source->clients[clientNum].playerstate, stream );
+			break;
+		case RC_STATE_VISIBILITY:
+			Record_EncodeVisibilityState( &state->clients[clientNum].visibility,
+					&source->clients[clientNum].visibility, stream );
+			break;
+		default:
+			Record_EncodeUsercmd( &state->clients[clientNum].usercmd,
+					&source->clients[clientNum].usercmd, stream );
+			break;
+	}
+}
+
+/*
+==================
+Record_Benchmark_DecodeCommand
+==================
+*/
+static void Record_Benchmark_DecodeCommand( const record_benchmark_command_t *cmd, record_state_t *state,
+		record_data_stream_t *stream ) {
+	int clientNum = cmd->clientNum;
+
+	switch ( cmd->command ) {
+		case RC_STATE_ENTITY_SET:
+			Record_DecodeEntityset( &state->entities, stream );
+			break;
+		case RC_STATE_PLAYERSTATE:
+			Record_DecodePlayerstate( &state->clients[clientNum].playerstate, stream );
+			break;
+		case RC_STATE_VISIBILITY:
+			Record_DecodeVisibilityState( &state->clients[clientNum].visibility, stream );
+			break;
+		default:
+			Record_DecodeUsercmd( &state->clients[clientNum].usercmd, stream );
+			break;
+	}
+}
+
+/*
+==================
+Record_Benchmark_CheckState
+
+Returns qtrue if decoded state matches encoded state, otherwise resets it to the encoded state.
+==================
+*/
+static qboolean Record_Benchmark_CheckState( record_state_t *encoded, record_state_t *decoded ) {
+	int size = sizeof( *encoded->clients ) * encoded->maxClients;
+
+	if ( !memcmp( &encoded->entities, &decoded->entities, sizeof( encoded->entities ) ) &&
+			!memcmp( encoded->clients, decoded->clients, size ) ) {
+		return qtrue;
+	}
+
+	Com_Memcpy( &decoded->entities, &encoded->entities, sizeof( encoded->entities ) );
+	Com_Memcpy( decoded->clients, encoded->clients, size );
+	return qfalse;
+}
+
+/*
+==================
+Record_Benchmark_ProcessBatch
+
+Runs the current batch through each encoding, then decodes it to a separate state to
+check the result.
+==================
+*/
+static void Record_Benchmark_ProcessBatch( record_benchmark_t *rb ) {
+	record_data_stream_t input = rb->batch;
+	int64_t start;
+	int i, j;
+
+	input.size = input.position;
+	input.position = 0;
+	start = Sys_Microseconds();
+	for ( i = 0; i < rb->commandCount; ++i ) {
+		Record_Benchmark_DecodeCommand( &rb->commands[i], rb->replayState, &input );
+	}
+	rb->replayTime += Sys_Microseconds() - start;
+
+	for ( j = 0; j < 2; ++j ) {
+		record_benchmark_encoding_t *rbe = &rb->encodings[j];
+		record_data_stream_t decodeStream;
+
+		input.position = 0;
+		rbe->stream.position = 0;
+		start = Sys_Microseconds();
+		for ( i = 0; i < rb->commandCount; ++i ) {
+			Record_Benchmark_DecodeCommand( &rb->commands[i], rbe->inputState, &input );
+			Record_Benchmark_EncodeCommand( &rb->commands[i], rbe->encodeState, rbe->inputState, &rbe->stream );
+		}
+		rbe->encodeTime += Sys_Microseconds() - start;
+		rbe->bytes += rbe->stream.position;
+
+		decodeStream = rbe->stream;
+		decodeStream.size = decodeStream.position;
+		decodeStream.position = 0;
+		start = Sys_Microseconds();
+		for ( i = 0; i < rb->commandCount; ++i ) {
+			Record_Benchmark_DecodeCommand( &rb->commands[i], rbe->decodeState, &decodeStream );
+		}
+		rbe->decodeTime += Sys_Microseconds() - start;
+
+		if ( !Record_Benchmark_CheckState( rbe->encodeState, rbe->decodeState ) ||
+				decodeStream.position != decodeStream.size ) {
+			++rbe->mismatches;
+		}
+	}
+
+	rb->batch.position = 0;
+	rb->commandCount = 0;
+}
+
+/*
+==================
+Record_Benchmark_AddCommand
+
+Adds current state change from reader state to the batch.
+==================
+*/
+static void Record_Benchmark_AddCommand( record_benchmark_t *rb, record_stream_reader_t *rsr ) {
+	record_benchmark_command_t *cmd = &rb->commands[rb->commandCount++];
+
+	cmd->command = rsr->command;
+	cmd->clientNum = rsr->clientNum;
+	Record_Benchmark_EncodeCommand( cmd, rb->batchState, rsr->rs, &rb->batch );
+
+	if ( rb->commandCount >= RECORD_BENCHMARK_BATCH_COMMANDS || rb->batch.position >= RECORD_BENCHMARK_BATCH_SIZE ) {
+		Record_Benchmark_ProcessBatch( rb );
+	}
+}
+
+/*
+==================
+Record_Benchmark_Print
+==================
+*/
+static void Record_Benchmark_Print( record_benchmark_encoding_t *rbe, int64_t replayTime, int snapshots,
+		double hours ) {
+	int64_t encodeTime = rbe->encodeTime > replayTime ? rbe->encodeTime - replayTime : 0;
+
+	Record_Printf( RP_ALL, "%s: %u bytes, %.2f MB per match-hour, encode %.0f ns, decode %.0f ns per snapshot",
+			rbe->name, rbe->bytes, hours > 0.0 ? rbe->bytes / hours / 1000000.0 : 0.0,
+			snapshots ? encodeTime * 1000.0 / snapshots : 0.0,
+			snapshots ? rbe->decodeTime * 1000.0 / snapshots : 0.0 );
+	if ( rbe->mismatches ) {
+		Record_Printf( RP_ALL, " (%i mismatched batches)", rbe->mismatches );
+	}
+	Record_Printf( RP_ALL, "\n" );
+}
+
+/*
+==================
+Record_Benchmark_ProcessStream
+==================
+*/
+static void Record_Benchmark_ProcessStream( record_benchmark_t *rb ) {
+	record_stream_reader_t *rsr = &rb->rsr;
+
+	rsr->stream.abortSet = qtrue;
+	if ( setjmp( rsr->stream.abort ) ) {
+		Record_Benchmark_ProcessBatch( rb );
+		return;
+	}
+
+	while ( Record_StreamReader_Advance( rsr ) ) {
+		switch ( rsr->command ) {
+			case RC_EVENT_SNAPSHOT:
+				// only count forward time, in case of discontinuities like map changes
+				if ( rb->snapshots && rsr->time > rb->lastSnapshotTime ) {
+					rb->duration += rsr->time - rb->lastSnapshotTime;
+				}
+				rb->lastSnapshotTime = rsr->time;
+				++rb->snapshots;
+				break;
+			case RC_STATE_ENTITY_SET:
+			case RC_STATE_PLAYERSTATE:
+			case RC_STATE_VISIBILITY:
+			case RC_STATE_USERCMD:
+				Record_Benchmark_AddCommand( rb, rsr );
+				break;
+			default:
+				break;
+		}
+	}
+
+	rsr->stream.abortSet = qfalse;
+	Record_Benchmark_ProcessBatch( rb );
+}
+
+/*
+==================
+Record_Benchmark_Run
+==================
+*/
+static void Record_Benchmark_Run( const char *path ) {
+	record_benchmark_t *rb = (record_benchmark_t *)Record_Calloc( sizeof( *rb ) );
+	int maxClients;
+	int i;
+
+	if ( !Record_StreamReader_Init( &rb->rsr, path ) ) {
+		Record_Free( rb );
+		return;
+	}
+	maxClients = rb->rsr.rs->maxClients;
+
+	rb->batch.data = (char *)Record_Calloc( RECORD_BENCHMARK_BUFFER_SIZE );
+	rb->batch.size = RECORD_BENCHMARK_BUFFER_SIZE;
+	rb->batchState = Record_AllocateState( maxClients );
+	rb->replayState = Record_AllocateState( maxClients );
+
+	rb->encodings[0].name = "word encoding";
+	rb->encodings[1].name = "field encoding";
+	for ( i = 0; i < 2; ++i ) {
+		rb->encodings[i].stream.data = (char *)Record_Calloc( RECORD_BENCHMARK_BUFFER_SIZE );
+		rb->encodings[i].stream.size = RECORD_BENCHMARK_BUFFER_SIZE;
+		rb->encodings[i].stream.fieldEncoding = i ? qtrue : qfalse;
+		rb->encodings[i].inputState = Record_AllocateState( maxClients );
+		rb->encodings[i].encodeState = Record_AllocateState( maxClients );
+		rb->encodings[i].decodeState = Record_AllocateState( maxClients );
+	}
+
+	Record_Benchmark_ProcessStream( rb );
+
+	Record_Printf( RP_ALL, "%i snapshots, %.1f minutes\n", rb->snapshots, rb->duration / 60000.0 );
+	for ( i = 0; i < 2; ++i ) {
+		Record_Benchmark_Print( &rb->encodings[i], rb->replayTime, rb->snapshots, rb->duration / 3600000.0 );
+		Record_Free( rb->encodings[i].stream.data );
+		Record_FreeState( rb->encodings[i].inputState );
+		Record_FreeState( rb->encodings[i].encodeState );
+		Record_FreeState( rb->encodings[i].decodeState );
+	}
+	if ( rb->encodings[0].bytes ) {
+		Record_Printf( RP_ALL, "field encoding size: %.1f%%\n",
+				rb->encodings[1].bytes * 100.0 / rb->encodings[0].bytes );
+	}
+
+	Record_Free( rb->batch.data );
+	Record_FreeState( rb->batchState );
+	Record_FreeState( rb->replayState );
+	Record_StreamReader_Close( &rb->rsr );
+	Record_Free( rb );
+}
+
+/*
+==================
+Record_Benchmark_Cmd
+==================
+*/
+void Record_Benchmark_Cmd( void ) {
+	char path[128];
+
+	if ( Cmd_Argc() < 2 ) {
+		Record_Printf( RP_ALL, "Usage: record_benchmark <path within 'records' directory>\n"
+				"Example: record_benchmark source.rec\n"
+				"Compares record state encoding size and speed between protocol versions.\n" );
+		return;
+	}
+
+	Com_sprintf( path, sizeof( path ), "records/%s", Cmd_Argv( 1 ) );
+	COM_DefaultExtension( path, sizeof( path ), ".rec" );
+	if ( strstr( path, ".." ) ) {
+		Record_Printf( RP_ALL, "Invalid path\n" );
+		return;
+	}
+
+	Record_Benchmark_Run( path );
+}
+#endif
+
 #endif
@@ -0,0 +1,1028 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+Copyright (C) 2017-2023 Noah Metzger (chomenor@gmail.com)
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+
+// Record file output on a background thread with optional block compression, and
+// streaming input that only keeps a window of the file in memory.
+//
+// Compressed files start with RECORD_FILE_MAGIC followed by a sequence of blocks, each
+// consisting of a 4 byte uncompressed size, a 4 byte compressed size, and the block data.
+// Block data is a raw deflate stream which can be decoded independently of other blocks,
+// or uncompressed data if the compressed size equals the uncompressed size.
+// Uncompressed files contain the record stream directly, as in previous versions.
+
+#if defined( STEF_RECORD_ASYNC_WRITER ) || defined( STEF_RECORD_STREAMING_READER )
+#include "stef_sv_record_local.h"
+#include "../../filesystem/fscore/fscore.h"
+#include "../../filesystem/zlib/zlib.h"
+
+#define RECORD_FILE_MAGIC 0x5a434552	// "RECZ"
+#define RECORD_FILE_BLOCK_SIZE ( 256 * 1024 )
+
+/*
+==================
+Record_File_GetInt
+==================
+*/
+static unsigned int Record_File_GetInt( const byte *source ) {
+	return (unsigned int)source[0] | ( (unsigned int)source[1] << 8 ) |
+			( (unsigned int)source[2] << 16 ) | ( (unsigned int)source[3] << 24 );
+}
+
+/*
+==================
+Record_File_InflateBlock
+
+Returns qtrue if compressed data decoded to exactly outputSize bytes.
+==================
+*/
+static qboolean Record_File_InflateBlock( const char *data, unsigned int size, char *output, unsigned int outputSize ) {
+	z_stream zs;
+	int result;
+
+	Com_Memset( &zs, 0, sizeof( zs ) );
+	if ( inflateInit2( &zs, -MAX_WBITS ) != Z_OK ) {
+		return qfalse;
+	}
+	zs.next_in = (Bytef *)data;
+	zs.avail_in = size;
+	zs.next_out = (Bytef *)output;
+	zs.avail_out = outputSize;
+	result = inflate( &zs, Z_FINISH );
+	inflateEnd( &zs );
+
+	return result == Z_STREAM_END && !zs.avail_out ? qtrue : qfalse;
+}
+
+#ifdef STEF_RECORD_ASYNC_WRITER
+#define RECORD_FILE_QUEUE_BLOCKS 16
+
+#define DEFLATE_WINDOW_SIZE 32768
+#define DEFLATE_WINDOW_MASK ( DEFLATE_WINDOW_SIZE - 1 )
+#define DEFLATE_HASH_SIZE 32768
+#define DEFLATE_HASH_MASK ( DEFLATE_HASH_SIZE - 1 )
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+#define DEFLATE_MAX_CHAIN 32
+
+typedef struct {
+	char *data;
+	unsigned int size;
+} record_file_block_t;
+
+typedef struct {
+	int head[DEFLATE_HASH_SIZE];
+	int prev[DEFLATE_WINDOW_SIZE];
+} record_deflate_state_t;
+
+struct record_file_writer_s {
+	fsc_filehandle_t *fp;
+	qboolean compress;
+
+	// Block currently being filled by the main thread
+	char *current;
+	unsigned int currentSize;
+
+	// Queue of completed blocks, accessed under mutex
+	stef_mutex_t *mutex;
+	stef_cond_t *workCond;
+	stef_cond_t *spaceCond;
+	record_file_block_t queue[RECORD_FILE_QUEUE_BLOCKS];
+	int queueStart;
+	int queueCount;
+	qboolean shutdown;
+	stef_thread_t *thread;
+
+	// Used by whichever thread is processing blocks
+	record_deflate_state_t *deflate;
+	char *compressBuffer;
+	unsigned int bytesWritten;
+	qboolean writeError;
+
+	// Main thread stats
+	unsigned int bytesIn;
+	int stalls;
+};
+
+/* ******************************************************************************** */
+// Deflate Encoder
+/* ******************************************************************************** */
+
+// The vendored zlib only includes inflate, so blocks are encoded here using LZ77 with
+// hash chains and the fixed Huffman codes from RFC 1951.
+
+typedef struct {
+	byte *out;
+	unsigned int outSize;
+	unsigned int outPosition;
+	uint32_t bitBuffer;
+	int bitCount;
+	qboolean overflow;
+} record_bit_writer_t;
+
+static const unsigned short deflateLengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const byte deflateLengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const unsigned short deflateDistBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const byte deflateDistExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+/*
+==================
+Record_Deflate_PutBits
+==================
+*/
+static void Record_Deflate_PutBits( record_bit_writer_t *bw, uint32_t value, int bits ) {
+	bw->bitBuffer |= value << bw->bitCount;
+	bw->bitCount += bits;
+	while ( bw->bitCount >= 8 ) {
+		if ( bw->outPosition >= bw->outSize ) {
+			bw->overflow = qtrue;
+			return;
+		}
+		bw->out[bw->outPosition++] = (byte)bw->bitBuffer;
+		bw->bitBuffer >>= 8;
+		bw->bitCount -= 8;
+	}
+}
+
+/*
+==================
+Record_Deflate_PutCode
+
+Huffman codes are packed starting from the most significant bit.
+==================
+*/
+static void Record_Deflate_PutCode( record_bit_writer_t *bw, uint32_t code, int bits ) {
+	uint32_t reversed = 0;
+	int i;
+	for ( i = 0; i < bits; ++i ) {
+		reversed = ( reversed << 1 ) | ( ( code >> i ) & 1 );
+	}
+	Record_Deflate_PutBits( bw, reversed, bits );
+}
+
+/*
+==================
+Record_Deflate_PutSymbol
+
+Writes literal/length symbol using the fixed Huffman table.
+==================
+*/
+static void Record_Deflate_PutSymbol( record_bit_writer_t *bw, int symbol ) {
+	if ( symbol < 144 ) {
+		Record_Deflate_PutCode( bw, 0x30 + symbol, 8 );
+	} else if ( symbol < 256 ) {
+		Record_Deflate_PutCode( bw, 0x190 + symbol - 144, 9 );
+	} else if ( symbol < 280 ) {
+		Record_Deflate_PutCode( bw, symbol - 256, 7 );
+	} else {
+		Record_Deflate_PutCode( bw, 0xc0 + symbol - 280, 8 );
+	}
+}
+
+/*
+==================
+Record_Deflate_PutMatch
+==================
+*/
+static void Record_Deflate_PutMatch( record_bit_writer_t *bw, int length, int distance ) {
+	int code = 28;
+	while ( deflateLengthBase[code] > length ) {
+		--code;
+	}
+	Record_Deflate_PutSymbol( bw, 257 + code );
+	Record_Deflate_PutBits( bw, length - deflateLengthBase[code], deflateLengthExtra[code] );
+
+	code = 29;
+	while ( deflateDistBase[code] > distance ) {
+		--code;
+	}
+	Record_Deflate_PutCode( bw, code, 5 );
+	Record_Deflate_PutBits( bw, distance - deflateDistBase[code], deflateDistExtra[code] );
+}
+
+/*
+==================
+Record_Deflate_Hash
+==================
+*/
+static int Record_Deflate_Hash( const byte *data ) {
+	return ( ( data[0] << 10 ) ^ ( data[1] << 5 ) ^ data[2] ) & DEFLATE_HASH_MASK;
+}
+
+/*
+==================
+Record_Deflate_Insert
+==================
+*/
+static void Record_Deflate_Insert( record_deflate_state_t *state, const byte *data, int position ) {
+	int hash = Record_Deflate_Hash( data + position );
+	state->prev[position & DEFLATE_WINDOW_MASK] = state->head[hash];
+	state->head[hash] = position;
+}
+
+/*
+==================
+Record_Deflate_Compress
+
+Encodes data as a single final deflate block. Returns compressed size, or 0 if output
+would not fit in outSize.
+==================
+*/
+static unsigned int Record_Deflate_Compress( record_deflate_state_t *state, const byte *data, int size,
+		byte *out, unsigned int outSize ) {
+	record_bit_writer_t bw;
+	int position = 0;
+	int i;
+
+	Com_Memset( &bw, 0, sizeof( bw ) );
+	bw.out = out;
+	bw.outSize = outSize;
+
+	for ( i = 0; i < DEFLATE_HASH_SIZE; ++i ) {
+		state->head[i] = -1;
+	}
+
+	// final block with fixed codes
+	Record_Deflate_PutBits( &bw, 1, 1 );
+	Record_Deflate_PutBits( &bw, 1, 2 );
+
+	while ( position < size && !bw.overflow ) {
+		int bestLength = 0;
+		int bestDistance = 0;
+
+		if ( position + DEFLATE_MIN_MATCH <= size ) {
+			int maxLength = size - position < DEFLATE_MAX_MATCH ? size - position : DEFLATE_MAX_MATCH;
+			int candidate = state->head[Record_Deflate_Hash( data + position )];
+			int chain = DEFLATE_MAX_CHAIN;
+
+			while ( candidate >= 0 && position - candidate < DEFLATE_WINDOW_SIZE && chain-- > 0 ) {
+				int next;
+				if ( data[candidate + bestLength] == data[position + bestLength] ) {
+					int length = 0;
+					while ( length < maxLength && data[candidate + length] == data[position + length] ) {
+						++length;
+					}
+					if ( length > bestLength ) {
+						bestLength = length;
+						bestDistance = position - candidate;
+						if ( length == maxLength ) {
+							break;
+						}
+					}
+				}
+				next = state->prev[candidate & DEFLATE_WINDOW_MASK];
+				if ( next >= candidate ) {
+					break;
+				}
+				candidate = next;
+			}
+
+			Record_Deflate_Insert( state, data, position );
+		}
+
+		if ( bestLength >= DEFLATE_MIN_MATCH ) {
+			Record_Deflate_PutMatch( &bw, bestLength, bestDistance );
+			for ( i = 1; i < bestLength; ++i ) {
+				if ( position + i + DEFLATE_MIN_MATCH <= size ) {
+					Record_Deflate_Insert( state, data, position + i );
+				}
+			}
+			position += bestLength;
+		} else {
+			Record_Deflate_PutSymbol( &bw, data[position] );
+			++position;
+		}
+	}
+
+	// end of block, then pad to byte boundary
+	Record_Deflate_PutSymbol( &bw, 256 );
+	Record_Deflate_PutBits( &bw, 0, 7 );
+
+	return bw.overflow ? 0 : bw.outPosition;
+}
+
+/* ******************************************************************************** */
+// Block Processing
+/* ******************************************************************************** */
+
+/*
+==================
+Record_File_WriteRaw
+
+Called from the thread processing blocks. Can't use engine filesystem handles here.
+==================
+*/
+static void Record_File_WriteRaw( record_file_writer_t *writer, const void *data, unsigned int size ) {
+	if ( writer->writeError ) {
+		return;
+	}
+	if ( FSC_FWrite( data, size, writer->fp ) != size ) {
+		writer->writeError = qtrue;
+		return;
+	}
+	writer->bytesWritten += size;
+}
+
+/*
+==================
+Record_File_PutInt
+==================
+*/
+static void Record_File_PutInt( byte *target, unsigned int value ) {
+	target[0] = (byte)value;
+	target[1] = (byte)( value >> 8 );
+	target[2] = (byte)( value >> 16 );
+	target[3] = (byte)( value >> 24 );
+}
+
+/*
+==================
+Record_File_ProcessBlock
+
+Compresses and writes block, then frees block data.
+==================
+*/
+static void Record_File_ProcessBlock( record_file_writer_t *writer, record_file_block_t *block ) {
+	if ( writer->compress ) {
+		byte header[8];
+		unsigned int compressedSize = Record_Deflate_Compress( writer->deflate, (byte *)block->data, block->size,
+				(byte *)writer->compressBuffer, block->size - 1 );
+
+		Record_File_PutInt( header, block->size );
+		if ( compressedSize ) {
+			Record_File_PutInt( header + 4, compressedSize );
+			Record_File_WriteRaw( writer, header, sizeof( header ) );
+			Record_File_WriteRaw( writer, writer->compressBuffer, compressedSize );
+		} else {
+			// not compressible; store directly
+			Record_File_PutInt( header + 4, block->size );
+			Record_File_WriteRaw( writer, header, sizeof( header ) );
+			Record_File_WriteRaw( writer, block->data, block->size );
+		}
+	} else {
+		Record_File_WriteRaw( writer, block->data, block->size );
+	}
+
+	free( block->data );
+	block->data = NULL;
+}
+
+/*
+==================
+Record_File_WriterThread
+==================
+*/
+static void Record_File_WriterThread( void *arg ) {
+	record_file_writer_t *writer = (record_file_writer_t *)arg;
+
+	Stef_Mutex_Lock( writer->mutex );
+	while ( 1 ) {
+		record_file_block_t block;
+
+		while ( !writer->queueCount && !writer->shutdown ) {
+			Stef_Cond_Wait( writer->workCond, writer->mutex );
+		}
+		if ( !writer->queueCount ) {
+			break;
+		}
+
+		// block stays counted against queue limit until it has been written
+		block = writer->queue[writer->queueStart];
+		Stef_Mutex_Unlock( writer->mutex );
+		Record_File_ProcessBlock( writer, &block );
+		Stef_Mutex_Lock( writer->mutex );
+
+		writer->queueStart = ( writer->queueStart + 1 ) % RECORD_FILE_QUEUE_BLOCKS;
+		--writer->queueCount;
+		Stef_Cond_Signal( writer->spaceCond );
+	}
+	Stef_Mutex_Unlock( writer->mutex );
+}
+
+/*
+==================
+Record_File_QueueCurrentBlock
+
+If the queue is full, waits for the writer thread to catch up rather than dropping data.
+==================
+*/
+static void Record_File_QueueCurrentBlock( record_file_writer_t *writer ) {
+	record_file_block_t block;
+
+	if ( !writer->currentSize ) {
+		return;
+	}
+
+	block.data = writer->current;
+	block.size = writer->currentSize;
+	writer->current = NULL;
+	writer->currentSize = 0;
+
+	if ( !writer->thread ) {
+		Record_File_ProcessBlock( writer, &block );
+		return;
+	}
+
+	Stef_Mutex_Lock( writer->mutex );
+	if ( writer->queueCount >= RECORD_FILE_QUEUE_BLOCKS ) {
+		++writer->stalls;
+		while ( writer->queueCount >= RECORD_FILE_QUEUE_BLOCKS ) {
+			Stef_Cond_Wait( writer->spaceCond, writer->mutex );
+		}
+	}
+	writer->queue[( writer->queueStart + writer->queueCount ) % RECORD_FILE_QUEUE_BLOCKS] = block;
+	++writer->queueCount;
+	Stef_Cond_Signal( writer->workCond );
+	Stef_Mutex_Unlock( writer->mutex );
+}
+
+/* ******************************************************************************** */
+// Writer Interface
+/* ******************************************************************************** */
+
+/*
+==================
+Record_File_OpenWriter
+
+Path is relative to write directory. Returns NULL on error.
+==================
+*/
+record_file_writer_t *Record_File_OpenWriter( const char *path, qboolean compress ) {
+	char fullPath[FS_MAX_PATH];
+	record_file_writer_t *writer;
+	fsc_filehandle_t *fp;
+
+	if ( !FS_GeneratePathWritedir( NULL, path, 0, FS_ALLOW_DIRECTORIES | FS_CREATE_DIRECTORIES_FOR_FILE,
+			fullPath, sizeof( fullPath ) ) ) {
+		return NULL;
+	}
+	fp = FSC_FOpen( fullPath, "wb" );
+	if ( !fp ) {
+		return NULL;
+	}
+
+	writer = (record_file_writer_t *)calloc( 1, sizeof( *writer ) );
+	writer->fp = fp;
+	writer->compress = compress;
+
+	if ( compress ) {
+		byte magic[4];
+		writer->deflate = (record_deflate_state_t *)malloc( sizeof( *writer->deflate ) );
+		writer->compressBuffer = (char *)malloc( RECORD_FILE_BLOCK_SIZE );
+		Record_File_PutInt( magic, RECORD_FILE_MAGIC );
+		Record_File_WriteRaw( writer, magic, sizeof( magic ) );
+	}
+
+	writer->mutex = Stef_Mutex_Create();
+	writer->workCond = Stef_Cond_Create();
+	writer->spaceCond = Stef_Cond_Create();
+	writer->thread = Stef_Thread_Create( Record_File_WriterThread, writer );
+	if ( !writer->thread ) {
+		Record_Printf( RP_ALL, "Record_File_OpenWriter: failed to create thread; writing synchronously\n" );
+	}
+
+	return writer;
+}
+
+/*
+==================
+Record_File_Write
+
+Copies data to the pending block. Blocks are handed to the writer thread when full.
+==================
+*/
+void Record_File_Write( record_file_writer_t *writer, const char *data, unsigned int size ) {
+	writer->bytesIn += size;
+
+	while ( size ) {
+		unsigned int chunk = size < RECORD_FILE_BLOCK_SIZE ? size : RECORD_FILE_BLOCK_SIZE;
+
+		// keep each write in a single block where possible
+		if ( writer->currentSize + chunk > RECORD_FILE_BLOCK_SIZE ) {
+			Record_File_QueueCurrentBlock( writer );
+		}
+		if ( !writer->current ) {
+			writer->current = (char *)malloc( RECORD_FILE_BLOCK_SIZE );
+		}
+
+		Com_Memcpy( writer->current + writer->currentSize, data, chunk );
+		writer->currentSize += chunk;
+		data += chunk;
+		size -= chunk;
+	}
+}
+
+/*
+==================
+Record_File_CloseWriter
+
+Writes any remaining data and waits for the writer thread to finish, so the file is
+complete and closed when this returns.
+==================
+*/
+void Record_File_CloseWriter( record_file_writer_t *writer ) {
+	Record_File_QueueCurrentBlock( writer );
+
+	if ( writer->thread ) {
+		Stef_Mutex_Lock( writer->mutex );
+		writer->shutdown = qtrue;
+		Stef_Cond_Signal( writer->workCond );
+		Stef_Mutex_Unlock( writer->mutex );
+		Stef_Thread_Join( writer->thread );
+	}
+
+	FSC_FClose( writer->fp );
+
+	if ( writer->writeError ) {
+		Record_Printf( RP_ALL, "WARNING: Error writing record file; recording may be incomplete\n" );
+	}
+	if ( writer->stalls ) {
+		Record_Printf( RP_ALL, "WARNING: Record writer queue was full %i times; server frames were delayed"
+				" waiting for disk writes\n", writer->stalls );
+	}
+	Record_Printf( RP_DEBUG, "Record_File_CloseWriter: %u bytes recorded, %u bytes written\n",
+			writer->bytesIn, writer->bytesWritten );
+
+	free( writer->current );
+	free( writer->deflate );
+	free( writer->compressBuffer );
+	Stef_Cond_Destroy( writer->workCond );
+	Stef_Cond_Destroy( writer->spaceCond );
+	Stef_Mutex_Destroy( writer->mutex );
+	free( writer );
+}
+
+/* ******************************************************************************** */
+// Whole File Reader
+/* ******************************************************************************** */
+
+/*
+==================
+Record_File_Decompress
+
+If stream contains a compressed record file, replaces stream data with the decompressed
+contents. Uncompressed streams are left unchanged.
+Returns qfalse on error, in which case the original stream data is left in place.
+==================
+*/
+qboolean Record_File_Decompress( record_data_stream_t *stream ) {
+	const byte *data = (const byte *)stream->data;
+	unsigned int totalSize = 0;
+	unsigned int position;
+	char *output;
+	unsigned int outputPosition = 0;
+
+	if ( stream->size < 4 || Record_File_GetInt( data ) != RECORD_FILE_MAGIC ) {
+		return qtrue;
+	}
+
+	// validate block headers and determine output size
+	position = 4;
+	while ( position < stream->size ) {
+		unsigned int uncompressedSize, compressedSize;
+		if ( stream->size - position < 8 ) {
+			Record_Printf( RP_ALL, "Record_File_Decompress: truncated block header\n" );
+			return qfalse;
+		}
+		uncompressedSize = Record_File_GetInt( data + position );
+		compressedSize = Record_File_GetInt( data + position + 4 );
+		position += 8;
+		if ( !uncompressedSize || uncompressedSize > RECORD_FILE_BLOCK_SIZE || compressedSize > uncompressedSize ||
+				compressedSize > stream->size - position ) {
+			Record_Printf( RP_ALL, "Record_File_Decompress: invalid block header\n" );
+			return qfalse;
+		}
+		if ( totalSize + uncompressedSize < totalSize ) {
+			Record_Printf( RP_ALL, "Record_File_Decompress: file too large\n" );
+			return qfalse;
+		}
+		totalSize += uncompressedSize;
+		position += compressedSize;
+	}
+
+	if ( !totalSize ) {
+		Record_Printf( RP_ALL, "Record_File_Decompress: empty file\n" );
+		return qfalse;
+	}
+	output = (char *)Record_Calloc( totalSize );
+
+	position = 4;
+	while ( position < stream->size ) {
+		unsigned int uncompressedSize = Record_File_GetInt( data + position );
+		unsigned int compressedSize = Record_File_GetInt( data + position + 4 );
+		position += 8;
+
+		if ( compressedSize == uncompressedSize ) {
+			Com_Memcpy( output + outputPosition, data + position, uncompressedSize );
+		} else if ( !Record_File_InflateBlock( (const char *)data + position, compressedSize,
+				output + outputPosition, uncompressedSize ) ) {
+			Record_Printf( RP_ALL, "Record_File_Decompress: corrupt block\n" );
+			Record_Free( output );
+			return qfalse;
+		}
+
+		outputPosition += uncompressedSize;
+		position += compressedSize;
+	}
+
+	Record_Free( stream->data );
+	stream->data = output;
+	stream->size = totalSize;
+	stream->position = 0;
+	return qtrue;
+}
+
+#endif
+
+#ifdef STEF_RECORD_STREAMING_READER
+#define RECORD_FILE_WINDOW_SIZE ( 1024 * 1024 )
+
+typedef struct {
+	unsigned int fileOffset;		// offset of block data in file
+	unsigned int streamOffset;		// offset of block start in decompressed stream
+	unsigned int uncompressedSize;
+	unsigned int compressedSize;
+} record_file_block_info_t;
+
+struct record_file_reader_s {
+	fileHandle_t fp;
+	unsigned int fileSize;
+	unsigned int streamSize;
+
+	// Block table for compressed files
+	qboolean compressed;
+	record_file_block_info_t *blocks;
+	int blockCount;
+	int nextBlock;
+	char *compressedBuffer;
+
+	// Window of stream data currently in memory
+	char *window;
+	unsigned int windowSize;
+	unsigned int windowOffset;
+};
+
+/* ******************************************************************************** */
+// Streaming Reader
+/* ******************************************************************************** */
+
+/*
+==================
+Record_File_ReadFile
+
+Reads data from given file offset. Returns qtrue on success.
+==================
+*/
+static qboolean Record_File_ReadFile( record_file_reader_t *reader, unsigned int offset, void *output,
+		unsigned int size ) {
+	if ( offset > reader->fileSize || size > reader->fileSize - offset ) {
+		return qfalse;
+	}
+	FS_Seek( reader->fp, (long)offset, FS_SEEK_SET );
+	return FS_Read( output, (int)size, reader->fp ) == (int)size ? qtrue : qfalse;
+}
+
+/*
+==================
+Record_File_ReadBlock
+
+Reads decompressed block into output, which must have room for uncompressedSize bytes.
+==================
+*/
+static qboolean Record_File_ReadBlock( record_file_reader_t *reader, int blockNum, char *output ) {
+	const record_file_block_info_t *block = &reader->blocks[blockNum];
+
+	if ( block->compressedSize == block->uncompressedSize ) {
+		return Record_File_ReadFile( reader, block->fileOffset, output, block->uncompressedSize );
+	}
+	if ( !Record_File_ReadFile( reader, block->fileOffset, reader->compressedBuffer, block->compressedSize ) ) {
+		return qfalse;
+	}
+	return Record_File_InflateBlock( reader->compressedBuffer, block->compressedSize, output, block->uncompressedSize );
+}
+
+/*
+==================
+Record_File_LoadBlockTable
+
+Reads block headers for compressed file. Returns qfalse if file is invalid.
+==================
+*/
+static qboolean Record_File_LoadBlockTable( record_file_reader_t *reader ) {
+	unsigned int position = 4;
+	int blockTableSize = 0;
+
+	while ( position < reader->fileSize ) {
+		record_file_block_info_t *block;
+		byte header[8];
+
+		if ( !Record_File_ReadFile( reader, position, header, sizeof( header ) ) ) {
+			Record_Printf( RP_ALL, "Record_File_LoadBlockTable: truncated block header\n" );
+			return qfalse;
+		}
+
+		if ( reader->blockCount >= blockTableSize ) {
+			record_file_block_info_t *oldBlocks = reader->blocks;
+			blockTableSize = blockTableSize ? blockTableSize * 2 : 1024;
+			reader->blocks = (record_file_block_info_t *)Record_Calloc( sizeof( *reader->blocks ) * blockTableSize );
+			if ( oldBlocks ) {
+				Com_Memcpy( reader->blocks, oldBlocks, sizeof( *reader->blocks ) * reader->blockCount );
+				Record_Free( oldBlocks );
+			}
+		}
+
+		block = &reader->blocks[reader->blockCount];
+		block->fileOffset = position + 8;
+		block->streamOffset = reader->streamSize;
+		block->uncompressedSize = Record_File_GetInt( header );
+		block->compressedSize = Record_File_GetInt( header + 4 );
+		if ( !block->uncompressedSize || block->uncompressedSize > RECORD_FILE_BLOCK_SIZE ||
+				block->compressedSize > block->uncompressedSize ||
+				block->compressedSize > reader->fileSize - block->fileOffset ||
+				reader->streamSize + block->uncompressedSize < reader->streamSize ) {
+			Record_Printf( RP_ALL, "Record_File_LoadBlockTable: invalid block header\n" );
+			return qfalse;
+		}
+
+		reader->streamSize += block->uncompressedSize;
+		position = block->fileOffset + block->compressedSize;
+		++reader->blockCount;
+	}
+
+	return qtrue;
+}
+
+/*
+==================
+Record_File_OpenReader
+
+Path is relative to homepath/basepath as with FS_SV_FOpenFileRead. Returns NULL on error.
+==================
+*/
+record_file_reader_t *Record_File_OpenReader( const char *path ) {
+	record_file_reader_t *reader;
+	fileHandle_t fp = 0;
+	long size = FS_SV_FOpenFileRead( path, &fp );
+	byte magic[4];
+
+	if ( !fp ) {
+		return NULL;
+	}
+
+	reader = (record_file_reader_t *)Record_Calloc( sizeof( *reader ) );
+	reader->fp = fp;
+	reader->fileSize = size > 0 ? (unsigned int)size : 0;
+	reader->streamSize = reader->fileSize;
+
+	if ( Record_File_ReadFile( reader, 0, magic, sizeof( magic ) ) && Record_File_GetInt( magic ) == RECORD_FILE_MAGIC ) {
+		reader->compressed = qtrue;
+		reader->streamSize = 0;
+		reader->compressedBuffer = (char *)Record_Calloc( RECORD_FILE_BLOCK_SIZE );
+		if ( !Record_File_LoadBlockTable( reader ) ) {
+			Record_File_CloseReader( reader );
+			return NULL;
+		}
+	}
+
+	reader->windowSize = RECORD_FILE_WINDOW_SIZE;
+	reader->window = (char *)Record_Calloc( reader->windowSize );
+	return reader;
+}
+
+/*
+==================
+Record_File_CloseReader
+==================
+*/
+void Record_File_CloseReader( record_file_reader_t *reader ) {
+	FS_FCloseFile( reader->fp );
+	if ( reader->blocks ) {
+		Record_Free( reader->blocks );
+	}
+	if ( reader->compressedBuffer ) {
+		Record_Free( reader->compressedBuffer );
+	}
+	if ( reader->window ) {
+		Record_Free( reader->window );
+	}
+	Record_Free( reader );
+}
+
+/*
+==================
+Record_File_GetSize
+
+Returns size of decompressed stream.
+==================
+*/
+unsigned int Record_File_GetSize( record_file_reader_t *reader ) {
+	return reader->streamSize;
+}
+
+/*
+==================
+Record_File_FindBlock
+
+Returns index of block containing stream offset.
+==================
+*/
+static int Record_File_FindBlock( record_file_reader_t *reader, unsigned int offset ) {
+	int low = 0;
+	int high = reader->blockCount - 1;
+	while ( low < high ) {
+		int mid = ( low + high + 1 ) / 2;
+		if ( reader->blocks[mid].streamOffset <= offset ) {
+			low = mid;
+		} else {
+			high = mid - 1;
+		}
+	}
+	return low;
+}
+
+/*
+==================
+Record_File_ReadRange
+
+Reads data from decompressed stream offset, independent of any attached stream window.
+Returns qtrue on success.
+==================
+*/
+qboolean Record_File_ReadRange( record_file_reader_t *reader, unsigned int offset, void *output, unsigned int size ) {
+	char *blockBuffer;
+	int blockNum;
+
+	if ( offset > reader->streamSize || size > reader->streamSize - offset ) {
+		return qfalse;
+	}
+	if ( !reader->compressed ) {
+		return Record_File_ReadFile( reader, offset, output, size );
+	}
+
+	blockBuffer = (char *)Record_Calloc( RECORD_FILE_BLOCK_SIZE );
+	blockNum = Record_File_FindBlock( reader, offset );
+	while ( size ) {
+		const record_file_block_info_t *block = &reader->blocks[blockNum];
+		unsigned int blockPosition = offset - block->streamOffset;
+		unsigned int chunk = block->uncompressedSize - blockPosition;
+		if ( chunk > size ) {
+			chunk = size;
+		}
+		if ( !Record_File_ReadBlock( reader, blockNum, blockBuffer ) ) {
+			Record_Free( blockBuffer );
+			return qfalse;
+		}
+		Com_Memcpy( output, blockBuffer + blockPosition, chunk );
+		output = (char *)output + chunk;
+		offset += chunk;
+		size -= chunk;
+		++blockNum;
+	}
+
+	Record_Free( blockBuffer );
+	return qtrue;
+}
+
+/*
+==================
+Record_File_Refill
+
+Stream refill callback. Discards data before the current position, then loads data
+following the window until the requested amount is available.
+==================
+*/
+static qboolean Record_File_Refill( record_data_stream_t *stream, unsigned int needed ) {
+	record_file_reader_t *reader = (record_file_reader_t *)stream->refillContext;
+	unsigned int remaining = stream->size - stream->position;
+
+	if ( remaining ) {
+		memmove( reader->window, reader->window + stream->position, remaining );
+	}
+	reader->windowOffset += stream->position;
+	stream->position = 0;
+	stream->size = remaining;
+
+	// window only grows beyond the default size for unusually large reads, such as keyframes
+	if ( needed + RECORD_FILE_BLOCK_SIZE > reader->windowSize ) {
+		char *newWindow = (char *)Record_Calloc( needed + RECORD_FILE_BLOCK_SIZE );
+		Com_Memcpy( newWindow, reader->window, stream->size );
+		Record_Free( reader->window );
+		reader->window = newWindow;
+		reader->windowSize = needed + RECORD_FILE_BLOCK_SIZE;
+	}
+	stream->data = reader->window;
+
+	while ( stream->size < needed ) {
+		if ( reader->compressed ) {
+			const record_file_block_info_t *block;
+			if ( reader->nextBlock >= reader->blockCount ) {
+				return qfalse;
+			}
+			block = &reader->blocks[reader->nextBlock];
+			if ( !Record_File_ReadBlock( reader, reader->nextBlock, reader->window + stream->size ) ) {
+				Record_Printf( RP_ALL, "Record_File_Refill: failed to read block %i\n", reader->nextBlock );
+				return qfalse;
+			}
+			stream->size += block->uncompressedSize;
+			++reader->nextBlock;
+		} else {
+			unsigned int fileOffset = reader->windowOffset + stream->size;
+			unsigned int amount = reader->windowSize - stream->size;
+			if ( fileOffset >= reader->fileSize ) {
+				return qfalse;
+			}
+			if ( amount > reader->fileSize - fileOffset ) {
+				amount = reader->fileSize - fileOffset;
+			}
+			if ( !Record_File_ReadFile( reader, fileOffset, reader->window + stream->size, amount ) ) {
+				Record_Printf( RP_ALL, "Record_File_Refill: read error\n" );
+				return qfalse;
+			}
+			stream->size += amount;
+		}
+	}
+
+	return qtrue;
+}
+
+/*
+==================
+Record_File_AttachStream
+
+Sets up stream to read from the start of the file through the reader window.
+==================
+*/
+void Record_File_AttachStream( record_file_reader_t *reader, record_data_stream_t *stream ) {
+	stream->data = reader->window;
+	stream->position = 0;
+	stream->size = 0;
+	stream->refill = Record_File_Refill;
+	stream->refillContext = reader;
+	reader->windowOffset = 0;
+	reader->nextBlock = 0;
+}
+
+/*
+==================
+Record_File_SeekStream
+
+Moves attached stream to decompressed stream offset. Returns qfalse if offset is invalid.
+==================
+*/
+qboolean Record_File_SeekStream( record_data_stream_t *stream, unsigned int offset ) {
+	record_file_reader_t *reader = (record_file_reader_t *)stream->refillContext;
+	unsigned int skip = 0;
+
+	if ( offset > reader->streamSize ) {
+		return qfalse;
+	}
+
+	stream->position = 0;
+	stream->size = 0;
+	if ( reader->compressed && reader->blockCount ) {
+		int blockNum = Record_File_FindBlock( reader, offset );
+		reader->nextBlock = blockNum;
+		reader->windowOffset = reader->blocks[blockNum].streamOffset;
+		skip = offset - reader->windowOffset;
+	} else {
+		reader->windowOffset = offset;
+	}
+
+	if ( skip ) {
+		if ( !Record_File_Refill( stream, skip ) ) {
+			return qfalse;
+		}
+		stream->position = skip;
+	}
+	return qtrue;
+}
+#endif
+
+#endif
@@ -29,18 +29,52 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 /* ******************************************************************************** */
 
 #ifdef ELITEFORCE
-#define RECORD_PROTOCOL 6
+#ifdef STEF_RECORD_FIELD_ENCODING
+#define RECORD_PROTOCOL 8
+#define RECORD_PROTOCOL_WORD_ENCODING 7	// structures encoded as fixed size xor chunks
 #else
-#define RECORD_PROTOCOL "quake3-v1"
+#define RECORD_PROTOCOL 7
+#endif
+#define RECORD_PROTOCOL_LEGACY 6	// no keyframes or seek index
+#else
+#ifdef STEF_RECORD_FIELD_ENCODING
+#define RECORD_PROTOCOL "quake3-v3"
+#define RECORD_PROTOCOL_WORD_ENCODING "quake3-v2"	// structures encoded as fixed size xor chunks
+#else
+#define RECORD_PROTOCOL "quake3-v2"
+#endif
+#define RECORD_PROTOCOL_LEGACY "quake3-v1"	// no keyframes or seek index
 #endif
 
+#define RECORD_SEEK_INDEX_MAGIC 0x58495352	// "RSIX"
+
 #define RECORD_MAX_CLIENTS 256
 
+#define RECORD_KEYFRAME_BUFFER_SIZE ( 2 * 1024 * 1024 )
+
 typedef struct {
+	unsigned int offset;
+	int time;
+} record_seek_entry_t;
+
+typedef struct record_data_stream_s {
 	char *data;
 	unsigned int position;
 	unsigned int size;
 
+#ifdef STEF_RECORD_STREAMING_READER
+	// Optional callback for streams that only hold a window of the source data. Called when
+	// reading past size to make at least 'needed' bytes available from current position,
+	// which may move data. Returns qfalse if the data is not available.
+	qboolean ( *refill )( struct record_data_stream_s *stream, unsigned int needed );
+	void *refillContext;
+#endif
+
+#ifdef STEF_RECORD_FIELD_ENCODING
+	// Structures use field-aware varint encoding (protocol 8+)
+	qboolean fieldEncoding;
+#endif
+
 	// Overflow abort
 	qboolean abortSet;
 	jmp_buf abort;
@@ -116,8 +150,19 @@ typedef enum {
 	RC_EVENT_CLIENT_ENTER_WORLD,
 	RC_EVENT_CLIENT_DISCONNECT,
 	RC_EVENT_MAP_RESTART,
+
+	// Seeking (protocol 7+)
+	RC_STATE_KEYFRAME,
+	RC_SEEK_INDEX,
 } record_command_t;
 
+typedef struct {
+	// Record state that isn't part of record_state_t, needed to start reading at a keyframe
+	record_entityset_t baselines;
+	char activeClients[RECORD_MAX_CLIENTS];
+	int instanceCounts[RECORD_MAX_CLIENTS];
+} record_keyframe_t;
+
 /* ******************************************************************************** */
 // Main
 /* ******************************************************************************** */
@@ -129,6 +174,7 @@ extern cvar_t *sv_recordAutoRecording;
 extern cvar_t *sv_recordFilenameIncludeMap;
 extern cvar_t *sv_recordFullBotData;
 extern cvar_t *sv_recordFullUsercmdData;
+extern cvar_t *sv_recordKeyframeInterval;
 
 #ifdef ELITEFORCE
 extern cvar_t *sv_recordConvertLegacyProtocol;
@@ -139,6 +185,24 @@ extern cvar_t *sv_recordConvertSimulateFollow;
 extern cvar_t *sv_recordVerifyData;
 extern cvar_t *sv_recordDebug;
 
+#ifdef STEF_RECORD_ASYNC_WRITER
+extern cvar_t *sv_recordCompress;
+#endif
+
+#if defined( STEF_RECORD_CONVERT_ALL ) && defined( STEF_THREADS )
+extern cvar_t *sv_recordConvertThreads;
+#endif
+
+#ifdef STEF_RECORD_CATALOG
+extern cvar_t *sv_recordCatalogKeys;
+#endif
+
+#ifdef STEF_RECORD_RELAY
+extern cvar_t *sv_recordRelayOutput;
+extern cvar_t *sv_recordRelaySource;
+extern cvar_t *sv_recordRelayDelay;
+#endif
+
 /* ******************************************************************************** */
 // Writer
 /* ******************************************************************************** */
@@ -151,12 +215,58 @@ void Record_StopWriter( void );
 void Record_StartCmd( void );
 void Record_StopCmd( void );
 
+/* ******************************************************************************** */
+// File
+/* ******************************************************************************** */
+
+#ifdef STEF_RECORD_ASYNC_WRITER
+typedef struct record_file_writer_s record_file_writer_t;
+
+record_file_writer_t *Record_File_OpenWriter( const char *path, qboolean compress );
+void Record_File_Write( record_file_writer_t *writer, const char *data, unsigned int size );
+void Record_File_CloseWriter( record_file_writer_t *writer );
+qboolean Record_File_Decompress( record_data_stream_t *stream );
+#endif
+
+#ifdef STEF_RECORD_STREAMING_READER
+typedef struct record_file_reader_s record_file_reader_t;
+
+record_file_reader_t *Record_File_OpenReader( const char *path );
+void Record_File_CloseReader( record_file_reader_t *reader );
+unsigned int Record_File_GetSize( record_file_reader_t *reader );
+qboolean Record_File_ReadRange( record_file_reader_t *reader, unsigned int offset, void *output, unsigned int size );
+void Record_File_AttachStream( record_file_reader_t *reader, record_data_stream_t *stream );
+qboolean Record_File_SeekStream( record_data_stream_t *stream, unsigned int offset );
+#endif
+
 /* ******************************************************************************** */
 // Convert
 /* ******************************************************************************** */
 
 void Record_Convert_Cmd( void );
+#ifdef STEF_RECORD_CONVERT_ALL
+void Record_ConvertAll_Cmd( void );
+#endif
 void Record_Scan_Cmd( void );
+#ifdef STEF_RECORD_FIELD_ENCODING
+void Record_Upgrade_Cmd( void );
+void Record_Benchmark_Cmd( void );
+#endif
+
+/* ******************************************************************************** */
+// Catalog
+/* ******************************************************************************** */
+
+#ifdef STEF_RECORD_CATALOG
+typedef struct record_metadata_s record_metadata_t;
+
+record_metadata_t *Record_Metadata_Create( void );
+void Record_Metadata_Free( record_metadata_t *metadata );
+void Record_Metadata_AddPlayer( record_metadata_t *metadata, int clientNum );
+void Record_Metadata_EndPlayer( record_metadata_t *metadata, int clientNum, playerState_t *ps );
+void Record_Metadata_Write( record_metadata_t *metadata, const char *path, int duration );
+void Record_Catalog_Cmd( void );
+#endif
 
 /* ******************************************************************************** */
 // Spectator
@@ -171,6 +281,35 @@ void Record_Spectator_ProcessMapLoaded( void );
 void Record_Spectator_ProcessConfigstring( int index, const char *value );
 void Record_Spectator_ProcessServercmd( int clientNum, const char *value );
 void Record_Spectator_ProcessUsercmd( int clientNum, usercmd_t *usercmd );
+#ifdef STEF_RECORD_RELAY
+void Record_Spectator_DropAll( const char *message );
+#endif
+
+/* ******************************************************************************** */
+// Relay
+/* ******************************************************************************** */
+
+#ifdef STEF_RECORD_RELAY
+typedef struct {
+	// Record stream state received by a relay process, used in place of the local
+	// server state to serve admin spectators
+	record_state_t *rs;
+	record_keyframe_t keyframe;
+	int time;
+	int serverId;
+	int snapFlagServerBit;
+} record_relay_state_t;
+
+extern record_relay_state_t *recordRelay;	// only set while serving spectators as a relay
+
+qboolean Record_Relay_Active( void );
+qboolean Record_Relay_Frame( int msec );
+void Record_Relay_Stop( void );
+void Record_Relay_PrintStatus( void );
+void Record_RelayOutput_Restart( void );
+void Record_RelayOutput_Write( const char *data, unsigned int size );
+void Record_RelayOutput_EndBlock( int time, record_state_t *rs, record_keyframe_t *keyframe );
+#endif
 
 /* ******************************************************************************** */
 // Common
@@ -183,6 +322,7 @@ char *Record_Stream_Allocate( int size, record_data_stream_t *stream );
 void Record_Stream_Write( void *data, int size, record_data_stream_t *stream );
 void Record_Stream_WriteValue( int value, int size, record_data_stream_t *stream );
 char *Record_Stream_ReadStatic( int size, record_data_stream_t *stream );
+qboolean Record_Stream_AtEnd( record_data_stream_t *stream );
 void Record_Stream_ReadBuffer( void *output, int size, record_data_stream_t *stream );
 void Record_Stream_DumpToFile( record_data_stream_t *stream, fileHandle_t file );
 
@@ -202,6 +342,8 @@ int Record_Bit_Get( int *source, int position );
 qboolean Record_UsercmdIsFiringWeapon( const usercmd_t *cmd );
 qboolean Record_PlayerstateIsSpectator( const playerState_t *ps );
 void Record_SetPlayerstateFollowFlag( playerState_t *ps );
+int Record_PlayerstateScore( const playerState_t *ps );
+int Record_TeamScoreConfigstring( int team );
 
 // ***** Message Printing *****
 
@@ -233,6 +375,15 @@ void Record_EncodeUsercmd( usercmd_t *state, usercmd_t *source, record_data_stre
 void Record_DecodeUsercmd( usercmd_t *state, record_data_stream_t *stream );
 #endif
 
+// ***** Stream Header *****
+
+void Record_EncodeStreamHeader( int maxClients, record_data_stream_t *stream );
+
+// ***** Keyframes *****
+
+void Record_EncodeKeyframe( record_state_t *rs, record_keyframe_t *keyframe, record_data_stream_t *stream );
+void Record_DecodeKeyframe( record_state_t *rs, record_keyframe_t *keyframe, record_data_stream_t *stream );
+
 #ifdef ELITEFORCE
 // ***** Usercmd Conversion *****
 
@@ -245,6 +396,37 @@ void Record_UnpackUsercmd( record_usercmd_t *source, usercmd_t *target );
 void Record_GetCurrentEntities( record_entityset_t *target );
 void Record_GetCurrentBaselines( record_entityset_t *target );
 
+#ifdef STEF_RECORD_ENTITY_TRACKER
+// ***** Entity Tracker *****
+
+typedef struct {
+	// Entity states as of the last update, which is 'frame'
+	int frame;
+	record_entityset_t entities;
+
+	// Entities that changed in the last update, in ascending order
+	int changeCount;
+	int changes[MAX_GENTITIES];
+
+	// Last update that changed each entity, including becoming active or inactive
+	int changedFrame[MAX_GENTITIES];
+
+	// Entities linked or unlinked since the last update
+	int touched[(MAX_GENTITIES+31)/32];
+	qboolean updated;
+} record_entity_tracker_t;
+
+extern record_entity_tracker_t *recordEntityTracker;
+
+void Record_EntityTracker_MarkEntity( int entityNum );
+void Record_EntityTracker_BeginFrame( void );
+void Record_EntityTracker_EndFrame( void );
+record_entity_tracker_t *Record_EntityTracker_Get( void );
+void Record_EncodeEntityChanges( record_entityset_t *state, record_entity_tracker_t *tracker,
+		record_data_stream_t *stream );
+void Record_CopyEntityChanges( record_entityset_t *target, int targetFrame, record_entity_tracker_t *tracker );
+#endif
+
 // ***** Visibility Building *****
 
 void Record_GetCurrentVisibility( int clientNum, record_visibility_state_t *target );
@@ -259,3 +441,7 @@ void Record_WriteSnapshotMessage( record_entityset_t *entities, record_visibilit
 		record_entityset_t *deltaEntities, record_visibility_state_t *deltaVisibility, playerState_t *deltaPs,
 		record_entityset_t *baselines, int baselineCutoff, int lastClientCommand, int deltaFrame, int snapFlags,
 		int svTime, msg_t *msg );
+void Record_WriteSnapshotHeader( int lastClientCommand, int deltaFrame, int snapFlags, int svTime, msg_t *msg );
+void Record_WriteSnapshotContent( record_entityset_t *entities, record_visibility_state_t *visibility, playerState_t *ps,
+		record_entityset_t *deltaEntities, record_visibility_state_t *deltaVisibility, playerState_t *deltaPs,
+		record_entityset_t *baselines, int baselineCutoff, msg_t *msg );
@@ -33,16 +33,32 @@ cvar_t *sv_recordAutoRecording;
 cvar_t *sv_recordFilenameIncludeMap;
 cvar_t *sv_recordFullBotData;
 cvar_t *sv_recordFullUsercmdData;
+cvar_t *sv_recordKeyframeInterval;
 
 #ifdef ELITEFORCE
 cvar_t *sv_recordConvertLegacyProtocol;
 #endif
 cvar_t *sv_recordConvertWeptiming;
 cvar_t *sv_recordConvertSimulateFollow;
+#if defined( STEF_RECORD_CONVERT_ALL ) && defined( STEF_THREADS )
+cvar_t *sv_recordConvertThreads;
+#endif
+#ifdef STEF_RECORD_CATALOG
+cvar_t *sv_recordCatalogKeys;
+#endif
+#ifdef STEF_RECORD_RELAY
+cvar_t *sv_recordRelayOutput;
+cvar_t *sv_recordRelaySource;
+cvar_t *sv_recordRelayDelay;
+#endif
 
 cvar_t *sv_recordDebug;
 cvar_t *sv_recordVerifyData;
 
+#ifdef STEF_RECORD_ASYNC_WRITER
+cvar_t *sv_recordCompress;
+#endif
+
 /* ******************************************************************************** */
 // Server Calls
 /* ******************************************************************************** */
@@ -95,6 +111,10 @@ void Record_ProcessMapLoaded( void ) {
 	if ( !recordInitialized ) {
 		return;
 	}
+#ifdef STEF_RECORD_RELAY
+	// Local game replaces relay state for spectators
+	Record_Relay_Stop();
+#endif
 	Record_Spectator_ProcessMapLoaded();
 }
 
@@ -107,10 +127,29 @@ void Record_ProcessSnapshot( void ) {
 	if ( !recordInitialized ) {
 		return;
 	}
+#ifdef STEF_RECORD_ENTITY_TRACKER
+	Record_EntityTracker_BeginFrame();
+#endif
 	Record_Spectator_ProcessSnapshot();
 	Record_Writer_ProcessSnapshot();
+#ifdef STEF_RECORD_ENTITY_TRACKER
+	Record_EntityTracker_EndFrame();
+#endif
 }
 
+#ifdef STEF_RECORD_ENTITY_TRACKER
+/*
+==================
+Record_ProcessEntityLink
+
+Called when an entity is linked or unlinked.
+==================
+*/
+void Record_ProcessEntityLink( int entityNum ) {
+	Record_EntityTracker_MarkEntity( entityNum );
+}
+#endif
+
 /*
 ==================
 Record_ProcessGameShutdown
@@ -152,6 +191,36 @@ qboolean Record_ProcessPacketEvent( const netadr_t *address, msg_t *msg, int qpo
 	return Record_Spectator_ProcessPacketEvent( address, msg, qport );
 }
 
+#ifdef STEF_RECORD_RELAY
+/*
+==================
+Record_RelayModeActive
+
+Returns qtrue if spectator connections and packets should be handled while no map is running.
+==================
+*/
+qboolean Record_RelayModeActive( void ) {
+	if ( !recordInitialized ) {
+		return qfalse;
+	}
+	return Record_Relay_Active();
+}
+
+/*
+==================
+Record_ProcessRelayFrame
+
+Called each server frame while no map is running. Returns qtrue if running as a relay.
+==================
+*/
+qboolean Record_ProcessRelayFrame( int msec ) {
+	if ( !recordInitialized ) {
+		return qfalse;
+	}
+	return Record_Relay_Frame( msec );
+}
+#endif
+
 /* ******************************************************************************** */
 // Initialization
 /* ******************************************************************************** */
@@ -179,6 +248,15 @@ void Record_Initialize( void ) {
 	sv_recordFullUsercmdData = Cvar_Get( "sv_recordFullUsercmdData", "0", 0 );
 	Cvar_SetDescription( sv_recordFullUsercmdData, "Write all usercmds to record file. Normally has no effect"
 			" except increasing record file size, but may be useful to advanced users." );
+	sv_recordKeyframeInterval = Cvar_Get( "sv_recordKeyframeInterval", "30", 0 );
+	Cvar_CheckRange( sv_recordKeyframeInterval, "0", "3600", CV_INTEGER );
+	Cvar_SetDescription( sv_recordKeyframeInterval, "Seconds between keyframes in server-side record files,"
+			" which allow record_convert to start at a given time without decoding the whole file. 0 = disabled." );
+#ifdef STEF_RECORD_ASYNC_WRITER
+	sv_recordCompress = Cvar_Get( "sv_recordCompress", "1", 0 );
+	Cvar_SetDescription( sv_recordCompress, "Compress server-side record files. Takes effect when the next"
+			" recording is started." );
+#endif
 
 #ifdef ELITEFORCE
 	sv_recordConvertLegacyProtocol = Cvar_Get( "sv_recordConvertLegacyProtocol", "1", 0 );
@@ -189,6 +267,31 @@ void Record_Initialize( void ) {
 	sv_recordConvertSimulateFollow = Cvar_Get( "sv_recordConvertSimulateFollow", "1", 0 );
 	Cvar_SetDescription( sv_recordConvertSimulateFollow, "Add follow spectator flag to converted demo file"
 			" to display 'following' message and player name on screen during replay." );
+#ifdef STEF_RECORD_CATALOG
+	sv_recordCatalogKeys = Cvar_Get( "sv_recordCatalogKeys", "cl_guid", 0 );
+	Cvar_SetDescription( sv_recordCatalogKeys, "Space separated list of userinfo keys to save for each player"
+			" in server-side record metadata files, which can be searched with record_catalog." );
+#endif
+#ifdef STEF_RECORD_RELAY
+	sv_recordRelayOutput = Cvar_Get( "sv_recordRelayOutput", "", 0 );
+	Cvar_SetDescription( sv_recordRelayOutput, "Path of a UNIX socket to publish the live record stream on,"
+			" for relay processes serving admin spectators. Only sent while recording is active, and includes"
+			" bot perspectives only with sv_recordFullBotData enabled." );
+	sv_recordRelaySource = Cvar_Get( "sv_recordRelaySource", "", 0 );
+	Cvar_SetDescription( sv_recordRelaySource, "Path of a UNIX socket to receive a record stream from. When set"
+			" on a dedicated server with no map running, it serves admin spectators from the received stream"
+			" and forwards it to sv_recordRelayOutput." );
+	sv_recordRelayDelay = Cvar_Get( "sv_recordRelayDelay", "0", 0 );
+	Cvar_CheckRange( sv_recordRelayDelay, "0", "3600", CV_INTEGER );
+	Cvar_SetDescription( sv_recordRelayDelay, "Seconds to delay the relay source stream before showing it to"
+			" spectators and forwarding it." );
+#endif
+#if defined( STEF_RECORD_CONVERT_ALL ) && defined( STEF_THREADS )
+	sv_recordConvertThreads = Cvar_Get( "sv_recordConvertThreads", "0", 0 );
+	Cvar_CheckRange( sv_recordConvertThreads, "0", "17", CV_INTEGER );
+	Cvar_SetDescription( sv_recordConvertThreads, "Number of threads used to encode demos in record_convert_all."
+			" 0 or 1 = single threaded." );
+#endif
 
 	sv_recordVerifyData = Cvar_Get( "sv_recordVerifyData", "0", 0 );
 	Cvar_SetDescription( sv_recordVerifyData, "Enables extra debug checks during server-side recording." );
@@ -198,8 +301,21 @@ void Record_Initialize( void ) {
 	Cmd_AddCommand( "record_start", Record_StartCmd );
 	Cmd_AddCommand( "record_stop", Record_StopCmd );
 	Cmd_AddCommand( "record_convert", Record_Convert_Cmd );
+#ifdef STEF_RECORD_CONVERT_ALL
+	Cmd_AddCommand( "record_convert_all", Record_ConvertAll_Cmd );
+#endif
 	Cmd_AddCommand( "record_scan", Record_Scan_Cmd );
+#ifdef STEF_RECORD_FIELD_ENCODING
+	Cmd_AddCommand( "record_upgrade", Record_Upgrade_Cmd );
+	Cmd_AddCommand( "record_benchmark", Record_Benchmark_Cmd );
+#endif
+#ifdef STEF_RECORD_CATALOG
+	Cmd_AddCommand( "record_catalog", Record_Catalog_Cmd );
+#endif
 	Cmd_AddCommand( "spect_status", Record_Spectator_PrintStatus );
+#ifdef STEF_RECORD_RELAY
+	Cmd_AddCommand( "relay_status", Record_Relay_PrintStatus );
+#endif
 
 	recordInitialized = qtrue;
 }
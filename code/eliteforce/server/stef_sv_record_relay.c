@@ -0,0 +1,1040 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+Copyright (C) 2017-2023 Noah Metzger (chomenor@gmail.com)
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+
+#ifdef STEF_RECORD_RELAY
+#include "stef_sv_record_local.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/* ******************************************************************************** */
+// Definitions
+/* ******************************************************************************** */
+
+// The relay output publishes the live record stream on a UNIX socket, and a dedicated
+// server with sv_recordRelaySource set and no map running reads it to serve admin spectators
+// in place of the game server. The stream is sent as blocks, normally one per snapshot,
+// each with a header containing the payload size, server time, and flags. A start block
+// holds the stream header and a keyframe with the full record state, and is sent first on
+// each connection and whenever the writer restarts, so a relay can join at any point.
+// Relays forward the blocks they process to their own relay output, so they can be chained.
+
+#define RELAY_BLOCK_HEADER_SIZE 12
+#define RELAY_BLOCK_START 1
+
+#define RELAY_MAX_CONNECTIONS 16
+#define RELAY_MAX_SEND_QUEUE ( 16 * 1024 * 1024 )
+#define RELAY_MAX_BLOCK_SIZE ( 16 * 1024 * 1024 )
+#define RELAY_MAX_DELAY_QUEUE ( 512 * 1024 * 1024 )
+#define RELAY_RECONNECT_INTERVAL 2000
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+typedef struct {
+	int socket;
+	qboolean started;	// start block sent, so regular blocks can follow
+	char *queue;
+	unsigned int queueSize;
+	unsigned int queueUsed;
+} record_relay_connection_t;
+
+typedef struct {
+	char path[MAX_OSPATH];
+	int listenSocket;
+	record_relay_connection_t connections[RELAY_MAX_CONNECTIONS];
+
+	// Stream data for the current block, only collected while a connection is started
+	char *block;
+	unsigned int blockSize;
+	unsigned int blockUsed;
+} record_relay_output_t;
+
+typedef struct record_relay_block_s {
+	struct record_relay_block_s *next;
+	int releaseTime;	// Sys_Milliseconds time the block is due to be processed
+	int time;
+	int flags;
+	unsigned int size;
+	char *data;
+} record_relay_block_t;
+
+typedef struct {
+	qboolean connected;
+	int socket;
+	int lastConnectTime;
+	int modificationCount;
+
+	// Block currently being received
+	int header[RELAY_BLOCK_HEADER_SIZE / 4];
+	unsigned int headerReceived;
+	record_relay_block_t *receiving;
+	unsigned int received;
+
+	// Received blocks waiting for the broadcast delay
+	record_relay_block_t *first;
+	record_relay_block_t *last;
+	int queuedBlocks;
+	unsigned int queuedBytes;
+
+	// Regular blocks are only applied following a successfully processed start block
+	qboolean haveStart;
+} record_relay_source_t;
+
+record_relay_state_t *recordRelay;
+
+static record_relay_output_t *relayOutput;
+static int relayOutputModificationCount = -1;
+
+static record_relay_source_t relaySource = { qfalse, -1, 0, -1 };
+
+/* ******************************************************************************** */
+// Common
+/* ******************************************************************************** */
+
+/*
+==================
+Record_Relay_AppendBuffer
+
+Appends data to a buffer which is reallocated as needed.
+==================
+*/
+static void Record_Relay_AppendBuffer( char **buffer, unsigned int *size, unsigned int *used,
+		const void *data, unsigned int length ) {
+	if ( *used + length > *size ) {
+		char *oldBuffer = *buffer;
+		unsigned int newSize = *size ? *size : 65536;
+		while ( newSize < *used + length ) {
+			newSize *= 2;
+		}
+		*buffer = (char *)Record_Calloc( newSize );
+		if ( oldBuffer ) {
+			Com_Memcpy( *buffer, oldBuffer, *used );
+			Record_Free( oldBuffer );
+		}
+		*size = newSize;
+	}
+	Com_Memcpy( *buffer + *used, data, length );
+	*used += length;
+}
+
+/*
+==================
+Record_Relay_SetAddress
+
+Returns qfalse if path is too long for a socket address.
+==================
+*/
+static qboolean Record_Relay_SetAddress( const char *path, struct sockaddr_un *address ) {
+	if ( strlen( path ) >= sizeof( address->sun_path ) ) {
+		Record_Printf( RP_ALL, "Relay socket path too long: %s\n", path );
+		return qfalse;
+	}
+	Com_Memset( address, 0, sizeof( *address ) );
+	address->sun_family = AF_UNIX;
+	Q_strncpyz( address->sun_path, path, sizeof( address->sun_path ) );
+	return qtrue;
+}
+
+/*
+==================
+Record_Relay_SetNonBlocking
+==================
+*/
+static void Record_Relay_SetNonBlocking( int sock ) {
+	fcntl( sock, F_SETFL, fcntl( sock, F_GETFL, 0 ) | O_NONBLOCK );
+#ifdef SO_NOSIGPIPE
+	{
+		int value = 1;
+		setsockopt( sock, SOL_SOCKET, SO_NOSIGPIPE, &value, sizeof( value ) );
+	}
+#endif
+}
+
+/*
+==================
+Record_Relay_EncodeStart
+
+Encodes the stream header and a keyframe with the current record state, which allows the
+receiver to start decoding the stream at this point. Returns qtrue on success, in which
+case stream data needs to be freed by caller.
+==================
+*/
+static qboolean Record_Relay_EncodeStart( int time, record_state_t *rs, record_keyframe_t *keyframe,
+		record_data_stream_t *stream ) {
+	unsigned int sizePosition;
+	int size;
+
+	Com_Memset( stream, 0, sizeof( *stream ) );
+	stream->data = (char *)Record_Calloc( RECORD_KEYFRAME_BUFFER_SIZE );
+	stream->size = RECORD_KEYFRAME_BUFFER_SIZE;
+#ifdef STEF_RECORD_FIELD_ENCODING
+	stream->fieldEncoding = qtrue;
+#endif
+	stream->abortSet = qtrue;
+	if ( setjmp( stream->abort ) ) {
+		Record_Printf( RP_ALL, "Record_Relay_EncodeStart: failed to encode keyframe\n" );
+		Record_Free( stream->data );
+		return qfalse;
+	}
+
+	Record_EncodeStreamHeader( rs->maxClients, stream );
+	Record_Stream_WriteValue( RC_STATE_KEYFRAME, 1, stream );
+	Record_Stream_WriteValue( time, 4, stream );
+	sizePosition = stream->position;
+	Record_Stream_WriteValue( 0, 4, stream );
+	Record_EncodeKeyframe( rs, keyframe, stream );
+	size = (int)( stream->position - sizePosition - 4 );
+	Com_Memcpy( stream->data + sizePosition, &size, 4 );
+
+	stream->abortSet = qfalse;
+	return qtrue;
+}
+
+/* ******************************************************************************** */
+// Relay Output
+/* ******************************************************************************** */
+
+/*
+==================
+Record_RelayOutput_CloseConnection
+==================
+*/
+static void Record_RelayOutput_CloseConnection( record_relay_connection_t *connection, const char *reason ) {
+	Record_Printf( RP_ALL, "Relay output connection %i closed: %s\n",
+			(int)( connection - relayOutput->connections ), reason );
+	close( connection->socket );
+	if ( connection->queue ) {
+		Record_Free( connection->queue );
+	}
+	Com_Memset( connection, 0, sizeof( *connection ) );
+	connection->socket = -1;
+}
+
+/*
+==================
+Record_RelayOutput_Close
+==================
+*/
+static void Record_RelayOutput_Close( void ) {
+	int i;
+	for ( i = 0; i < RELAY_MAX_CONNECTIONS; ++i ) {
+		if ( relayOutput->connections[i].socket >= 0 ) {
+			Record_RelayOutput_CloseConnection( &relayOutput->connections[i], "relay output closed" );
+		}
+	}
+	close( relayOutput->listenSocket );
+	unlink( relayOutput->path );
+	if ( relayOutput->block ) {
+		Record_Free( relayOutput->block );
+	}
+	Record_Free( relayOutput );
+	relayOutput = NULL;
+}
+
+/*
+==================
+Record_RelayOutput_Open
+==================
+*/
+static void Record_RelayOutput_Open( const char *path ) {
+	struct sockaddr_un address;
+	struct stat st;
+	int sock;
+	int i;
+
+	if ( !Record_Relay_SetAddress( path, &address ) ) {
+		return;
+	}
+	sock = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if ( sock < 0 ) {
+		Record_Printf( RP_ALL, "Failed to create relay output socket: %s\n", strerror( errno ) );
+		return;
+	}
+
+	// Remove socket left over from a previous process
+	if ( !lstat( path, &st ) && S_ISSOCK( st.st_mode ) ) {
+		unlink( path );
+	}
+
+	if ( bind( sock, (struct sockaddr *)&address, sizeof( address ) ) < 0 ||
+			listen( sock, RELAY_MAX_CONNECTIONS ) < 0 ) {
+		Record_Printf( RP_ALL, "Failed to open relay output socket %s: %s\n", path, strerror( errno ) );
+		close( sock );
+		return;
+	}
+	Record_Relay_SetNonBlocking( sock );
+
+	relayOutput = (record_relay_output_t *)Record_Calloc( sizeof( *relayOutput ) );
+	Q_strncpyz( relayOutput->path, path, sizeof( relayOutput->path ) );
+	relayOutput->listenSocket = sock;
+	for ( i = 0; i < RELAY_MAX_CONNECTIONS; ++i ) {
+		relayOutput->connections[i].socket = -1;
+	}
+	Record_Printf( RP_ALL, "Relay output listening on %s\n", path );
+}
+
+/*
+==================
+Record_RelayOutput_Update
+
+Opens or closes relay output according to sv_recordRelayOutput, and accepts new connections.
+Returns qtrue if relay output is open.
+==================
+*/
+static qboolean Record_RelayOutput_Update( void ) {
+	if ( sv_recordRelayOutput->modificationCount != relayOutputModificationCount ) {
+		relayOutputModificationCount = sv_recordRelayOutput->modificationCount;
+		if ( relayOutput ) {
+			Record_RelayOutput_Close();
+		}
+		if ( *sv_recordRelayOutput->string ) {
+			Record_RelayOutput_Open( sv_recordRelayOutput->string );
+		}
+	}
+	if ( !relayOutput ) {
+		return qfalse;
+	}
+
+	while ( 1 ) {
+		int i;
+		int sock = accept( relayOutput->listenSocket, NULL, NULL );
+		if ( sock < 0 ) {
+			break;
+		}
+
+		for ( i = 0; i < RELAY_MAX_CONNECTIONS; ++i ) {
+			if ( relayOutput->connections[i].socket < 0 ) {
+				break;
+			}
+		}
+		if ( i >= RELAY_MAX_CONNECTIONS ) {
+			Record_Printf( RP_ALL, "Relay output connection refused: too many connections\n" );
+			close( sock );
+			continue;
+		}
+
+		Record_Relay_SetNonBlocking( sock );
+		relayOutput->connections[i].socket = sock;
+		relayOutput->connections[i].started = qfalse;
+		Record_Printf( RP_ALL, "Relay output connection %i opened\n", i );
+	}
+
+	return qtrue;
+}
+
+/*
+==================
+Record_RelayOutput_QueueBlock
+==================
+*/
+static void Record_RelayOutput_QueueBlock( record_relay_connection_t *connection, int time, int flags,
+		const char *data, unsigned int size ) {
+	int header[RELAY_BLOCK_HEADER_SIZE / 4];
+	header[0] = (int)size;
+	header[1] = time;
+	header[2] = flags;
+	Record_Relay_AppendBuffer( &connection->queue, &connection->queueSize, &connection->queueUsed,
+			header, sizeof( header ) );
+	Record_Relay_AppendBuffer( &connection->queue, &connection->queueSize, &connection->queueUsed, data, size );
+}
+
+/*
+==================
+Record_RelayOutput_Send
+
+Sends as much queued data as the socket accepts without blocking.
+==================
+*/
+static void Record_RelayOutput_Send( record_relay_connection_t *connection ) {
+	unsigned int sent = 0;
+
+	while ( sent < connection->queueUsed ) {
+		ssize_t result = send( connection->socket, connection->queue + sent, connection->queueUsed - sent,
+				MSG_NOSIGNAL );
+		if ( result < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			if ( errno == EAGAIN || errno == EWOULDBLOCK ) {
+				break;
+			}
+			Record_RelayOutput_CloseConnection( connection, strerror( errno ) );
+			return;
+		}
+		sent += (unsigned int)result;
+	}
+
+	if ( sent ) {
+		memmove( connection->queue, connection->queue + sent, connection->queueUsed - sent );
+		connection->queueUsed -= sent;
+	}
+
+	// Receiver isn't keeping up; it can reconnect and resume from a new start block
+	if ( connection->queueUsed > RELAY_MAX_SEND_QUEUE ) {
+		Record_RelayOutput_CloseConnection( connection, "send queue full" );
+	}
+}
+
+/*
+==================
+Record_RelayOutput_Restart
+
+Called when the record state is reset. Each connection is sent a new start block
+at the end of the current block, instead of the data written up to that point.
+==================
+*/
+void Record_RelayOutput_Restart( void ) {
+	int i;
+	if ( !relayOutput ) {
+		return;
+	}
+	for ( i = 0; i < RELAY_MAX_CONNECTIONS; ++i ) {
+		relayOutput->connections[i].started = qfalse;
+	}
+	relayOutput->blockUsed = 0;
+}
+
+/*
+==================
+Record_RelayOutput_Write
+
+Adds record stream data to the current block.
+==================
+*/
+void Record_RelayOutput_Write( const char *data, unsigned int size ) {
+	int i;
+	if ( !relayOutput ) {
+		return;
+	}
+	for ( i = 0; i < RELAY_MAX_CONNECTIONS; ++i ) {
+		if ( relayOutput->connections[i].socket >= 0 && relayOutput->connections[i].started ) {
+			Record_Relay_AppendBuffer( &relayOutput->block, &relayOutput->blockSize, &relayOutput->blockUsed,
+					data, size );
+			return;
+		}
+	}
+}
+
+/*
+==================
+Record_RelayOutput_EndBlock
+
+Sends the current block to started connections, and a start block built from the
+given record state to new ones.
+==================
+*/
+void Record_RelayOutput_EndBlock( int time, record_state_t *rs, record_keyframe_t *keyframe ) {
+	int i;
+	record_data_stream_t start;
+	qboolean haveStart = qfalse;
+
+	if ( !Record_RelayOutput_Update() ) {
+		return;
+	}
+
+	for ( i = 0; i < RELAY_MAX_CONNECTIONS; ++i ) {
+		record_relay_connection_t *connection = &relayOutput->connections[i];
+		if ( connection->socket < 0 ) {
+			continue;
+		}
+
+		if ( connection->started ) {
+			Record_RelayOutput_QueueBlock( connection, time, 0, relayOutput->block, relayOutput->blockUsed );
+		} else {
+			if ( !haveStart ) {
+				if ( !Record_Relay_EncodeStart( time, rs, keyframe, &start ) ) {
+					Record_RelayOutput_CloseConnection( connection, "failed to encode start block" );
+					continue;
+				}
+				haveStart = qtrue;
+			}
+			Record_RelayOutput_QueueBlock( connection, time, RELAY_BLOCK_START, start.data, start.position );
+			connection->started = qtrue;
+		}
+
+		Record_RelayOutput_Send( connection );
+	}
+
+	relayOutput->blockUsed = 0;
+	if ( haveStart ) {
+		Record_Free( start.data );
+	}
+}
+
+/* ******************************************************************************** */
+// Relay Source
+/* ******************************************************************************** */
+
+/*
+==================
+Record_Relay_Disconnect
+==================
+*/
+static void Record_Relay_Disconnect( const char *reason ) {
+	if ( !relaySource.connected ) {
+		return;
+	}
+	Record_Printf( RP_ALL, "Relay source disconnected: %s\n", reason );
+	close( relaySource.socket );
+	relaySource.connected = qfalse;
+	relaySource.socket = -1;
+	if ( relaySource.receiving ) {
+		Record_Free( relaySource.receiving );
+		relaySource.receiving = NULL;
+	}
+	relaySource.headerReceived = 0;
+	relaySource.received = 0;
+}
+
+/*
+==================
+Record_Relay_Connect
+==================
+*/
+static void Record_Relay_Connect( void ) {
+	struct sockaddr_un address;
+	int sock;
+	int now = Sys_Milliseconds();
+
+	if ( relaySource.lastConnectTime && now - relaySource.lastConnectTime < RELAY_RECONNECT_INTERVAL ) {
+		return;
+	}
+	relaySource.lastConnectTime = now ? now : 1;
+
+	if ( !Record_Relay_SetAddress( sv_recordRelaySource->string, &address ) ) {
+		return;
+	}
+	sock = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if ( sock < 0 ) {
+		Record_Printf( RP_ALL, "Failed to create relay source socket: %s\n", strerror( errno ) );
+		return;
+	}
+	if ( connect( sock, (struct sockaddr *)&address, sizeof( address ) ) < 0 ) {
+		Record_Printf( RP_DEBUG, "Failed to connect to relay source %s: %s\n", sv_recordRelaySource->string,
+				strerror( errno ) );
+		close( sock );
+		return;
+	}
+	Record_Relay_SetNonBlocking( sock );
+
+	relaySource.socket = sock;
+	relaySource.connected = qtrue;
+	Record_Printf( RP_ALL, "Relay source connected to %s\n", sv_recordRelaySource->string );
+}
+
+/*
+==================
+Record_Relay_FreeBlocks
+
+Discards blocks waiting for the broadcast delay.
+==================
+*/
+static void Record_Relay_FreeBlocks( void ) {
+	while ( relaySource.first ) {
+		record_relay_block_t *block = relaySource.first;
+		relaySource.first = block->next;
+		Record_Free( block );
+	}
+	relaySource.last = NULL;
+	relaySource.queuedBlocks = 0;
+	relaySource.queuedBytes = 0;
+}
+
+/*
+==================
+Record_Relay_QueueBlock
+==================
+*/
+static void Record_Relay_QueueBlock( record_relay_block_t *block ) {
+	block->releaseTime = Sys_Milliseconds() + sv_recordRelayDelay->integer * 1000;
+	if ( relaySource.last ) {
+		relaySource.last->next = block;
+	} else {
+		relaySource.first = block;
+	}
+	relaySource.last = block;
+	++relaySource.queuedBlocks;
+	relaySource.queuedBytes += block->size;
+
+	if ( relaySource.queuedBytes > RELAY_MAX_DELAY_QUEUE ) {
+		// Regular blocks can't be applied after dropping data, so restart from a new start block
+		Record_Relay_FreeBlocks();
+		relaySource.haveStart = qfalse;
+		Record_Relay_Disconnect( "delay queue full" );
+	}
+}
+
+/*
+==================
+Record_Relay_ReceiveData
+
+Returns qtrue if data was received, qfalse if none is available or the connection was closed.
+==================
+*/
+static qboolean Record_Relay_ReceiveData( void *output, unsigned int size, unsigned int *position ) {
+	ssize_t result = recv( relaySource.socket, (char *)output + *position, size - *position, 0 );
+	if ( result > 0 ) {
+		*position += (unsigned int)result;
+		return qtrue;
+	}
+	if ( result == 0 ) {
+		Record_Relay_Disconnect( "connection closed" );
+	} else if ( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR ) {
+		Record_Relay_Disconnect( strerror( errno ) );
+	}
+	return qfalse;
+}
+
+/*
+==================
+Record_Relay_Receive
+
+Reads available data from the source connection and queues completed blocks.
+==================
+*/
+static void Record_Relay_Receive( void ) {
+	while ( relaySource.connected ) {
+		if ( relaySource.headerReceived < RELAY_BLOCK_HEADER_SIZE ) {
+			if ( !Record_Relay_ReceiveData( relaySource.header, RELAY_BLOCK_HEADER_SIZE, &relaySource.headerReceived ) ) {
+				return;
+			}
+			if ( relaySource.headerReceived < RELAY_BLOCK_HEADER_SIZE ) {
+				continue;
+			}
+
+			if ( (unsigned int)relaySource.header[0] > RELAY_MAX_BLOCK_SIZE ) {
+				relaySource.haveStart = qfalse;
+				Record_Relay_Disconnect( "invalid block size" );
+				return;
+			}
+			relaySource.receiving = (record_relay_block_t *)Record_Calloc(
+					sizeof( *relaySource.receiving ) + relaySource.header[0] );
+			relaySource.receiving->data = (char *)( relaySource.receiving + 1 );
+			relaySource.receiving->size = (unsigned int)relaySource.header[0];
+			relaySource.receiving->time = relaySource.header[1];
+			relaySource.receiving->flags = relaySource.header[2];
+			relaySource.received = 0;
+		}
+
+		if ( relaySource.received < relaySource.receiving->size ) {
+			if ( !Record_Relay_ReceiveData( relaySource.receiving->data, relaySource.receiving->size,
+					&relaySource.received ) ) {
+				return;
+			}
+			if ( relaySource.received < relaySource.receiving->size ) {
+				continue;
+			}
+		}
+
+		// Queueing may free the block and disconnect, so release ownership first
+		{
+			record_relay_block_t *block = relaySource.receiving;
+			relaySource.receiving = NULL;
+			relaySource.headerReceived = 0;
+			Record_Relay_QueueBlock( block );
+		}
+	}
+}
+
+/*
+==================
+Record_Relay_UpdateServerId
+==================
+*/
+static void Record_Relay_UpdateServerId( void ) {
+	recordRelay->serverId = atoi( Info_ValueForKey( recordRelay->rs->configstrings[CS_SYSTEMINFO], "sv_serverid" ) );
+}
+
+/*
+==================
+Record_Relay_ReadClientNum
+==================
+*/
+static int Record_Relay_ReadClientNum( record_data_stream_t *stream ) {
+	int clientNum = *(unsigned char *)Record_Stream_ReadStatic( 1, stream );
+	if ( clientNum >= recordRelay->rs->maxClients ) {
+		Record_Stream_Error( stream, "Record_Relay_ReadClientNum: invalid clientnum" );
+	}
+	return clientNum;
+}
+
+/*
+==================
+Record_Relay_ProcessStart
+
+Reads the stream header and keyframe which begin a start block.
+==================
+*/
+static void Record_Relay_ProcessStart( record_data_stream_t *stream, int time ) {
+	int maxClients;
+	int oldServerId;
+#ifndef ELITEFORCE
+	int size;
+#endif
+
+#ifdef ELITEFORCE
+	if ( *(int *)Record_Stream_ReadStatic( 4, stream ) != RECORD_PROTOCOL ) {
+		Record_Stream_Error( stream, "Record_Relay_ProcessStart: relay source has wrong protocol" );
+	}
+#else
+	size = *(int *)Record_Stream_ReadStatic( 4, stream );
+	if ( size != sizeof( RECORD_PROTOCOL ) - 1 || memcmp( Record_Stream_ReadStatic( size, stream ), RECORD_PROTOCOL, size ) ) {
+		Record_Stream_Error( stream, "Record_Relay_ProcessStart: relay source has wrong protocol" );
+	}
+	size = *(int *)Record_Stream_ReadStatic( 4, stream );
+	Record_Stream_ReadStatic( size, stream );
+#endif
+
+	maxClients = *(int *)Record_Stream_ReadStatic( 4, stream );
+	if ( maxClients < 1 || maxClients > MAX_CLIENTS ) {
+		Record_Stream_Error( stream, "Record_Relay_ProcessStart: bad maxClients" );
+	}
+	if ( *(unsigned char *)Record_Stream_ReadStatic( 1, stream ) != RC_STATE_KEYFRAME ) {
+		Record_Stream_Error( stream, "Record_Relay_ProcessStart: missing keyframe" );
+	}
+	Record_Stream_ReadStatic( 8, stream );	// keyframe time and size
+
+	if ( !recordRelay ) {
+		recordRelay = (record_relay_state_t *)Record_Calloc( sizeof( *recordRelay ) );
+	}
+	if ( recordRelay->rs && recordRelay->rs->maxClients != maxClients ) {
+		Record_FreeState( recordRelay->rs );
+		recordRelay->rs = NULL;
+	}
+	if ( !recordRelay->rs ) {
+		recordRelay->rs = Record_AllocateState( maxClients );
+	}
+
+	oldServerId = recordRelay->serverId;
+	Record_DecodeKeyframe( recordRelay->rs, &recordRelay->keyframe, stream );
+	recordRelay->time = time;
+	Record_Relay_UpdateServerId();
+
+	// A restarted writer on the same map continues the same game for spectators
+	if ( recordRelay->serverId != oldServerId ) {
+		recordRelay->snapFlagServerBit ^= SNAPFLAG_SERVERCOUNT;
+		Record_Spectator_ProcessMapLoaded();
+	}
+}
+
+/*
+==================
+Record_Relay_ProcessCommand
+
+Based on stef_sv_record_convert.c->Record_StreamReader_Advance
+==================
+*/
+static void Record_Relay_ProcessCommand( record_data_stream_t *stream ) {
+	record_state_t *rs = recordRelay->rs;
+	record_command_t command = (record_command_t)*(unsigned char *)Record_Stream_ReadStatic( 1, stream );
+	int clientNum;
+
+	switch ( command ) {
+		case RC_MISC_COMMAND: {
+			int size = *(unsigned char *)Record_Stream_ReadStatic( 1, stream );
+			if ( size == 255 ) {
+				size = *(unsigned short *)Record_Stream_ReadStatic( 2, stream );
+			}
+			Record_Stream_ReadStatic( size, stream );
+			break;
+		}
+
+		case RC_STATE_ENTITY_SET:
+			Record_DecodeEntityset( &rs->entities, stream );
+			break;
+		case RC_STATE_PLAYERSTATE:
+			clientNum = Record_Relay_ReadClientNum( stream );
+			Record_DecodePlayerstate( &rs->clients[clientNum].playerstate, stream );
+			break;
+		case RC_STATE_VISIBILITY:
+			clientNum = Record_Relay_ReadClientNum( stream );
+			Record_DecodeVisibilityState( &rs->clients[clientNum].visibility, stream );
+			break;
+		case RC_STATE_USERCMD: {
+			usercmd_t usercmd;
+			clientNum = Record_Relay_ReadClientNum( stream );
+			Record_DecodeUsercmd( &rs->clients[clientNum].usercmd, stream );
+#ifdef ELITEFORCE
+			Record_UnpackUsercmd( &rs->clients[clientNum].usercmd, &usercmd );
+#else
+			usercmd = rs->clients[clientNum].usercmd;
+#endif
+			Record_Spectator_ProcessUsercmd( clientNum, &usercmd );
+			break;
+		}
+		case RC_STATE_CONFIGSTRING: {
+			int index = *(unsigned short *)Record_Stream_ReadStatic( 2, stream );
+			char *string;
+			if ( index >= MAX_CONFIGSTRINGS ) {
+				Record_Stream_Error( stream, "Record_Relay_ProcessCommand: invalid configstring index" );
+			}
+			string = Record_DecodeString( stream );
+			Z_Free( rs->configstrings[index] );
+			rs->configstrings[index] = CopyString( string );
+			if ( index == CS_SYSTEMINFO ) {
+				Record_Relay_UpdateServerId();
+			}
+			Record_Spectator_ProcessConfigstring( index, rs->configstrings[index] );
+			break;
+		}
+		case RC_STATE_CURRENT_SERVERCMD: {
+			char *string = Record_DecodeString( stream );
+			Z_Free( rs->currentServercmd );
+			rs->currentServercmd = CopyString( string );
+			break;
+		}
+
+		case RC_EVENT_BASELINES:
+			recordRelay->keyframe.baselines = rs->entities;
+			break;
+		case RC_EVENT_SNAPSHOT:
+			recordRelay->time = *(int *)Record_Stream_ReadStatic( 4, stream );
+			Record_Spectator_ProcessSnapshot();
+			break;
+		case RC_EVENT_SERVERCMD:
+			clientNum = Record_Relay_ReadClientNum( stream );
+			Record_Spectator_ProcessServercmd( clientNum, rs->currentServercmd );
+			break;
+		case RC_EVENT_CLIENT_ENTER_WORLD:
+			clientNum = Record_Relay_ReadClientNum( stream );
+			recordRelay->keyframe.activeClients[clientNum] = 1;
+			++recordRelay->keyframe.instanceCounts[clientNum];
+			break;
+		case RC_EVENT_CLIENT_DISCONNECT:
+			clientNum = Record_Relay_ReadClientNum( stream );
+			recordRelay->keyframe.activeClients[clientNum] = 0;
+			break;
+		case RC_EVENT_MAP_RESTART:
+			recordRelay->snapFlagServerBit ^= SNAPFLAG_SERVERCOUNT;
+			break;
+
+		case RC_STATE_KEYFRAME: {
+			// state is already current, so just skip it
+			int size;
+			Record_Stream_ReadStatic( 4, stream );
+			size = *(int *)Record_Stream_ReadStatic( 4, stream );
+			Record_Stream_ReadStatic( size, stream );
+			break;
+		}
+		case RC_SEEK_INDEX: {
+			unsigned int count;
+			Record_Stream_ReadStatic( 4, stream );
+			count = *(unsigned int *)Record_Stream_ReadStatic( 4, stream );
+			if ( count > stream->size / 8 ) {
+				Record_Stream_Error( stream, "Record_Relay_ProcessCommand: invalid seek index" );
+			}
+			Record_Stream_ReadStatic( count * 8 + 8, stream );
+			break;
+		}
+
+		default:
+			Record_Stream_Error( stream, "Record_Relay_ProcessCommand: unknown command" );
+	}
+}
+
+/*
+==================
+Record_Relay_ProcessBlock
+
+Applies a block to the relay state, sends spectator snapshots, and forwards it to relay output.
+==================
+*/
+static void Record_Relay_ProcessBlock( record_relay_block_t *block ) {
+	record_data_stream_t stream;
+	if ( !relaySource.haveStart && !( block->flags & RELAY_BLOCK_START ) ) {
+		return;
+	}
+
+	Com_Memset( &stream, 0, sizeof( stream ) );
+	stream.data = block->data;
+	stream.size = block->size;
+#ifdef STEF_RECORD_FIELD_ENCODING
+	stream.fieldEncoding = qtrue;
+#endif
+	stream.abortSet = qtrue;
+	if ( setjmp( stream.abort ) ) {
+		relaySource.haveStart = qfalse;
+		Record_Relay_Disconnect( "invalid stream data" );
+		return;
+	}
+
+	if ( block->flags & RELAY_BLOCK_START ) {
+		Record_Relay_ProcessStart( &stream, block->time );
+		relaySource.haveStart = qtrue;
+	}
+	while ( !Record_Stream_AtEnd( &stream ) ) {
+		Record_Relay_ProcessCommand( &stream );
+	}
+	stream.abortSet = qfalse;
+
+	// Forward to chained relays
+	if ( block->flags & RELAY_BLOCK_START ) {
+		Record_RelayOutput_Restart();
+	} else {
+		Record_RelayOutput_Write( block->data, block->size );
+	}
+	Record_RelayOutput_EndBlock( recordRelay->time, recordRelay->rs, &recordRelay->keyframe );
+}
+
+/*
+==================
+Record_Relay_ReleaseBlocks
+
+Processes queued blocks which have reached the end of the broadcast delay.
+==================
+*/
+static void Record_Relay_ReleaseBlocks( void ) {
+	int now = Sys_Milliseconds();
+	while ( relaySource.first && now - relaySource.first->releaseTime >= 0 ) {
+		record_relay_block_t *block = relaySource.first;
+		relaySource.first = block->next;
+		if ( !relaySource.first ) {
+			relaySource.last = NULL;
+		}
+		--relaySource.queuedBlocks;
+		relaySource.queuedBytes -= block->size;
+
+		Record_Relay_ProcessBlock( block );
+		Record_Free( block );
+	}
+}
+
+/* ******************************************************************************** */
+// Exported functions
+/* ******************************************************************************** */
+
+/*
+==================
+Record_Relay_Active
+
+Returns qtrue if this process is serving spectators from a relay source instead of a local game.
+==================
+*/
+qboolean Record_Relay_Active( void ) {
+	if ( !com_dedicated->integer || com_sv_running->integer || !*sv_recordRelaySource->string ) {
+		return qfalse;
+	}
+	return qtrue;
+}
+
+/*
+==================
+Record_Relay_Stop
+
+Disconnects from the relay source and discards relay state.
+==================
+*/
+void Record_Relay_Stop( void ) {
+	Record_Relay_Disconnect( "relay stopped" );
+	Record_Relay_FreeBlocks();
+	if ( recordRelay ) {
+		Record_FreeState( recordRelay->rs );
+		Record_Free( recordRelay );
+		recordRelay = NULL;
+	}
+	relaySource.haveStart = qfalse;
+	relaySource.lastConnectTime = 0;
+}
+
+/*
+==================
+Record_Relay_Frame
+
+Called each server frame while no map is running. Returns qtrue if relay is active.
+==================
+*/
+qboolean Record_Relay_Frame( int msec ) {
+	if ( !Record_Relay_Active() ) {
+		if ( recordRelay ) {
+			Record_Spectator_DropAll( "Relay stopped" );
+		}
+		Record_Relay_Stop();
+		return qfalse;
+	}
+
+	// Used for spectator timeouts and challenges
+	svs.time += msec;
+
+	if ( sv_recordRelaySource->modificationCount != relaySource.modificationCount ) {
+		relaySource.modificationCount = sv_recordRelaySource->modificationCount;
+		Record_Relay_Disconnect( "relay source changed" );
+		relaySource.lastConnectTime = 0;
+	}
+	if ( !relaySource.connected ) {
+		Record_Relay_Connect();
+	}
+
+	Record_Relay_Receive();
+	Record_Relay_ReleaseBlocks();
+
+	if ( !recordRelay ) {
+		// Drop spectators left over from a previous local game
+		Record_Spectator_DropAll( NULL );
+	}
+	return qtrue;
+}
+
+/*
+==================
+Record_Relay_PrintStatus
+==================
+*/
+void Record_Relay_PrintStatus( void ) {
+	int i;
+
+	if ( !Record_Relay_Active() ) {
+		Record_Printf( RP_ALL, "Relay source: not active\n" );
+	} else {
+		Record_Printf( RP_ALL, "Relay source: %s (%s)\n", sv_recordRelaySource->string,
+				relaySource.connected ? "connected" : "disconnected" );
+		Record_Printf( RP_ALL, "Delay queue: %i blocks, %u bytes, %i second delay\n", relaySource.queuedBlocks,
+				relaySource.queuedBytes, sv_recordRelayDelay->integer );
+		if ( recordRelay ) {
+			Record_Printf( RP_ALL, "Relay state: time(%i) maxClients(%i) serverId(%i)\n", recordRelay->time,
+					recordRelay->rs->maxClients, recordRelay->serverId );
+		} else {
+			Record_Printf( RP_ALL, "Relay state: waiting for start block\n" );
+		}
+	}
+
+	if ( !relayOutput ) {
+		Record_Printf( RP_ALL, "Relay output: not open\n" );
+		return;
+	}
+	Record_Printf( RP_ALL, "Relay output: %s\n", relayOutput->path );
+	for ( i = 0; i < RELAY_MAX_CONNECTIONS; ++i ) {
+		record_relay_connection_t *connection = &relayOutput->connections[i];
+		if ( connection->socket < 0 ) {
+			continue;
+		}
+		Record_Printf( RP_ALL, "num(%i) started(%i) queued(%u)\n", i, connection->started ? 1 : 0,
+				connection->queueUsed );
+	}
+}
+
+#endif
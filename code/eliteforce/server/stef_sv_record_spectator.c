@@ -31,6 +31,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 typedef struct {
 	playerState_t ps;
 	int frameEntitiesPosition;
+	int targetClient;
 	record_visibility_state_t visibility;
 } spectator_frame_t;
 
@@ -49,16 +50,151 @@ typedef struct {
 
 #define FRAME_ENTITY_COUNT (PACKET_BACKUP * 2)
 
+#ifdef STEF_RECORD_SPECTATOR_CACHE
+#define SNAPSHOT_CACHE_ENTRIES 16
+
+typedef struct {
+	// Everything that affects the snapshot content following the header
+	int targetClient;
+	int deltaTargetClient;	// -1 for non-delta snapshot
+	int deltaFrameEntitiesPosition;
+	int baselineCutoff;
+	qboolean compat;
+
+	int bits;
+	byte data[MAX_MSGLEN_BUF];
+} spectator_snapshot_cache_entry_t;
+
+typedef struct {
+	qboolean active;	// only valid while sending snapshots for the current frame
+	int count;
+	spectator_snapshot_cache_entry_t entries[SNAPSHOT_CACHE_ENTRIES];
+} spectator_snapshot_cache_t;
+#endif
+
 typedef struct {
 	record_entityset_t currentBaselines;
 	spectator_t *spectators;
 	int maxSpectators;
 	int frameEntitiesPosition;
 	record_entityset_t frameEntities[FRAME_ENTITY_COUNT];
+#ifdef STEF_RECORD_ENTITY_TRACKER
+	int frameEntitiesTrackerFrame[FRAME_ENTITY_COUNT];
+#endif
+#ifdef STEF_RECORD_SPECTATOR_CACHE
+	spectator_snapshot_cache_t snapshotCache;
+#endif
 } spectator_system_t;
 
 spectator_system_t *sps;
 
+/* ******************************************************************************** */
+// Server state access
+/* ******************************************************************************** */
+
+// When running as a relay, spectators are served from the record stream received from
+// the game server instead of the local server state.
+
+/*
+==================
+Record_Spectator_MaxClients
+==================
+*/
+static int Record_Spectator_MaxClients( void ) {
+#ifdef STEF_RECORD_RELAY
+	if ( recordRelay ) {
+		return recordRelay->rs->maxClients;
+	}
+#endif
+	return sv_maxclients->integer;
+}
+
+/*
+==================
+Record_Spectator_Configstrings
+==================
+*/
+static char **Record_Spectator_Configstrings( void ) {
+#ifdef STEF_RECORD_RELAY
+	if ( recordRelay ) {
+		return recordRelay->rs->configstrings;
+	}
+#endif
+	return sv.configstrings;
+}
+
+/*
+==================
+Record_Spectator_ServerTime
+==================
+*/
+static int Record_Spectator_ServerTime( void ) {
+#ifdef STEF_RECORD_RELAY
+	if ( recordRelay ) {
+		return recordRelay->time;
+	}
+#endif
+	return sv.time;
+}
+
+/*
+==================
+Record_Spectator_Playerstate
+==================
+*/
+static playerState_t *Record_Spectator_Playerstate( int clientNum ) {
+#ifdef STEF_RECORD_RELAY
+	if ( recordRelay ) {
+		return &recordRelay->rs->clients[clientNum].playerstate;
+	}
+#endif
+	return SV_GameClientNum( clientNum );
+}
+
+/*
+==================
+Record_Spectator_ClientIsBot
+==================
+*/
+static qboolean Record_Spectator_ClientIsBot( int clientNum ) {
+#ifdef STEF_RECORD_RELAY
+	if ( recordRelay ) {
+		// Game module only includes skill in bot player info
+		return *Info_ValueForKey( recordRelay->rs->configstrings[CS_PLAYERS + clientNum], "skill" ) ? qtrue : qfalse;
+	}
+#endif
+	return svs.clients[clientNum].netchan.remoteAddress.type == NA_BOT ? qtrue : qfalse;
+}
+
+/*
+==================
+Record_Spectator_ClientName
+==================
+*/
+static const char *Record_Spectator_ClientName( int clientNum ) {
+#ifdef STEF_RECORD_RELAY
+	if ( recordRelay ) {
+		return Info_ValueForKey( recordRelay->rs->configstrings[CS_PLAYERS + clientNum], "n" );
+	}
+#endif
+	return svs.clients[clientNum].name;
+}
+
+/*
+==================
+Record_Spectator_GetBaselines
+==================
+*/
+static void Record_Spectator_GetBaselines( record_entityset_t *target ) {
+#ifdef STEF_RECORD_RELAY
+	if ( recordRelay ) {
+		*target = recordRelay->keyframe.baselines;
+		return;
+	}
+#endif
+	Record_GetCurrentBaselines( target );
+}
+
 /* ******************************************************************************** */
 // Command / configstring update handling
 /* ******************************************************************************** */
@@ -148,6 +284,14 @@ Record_TargetClientValid
 ==================
 */
 static qboolean Record_TargetClientValid( int clientnum ) {
+#ifdef STEF_RECORD_RELAY
+	if ( recordRelay ) {
+		if ( clientnum < 0 || clientnum >= recordRelay->rs->maxClients || !recordRelay->keyframe.activeClients[clientnum] ) {
+			return qfalse;
+		}
+		return qtrue;
+	}
+#endif
 	if ( sv.state != SS_GAME || clientnum < 0 || clientnum > sv_maxclients->integer ||
 			svs.clients[clientnum].state != CS_ACTIVE ) {
 		return qfalse;
@@ -164,20 +308,21 @@ Returns clientnum if valid client selected, -1 otherwise
 */
 static int Record_SelectTargetClient( int startIndex, qboolean cycleall ) {
 	int i;
-	if ( startIndex < 0 || startIndex >= sv_maxclients->integer ) {
+	int maxClients = Record_Spectator_MaxClients();
+	if ( startIndex < 0 || startIndex >= maxClients ) {
 		startIndex = 0;
 	}
 
-	for ( i = startIndex; i < startIndex + sv_maxclients->integer; ++i ) {
-		int clientnum = i % sv_maxclients->integer;
+	for ( i = startIndex; i < startIndex + maxClients; ++i ) {
+		int clientnum = i % maxClients;
 		if ( !Record_TargetClientValid( clientnum ) ) {
 			continue;
 		}
 		if ( !cycleall ) {
-			if ( svs.clients[clientnum].netchan.remoteAddress.type == NA_BOT ) {
+			if ( Record_Spectator_ClientIsBot( clientnum ) ) {
 				continue;
 			}
-			if ( Record_PlayerstateIsSpectator( SV_GameClientNum( clientnum ) ) ) {
+			if ( Record_PlayerstateIsSpectator( Record_Spectator_Playerstate( clientnum ) ) ) {
 				continue;
 			}
 		}
@@ -203,15 +348,15 @@ static void Record_AdvanceTargetClient( spectator_t *spectator ) {
 	spectator->targetClient = Record_SelectTargetClient( spectator->targetClient + 1, spectator->cycleall );
 	if ( spectator->targetClient >= 0 && spectator->targetClient != original_target ) {
 		const char *suffix = "";
-		if ( Record_PlayerstateIsSpectator( SV_GameClientNum( spectator->targetClient ) ) ) {
+		if ( Record_PlayerstateIsSpectator( Record_Spectator_Playerstate( spectator->targetClient ) ) ) {
 			suffix = " [SPECT]";
 		}
-		if ( svs.clients[spectator->targetClient].netchan.remoteAddress.type == NA_BOT ) {
+		if ( Record_Spectator_ClientIsBot( spectator->targetClient ) ) {
 			suffix = " [BOT]";
 		}
 
 		Record_Spectator_AddServerCmdFmt( &spectator->cl, "print \"Client(%i) Name(%s^7)%s\n\"",
-				spectator->targetClient, svs.clients[spectator->targetClient].name, suffix );
+				spectator->targetClient, Record_Spectator_ClientName( spectator->targetClient ), suffix );
 	}
 }
 
@@ -286,13 +431,81 @@ static void Record_SendSpectatorGamestate( spectator_t *spectator ) {
 	Record_InitSpectatorMessage( cl, &msg, msgBuf, MAX_MSGLEN );
 
 	// Write gamestate message
-	Record_WriteGamestateMessage( &sps->currentBaselines, sv.configstrings, 0, cl->reliableSequence, &msg,
+	Record_WriteGamestateMessage( &sps->currentBaselines, Record_Spectator_Configstrings(), 0, cl->reliableSequence, &msg,
 			&spectator->baselineCutoff );
 
 	// Send to client
 	SV_SendMessageToClient( &msg, cl );
 }
 
+/*
+==================
+Record_WriteSpectatorSnapshotContent
+
+Writes the snapshot content following the header. Spectators following the same target
+from the same delta frame share the same content, so it is only encoded once per frame.
+==================
+*/
+static void Record_WriteSpectatorSnapshotContent( spectator_t *spectator, spectator_frame_t *current_frame,
+		spectator_frame_t *delta_frame, msg_t *msg ) {
+	record_entityset_t *entities = &sps->frameEntities[current_frame->frameEntitiesPosition % FRAME_ENTITY_COUNT];
+	record_entityset_t *deltaEntities = delta_frame ?
+			&sps->frameEntities[delta_frame->frameEntitiesPosition % FRAME_ENTITY_COUNT] : 0;
+	record_visibility_state_t *deltaVisibility = delta_frame ? &delta_frame->visibility : 0;
+	playerState_t *deltaPs = delta_frame ? &delta_frame->ps : 0;
+
+#ifdef STEF_RECORD_SPECTATOR_CACHE
+	spectator_snapshot_cache_t *cache = &sps->snapshotCache;
+	if ( cache->active ) {
+		int i;
+		int deltaTargetClient = delta_frame ? delta_frame->targetClient : -1;
+		int deltaPosition = delta_frame ? delta_frame->frameEntitiesPosition : 0;
+		spectator_snapshot_cache_entry_t *entry;
+		msg_t encoded;
+
+		for ( i = 0; i < cache->count; ++i ) {
+			entry = &cache->entries[i];
+			if ( entry->targetClient == current_frame->targetClient && entry->deltaTargetClient == deltaTargetClient &&
+					entry->deltaFrameEntitiesPosition == deltaPosition &&
+					entry->baselineCutoff == spectator->baselineCutoff && entry->compat == spectator->cl.compat ) {
+				MSG_WriteBitStream( msg, entry->data, entry->bits );
+				return;
+			}
+		}
+
+		if ( cache->count < SNAPSHOT_CACHE_ENTRIES ) {
+			entry = &cache->entries[cache->count];
+#ifdef ELITEFORCE
+			if ( spectator->cl.compat ) {
+				MSG_InitOOB( &encoded, entry->data, MAX_MSGLEN );
+				encoded.compat = qtrue;
+			} else
+#endif
+			MSG_Init( &encoded, entry->data, MAX_MSGLEN );
+			encoded.allowoverflow = qtrue;
+
+			Record_WriteSnapshotContent( entities, &current_frame->visibility, &current_frame->ps, deltaEntities,
+					deltaVisibility, deltaPs, &sps->currentBaselines, spectator->baselineCutoff, &encoded );
+
+			if ( !encoded.overflowed ) {
+				entry->targetClient = current_frame->targetClient;
+				entry->deltaTargetClient = deltaTargetClient;
+				entry->deltaFrameEntitiesPosition = deltaPosition;
+				entry->baselineCutoff = spectator->baselineCutoff;
+				entry->compat = spectator->cl.compat;
+				entry->bits = encoded.bit;
+				++cache->count;
+				MSG_WriteBitStream( msg, entry->data, entry->bits );
+				return;
+			}
+		}
+	}
+#endif
+
+	Record_WriteSnapshotContent( entities, &current_frame->visibility, &current_frame->ps, deltaEntities,
+			deltaVisibility, deltaPs, &sps->currentBaselines, spectator->baselineCutoff, msg );
+}
+
 /*
 ==================
 Record_SendSpectatorSnapshot
@@ -309,6 +522,12 @@ static void Record_SendSpectatorSnapshot( spectator_t *spectator ) {
 	int delta_frame_offset = 0;
 	int snapFlags = svs.snapFlagServerBit;
 
+#ifdef STEF_RECORD_RELAY
+	if ( recordRelay ) {
+		snapFlags = recordRelay->snapFlagServerBit;
+	}
+#endif
+
 	// Advance target client if current one is invalid
 	Record_ValidateTargetClient( spectator );
 	if ( spectator->targetClient < 0 ) {
@@ -316,7 +535,7 @@ static void Record_SendSpectatorSnapshot( spectator_t *spectator ) {
 	}
 
 	// Store snapshot time in case it is needed to set oldServerTime on a map change
-	spectator->lastSnapshotSvTime = sv.time + cl->oldServerTime;
+	spectator->lastSnapshotSvTime = Record_Spectator_ServerTime() + cl->oldServerTime;
 
 	// Determine snapFlags
 	if ( cl->state != CS_ACTIVE ) {
@@ -325,7 +544,13 @@ static void Record_SendSpectatorSnapshot( spectator_t *spectator ) {
 
 	// Set up current frame
 	current_frame->frameEntitiesPosition = sps->frameEntitiesPosition;
-	current_frame->ps = *SV_GameClientNum( spectator->targetClient );
+	current_frame->targetClient = spectator->targetClient;
+	current_frame->ps = *Record_Spectator_Playerstate( spectator->targetClient );
+#ifdef STEF_RECORD_RELAY
+	if ( recordRelay ) {
+		current_frame->visibility = recordRelay->rs->clients[spectator->targetClient].visibility;
+	} else
+#endif
 	Record_GetCurrentVisibility( spectator->targetClient, &current_frame->visibility );
 
 	// Tweak playerstate to indicate spectator mode
@@ -348,12 +573,9 @@ static void Record_SendSpectatorSnapshot( spectator_t *spectator ) {
 	Record_InitSpectatorMessage( cl, &msg, msg_buf, MAX_MSGLEN );
 
 	// Write snapshot message
-	Record_WriteSnapshotMessage( &sps->frameEntities[current_frame->frameEntitiesPosition % FRAME_ENTITY_COUNT],
-			&current_frame->visibility, &current_frame->ps,
-			delta_frame ? &sps->frameEntities[delta_frame->frameEntitiesPosition % FRAME_ENTITY_COUNT] : 0,
-			delta_frame ? &delta_frame->visibility : 0, delta_frame ? &delta_frame->ps : 0,
-			&sps->currentBaselines, spectator->baselineCutoff, cl->lastClientCommand,
-			delta_frame ? delta_frame_offset : 0, snapFlags, spectator->lastSnapshotSvTime, &msg );
+	Record_WriteSnapshotHeader( cl->lastClientCommand, delta_frame ? delta_frame_offset : 0, snapFlags,
+			spectator->lastSnapshotSvTime, &msg );
+	Record_WriteSpectatorSnapshotContent( spectator, current_frame, delta_frame, &msg );
 
 	// Send to client
 	SV_SendMessageToClient( &msg, cl );
@@ -429,7 +651,7 @@ static void Record_Spectator_EnterWorld( spectator_t *spectator ) {
 	// Based on sv_init.c->SV_UpdateConfigstrings
 	for ( i = 0; i < MAX_CONFIGSTRINGS; ++i ) {
 		if ( cl->csUpdated[i] ) {
-			Record_Spectator_SendConfigstring( cl, i, sv.configstrings[i] );
+			Record_Spectator_SendConfigstring( cl, i, Record_Spectator_Configstrings()[i] );
 			cl->csUpdated[i] = qfalse;
 		}
 	}
@@ -506,7 +728,7 @@ static void Record_Spectator_Move( spectator_t *spectator, msg_t *msg, qboolean
 	}
 
 	// Handle sv.time reset on map restart etc.
-	if ( cl->lastUsercmd.serverTime > sv.time ) {
+	if ( cl->lastUsercmd.serverTime > Record_Spectator_ServerTime() ) {
 		cl->lastUsercmd.serverTime = 0;
 	}
 
@@ -616,7 +838,11 @@ static void Record_Spectator_ProcessMessage( spectator_t *spectator, msg_t *msg
 		cl->reliableAcknowledge = cl->reliableSequence;
 	}
 
+#ifdef STEF_RECORD_RELAY
+	if ( serverId != ( recordRelay ? recordRelay->serverId : sv.serverId ) ) {
+#else
 	if ( serverId != sv.serverId ) {
+#endif
 		// Invalid serverID
 		if ( cl->messageAcknowledge > cl->gamestateMessageNum ) {
 			// No previous gamestate waiting to be acknowledged - send new one
@@ -674,7 +900,7 @@ static void Record_Spectator_Init( int maxSpectators ) {
 	sps = (spectator_system_t *)Record_Calloc( sizeof( *sps ) );
 	sps->spectators = (spectator_t *)Record_Calloc( sizeof( *sps->spectators ) * maxSpectators );
 	sps->maxSpectators = maxSpectators;
-	Record_GetCurrentBaselines( &sps->currentBaselines );
+	Record_Spectator_GetBaselines( &sps->currentBaselines );
 }
 
 /*
@@ -767,7 +993,33 @@ void Record_Spectator_ProcessSnapshot( void ) {
 	}
 
 	// Add current entities to entity buffer
+#ifdef STEF_RECORD_RELAY
+	if ( recordRelay ) {
+		int slot = ++sps->frameEntitiesPosition % FRAME_ENTITY_COUNT;
+		sps->frameEntities[slot] = recordRelay->rs->entities;
+#ifdef STEF_RECORD_ENTITY_TRACKER
+		sps->frameEntitiesTrackerFrame[slot] = -1;
+#endif
+	} else
+#endif
+#ifdef STEF_RECORD_ENTITY_TRACKER
+	{
+		// Only copy entities that changed since this buffer slot was last written
+		record_entity_tracker_t *tracker = Record_EntityTracker_Get();
+		int slot = ++sps->frameEntitiesPosition % FRAME_ENTITY_COUNT;
+		Record_CopyEntityChanges( &sps->frameEntities[slot], sps->frameEntitiesTrackerFrame[slot], tracker );
+		sps->frameEntitiesTrackerFrame[slot] = tracker->frame;
+	}
+#else
 	Record_GetCurrentEntities( &sps->frameEntities[++sps->frameEntitiesPosition % FRAME_ENTITY_COUNT] );
+#endif
+
+#ifdef STEF_RECORD_SPECTATOR_CACHE
+	// Snapshots sent outside this loop (e.g. on disconnect) may use a target playerstate
+	// that has changed since the frame, so they don't use the cache
+	sps->snapshotCache.active = qtrue;
+	sps->snapshotCache.count = 0;
+#endif
 
 	// Based on sv_snapshot.c->SV_SendClientMessages
 	for ( i = 0; i < sps->maxSpectators; ++i ) {
@@ -803,6 +1055,10 @@ void Record_Spectator_ProcessSnapshot( void ) {
 		cl->rateDelayed = qfalse;
 	}
 
+#ifdef STEF_RECORD_SPECTATOR_CACHE
+	sps->snapshotCache.active = qfalse;
+#endif
+
 	if ( !active ) {
 		// No active spectators; free spectator system to save memory
 		Record_Spectator_Shutdown();
@@ -820,18 +1076,37 @@ qboolean Record_Spectator_ProcessConnection( const netadr_t *address, const char
 		int qport, qboolean compat ) {
 	spectator_t *spectator;
 	const char *password = Info_ValueForKey( userinfo, "password" );
-	if ( Q_stricmpn( password, "spect_", 6 ) ) {
-		return qfalse;
-	}
+#ifdef STEF_RECORD_RELAY
+	if ( Record_Relay_Active() ) {
+		// Every connection to a relay is a spectator, so the password prefix is optional
+		// and an empty sv_adminSpectatorPassword allows anyone to connect
+		if ( !Q_stricmpn( password, "spect_", 6 ) ) {
+			password += 6;
+		}
+		if ( *sv_adminSpectatorPassword->string && strcmp( password, sv_adminSpectatorPassword->string ) ) {
+			NET_OutOfBandPrint( NS_SERVER, address, "print\nIncorrect spectator password.\n" );
+			return qtrue;
+		}
+		if ( !recordRelay ) {
+			NET_OutOfBandPrint( NS_SERVER, address, "print\nRelay is waiting for the game server.\n" );
+			return qtrue;
+		}
+	} else
+#endif
+	{
+		if ( Q_stricmpn( password, "spect_", 6 ) ) {
+			return qfalse;
+		}
 
-	if ( !*sv_adminSpectatorPassword->string ) {
-		NET_OutOfBandPrint( NS_SERVER, address, "print\nSpectator mode not enabled on this server.\n" );
-		return qtrue;
-	}
+		if ( !*sv_adminSpectatorPassword->string ) {
+			NET_OutOfBandPrint( NS_SERVER, address, "print\nSpectator mode not enabled on this server.\n" );
+			return qtrue;
+		}
 
-	if ( strcmp( password + 6, sv_adminSpectatorPassword->string ) ) {
-		NET_OutOfBandPrint( NS_SERVER, address, "print\nIncorrect spectator password.\n" );
-		return qtrue;
+		if ( strcmp( password + 6, sv_adminSpectatorPassword->string ) ) {
+			NET_OutOfBandPrint( NS_SERVER, address, "print\nIncorrect spectator password.\n" );
+			return qtrue;
+		}
 	}
 
 	spectator = Record_Spectator_AllocateClient( address, qport );
@@ -911,7 +1186,7 @@ void Record_Spectator_ProcessMapLoaded( void ) {
 	}
 
 	// Update current baselines
-	Record_GetCurrentBaselines( &sps->currentBaselines );
+	Record_Spectator_GetBaselines( &sps->currentBaselines );
 
 	for ( i = 0; i < sps->maxSpectators; ++i ) {
 		client_t *cl = &sps->spectators[i].cl;
@@ -934,7 +1209,11 @@ void Record_Spectator_ProcessConfigstring( int index, const char *value ) {
 	}
 
 	// Based on sv_init.c->SV_SetConfigstring
+#ifdef STEF_RECORD_RELAY
+	if ( recordRelay || sv.state == SS_GAME || sv.restarting ) {
+#else
 	if ( sv.state == SS_GAME || sv.restarting ) {
+#endif
 		for ( i = 0; i < sps->maxSpectators; ++i ) {
 			client_t *cl = &sps->spectators[i].cl;
 			if ( cl->state == CS_ACTIVE ) {
@@ -975,6 +1254,27 @@ void Record_Spectator_ProcessServercmd( int clientNum, const char *value ) {
 	}
 }
 
+#ifdef STEF_RECORD_RELAY
+/*
+==================
+Record_Spectator_DropAll
+
+Drops all spectators and frees the spectator system.
+==================
+*/
+void Record_Spectator_DropAll( const char *message ) {
+	int i;
+	if ( !sps ) {
+		return;
+	}
+
+	for ( i = 0; i < sps->maxSpectators; ++i ) {
+		Record_Spectator_DropClient( &sps->spectators[i], message );
+	}
+	Record_Spectator_Shutdown();
+}
+#endif
+
 /*
 ==================
 Record_Spectator_ProcessUsercmd
@@ -35,11 +35,33 @@ typedef struct {
 	record_state_t *rs;
 	char activePlayers[RECORD_MAX_CLIENTS];
 	int lastSnapflags;
+#ifdef STEF_RECORD_ENTITY_TRACKER
+	int entityTrackerFrame;	// tracker frame matching rs->entities, or -1 if none
+#endif
 
 	char *targetDirectory;
 	char *targetFilename;
 
+	// Keyframe and seek index
+	record_keyframe_t keyframe;
+	qboolean haveSnapshot;
+	int firstSnapshotTime;
+	int lastKeyframeTime;
+	record_seek_entry_t *seekIndex;
+	int seekIndexCount;
+	int seekIndexSize;
+	unsigned int fileOffset;	// stream bytes written before current stream buffer
+
+#ifdef STEF_RECORD_CATALOG
+	record_metadata_t *metadata;
+	int lastSnapshotTime;
+#endif
+
+#ifdef STEF_RECORD_ASYNC_WRITER
+	record_file_writer_t *fileWriter;
+#else
 	fileHandle_t recordfile;
+#endif
 	record_data_stream_t stream;
 	char streamBuffer[130000];
 } record_writer_state_t;
@@ -99,7 +121,23 @@ static void Record_UpdateEntityset( record_entityset_t *entities ) {
 		*verify_entities = rws->rs->entities;
 	}
 
+#ifdef STEF_RECORD_ENTITY_TRACKER
+	if ( recordEntityTracker && entities == &recordEntityTracker->entities ) {
+		// If the record state matches the previous tracker update, only the changes
+		// from that update need to be encoded
+		if ( rws->entityTrackerFrame == recordEntityTracker->frame - 1 ) {
+			Record_EncodeEntityChanges( &rws->rs->entities, recordEntityTracker, &rws->stream );
+		} else {
+			Record_EncodeEntityset( &rws->rs->entities, entities, &rws->stream );
+		}
+		rws->entityTrackerFrame = recordEntityTracker->frame;
+	} else {
+		Record_EncodeEntityset( &rws->rs->entities, entities, &rws->stream );
+		rws->entityTrackerFrame = -1;
+	}
+#else
 	Record_EncodeEntityset( &rws->rs->entities, entities, &rws->stream );
+#endif
 
 	if ( sv_recordVerifyData->integer ) {
 		Record_DecodeEntityset( verify_entities, &verify_stream );
@@ -282,6 +320,113 @@ static void Record_UpdateCurrentServercmd( char *value ) {
 // Recording Start/Stop Functions
 /* ******************************************************************************** */
 
+/*
+==================
+Record_WriteData
+==================
+*/
+static void Record_WriteData( const char *data, unsigned int size ) {
+#ifdef STEF_RECORD_RELAY
+	Record_RelayOutput_Write( data, size );
+#endif
+#ifdef STEF_RECORD_ASYNC_WRITER
+	Record_File_Write( rws->fileWriter, data, size );
+#else
+	FS_Write( data, size, rws->recordfile );
+#endif
+	rws->fileOffset += size;
+}
+
+/*
+==================
+Record_FlushStream
+==================
+*/
+static void Record_FlushStream( void ) {
+	Record_WriteData( rws->stream.data, rws->stream.position );
+	rws->stream.position = 0;
+}
+
+/*
+==================
+Record_WriteKeyframe
+
+Keyframe is written as command, server time, payload size, and payload, so readers that
+aren't seeking can skip it.
+==================
+*/
+static void Record_WriteKeyframe( void ) {
+	record_data_stream_t keyframeStream;
+
+	rws->lastKeyframeTime = sv.time;
+	Com_Memset( &keyframeStream, 0, sizeof( keyframeStream ) );
+	keyframeStream.data = (char *)Record_Calloc( RECORD_KEYFRAME_BUFFER_SIZE );
+	keyframeStream.size = RECORD_KEYFRAME_BUFFER_SIZE;
+#ifdef STEF_RECORD_FIELD_ENCODING
+	keyframeStream.fieldEncoding = rws->stream.fieldEncoding;
+#endif
+	keyframeStream.abortSet = qtrue;
+	if ( setjmp( keyframeStream.abort ) ) {
+		Record_Printf( RP_ALL, "Record_WriteKeyframe: failed to encode keyframe\n" );
+		Record_Free( keyframeStream.data );
+		return;
+	}
+
+	Com_Memcpy( rws->keyframe.activeClients, rws->activePlayers, sizeof( rws->keyframe.activeClients ) );
+	Record_EncodeKeyframe( rws->rs, &rws->keyframe, &keyframeStream );
+	keyframeStream.abortSet = qfalse;
+
+	if ( rws->seekIndexCount >= rws->seekIndexSize ) {
+		record_seek_entry_t *oldIndex = rws->seekIndex;
+		rws->seekIndexSize = rws->seekIndexSize ? rws->seekIndexSize * 2 : 256;
+		rws->seekIndex = (record_seek_entry_t *)Record_Calloc( sizeof( *rws->seekIndex ) * rws->seekIndexSize );
+		if ( oldIndex ) {
+			Com_Memcpy( rws->seekIndex, oldIndex, sizeof( *rws->seekIndex ) * rws->seekIndexCount );
+			Record_Free( oldIndex );
+		}
+	}
+	rws->seekIndex[rws->seekIndexCount].offset = rws->fileOffset + rws->stream.position;
+	rws->seekIndex[rws->seekIndexCount].time = sv.time;
+	++rws->seekIndexCount;
+
+	Record_Stream_WriteValue( RC_STATE_KEYFRAME, 1, &rws->stream );
+	Record_Stream_WriteValue( sv.time, 4, &rws->stream );
+	Record_Stream_WriteValue( keyframeStream.position, 4, &rws->stream );
+	Record_FlushStream();
+	Record_WriteData( keyframeStream.data, keyframeStream.position );
+
+	Record_Free( keyframeStream.data );
+}
+
+/*
+==================
+Record_WriteSeekIndex
+
+Index is written at the end of the file, and ends with the offset of the index command
+followed by RECORD_SEEK_INDEX_MAGIC so it can be located from the end of the file.
+==================
+*/
+static void Record_WriteSeekIndex( void ) {
+	unsigned int indexOffset;
+	int i;
+
+	Record_FlushStream();
+	indexOffset = rws->fileOffset;
+
+	Record_Stream_WriteValue( RC_SEEK_INDEX, 1, &rws->stream );
+	Record_Stream_WriteValue( rws->firstSnapshotTime, 4, &rws->stream );
+	Record_Stream_WriteValue( rws->seekIndexCount, 4, &rws->stream );
+	for ( i = 0; i < rws->seekIndexCount; ++i ) {
+		Record_Stream_WriteValue( rws->seekIndex[i].offset, 4, &rws->stream );
+		Record_Stream_WriteValue( rws->seekIndex[i].time, 4, &rws->stream );
+		if ( rws->stream.size - rws->stream.position < 16 ) {
+			Record_FlushStream();
+		}
+	}
+	Record_Stream_WriteValue( indexOffset, 4, &rws->stream );
+	Record_Stream_WriteValue( RECORD_SEEK_INDEX_MAGIC, 4, &rws->stream );
+}
+
 /*
 ==================
 Record_DeallocateRecordWriter
@@ -300,6 +445,14 @@ static void Record_DeallocateRecordWriter( void ) {
 	if ( rws->targetFilename ) {
 		Z_Free( rws->targetFilename );
 	}
+	if ( rws->seekIndex ) {
+		Record_Free( rws->seekIndex );
+	}
+#ifdef STEF_RECORD_CATALOG
+	if ( rws->metadata ) {
+		Record_Metadata_Free( rws->metadata );
+	}
+#endif
 	Record_Free( rws );
 	rws = 0;
 }
@@ -317,12 +470,32 @@ static void Record_CloseRecordWriter( void ) {
 	}
 
 	// Flush stream to file and close temp file
-	Record_Stream_DumpToFile( &rws->stream, rws->recordfile );
+	Record_WriteSeekIndex();
+	Record_FlushStream();
+#ifdef STEF_RECORD_ASYNC_WRITER
+	// Waits for writer thread to finish, so the file is complete before renaming
+	Record_File_CloseWriter( rws->fileWriter );
+#else
 	FS_FCloseFile( rws->recordfile );
+#endif
 
 	// Attempt to move the temp file to final destination
 	FS_SV_Rename( "records/current.rec", va( "records/%s/%s.rec", rws->targetDirectory, rws->targetFilename ) );
 
+#ifdef STEF_RECORD_CATALOG
+	// Write metadata file alongside the record file, for record_catalog
+	{
+		int i;
+		for ( i = 0; i < rws->rs->maxClients; ++i ) {
+			if ( rws->activePlayers[i] ) {
+				Record_Metadata_EndPlayer( rws->metadata, i, &rws->rs->clients[i].playerstate );
+			}
+		}
+		Record_Metadata_Write( rws->metadata, va( "records/%s/%s.meta", rws->targetDirectory, rws->targetFilename ),
+				rws->haveSnapshot ? rws->lastSnapshotTime - rws->firstSnapshotTime : 0 );
+	}
+#endif
+
 	Record_DeallocateRecordWriter();
 }
 
@@ -372,8 +545,13 @@ static void Record_InitializeRecordWriter( int maxClients, qboolean autoStarted
 	}
 
 	// Open the temp output file
+#ifdef STEF_RECORD_ASYNC_WRITER
+	rws->fileWriter = Record_File_OpenWriter( "records/current.rec", sv_recordCompress->integer ? qtrue : qfalse );
+	if ( !rws->fileWriter ) {
+#else
 	rws->recordfile = FS_SV_FOpenFileWrite( "records/current.rec" );
 	if ( !rws->recordfile ) {
+#endif
 		Record_Printf( RP_ALL, "Record_InitializeRecordWriter: failed to open output file\n" );
 		Record_DeallocateRecordWriter();
 		return;
@@ -382,11 +560,20 @@ static void Record_InitializeRecordWriter( int maxClients, qboolean autoStarted
 	// Set up the stream
 	rws->stream.data = rws->streamBuffer;
 	rws->stream.size = sizeof( rws->streamBuffer );
+#ifdef STEF_RECORD_FIELD_ENCODING
+	rws->stream.fieldEncoding = qtrue;
+#endif
 
 	// Set up the record state
 	rws->rs = Record_AllocateState( maxClients );
 	rws->autoStarted = autoStarted;
 	rws->lastSnapflags = svs.snapFlagServerBit;
+#ifdef STEF_RECORD_ENTITY_TRACKER
+	rws->entityTrackerFrame = -1;
+#endif
+#ifdef STEF_RECORD_CATALOG
+	rws->metadata = Record_Metadata_Create();
+#endif
 }
 
 /*
@@ -399,6 +586,10 @@ static void Record_WriteClientEnterWorld( int clientNum ) {
 		return;
 	}
 	rws->activePlayers[clientNum] = 1;
+	++rws->keyframe.instanceCounts[clientNum];
+#ifdef STEF_RECORD_CATALOG
+	Record_Metadata_AddPlayer( rws->metadata, clientNum );
+#endif
 	Record_Stream_WriteValue( RC_EVENT_CLIENT_ENTER_WORLD, 1, &rws->stream );
 	Record_Stream_WriteValue( clientNum, 1, &rws->stream );
 }
@@ -413,6 +604,9 @@ static void Record_WriteClientDisconnect( int clientNum ) {
 		return;
 	}
 	rws->activePlayers[clientNum] = 0;
+#ifdef STEF_RECORD_CATALOG
+	Record_Metadata_EndPlayer( rws->metadata, clientNum, &rws->rs->clients[clientNum].playerstate );
+#endif
 	Record_Stream_WriteValue( RC_EVENT_CLIENT_DISCONNECT, 1, &rws->stream );
 	Record_Stream_WriteValue( clientNum, 1, &rws->stream );
 }
@@ -461,17 +655,13 @@ static void Record_StartWriter( int maxClients, qboolean autoStarted ) {
 		return;
 	}
 
-	// Write the protocol
-#ifdef ELITEFORCE
-	Record_Stream_WriteValue( RECORD_PROTOCOL, 4, &rws->stream );
-#else
-	Record_Stream_WriteValue( sizeof( RECORD_PROTOCOL ) - 1, 4, &rws->stream ); // version length
-	Record_Stream_Write( RECORD_PROTOCOL, sizeof( RECORD_PROTOCOL ) - 1, &rws->stream ); // version value
-	Record_Stream_WriteValue( 0, 4, &rws->stream ); // aux info length (zero)
+#ifdef STEF_RECORD_RELAY
+	// Relay connections need a new start block from the new record state
+	Record_RelayOutput_Restart();
 #endif
 
-	// Write max clients
-	Record_Stream_WriteValue( maxClients, 4, &rws->stream );
+	// Write the protocol and max clients
+	Record_EncodeStreamHeader( maxClients, &rws->stream );
 
 	// Write the configstrings
 	for ( i = 0; i < MAX_CONFIGSTRINGS; ++i ) {
@@ -486,14 +676,11 @@ static void Record_StartWriter( int maxClients, qboolean autoStarted ) {
 	}
 
 	// Write the baselines
-	{
-		record_entityset_t baselines;
-		Record_GetCurrentBaselines( &baselines );
-		Record_UpdateEntityset( &baselines );
-	}
+	Record_GetCurrentBaselines( &rws->keyframe.baselines );
+	Record_UpdateEntityset( &rws->keyframe.baselines );
 	Record_Stream_WriteValue( RC_EVENT_BASELINES, 1, &rws->stream );
 
-	Record_Stream_DumpToFile( &rws->stream, rws->recordfile );
+	Record_FlushStream();
 
 	Record_Printf( RP_ALL, "Recording to %s/%s.rec\n", rws->targetDirectory, rws->targetFilename );
 	Logging_Printf( LP_INFO, "SV_NOTIFY_RECORD", "Recording to %s/%s.rec", rws->targetDirectory, rws->targetFilename );
@@ -654,11 +841,15 @@ void Record_Writer_ProcessSnapshot( void ) {
 	}
 	rws->lastSnapflags = svs.snapFlagServerBit;
 
+#ifdef STEF_RECORD_ENTITY_TRACKER
+	Record_UpdateEntityset( &Record_EntityTracker_Get()->entities );
+#else
 	{
 		record_entityset_t entities;
 		Record_GetCurrentEntities( &entities );
 		Record_UpdateEntityset( &entities );
 	}
+#endif
 
 	{
 		int i;
@@ -674,10 +865,34 @@ void Record_Writer_ProcessSnapshot( void ) {
 		}
 	}
 
+	// Write keyframe preceding the snapshot event, if due
+	{
+		qboolean keyframeDue = qfalse;
+		if ( !rws->haveSnapshot ) {
+			rws->haveSnapshot = qtrue;
+			rws->firstSnapshotTime = sv.time;
+			keyframeDue = qtrue;
+		} else if ( sv.time - rws->lastKeyframeTime >= sv_recordKeyframeInterval->integer * 1000 ) {
+			keyframeDue = qtrue;
+		}
+		if ( keyframeDue && sv_recordKeyframeInterval->integer > 0 ) {
+			Record_WriteKeyframe();
+		}
+	}
+
 	Record_Stream_WriteValue( RC_EVENT_SNAPSHOT, 1, &rws->stream );
 	Record_Stream_WriteValue( sv.time, 4, &rws->stream );
+#ifdef STEF_RECORD_CATALOG
+	rws->lastSnapshotTime = sv.time;
+#endif
 
-	Record_Stream_DumpToFile( &rws->stream, rws->recordfile );
+	Record_FlushStream();
+
+#ifdef STEF_RECORD_RELAY
+	// Send the data for this snapshot to relay connections as one block
+	Com_Memcpy( rws->keyframe.activeClients, rws->activePlayers, sizeof( rws->keyframe.activeClients ) );
+	Record_RelayOutput_EndBlock( sv.time, rws->rs, &rws->keyframe );
+#endif
 }
 
 #endif
@@ -43,6 +43,32 @@
 // parameters triggering Quake3e validation error.
 #define STEF_VM_BOUNDS_FIXES
 
+// [TWEAK] Read pk3 central directories on multiple threads when refreshing the filesystem
+// index, enabled by fs_index_threads cvar. Files are still registered in directory order,
+// so the resulting index is identical.
+#if defined( NEW_FILESYSTEM )
+#define STEF_FS_PARALLEL_INDEX
+#endif
+
+// [TWEAK] Support reading pk3 files through memory mappings, enabled by fs_pk3_mmap cvar.
+// Uncompressed files opened through cache read handles are accessed directly in the mapping.
+#if defined( NEW_FILESYSTEM )
+#define STEF_FS_PK3_MMAP
+#endif
+
+// [TWEAK] Track changes to source directories with inotify, enabled by fs_watch cvar. Auto
+// refreshes only reindex changed paths, and are skipped entirely if nothing has changed.
+#if defined( NEW_FILESYSTEM ) && defined( __linux__ )
+#define STEF_FS_INOTIFY_REFRESH
+#endif
+
+// [TWEAK] Map fscache.dat copy-on-write and use the index data in place instead of copying it
+// at startup, so server processes on the same host share unmodified pages. Not used on Windows
+// because a mapped file can't be replaced when the cache is rewritten.
+#if defined( NEW_FILESYSTEM ) && !defined( _WIN32 )
+#define STEF_FS_MMAP_INDEX_CACHE
+#endif
+
 /* ******************************************************************************** */
 // Client
 /* ******************************************************************************** */
@@ -62,6 +88,15 @@
 #define STEF_CLIENT_ALT_SWAP_SUPPORT
 #endif
 
+// [TWEAK] Encode and decode huffman message values a whole code at a time instead of
+// bit by bit. Output is identical. Includes "huffman_benchmark" command to compare
+// performance against the bitwise version.
+#define STEF_HUFFMAN_WHOLE_CODES
+
+// [TWEAK] Detect changed fields for entity and playerstate deltas with a single
+// vectorized comparison pass. Output is identical.
+#define STEF_MSG_FIELD_MASK
+
 // [BUGFIX] Ignore pk3 download 'pak signature' check, because it blocks some valid EF pk3s.
 #define STEF_IGNORE_PAK_SIGNATURE
 
@@ -87,12 +122,104 @@
 // engine) for alt swapping, this handler is the preferred and most reliable method.
 #define STEF_SERVER_ALT_SWAP_SUPPORT
 
+// [TWEAK] Use epoll and recvmmsg to wait for and receive packets in batches on Linux,
+// enabled by net_batchedReceive cvar.
+#if defined( __linux__ )
+#define STEF_NET_BATCHED_RECEIVE
+#endif
+
+// [TWEAK] Collect packets sent during the server frame and send them with sendmmsg
+// on Linux, enabled by net_batchedSend cvar.
+#if defined( __linux__ )
+#define STEF_NET_BATCHED_SEND
+#endif
+
+// [FEATURE] Support building client snapshots on multiple threads, enabled by
+// sv_snapshotThreads cvar. Messages are still sent in client order and are identical
+// to the single threaded output.
+#define STEF_SNAPSHOT_THREADS
+
+// [TWEAK] Share encoded entity deltas between clients that send the same entity update
+// within a snapshot frame, enabled by sv_snapshotEntityCache cvar.
+#define STEF_SNAPSHOT_ENTITY_CACHE
+
+// [TWEAK] Index linked entities by PVS cluster and area when building the common
+// snapshot, so client visibility checks only need to examine candidate entities.
+#define STEF_SNAPSHOT_VIS_INDEX
+
+// [TWEAK] Cache each client's snapshot visibility for the current frame, so server-side
+// recording reuses the result from snapshot building instead of recalculating the PVS.
+#define STEF_SNAPSHOT_VIS_CACHE
+
+// [TWEAK] Cache formatted getstatus and getinfo responses and only rebuild them when
+// server info or player status changes. Responses are identical.
+#define STEF_STATUS_CACHE
+
+// [FEATURE] Microsecond timing of server frame phases, available through "sv_perf"
+// command and Lua interface.
+#define STEF_SV_PERF
+
 // [TWEAK] Disable auto-running or saving config files in dedicated server build.
 // Only settings manually specified using e.g. exec on command line are loaded.
 #if defined( DEDICATED )
 #define STEF_NO_DEDICATED_SERVER_AUTO_SETTINGS
 #endif
 
+// [TWEAK] Write server-side record files on a background thread, compressing them in
+// blocks when sv_recordCompress is enabled. If the write queue fills up the server waits
+// for it rather than dropping record data.
+#if defined( STEF_SERVER_RECORD )
+#define STEF_RECORD_ASYNC_WRITER
+#endif
+
+// [TWEAK] Read server-side record files through a bounded window that is refilled from
+// disk as the stream advances, instead of loading the whole file into memory. Record_scan
+// also accepts a directory and scans each record file in it sequentially.
+#if defined( STEF_SERVER_RECORD )
+#define STEF_RECORD_STREAMING_READER
+#endif
+
+// [FEATURE] Support "record_convert_all" command to export a demo for every client session
+// in a record file with a single decoding pass. Snapshot encoding for different clients
+// can be spread across threads with sv_recordConvertThreads cvar.
+#if defined( STEF_SERVER_RECORD )
+#define STEF_RECORD_CONVERT_ALL
+#endif
+
+// [FEATURE] Write a metadata file alongside each completed server-side record file, and
+// support "record_catalog" command to search them through an incrementally updated index.
+#if defined( STEF_SERVER_RECORD )
+#define STEF_RECORD_CATALOG
+#endif
+
+// [TWEAK] Track entity changes once per frame for the record writer and admin spectators,
+// using entity link/unlink notifications, instead of copying and comparing the full entity
+// set separately for each. Record output is identical.
+#if defined( STEF_SERVER_RECORD )
+#define STEF_RECORD_ENTITY_TRACKER
+#endif
+
+// [TWEAK] Encode the snapshot content once per frame for admin spectators following the
+// same player from the same delta frame, and copy the encoded bits into each message.
+#if defined( STEF_SERVER_RECORD )
+#define STEF_RECORD_SPECTATOR_CACHE
+#endif
+
+// [FEATURE] Write server-side record files in protocol 8, which encodes each changed
+// structure field as a varint xor or zigzag delta, using whole number deltas for float
+// fields where lossless. Older files are still readable and can be rewritten with
+// "record_upgrade". Includes "record_benchmark" command to compare the encodings.
+#if defined( STEF_SERVER_RECORD )
+#define STEF_RECORD_FIELD_ENCODING
+#endif
+
+// [FEATURE] Support serving admin spectators from a separate relay process, which reads
+// the live record stream from the game server through a UNIX socket with an optional
+// broadcast delay. Relays forward the stream, so they can be chained.
+#if defined( STEF_SERVER_RECORD ) && !defined( _WIN32 )
+#define STEF_RECORD_RELAY
+#endif
+
 // [TWEAK] Support minimium snaps value. This prevents older clients with low snaps
 // defaults from having impaired connections on servers with higher sv_fps settings.
 #define STEF_MIN_SNAPS
@@ -184,6 +311,12 @@
 // [COMMON] Support basic log print functions even if STEF_LOGGING_SYSTEM is disabled.
 #define STEF_LOGGING_CORE
 
+// [COMMON] Threading primitives and worker pool.
+#if defined( STEF_SNAPSHOT_THREADS ) || defined( STEF_RECORD_ASYNC_WRITER ) || defined( STEF_RECORD_CONVERT_ALL ) || \
+		defined( STEF_FS_PARALLEL_INDEX )
+#define STEF_THREADS
+#endif
+
 /* ******************************************************************************** */
 // Misc
 /* ******************************************************************************** */
@@ -38,3 +38,23 @@ CVAR_DEF( sv_maxModelLength, "48", 0 )
 #ifdef STEF_SV_PINGFIX
 CVAR_DEF( sv_pingFix, "1", 0 )
 #endif
+
+#ifdef STEF_NET_BATCHED_RECEIVE
+// Use epoll and recvmmsg for receiving packets.
+CVAR_DEF( net_batchedReceive, "1", 0 )
+#endif
+
+#ifdef STEF_NET_BATCHED_SEND
+// Use sendmmsg for packets sent during the server frame.
+CVAR_DEF( net_batchedSend, "1", 0 )
+#endif
+
+#ifdef STEF_SNAPSHOT_ENTITY_CACHE
+// Share encoded entity deltas between clients within each snapshot frame.
+CVAR_DEF( sv_snapshotEntityCache, "1", 0 )
+#endif
+
+#ifdef STEF_SNAPSHOT_THREADS
+// Number of threads used to build client snapshots. Values of 1 or less build on main thread only.
+CVAR_DEF( sv_snapshotThreads, "0", 0 )
+#endif
@@ -46,6 +46,77 @@ void ClientAltSwap_ModifyCommand( usercmd_t *cmd );
 void ClientAltSwap_SetState( qboolean swap );
 #endif
 
+#ifdef STEF_NET_BATCHED_SEND
+void Sys_BeginPacketBatch( void );
+void Sys_FlushPacketBatch( void );
+#endif
+
+#if defined( STEF_SNAPSHOT_ENTITY_CACHE ) || defined( STEF_RECORD_SPECTATOR_CACHE )
+void MSG_WriteBitStream( msg_t *msg, const byte *data, int bits );
+#endif
+
+#ifdef STEF_HUFFMAN_WHOLE_CODES
+int HuffmanPutValue( byte* fout, uint32_t offset, uint32_t value, int bits );
+uint32_t HuffmanGetValue( const byte* buffer, int bitIndex, int bits, int* bitsRead );
+void Huffman_Benchmark_f( void );
+#endif
+
+#ifdef STEF_SNAPSHOT_VIS_INDEX
+int CM_NumAreas( void );
+#endif
+
+#ifdef STEF_THREADS
+#define STEF_JOBS_MAX_THREADS 16
+
+typedef struct stef_thread_s stef_thread_t;
+typedef struct stef_mutex_s stef_mutex_t;
+typedef struct stef_cond_s stef_cond_t;
+
+stef_thread_t *Stef_Thread_Create( void ( *func )( void *arg ), void *arg );
+void Stef_Thread_Join( stef_thread_t *thread );
+stef_mutex_t *Stef_Mutex_Create( void );
+void Stef_Mutex_Destroy( stef_mutex_t *mutex );
+void Stef_Mutex_Lock( stef_mutex_t *mutex );
+void Stef_Mutex_Unlock( stef_mutex_t *mutex );
+stef_cond_t *Stef_Cond_Create( void );
+void Stef_Cond_Destroy( stef_cond_t *cond );
+void Stef_Cond_Wait( stef_cond_t *cond, stef_mutex_t *mutex );
+void Stef_Cond_Signal( stef_cond_t *cond );
+void Stef_Cond_Broadcast( stef_cond_t *cond );
+void Stef_Jobs_Run( int count, void ( *func )( int index, void *context ), void *context, int maxThreads );
+#endif
+
+#ifdef STEF_SV_PERF
+typedef enum {
+	SV_PERF_FRAME,
+	SV_PERF_GAME,
+	SV_PERF_BOTS,
+	SV_PERF_PINGS,
+	SV_PERF_SNAPSHOT_BUILD,
+	SV_PERF_SNAPSHOT_ENCODE,
+	SV_PERF_TRANSMIT,
+	SV_PERF_RECORD,
+	SV_PERF_LUA,
+	SV_PERF_NUM_PHASES
+} svPerfPhase_t;
+
+typedef struct {
+	const char *name;
+	unsigned int last;
+	unsigned int p50;
+	unsigned int p99;
+	unsigned int max;
+} svPerfStats_t;
+
+void SV_Perf_Begin( svPerfPhase_t phase );
+void SV_Perf_End( svPerfPhase_t phase );
+void SV_Perf_BeginFrame( void );
+void SV_Perf_CommitFrame( void );
+qboolean SV_Perf_GetStats( svPerfPhase_t phase, svPerfStats_t *stats );
+void SV_Perf_GetFrameInfo( int *windowFrames, int *overruns, int *budget );
+void SV_Perf_Init( void );
+#endif
+
 #ifdef STEF_SUPPORT_STATUS_SCORES_OVERRIDE
 void SV_StatusScoresOverride_Reset( void );
 int SV_StatusScoresOverride_AdjustScore( int defaultScore, int clientNum );
@@ -714,7 +714,15 @@ On error, stack will be restored to state before Stef_Lua_InitEventCall.
 =================
 */
 qboolean Stef_Lua_RunEventCall( void ) {
+#ifdef STEF_SV_PERF
+	int result;
+	SV_Perf_Begin( SV_PERF_LUA );
+	result = lua_pcall( stef_lua_state, 1, 1, 0 );
+	SV_Perf_End( SV_PERF_LUA );
+	if ( result == LUA_OK ) {
+#else
 	if ( lua_pcall( stef_lua_state, 1, 1, 0 ) == LUA_OK ) {
+#endif
 		if ( lua_toboolean( stef_lua_state, -1 ) ) {
 			lua_pop( stef_lua_state, 1 );	// return parameter
 			return qtrue;
@@ -0,0 +1,390 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+Copyright (C) 2017-2023 Noah Metzger (chomenor@gmail.com)
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+
+// Minimal threading primitives and a persistent worker pool.
+// Code run on worker threads must not call engine functions that are not thread safe,
+// which includes Com_Printf, Com_Error, Z_Malloc, cvar and filesystem access.
+
+#ifdef STEF_THREADS
+#include "../qcommon/q_shared.h"
+#include "../qcommon/qcommon.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+struct stef_thread_s {
+#ifdef _WIN32
+	HANDLE handle;
+#else
+	pthread_t handle;
+#endif
+	void ( *func )( void *arg );
+	void *arg;
+};
+
+struct stef_mutex_s {
+#ifdef _WIN32
+	CRITICAL_SECTION cs;
+#else
+	pthread_mutex_t mutex;
+#endif
+};
+
+struct stef_cond_s {
+#ifdef _WIN32
+	CONDITION_VARIABLE cv;
+#else
+	pthread_cond_t cond;
+#endif
+};
+
+/* ******************************************************************************** */
+// Threads
+/* ******************************************************************************** */
+
+#ifdef _WIN32
+static DWORD WINAPI Stef_Thread_Entry( LPVOID param ) {
+	stef_thread_t *thread = (stef_thread_t *)param;
+	thread->func( thread->arg );
+	return 0;
+}
+#else
+static void *Stef_Thread_Entry( void *param ) {
+	stef_thread_t *thread = (stef_thread_t *)param;
+	thread->func( thread->arg );
+	return NULL;
+}
+#endif
+
+/*
+==================
+Stef_Thread_Create
+
+Returns NULL on error.
+==================
+*/
+stef_thread_t *Stef_Thread_Create( void ( *func )( void *arg ), void *arg ) {
+	stef_thread_t *thread = (stef_thread_t *)calloc( 1, sizeof( *thread ) );
+	if ( !thread ) {
+		return NULL;
+	}
+	thread->func = func;
+	thread->arg = arg;
+
+#ifdef _WIN32
+	thread->handle = CreateThread( NULL, 0, Stef_Thread_Entry, thread, 0, NULL );
+	if ( !thread->handle ) {
+		free( thread );
+		return NULL;
+	}
+#else
+	if ( pthread_create( &thread->handle, NULL, Stef_Thread_Entry, thread ) ) {
+		free( thread );
+		return NULL;
+	}
+#endif
+
+	return thread;
+}
+
+/*
+==================
+Stef_Thread_Join
+
+Waits for thread to exit and frees thread object.
+==================
+*/
+void Stef_Thread_Join( stef_thread_t *thread ) {
+#ifdef _WIN32
+	WaitForSingleObject( thread->handle, INFINITE );
+	CloseHandle( thread->handle );
+#else
+	pthread_join( thread->handle, NULL );
+#endif
+	free( thread );
+}
+
+/* ******************************************************************************** */
+// Mutexes
+/* ******************************************************************************** */
+
+/*
+==================
+Stef_Mutex_Create
+==================
+*/
+stef_mutex_t *Stef_Mutex_Create( void ) {
+	stef_mutex_t *mutex = (stef_mutex_t *)calloc( 1, sizeof( *mutex ) );
+	if ( !mutex ) {
+		Com_Error( ERR_FATAL, "Stef_Mutex_Create: failed to allocate mutex" );
+	}
+#ifdef _WIN32
+	InitializeCriticalSection( &mutex->cs );
+#else
+	pthread_mutex_init( &mutex->mutex, NULL );
+#endif
+	return mutex;
+}
+
+/*
+==================
+Stef_Mutex_Destroy
+==================
+*/
+void Stef_Mutex_Destroy( stef_mutex_t *mutex ) {
+#ifdef _WIN32
+	DeleteCriticalSection( &mutex->cs );
+#else
+	pthread_mutex_destroy( &mutex->mutex );
+#endif
+	free( mutex );
+}
+
+/*
+==================
+Stef_Mutex_Lock
+==================
+*/
+void Stef_Mutex_Lock( stef_mutex_t *mutex ) {
+#ifdef _WIN32
+	EnterCriticalSection( &mutex->cs );
+#else
+	pthread_mutex_lock( &mutex->mutex );
+#endif
+}
+
+/*
+==================
+Stef_Mutex_Unlock
+==================
+*/
+void Stef_Mutex_Unlock( stef_mutex_t *mutex ) {
+#ifdef _WIN32
+	LeaveCriticalSection( &mutex->cs );
+#else
+	pthread_mutex_unlock( &mutex->mutex );
+#endif
+}
+
+/* ******************************************************************************** */
+// Condition Variables
+/* ******************************************************************************** */
+
+/*
+==================
+Stef_Cond_Create
+==================
+*/
+stef_cond_t *Stef_Cond_Create( void ) {
+	stef_cond_t *cond = (stef_cond_t *)calloc( 1, sizeof( *cond ) );
+	if ( !cond ) {
+		Com_Error( ERR_FATAL, "Stef_Cond_Create: failed to allocate condition variable" );
+	}
+#ifdef _WIN32
+	InitializeConditionVariable( &cond->cv );
+#else
+	pthread_cond_init( &cond->cond, NULL );
+#endif
+	return cond;
+}
+
+/*
+==================
+Stef_Cond_Destroy
+==================
+*/
+void Stef_Cond_Destroy( stef_cond_t *cond ) {
+#ifndef _WIN32
+	pthread_cond_destroy( &cond->cond );
+#endif
+	free( cond );
+}
+
+/*
+==================
+Stef_Cond_Wait
+
+Mutex must be locked by caller.
+==================
+*/
+void Stef_Cond_Wait( stef_cond_t *cond, stef_mutex_t *mutex ) {
+#ifdef _WIN32
+	SleepConditionVariableCS( &cond->cv, &mutex->cs, INFINITE );
+#else
+	pthread_cond_wait( &cond->cond, &mutex->mutex );
+#endif
+}
+
+/*
+==================
+Stef_Cond_Signal
+==================
+*/
+void Stef_Cond_Signal( stef_cond_t *cond ) {
+#ifdef _WIN32
+	WakeConditionVariable( &cond->cv );
+#else
+	pthread_cond_signal( &cond->cond );
+#endif
+}
+
+/*
+==================
+Stef_Cond_Broadcast
+==================
+*/
+void Stef_Cond_Broadcast( stef_cond_t *cond ) {
+#ifdef _WIN32
+	WakeAllConditionVariable( &cond->cv );
+#else
+	pthread_cond_broadcast( &cond->cond );
+#endif
+}
+
+/* ******************************************************************************** */
+// Job Pool
+/* ******************************************************************************** */
+
+typedef struct {
+	stef_mutex_t *mutex;
+	stef_cond_t *workCond;
+	stef_cond_t *doneCond;
+	stef_thread_t *threads[STEF_JOBS_MAX_THREADS];
+	int threadCount;
+
+	// current batch
+	void ( *func )( int index, void *context );
+	void *context;
+	int count;
+	int next;
+	int remaining;
+	int activeWorkers;
+} stef_jobs_t;
+
+static stef_jobs_t jobs;
+
+/*
+==================
+Stef_Jobs_RunPending
+
+Runs items from the current batch until none are left to start. Mutex must be locked
+by caller, and is unlocked while each item is running.
+==================
+*/
+static void Stef_Jobs_RunPending( void ) {
+	while ( jobs.next < jobs.count ) {
+		int index = jobs.next++;
+		Stef_Mutex_Unlock( jobs.mutex );
+		jobs.func( index, jobs.context );
+		Stef_Mutex_Lock( jobs.mutex );
+		if ( --jobs.remaining == 0 ) {
+			Stef_Cond_Broadcast( jobs.doneCond );
+		}
+	}
+}
+
+/*
+==================
+Stef_Jobs_WorkerThread
+==================
+*/
+static void Stef_Jobs_WorkerThread( void *arg ) {
+	int workerNum = (int)(intptr_t)arg;
+
+	Stef_Mutex_Lock( jobs.mutex );
+	while ( 1 ) {
+		while ( jobs.next >= jobs.count || workerNum >= jobs.activeWorkers ) {
+			Stef_Cond_Wait( jobs.workCond, jobs.mutex );
+		}
+		Stef_Jobs_RunPending();
+	}
+}
+
+/*
+==================
+Stef_Jobs_Run
+
+Calls func once for each index from 0 to count - 1, spread across up to maxThreads
+threads including the calling thread. Returns once all calls have completed.
+Only one batch can run at a time, so this should only be called from the main thread.
+==================
+*/
+void Stef_Jobs_Run( int count, void ( *func )( int index, void *context ), void *context, int maxThreads ) {
+	int i;
+
+	if ( maxThreads > STEF_JOBS_MAX_THREADS + 1 ) {
+		maxThreads = STEF_JOBS_MAX_THREADS + 1;
+	}
+	if ( maxThreads > count ) {
+		maxThreads = count;
+	}
+
+	if ( maxThreads <= 1 ) {
+		for ( i = 0; i < count; ++i ) {
+			func( i, context );
+		}
+		return;
+	}
+
+	if ( !jobs.mutex ) {
+		jobs.mutex = Stef_Mutex_Create();
+		jobs.workCond = Stef_Cond_Create();
+		jobs.doneCond = Stef_Cond_Create();
+	}
+
+	// start additional worker threads if needed
+	while ( jobs.threadCount < maxThreads - 1 ) {
+		stef_thread_t *thread = Stef_Thread_Create( Stef_Jobs_WorkerThread, (void *)(intptr_t)jobs.threadCount );
+		if ( !thread ) {
+			Com_Printf( "WARNING: Stef_Jobs_Run failed to create worker thread\n" );
+			break;
+		}
+		jobs.threads[jobs.threadCount++] = thread;
+	}
+
+	Stef_Mutex_Lock( jobs.mutex );
+	jobs.func = func;
+	jobs.context = context;
+	jobs.count = count;
+	jobs.next = 0;
+	jobs.remaining = count;
+	jobs.activeWorkers = maxThreads - 1;
+	Stef_Cond_Broadcast( jobs.workCond );
+
+	// calling thread participates too
+	Stef_Jobs_RunPending();
+	while ( jobs.remaining > 0 ) {
+		Stef_Cond_Wait( jobs.doneCond, jobs.mutex );
+	}
+
+	jobs.count = 0;
+	jobs.next = 0;
+	jobs.func = NULL;
+	jobs.context = NULL;
+	Stef_Mutex_Unlock( jobs.mutex );
+}
+#endif
@@ -155,6 +155,22 @@ static void FS_ReadCacheDebug_f( void ) {
 	FS_ReadCache_Debug();
 }
 
+/*
+=================
+FS_ReadCacheStats_f
+
+Usage: readcache_stats [reset]
+=================
+*/
+static void FS_ReadCacheStats_f( void ) {
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		FS_ReadCache_ResetStats();
+		Com_Printf( "Read cache stats reset.\n" );
+		return;
+	}
+	FS_ReadCache_PrintStats();
+}
+
 /*
 =================
 FS_IndexCacheWrite_f
@@ -336,6 +352,7 @@ void FS_RegisterCommands( void ) {
 
 	Cmd_AddCommand( "fs_refresh", FS_Refresh_f );
 	Cmd_AddCommand( "readcache_debug", FS_ReadCacheDebug_f );
+	Cmd_AddCommand( "readcache_stats", FS_ReadCacheStats_f );
 	Cmd_AddCommand( "indexcache_write", FS_IndexCacheWrite_f );
 
 	Cmd_AddCommand( "dir", FS_Dir_f );
@@ -406,19 +406,30 @@ qboolean FS_FileExists( const char *file ) {
 
 File read cache
 
+Recently read files are kept in memory up to the budget set by fs_read_cache_megs. Entries are
+kept in least-recently-used order and evicted from the tail when space is needed, skipping any
+entries currently locked by FS_ReadData callers.
+
+Every buffer returned by FS_ReadData is preceded by a cache entry header. Entries that can't
+be placed in the cache (e.g. files too large for the budget) are standalone, and are freed
+as soon as they are unlocked.
+
 ###############################################################################################
 */
 
 typedef struct cache_entry_s {
 	unsigned int size;
 	int lock_count;
-	int stage;
+	qboolean cached;	// qfalse for standalone entries
 
 	const fsc_file_t *file;
 	unsigned int file_size;
 	unsigned int file_timestamp;
 
-	struct cache_entry_s *next_position;
+	// Most recently used first
+	struct cache_entry_s *lru_next;
+	struct cache_entry_s *lru_prev;
+
 	unsigned int lookup_hash;
 	struct cache_entry_s *next_lookup;
 	struct cache_entry_s *prev_lookup;
@@ -431,13 +442,36 @@ static cache_entry_t *cache_lookup_table[CACHE_LOOKUP_TABLE_SIZE];
 
 // ***** Cache data store *****
 
-#define CACHE_ENTRY_DATA( cache_entry ) ( (char *)( cache_entry ) + sizeof( cache_entry_t ) )
-#define CACHE_ALIGN( ptr ) ( ( ( uintptr_t )( ptr ) + 15 ) & ~15 )
+#define CACHE_HEADER_SIZE ( ( sizeof( cache_entry_t ) + 15 ) & ~15 )
+#define CACHE_ENTRY_DATA( cache_entry ) ( (char *)( cache_entry ) + CACHE_HEADER_SIZE )
+#define CACHE_DATA_ENTRY( data ) ( (cache_entry_t *)( (char *)( data ) - CACHE_HEADER_SIZE ) )
+
+static unsigned int cache_budget;	// Maximum bytes used by cached entries, including headers
+static unsigned int cache_used;
+static int cache_entry_count;
+static cache_entry_t *lru_head;
+static cache_entry_t *lru_tail;
+
+// ***** Cache statistics *****
 
-int cache_stage = 0;
-int cache_size = 0;
-cache_entry_t *base_entry;
-cache_entry_t *head_entry; // Last entry created. Null if just initialized.
+#define CACHE_STATS_MAX_EXTENSIONS 32
+
+typedef struct {
+	char ext[16];
+	unsigned int hits;
+	unsigned int misses;
+	unsigned int uncached;	// Reads that bypassed the cache due to size or locked entries
+	uint64_t hit_bytes;
+	uint64_t read_bytes;
+} cache_ext_stats_t;
+
+static struct {
+	// Last slot is used for all other extensions once the table is full
+	cache_ext_stats_t ext[CACHE_STATS_MAX_EXTENSIONS];
+	int ext_count;
+	unsigned int evictions;
+	uint64_t evicted_bytes;
+} cache_stats;
 
 /*
 =================
@@ -485,13 +519,56 @@ static void FS_ReadCache_LookupTableDeregister( cache_entry_t *entry ) {
 
 /*
 =================
-FS_ReadCache_LookupTableDeregisterRange
+FS_ReadCache_LruUnlink
+=================
+*/
+static void FS_ReadCache_LruUnlink( cache_entry_t *entry ) {
+	if ( entry->lru_prev ) {
+		entry->lru_prev->lru_next = entry->lru_next;
+	} else {
+		lru_head = entry->lru_next;
+	}
+	if ( entry->lru_next ) {
+		entry->lru_next->lru_prev = entry->lru_prev;
+	} else {
+		lru_tail = entry->lru_prev;
+	}
+	entry->lru_next = entry->lru_prev = NULL;
+}
+
+/*
+=================
+FS_ReadCache_LruPushFront
+=================
+*/
+static void FS_ReadCache_LruPushFront( cache_entry_t *entry ) {
+	entry->lru_prev = NULL;
+	entry->lru_next = lru_head;
+	if ( lru_head ) {
+		lru_head->lru_prev = entry;
+	} else {
+		lru_tail = entry;
+	}
+	lru_head = entry;
+}
+
+/*
+=================
+FS_ReadCache_RemoveEntry
+
+Removes entry from the cache. It is freed immediately if unlocked, otherwise it becomes
+standalone and is freed by FS_FreeData.
 =================
 */
-static void FS_ReadCache_LookupTableDeregisterRange( cache_entry_t *start, cache_entry_t *end ) {
-	while ( start && start != end ) {
-		FS_ReadCache_LookupTableDeregister( start );
-		start = start->next_position;
+static void FS_ReadCache_RemoveEntry( cache_entry_t *entry ) {
+	FSC_ASSERT( entry->cached );
+	FS_ReadCache_LookupTableDeregister( entry );
+	FS_ReadCache_LruUnlink( entry );
+	cache_used -= CACHE_HEADER_SIZE + entry->size;
+	--cache_entry_count;
+	entry->cached = qfalse;
+	if ( !entry->lock_count ) {
+		FSC_Free( entry );
 	}
 }
 
@@ -520,90 +597,92 @@ static qboolean FS_ReadCache_EntryMatchesFile( const fsc_file_t *file, const cac
 /*
 =================
 FS_ReadCache_LookupSearch
+
+Returns cache entry for file, or null if not found. Outdated entries for the same file object
+are dropped.
 =================
 */
 static cache_entry_t *FS_ReadCache_LookupSearch( const fsc_file_t *file ) {
 	cache_entry_t *entry = cache_lookup_table[FS_ReadCache_HashFile( file ) % CACHE_LOOKUP_TABLE_SIZE];
-	cache_entry_t *best_entry = NULL;
 
 	while ( entry ) {
-		if ( ( !best_entry || entry->stage > best_entry->stage ) && FS_ReadCache_EntryMatchesFile( file, entry ) ) {
-			best_entry = entry;
+		cache_entry_t *next = entry->next_lookup;
+		if ( entry->file == file ) {
+			if ( FS_ReadCache_EntryMatchesFile( file, entry ) ) {
+				return entry;
+			}
+			FS_ReadCache_RemoveEntry( entry );
 		}
-		entry = entry->next_lookup;
+		entry = next;
 	}
 
-	return best_entry;
+	return NULL;
 }
 
 /*
 =================
-FS_ReadCache_Allocate
+FS_ReadCache_MakeSpace
+
+Evicts least recently used entries until the requested number of bytes fits in the cache budget.
+Returns qtrue on success, qfalse if not enough unlocked entries could be evicted.
 =================
 */
-static cache_entry_t *FS_ReadCache_Allocate( const fsc_file_t *file, unsigned int size ) {
-	unsigned int required_space = size + sizeof( cache_entry_t );
-	int wrapped_around = 0;
-	cache_entry_t *lead_entry = head_entry; // Entry preceding new entry (can be null)
-	cache_entry_t *limit_entry = lead_entry ? lead_entry->next_position : NULL; // Entry following new entry (can be null)
-	char *start_point, *end_point; // Range of memory available for new entry: [start, end)
-	cache_entry_t *new_entry;
+static qboolean FS_ReadCache_MakeSpace( unsigned int required_space ) {
+	cache_entry_t *entry = lru_tail;
 
-	while ( 1 ) {
-		// Check if we have enough space yet
-		start_point = (char *)CACHE_ALIGN( lead_entry ? (char *)lead_entry + lead_entry->size + sizeof( cache_entry_t ) : (char *)base_entry );
-		end_point = limit_entry ? (char *)limit_entry : (char *)base_entry + cache_size;
-		FSC_ASSERT( end_point >= start_point );
+	if ( required_space > cache_budget ) {
+		return qfalse;
+	}
 
-		if ( end_point - start_point >= required_space ) {
-			break;
-		}
+	while ( cache_used > cache_budget - required_space ) {
+		cache_entry_t *prev;
 
-		// Wraparound check
-		if ( !limit_entry ) {
-			if ( !head_entry || wrapped_around++ ) {
-				return NULL;
-			}
-			lead_entry = NULL;
-			limit_entry = base_entry;
-			continue;
+		// Don't evict locked entries
+		while ( entry && entry->lock_count ) {
+			entry = entry->lru_prev;
 		}
-
-		// Don't advance limit over a locked entry
-		while ( limit_entry && limit_entry->lock_count ) {
-			lead_entry = limit_entry;
-			limit_entry = lead_entry->next_position;
+		if ( !entry ) {
+			return qfalse;
 		}
 
-		// Advance limit
-		if ( limit_entry ) {
-			limit_entry = limit_entry->next_position;
-		}
+		prev = entry->lru_prev;
+		++cache_stats.evictions;
+		cache_stats.evicted_bytes += entry->size;
+		FS_ReadCache_RemoveEntry( entry );
+		entry = prev;
 	}
 
-	// We have space for a new entry
-	new_entry = (cache_entry_t *)start_point;
+	return qtrue;
+}
 
-	// Deregister entries we are overwriting
-	if ( lead_entry ) {
-		FS_ReadCache_LookupTableDeregisterRange( lead_entry->next_position, limit_entry );
-		lead_entry->next_position = new_entry;
-	} else if ( head_entry ) {
-		FS_ReadCache_LookupTableDeregisterRange( base_entry, limit_entry );
-	}
+/*
+=================
+FS_ReadCache_Allocate
 
-	new_entry->next_position = limit_entry;
-	head_entry = new_entry;
+Returns a new entry with space for size bytes of data. If file is set and the entry fits the
+cache budget, it is registered in the cache, otherwise it is a standalone entry.
+=================
+*/
+static cache_entry_t *FS_ReadCache_Allocate( const fsc_file_t *file, unsigned int size ) {
+	cache_entry_t *new_entry = (cache_entry_t *)FSC_Malloc( CACHE_HEADER_SIZE + size );
 
 	new_entry->size = size;
 	new_entry->lock_count = 0;
-	new_entry->stage = cache_stage;
+	new_entry->cached = qfalse;
 	new_entry->file = file;
 	new_entry->file_size = file ? file->filesize : 0;
 	new_entry->file_timestamp = file && file->sourcetype == FSC_SOURCETYPE_DIRECT ? ( (fsc_file_direct_t *)file )->os_timestamp : 0;
+	new_entry->lru_next = new_entry->lru_prev = NULL;
 	new_entry->lookup_hash = FS_ReadCache_HashFile( file );
 
-	FS_ReadCache_LookupTableRegister( new_entry );
+	// Don't use more than 1/3 of the cache for a single file to avoid flushing smaller files
+	if ( file && size < cache_budget / 3 && FS_ReadCache_MakeSpace( CACHE_HEADER_SIZE + size ) ) {
+		new_entry->cached = qtrue;
+		cache_used += CACHE_HEADER_SIZE + size;
+		++cache_entry_count;
+		FS_ReadCache_LookupTableRegister( new_entry );
+		FS_ReadCache_LruPushFront( new_entry );
+	}
 
 	return new_entry;
 }
@@ -630,75 +709,123 @@ void FS_ReadCache_Initialize( void ) {
 		cache_megs = 1024;
 	}
 
-	cache_size = cache_megs << 20;
-	base_entry = (cache_entry_t *)FSC_Malloc( cache_size );
-	head_entry = NULL;
+	cache_budget = (unsigned int)cache_megs << 20;
 }
 
 /*
 =================
-FS_ReadCache_AdvanceStage
+FS_ReadCache_CacheLookup
 
-Causes existing files in cache to be recopied to the front of the cache on reference.
-This may be called between level loads to help with performance. This is only for
-optimization purposes and should not have any functional effects.
+Attempts to locate file in cache. Returns corresponding cache entry if found, null otherwise.
+Found entries are moved to the front of the eviction order.
 =================
 */
-void FS_ReadCache_AdvanceStage( void ) {
-	++cache_stage;
+static cache_entry_t *FS_ReadCache_CacheLookup( const fsc_file_t *file ) {
+	cache_entry_t *entry = FS_ReadCache_LookupSearch( file );
+	if ( !entry ) {
+		return NULL;
+	}
+
+	if ( entry != lru_head ) {
+		FS_ReadCache_LruUnlink( entry );
+		FS_ReadCache_LruPushFront( entry );
+	}
+
+	return entry;
 }
 
 /*
 =================
-FS_ReadCache_CacheLookupStaged
+FS_ReadCache_IsCached
 
-Attempts to locate file in cache. Returns corresponding cache entry if found, null otherwise.
+Returns qtrue if file contents are currently available from the read cache.
+=================
+*/
+qboolean FS_ReadCache_IsCached( const fsc_file_t *file ) {
+	return FS_ReadCache_LookupSearch( file ) ? qtrue : qfalse;
+}
+
+// ***** Cache statistics *****
 
-If file is found in an earlier cache stage, it will be duplicated to the front of the cache
-and the new entry returned instead.
+/*
+=================
+FS_ReadCache_GetExtStats
 =================
 */
-static cache_entry_t *FS_ReadCache_CacheLookupStaged( const fsc_file_t *file ) {
-	cache_entry_t *entry = FS_ReadCache_LookupSearch( file );
-	if ( !entry ) {
-		return NULL;
+static cache_ext_stats_t *FS_ReadCache_GetExtStats( const fsc_file_t *file ) {
+	const char *ext = (const char *)STACKPTR( file->qp_ext_ptr );
+	int i;
+
+	if ( !*ext ) {
+		ext = "<none>";
 	}
 
-	if ( entry->stage != cache_stage ) {
-		cache_entry_t *new_entry;
-		++entry->lock_count;
-		new_entry = FS_ReadCache_Allocate( file, entry->size );
-		--entry->lock_count;
-		if ( new_entry ) {
-			FSC_Memcpy( CACHE_ENTRY_DATA( new_entry ), CACHE_ENTRY_DATA( entry ), entry->size );
-			return new_entry;
+	for ( i = 0; i < cache_stats.ext_count; ++i ) {
+		if ( !Q_stricmp( cache_stats.ext[i].ext, ext ) ) {
+			return &cache_stats.ext[i];
 		}
 	}
 
-	return entry;
-}
+	if ( cache_stats.ext_count >= CACHE_STATS_MAX_EXTENSIONS - 1 ) {
+		cache_ext_stats_t *other = &cache_stats.ext[CACHE_STATS_MAX_EXTENSIONS - 1];
+		if ( !*other->ext ) {
+			Q_strncpyz( other->ext, "<other>", sizeof( other->ext ) );
+		}
+		return other;
+	}
 
-// ***** Cache debugging *****
+	Q_strncpyz( cache_stats.ext[cache_stats.ext_count].ext, ext, sizeof( cache_stats.ext[cache_stats.ext_count].ext ) );
+	return &cache_stats.ext[cache_stats.ext_count++];
+}
 
 /*
 =================
-FS_ReadCache_EntryCountDirect
+FS_ReadCache_PrintStats
 =================
 */
-static int FS_ReadCache_EntryCountDirect( void ) {
-	cache_entry_t *entry = base_entry;
-	int count = 0;
+void FS_ReadCache_PrintStats( void ) {
+	cache_ext_stats_t total;
+	int i;
 
-	if ( !head_entry ) {
-		return 0;
+	Com_Memset( &total, 0, sizeof( total ) );
+
+	Com_Printf( "%-12s %9s %9s %6s %9s %12s %12s\n", "extension", "hits", "misses", "hit%",
+			"uncached", "hit kb", "read kb" );
+	for ( i = 0; i <= cache_stats.ext_count && i < CACHE_STATS_MAX_EXTENSIONS; ++i ) {
+		const cache_ext_stats_t *stats = &cache_stats.ext[i];
+		unsigned int lookups = stats->hits + stats->misses;
+		if ( !*stats->ext ) {
+			continue;
+		}
+		Com_Printf( "%-12s %9u %9u %6.1f %9u %12u %12u\n", stats->ext, stats->hits, stats->misses,
+				lookups ? stats->hits * 100.0 / lookups : 0.0, stats->uncached,
+				(unsigned int)( stats->hit_bytes >> 10 ), (unsigned int)( stats->read_bytes >> 10 ) );
+		total.hits += stats->hits;
+		total.misses += stats->misses;
+		total.uncached += stats->uncached;
+		total.hit_bytes += stats->hit_bytes;
+		total.read_bytes += stats->read_bytes;
 	}
-	do {
-		++count;
-	} while ( ( entry = entry->next_position ) );
+	Com_Printf( "%-12s %9u %9u %6.1f %9u %12u %12u\n", "total", total.hits, total.misses,
+			total.hits + total.misses ? total.hits * 100.0 / ( total.hits + total.misses ) : 0.0,
+			total.uncached, (unsigned int)( total.hit_bytes >> 10 ),
+			(unsigned int)( total.read_bytes >> 10 ) );
 
-	return count;
+	Com_Printf( "\n%i entries using %ukb of %ukb budget\n", cache_entry_count, cache_used >> 10, cache_budget >> 10 );
+	Com_Printf( "%u evictions totaling %ukb\n", cache_stats.evictions, (unsigned int)( cache_stats.evicted_bytes >> 10 ) );
+}
+
+/*
+=================
+FS_ReadCache_ResetStats
+=================
+*/
+void FS_ReadCache_ResetStats( void ) {
+	Com_Memset( &cache_stats, 0, sizeof( cache_stats ) );
 }
 
+// ***** Cache debugging *****
+
 /*
 =================
 FS_ReadCache_EntryCountTable
@@ -724,43 +851,32 @@ static int FS_ReadCache_EntryCountTable( void ) {
 =================
 FS_ReadCache_Debug
 
-Prints information about cache contents to console.
+Prints information about cache contents to console, most recently used first.
 =================
 */
 void FS_ReadCache_Debug( void ) {
-	cache_entry_t *entry = base_entry;
+	cache_entry_t *entry = lru_head;
 	char data[1000];
 	fsc_stream_t stream = FSC_InitStream( data, sizeof( data ) );
 	int index_counter = 0;
 
-	if ( !head_entry ) {
-		return;
-	}
-
 #define ADD_STRING( string ) FSC_StreamAppendString( &stream, string )
 
-	do {
+	while ( entry ) {
 		stream.position = 0;
-		if ( !entry->file ) {
-			ADD_STRING( va( "Null File Index(%i) Position(%i) Size(%i) Stage(%i) Lockcount(%i)",
-							index_counter, (int)( (char *)entry - (char *)base_entry ), entry->size, entry->stage, entry->lock_count ) );
-		} else {
-			ADD_STRING( "File(" );
-			FS_FileToStream( entry->file, &stream, qtrue, qtrue, qtrue, qfalse );
-			ADD_STRING( va( ") Index(%i) Position(%i) Size(%i) Stage(%i) Lockcount(%i)",
-							index_counter, (int)( (char *)entry - (char *)base_entry ), entry->size, entry->stage, entry->lock_count ) );
-		}
-		if ( entry == head_entry ) {
-			ADD_STRING( " <head entry>" );
-		}
+		ADD_STRING( "File(" );
+		FS_FileToStream( entry->file, &stream, qtrue, qtrue, qtrue, qfalse );
+		ADD_STRING( va( ") Index(%i) Size(%i) Lockcount(%i)", index_counter, entry->size, entry->lock_count ) );
 		ADD_STRING( "\n\n" );
 		Com_Printf( "%s", stream.data );
 		++index_counter;
-	} while ( ( entry = entry->next_position ) );
+		entry = entry->lru_next;
+	}
 
 	// These should always be the same
-	Com_Printf( "entry count from direct iteration: %i\n", FS_ReadCache_EntryCountDirect() );
+	Com_Printf( "entry count from lru list: %i\n", index_counter );
 	Com_Printf( "entry count from lookup table: %i\n", FS_ReadCache_EntryCountTable() );
+	Com_Printf( "entry count from counter: %i\n", cache_entry_count );
 }
 
 /*
@@ -814,8 +930,11 @@ char *FS_ReadData( const fsc_file_t *file, const char *path, unsigned int *size_
 
 	// Check if file is already available from cache
 	if ( file ) {
-		cache_entry = FS_ReadCache_CacheLookupStaged( file );
+		cache_entry = FS_ReadCache_CacheLookup( file );
 		if ( cache_entry ) {
+			cache_ext_stats_t *stats = FS_ReadCache_GetExtStats( file );
+			++stats->hits;
+			stats->hit_bytes += cache_entry->size - 1;
 			++cache_entry->lock_count;
 			if ( size_out ) {
 				*size_out = cache_entry->size - 1;
@@ -862,17 +981,10 @@ char *FS_ReadData( const fsc_file_t *file, const char *path, unsigned int *size_
 		goto error;
 	}
 
-	// Obtain buffer from cache or malloc
-	if ( size < cache_size / 3 ) {
-		// Don't use more than 1/3 of the cache for a single file to avoid flushing smaller files
-		cache_entry = FS_ReadCache_Allocate( file, size + 1 );
-	}
-	if ( cache_entry ) {
-		++cache_entry->lock_count;
-		data = CACHE_ENTRY_DATA( cache_entry );
-	} else {
-		data = (char *)FSC_Malloc( size + 1 );
-	}
+	// Obtain buffer, which is placed in the cache if possible
+	cache_entry = FS_ReadCache_Allocate( file, size + 1 );
+	++cache_entry->lock_count;
+	data = CACHE_ENTRY_DATA( cache_entry );
 
 	// Extract data into buffer
 	if ( fsc_file_handle ) {
@@ -888,6 +1000,15 @@ char *FS_ReadData( const fsc_file_t *file, const char *path, unsigned int *size_
 	}
 	data[size] = '\0';
 
+	if ( file ) {
+		cache_ext_stats_t *stats = FS_ReadCache_GetExtStats( file );
+		++stats->misses;
+		if ( !cache_entry->cached ) {
+			++stats->uncached;
+		}
+		stats->read_bytes += size;
+	}
+
 	if ( size_out ) {
 		*size_out = size;
 	}
@@ -902,10 +1023,13 @@ error:
 		FS_DPrintf( "  result: failed to load file\n" );
 	}
 	if ( cache_entry ) {
-		cache_entry->file = NULL;
 		cache_entry->lock_count = 0;
-	} else if ( data )
-		FSC_Free( data );
+		if ( cache_entry->cached ) {
+			FS_ReadCache_RemoveEntry( cache_entry );
+		} else {
+			FSC_Free( cache_entry );
+		}
+	}
 	if ( size_out ) {
 		*size_out = 0;
 	}
@@ -918,15 +1042,15 @@ FS_FreeData
 =================
 */
 void FS_FreeData( char *data ) {
+	cache_entry_t *cache_entry;
 	FSC_ASSERT( data );
-	if ( data >= (char *)base_entry && data < (char *)base_entry + cache_size ) {
-		cache_entry_t *cache_entry = (cache_entry_t *)( data - sizeof( cache_entry_t ) );
-		if ( cache_entry->lock_count <= 0 ) {
-			Com_Error( ERR_DROP, "FS_FreeData on invalid or already freed entry." );
-		}
-		--cache_entry->lock_count;
-	} else {
-		FSC_Free( data );
+	cache_entry = CACHE_DATA_ENTRY( data );
+	if ( cache_entry->lock_count <= 0 ) {
+		Com_Error( ERR_DROP, "FS_FreeData on invalid or already freed entry." );
+	}
+	--cache_entry->lock_count;
+	if ( !cache_entry->cached && !cache_entry->lock_count ) {
+		FSC_Free( cache_entry );
 	}
 }
 
@@ -1271,8 +1395,52 @@ typedef struct {
 	char *data;
 	unsigned int position;
 	unsigned int size;
+#ifdef STEF_FS_PK3_MMAP
+	fsc_pk3handle_t *mapped_handle;		// if set, data points into pk3 mapping instead of read cache
+#endif
 } fs_cache_read_handle_state_t;
 
+#ifdef STEF_FS_PK3_MMAP
+/*
+=================
+FS_CacheReadHandle_OpenMapped
+
+Opens uncompressed pk3 file for direct access from the pk3 mapping. Returns pk3 handle and writes
+data pointer and size on success, or returns null if not available.
+=================
+*/
+static fsc_pk3handle_t *FS_CacheReadHandle_OpenMapped( const fsc_file_t *file, char **data_out, unsigned int *size_out ) {
+	fsc_pk3handle_t *fsc_handle;
+	unsigned int size;
+
+	if ( !fs.cvar.fs_pk3_mmap->integer || file->sourcetype != FSC_SOURCETYPE_PK3 ||
+			( (const fsc_file_frompk3_t *)file )->compression_method != 0 ) {
+		return NULL;
+	}
+
+	fsc_handle = FSC_Pk3HandleOpen( (const fsc_file_frompk3_t *)file, 16384, &fs.index );
+	if ( !fsc_handle ) {
+		return NULL;
+	}
+	*data_out = (char *)FSC_Pk3HandleMappedData( fsc_handle, &size );
+	if ( !*data_out || size != file->filesize ) {
+		FSC_Pk3HandleClose( fsc_handle );
+		return NULL;
+	}
+
+	*size_out = size;
+	FS_RegisterReference( file );
+	if ( fs.cvar.fs_debug_fileio->integer ) {
+		char buffer[FS_FILE_BUFFER_SIZE];
+		FS_FileToBuffer( file, buffer, sizeof( buffer ), qtrue, qtrue, qtrue, qfalse );
+		FS_DPrintf( "********** map file data **********\n" );
+		FS_DPrintf( "  file: %s\n", buffer );
+		FS_DPrintf( "  result: mapped %u bytes from pk3\n", size );
+	}
+	return fsc_handle;
+}
+#endif
+
 /*
 =================
 FS_CacheReadHandle_Open
@@ -1288,6 +1456,9 @@ fileHandle_t FS_CacheReadHandle_Open( const fsc_file_t *file, const char *path,
 	fs_handle_t *handle;
 	unsigned int size;
 	fs_cache_read_handle_state_t *state;
+#ifdef STEF_FS_PK3_MMAP
+	fsc_pk3handle_t *mapped_handle = NULL;
+#endif
 
 	// Get debug path
 	if ( file ) {
@@ -1298,6 +1469,11 @@ fileHandle_t FS_CacheReadHandle_Open( const fsc_file_t *file, const char *path,
 	}
 
 	// Set up handle entry
+#ifdef STEF_FS_PK3_MMAP
+	// Access uncompressed pk3 files directly from the mapping if possible
+	mapped_handle = file ? FS_CacheReadHandle_OpenMapped( file, &data, &size ) : NULL;
+	if ( !mapped_handle )
+#endif
 	data = FS_ReadData( file, path, &size, "FS_CacheReadHandle_Open" );
 	if ( !data ) {
 		if ( size_out ) {
@@ -1310,6 +1486,9 @@ fileHandle_t FS_CacheReadHandle_Open( const fsc_file_t *file, const char *path,
 	state = (fs_cache_read_handle_state_t *)handle->state;
 	state->data = data;
 	state->size = size;
+#ifdef STEF_FS_PK3_MMAP
+	state->mapped_handle = mapped_handle;
+#endif
 
 	if ( size_out ) {
 		*size_out = size;
@@ -1396,6 +1575,12 @@ FS_CacheReadHandle_Free
 */
 static void FS_CacheReadHandle_Free( fs_handle_t *handle ) {
 	fs_cache_read_handle_state_t *state = (fs_cache_read_handle_state_t *)handle->state;
+#ifdef STEF_FS_PK3_MMAP
+	if ( state->mapped_handle ) {
+		FSC_Pk3HandleClose( state->mapped_handle );
+		return;
+	}
+#endif
 	FS_FreeData( state->data );
 }
 
@@ -2003,15 +2188,11 @@ char *FS_Journal_ReadData( void ) {
 		return NULL;
 	}
 
-	// Obtain buffer from cache or malloc
+	// Obtain standalone buffer
 	{
 		cache_entry_t *cache_entry = FS_ReadCache_Allocate( NULL, length + 1 );
-		if ( cache_entry ) {
-			++cache_entry->lock_count;
-			data = CACHE_ENTRY_DATA( cache_entry );
-		} else {
-			data = (char *)FSC_Malloc( length + 1 );
-		}
+		++cache_entry->lock_count;
+		data = CACHE_ENTRY_DATA( cache_entry );
 	}
 
 	// Attempt to read data
@@ -2161,6 +2342,11 @@ static int FS_FOpenFile_ReadHandleOpen( const char *filename, fileHandle_t *hand
 		goto finish;
 	}
 
+	// Pk3 files already in the read cache are served from there
+	if ( allow_direct_handle && fscfile->sourcetype == FSC_SOURCETYPE_PK3 && FS_ReadCache_IsCached( fscfile ) ) {
+		allow_direct_handle = qfalse;
+	}
+
 	// Get the handle and size
 	if ( allow_direct_handle && fscfile->sourcetype == FSC_SOURCETYPE_DIRECT ) {
 		handle = FS_DirectReadHandle_Open( fscfile, NULL, (unsigned int *)&size );
@@ -536,6 +536,17 @@ static void FS_RefreshErrorHandler( fsc_error_level_t level, fsc_error_category_
 	}
 }
 
+#ifdef STEF_FS_PARALLEL_INDEX
+/*
+=================
+FS_IndexJobsHandler
+=================
+*/
+static void FS_IndexJobsHandler( int count, void ( *func )( int index, void *context ), void *context ) {
+	Stef_Jobs_Run( count, func, context, fs.cvar.fs_index_threads->integer );
+}
+#endif
+
 /*
 =================
 FS_IndexDirectory
@@ -544,9 +555,16 @@ FS_IndexDirectory
 static void FS_IndexDirectory( const char *directory, int dir_id, qboolean quiet ) {
 	fsc_stats_t old_active_stats = fs.index.active_stats;
 	fsc_stats_t old_total_stats = fs.index.total_stats;
+	fsc_jobs_handler_t jobs_handler = NULL;
+
+#ifdef STEF_FS_PARALLEL_INDEX
+	if ( fs.cvar.fs_index_threads->integer > 1 ) {
+		jobs_handler = FS_IndexJobsHandler;
+	}
+#endif
 
 	fs_useRefreshErrorHandler = qtrue;
-	FSC_LoadDirectory( &fs.index, directory, dir_id );
+	FSC_LoadDirectory( &fs.index, directory, dir_id, jobs_handler );
 	fs_useRefreshErrorHandler = qfalse;
 
 	#define NON_PK3_FILES( stats ) ( stats.total_file_count - stats.pk3_subfile_count - stats.valid_pk3_count )
@@ -584,7 +602,13 @@ void FS_Refresh( qboolean quiet ) {
 		Com_Printf( "----- FS_Refresh -----\n" );
 	}
 
+#ifdef STEF_FS_INOTIFY_REFRESH
+	FS_Watch_BeginFullRefresh();
+#endif
 	FSC_FilesystemReset( &fs.index );
+#ifdef STEF_FS_PK3_MMAP
+	FSC_Pk3MapReset( fs.cvar.fs_pk3_mmap->integer ? fsc_true : fsc_false );
+#endif
 
 	for ( i = 0; i < FS_MAX_SOURCEDIRS; ++i ) {
 		if ( !fs.sourcedirs[i].active ) {
@@ -604,6 +628,54 @@ void FS_Refresh( qboolean quiet ) {
 	FS_ReadbackTracker_Reset();
 }
 
+#ifdef STEF_FS_INOTIFY_REFRESH
+/*
+=================
+FS_RefreshPaths
+
+Updates file index for specific paths that have changed, without rescanning the rest of the
+source directories. Paths are relative to the corresponding source directory.
+=================
+*/
+void FS_RefreshPaths( const char *const *paths, const int *source_dir_ids, int count ) {
+	const char **dir_paths = (const char **)Z_Malloc( count * sizeof( *dir_paths ) );
+	int i, j;
+
+	if ( fs.cvar.fs_debug_refresh->integer ) {
+		Com_Printf( "----- FS_RefreshPaths -----\n" );
+		for ( i = 0; i < count; ++i ) {
+			Com_Printf( "Changed path: %s/%s\n", fs.sourcedirs[source_dir_ids[i]].name, paths[i] );
+		}
+	}
+
+#ifdef STEF_FS_PK3_MMAP
+	FSC_Pk3MapReset( fs.cvar.fs_pk3_mmap->integer ? fsc_true : fsc_false );
+#endif
+
+	fs_useRefreshErrorHandler = qtrue;
+	for ( i = 0; i < FS_MAX_SOURCEDIRS; ++i ) {
+		int dir_path_count = 0;
+		if ( !fs.sourcedirs[i].active ) {
+			continue;
+		}
+		for ( j = 0; j < count; ++j ) {
+			if ( source_dir_ids[j] == i ) {
+				dir_paths[dir_path_count++] = paths[j];
+			}
+		}
+		if ( dir_path_count ) {
+			FSC_RefreshPaths( &fs.index, fs.sourcedirs[i].path, i, dir_paths, dir_path_count );
+		}
+	}
+	fs_useRefreshErrorHandler = qfalse;
+
+	Z_Free( (void *)dir_paths );
+
+	fs_refresh_frame = com_frameNumber;
+	FS_ReadbackTracker_Reset();
+}
+#endif
+
 /*
 =================
 FS_RecentlyRefreshed
@@ -640,6 +712,11 @@ void FS_AutoRefresh( void ) {
 		}
 		return;
 	}
+#ifdef STEF_FS_INOTIFY_REFRESH
+	if ( FS_Watch_AutoRefresh() ) {
+		return;
+	}
+#endif
 	FS_Refresh( qtrue );
 }
 
@@ -669,9 +746,25 @@ FS_WriteIndexCache
 */
 void FS_WriteIndexCache( void ) {
 	char path[FS_MAX_PATH];
+	char temp_path[FS_MAX_PATH];
 	FS_GetIndexCachePath( path, sizeof( path ) );
-	if ( *path ) {
-		FSC_CacheExportFile( &fs.index, path );
+	if ( !*path ) {
+		return;
+	}
+
+	// The current index may be using the existing cache file in place, so write a new
+	// file and replace the old one rather than overwriting it.
+	Com_sprintf( temp_path, sizeof( temp_path ), "%s.tmp", path );
+	if ( FSC_CacheExportFile( &fs.index, temp_path ) ) {
+		FSC_DeleteFile( temp_path );
+		return;
+	}
+	if ( FSC_RenameFile( temp_path, path ) ) {
+		FSC_DeleteFile( path );
+		if ( FSC_RenameFile( temp_path, path ) ) {
+			Com_Printf( "WARNING: Failed to replace fscache.dat.\n" );
+			FSC_DeleteFile( temp_path );
+		}
 	}
 }
 
@@ -707,10 +800,15 @@ static void FS_InitIndex( void ) {
 
 	if ( fs.cvar.fs_index_cache->integer ) {
 		char path[FS_MAX_PATH];
+#ifdef STEF_FS_MMAP_INDEX_CACHE
+		fsc_boolean map_file = fsc_true;
+#else
+		fsc_boolean map_file = fsc_false;
+#endif
 		FS_GetIndexCachePath( path, sizeof( path ) );
 
 		Com_Printf( "Loading fscache.dat...\n" );
-		if ( *path && !FSC_CacheImportFile( path, &fs.index ) ) {
+		if ( *path && !FSC_CacheImportFile( path, &fs.index, map_file ) ) {
 			cache_loaded = qtrue;
 		} else {
 			Com_Printf( "Failed to load fscache.dat.\n" );
@@ -786,6 +884,22 @@ void FS_Startup( void ) {
 	fs.cvar.fs_full_pure_validation = Cvar_Get( "fs_full_pure_validation", "0", CVAR_ARCHIVE );
 	fs.cvar.fs_download_mode = Cvar_Get( "fs_download_mode", "0", CVAR_ARCHIVE );
 	fs.cvar.fs_auto_refresh_enabled = Cvar_Get( "fs_auto_refresh_enabled", "1", 0 );
+#ifdef STEF_FS_PARALLEL_INDEX
+	fs.cvar.fs_index_threads = Cvar_Get( "fs_index_threads", "4", 0 );
+	Cvar_CheckRange( fs.cvar.fs_index_threads, "0", "17", CV_INTEGER );
+	Cvar_SetDescription( fs.cvar.fs_index_threads, "Number of threads used to read pk3 files when refreshing the filesystem index." );
+#endif
+#ifdef STEF_FS_PK3_MMAP
+	fs.cvar.fs_pk3_mmap = Cvar_Get( "fs_pk3_mmap", "0", 0 );
+	Cvar_CheckRange( fs.cvar.fs_pk3_mmap, "0", "1", CV_INTEGER );
+	Cvar_SetDescription( fs.cvar.fs_pk3_mmap, "Read pk3 files through memory mappings. Changes take effect on the next filesystem refresh.\n"
+			"Pk3 files should not be modified in place while this is enabled." );
+#endif
+#ifdef STEF_FS_INOTIFY_REFRESH
+	fs.cvar.fs_watch = Cvar_Get( "fs_watch", "1", CVAR_INIT );
+	Cvar_CheckRange( fs.cvar.fs_watch, "0", "1", CV_INTEGER );
+	Cvar_SetDescription( fs.cvar.fs_watch, "Track changes to source directories using inotify, so auto refreshes only reindex changed files." );
+#endif
 #ifdef FS_SERVERCFG_ENABLED
 	fs.cvar.fs_servercfg = Cvar_Get( "fs_servercfg", "servercfg", 0 );
 	fs.cvar.fs_servercfg_writedir = Cvar_Get( "fs_servercfg_writedir", "", 0 );
@@ -811,6 +925,9 @@ void FS_Startup( void ) {
 	}
 	Com_Printf( "\n" );
 
+#ifdef STEF_FS_INOTIFY_REFRESH
+	FS_Watch_Init();
+#endif
 	FS_RegisterCommands();
 	fs.initialized = qtrue;
 
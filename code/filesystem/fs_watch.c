@@ -0,0 +1,494 @@
+/*
+===========================================================================
+Copyright (C) 2017 Noah Metzger (chomenor@gmail.com)
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+
+#ifdef NEW_FILESYSTEM
+#include "fslocal.h"
+
+#ifdef STEF_FS_INOTIFY_REFRESH
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <unistd.h>
+
+/*
+###############################################################################################
+
+Filesystem Watch
+
+This section uses inotify to track which paths in the source directories have changed since
+the last refresh, so auto refreshes can update only those paths instead of rescanning every
+source directory. A watch is placed on every directory, since inotify is not recursive.
+
+If the event queue overflows, a watched source directory is moved or deleted, or too many
+paths change at once, the watch state is flagged invalid. Auto refreshes then fall back to
+a full refresh, which also rebuilds the watches.
+
+###############################################################################################
+*/
+
+#define FS_WATCH_MAX_DIRTY 1024
+#define FS_WATCH_MAX_DEPTH 32
+#define FS_WATCH_MASK ( IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | \
+		IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF )
+
+typedef struct {
+	// Path relative to source directory, or empty string for source directory itself
+	// Null if entry is unused
+	char *path;
+	int source_dir_id;
+} fs_watch_dir_t;
+
+typedef struct {
+	char *path;
+	int source_dir_id;
+} fs_watch_dirty_t;
+
+static struct {
+	qboolean enabled;
+	qboolean valid;
+	int fd;
+
+	// Indexed by inotify watch descriptor
+	fs_watch_dir_t *dirs;
+	int dirs_size;
+
+	fs_watch_dirty_t dirty[FS_WATCH_MAX_DIRTY];
+	int dirty_count;
+} fs_watch;
+
+/*
+=================
+FS_Watch_JoinPath
+
+Returns "base/name", or just name if base is empty. Result must be freed by Z_Free.
+=================
+*/
+static char *FS_Watch_JoinPath( const char *base, const char *name ) {
+	char *result;
+	if ( !*base ) {
+		return CopyString( name );
+	}
+	result = (char *)Z_Malloc( strlen( base ) + strlen( name ) + 2 );
+	sprintf( result, "%s/%s", base, name );
+	return result;
+}
+
+/*
+=================
+FS_Watch_Invalidate
+=================
+*/
+static void FS_Watch_Invalidate( const char *reason ) {
+	if ( fs_watch.valid && fs.cvar.fs_debug_refresh->integer ) {
+		Com_Printf( "fs watch invalidated (%s); next auto refresh will be a full refresh.\n", reason );
+	}
+	fs_watch.valid = qfalse;
+}
+
+/*
+=================
+FS_Watch_Disable
+
+Stops watching permanently, for errors that are unlikely to resolve themselves.
+=================
+*/
+static void FS_Watch_Disable( const char *reason ) {
+	Com_Printf( "WARNING: Disabling fs watch: %s\n", reason );
+	fs_watch.enabled = qfalse;
+	fs_watch.valid = qfalse;
+}
+
+/*
+=================
+FS_Watch_ClearDirty
+=================
+*/
+static void FS_Watch_ClearDirty( void ) {
+	int i;
+	for ( i = 0; i < fs_watch.dirty_count; ++i ) {
+		Z_Free( fs_watch.dirty[i].path );
+	}
+	fs_watch.dirty_count = 0;
+}
+
+/*
+=================
+FS_Watch_IsWithin
+
+Returns qtrue if path is equal to or located under base.
+=================
+*/
+static qboolean FS_Watch_IsWithin( const char *path, const char *base ) {
+	size_t length = strlen( base );
+	if ( strncmp( path, base, length ) ) {
+		return qfalse;
+	}
+	return !path[length] || path[length] == '/' ? qtrue : qfalse;
+}
+
+/*
+=================
+FS_Watch_AddDirty
+
+Adds a path to the set of paths needing refresh. Paths already covered by a parent in the set
+are skipped, and existing entries under the new path are removed.
+=================
+*/
+static void FS_Watch_AddDirty( int source_dir_id, const char *path ) {
+	int i;
+
+	for ( i = 0; i < fs_watch.dirty_count; ) {
+		fs_watch_dirty_t *entry = &fs_watch.dirty[i];
+		if ( entry->source_dir_id == source_dir_id ) {
+			if ( FS_Watch_IsWithin( path, entry->path ) ) {
+				return;
+			}
+			if ( FS_Watch_IsWithin( entry->path, path ) ) {
+				Z_Free( entry->path );
+				*entry = fs_watch.dirty[--fs_watch.dirty_count];
+				continue;
+			}
+		}
+		++i;
+	}
+
+	if ( fs_watch.dirty_count >= FS_WATCH_MAX_DIRTY ) {
+		FS_Watch_Invalidate( "too many changed paths" );
+		return;
+	}
+
+	fs_watch.dirty[fs_watch.dirty_count].path = CopyString( path );
+	fs_watch.dirty[fs_watch.dirty_count].source_dir_id = source_dir_id;
+	++fs_watch.dirty_count;
+}
+
+/*
+=================
+FS_Watch_AddDirectory
+
+Adds watches to a directory and all its subdirectories. Set from_event if the directory was
+reported by an event, rather than being added by a full rebuild.
+=================
+*/
+static void FS_Watch_AddDirectory( int source_dir_id, const char *path, int depth, qboolean from_event ) {
+	char os_path[FS_MAX_PATH];
+	DIR *dir;
+	int wd;
+
+	if ( !fs_watch.enabled ) {
+		return;
+	}
+	if ( depth > FS_WATCH_MAX_DEPTH ) {
+		FS_Watch_Invalidate( "directory depth limit exceeded" );
+		return;
+	}
+
+	if ( *path ) {
+		Com_sprintf( os_path, sizeof( os_path ), "%s/%s", fs.sourcedirs[source_dir_id].path, path );
+	} else {
+		Q_strncpyz( os_path, fs.sourcedirs[source_dir_id].path, sizeof( os_path ) );
+	}
+
+	wd = inotify_add_watch( fs_watch.fd, os_path, FS_WATCH_MASK | IN_ONLYDIR );
+	if ( wd < 0 ) {
+		if ( errno == ENOSPC || errno == ENOMEM ) {
+			FS_Watch_Disable( "inotify watch limit reached" );
+		} else {
+			// Most likely the directory was removed or is inaccessible
+			FS_Watch_Invalidate( "failed to add watch" );
+		}
+		return;
+	}
+
+	if ( wd >= fs_watch.dirs_size ) {
+		int new_size = fs_watch.dirs_size ? fs_watch.dirs_size : 64;
+		fs_watch_dir_t *new_dirs;
+		while ( new_size <= wd ) {
+			new_size *= 2;
+		}
+		new_dirs = (fs_watch_dir_t *)Z_Malloc( new_size * sizeof( *new_dirs ) );
+		if ( fs_watch.dirs ) {
+			Com_Memcpy( new_dirs, fs_watch.dirs, fs_watch.dirs_size * sizeof( *new_dirs ) );
+			Z_Free( fs_watch.dirs );
+		}
+		fs_watch.dirs = new_dirs;
+		fs_watch.dirs_size = new_size;
+	}
+
+	if ( fs_watch.dirs[wd].path ) {
+		if ( fs_watch.dirs[wd].source_dir_id != source_dir_id || strcmp( fs_watch.dirs[wd].path, path ) ) {
+			if ( from_event ) {
+				// Directory was moved within the watched tree, leaving stale paths on the
+				// existing watches
+				FS_Watch_Invalidate( "watched directory moved" );
+			} else {
+				// Same directory is reachable through multiple paths (e.g. symlinks or
+				// overlapping source directories). Changes can't be attributed to a single
+				// path, so fall back to full refreshes.
+				FS_Watch_Disable( "directory reachable through multiple paths" );
+			}
+		}
+		return;
+	}
+
+	fs_watch.dirs[wd].path = CopyString( path );
+	fs_watch.dirs[wd].source_dir_id = source_dir_id;
+
+	dir = opendir( os_path );
+	if ( !dir ) {
+		return;
+	}
+
+	while ( 1 ) {
+		struct dirent *entry = readdir( dir );
+		char entry_os_path[FS_MAX_PATH];
+		struct stat st;
+		char *entry_path;
+
+		if ( !entry ) {
+			break;
+		}
+		if ( entry->d_name[0] == '.' && ( !entry->d_name[1] || ( entry->d_name[1] == '.' && !entry->d_name[2] ) ) ) {
+			continue;
+		}
+
+		Com_sprintf( entry_os_path, sizeof( entry_os_path ), "%s/%s", os_path, entry->d_name );
+		if ( stat( entry_os_path, &st ) == -1 || !S_ISDIR( st.st_mode ) ) {
+			continue;
+		}
+
+		entry_path = FS_Watch_JoinPath( path, entry->d_name );
+		FS_Watch_AddDirectory( source_dir_id, entry_path, depth + 1, from_event );
+		Z_Free( entry_path );
+	}
+
+	closedir( dir );
+}
+
+/*
+=================
+FS_Watch_Close
+=================
+*/
+static void FS_Watch_Close( void ) {
+	int i;
+	if ( fs_watch.fd >= 0 ) {
+		close( fs_watch.fd );
+		fs_watch.fd = -1;
+	}
+	for ( i = 0; i < fs_watch.dirs_size; ++i ) {
+		if ( fs_watch.dirs[i].path ) {
+			Z_Free( fs_watch.dirs[i].path );
+		}
+	}
+	if ( fs_watch.dirs ) {
+		Z_Free( fs_watch.dirs );
+	}
+	fs_watch.dirs = NULL;
+	fs_watch.dirs_size = 0;
+	FS_Watch_ClearDirty();
+	fs_watch.valid = qfalse;
+}
+
+/*
+=================
+FS_Watch_Rebuild
+
+Sets up new watches on all active source directories.
+=================
+*/
+static void FS_Watch_Rebuild( void ) {
+	int i;
+
+	FS_Watch_Close();
+
+	fs_watch.fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+	if ( fs_watch.fd < 0 ) {
+		FS_Watch_Disable( "failed to initialize inotify" );
+		return;
+	}
+
+	fs_watch.valid = qtrue;
+	for ( i = 0; i < FS_MAX_SOURCEDIRS; ++i ) {
+		if ( fs.sourcedirs[i].active ) {
+			FS_Watch_AddDirectory( i, "", 0, qfalse );
+		}
+	}
+
+	if ( !fs_watch.enabled ) {
+		FS_Watch_Close();
+	}
+}
+
+/*
+=================
+FS_Watch_ProcessEvent
+=================
+*/
+static void FS_Watch_ProcessEvent( const struct inotify_event *event ) {
+	fs_watch_dir_t *dir;
+	char *path;
+
+	if ( event->mask & IN_Q_OVERFLOW ) {
+		FS_Watch_Invalidate( "event queue overflow" );
+		return;
+	}
+
+	if ( event->wd < 0 || event->wd >= fs_watch.dirs_size || !fs_watch.dirs[event->wd].path ) {
+		return;
+	}
+	dir = &fs_watch.dirs[event->wd];
+
+	if ( event->mask & IN_IGNORED ) {
+		// Watch was removed, typically because the directory was deleted
+		Z_Free( dir->path );
+		dir->path = NULL;
+		return;
+	}
+
+	if ( event->mask & ( IN_DELETE_SELF | IN_MOVE_SELF ) ) {
+		// Deleted subdirectories are handled through the parent directory event, but moved
+		// directories would leave stale paths for all the watches underneath.
+		if ( !*dir->path || ( event->mask & IN_MOVE_SELF ) ) {
+			FS_Watch_Invalidate( "watched directory moved or deleted" );
+		}
+		return;
+	}
+
+	if ( !event->len || !*event->name ) {
+		return;
+	}
+
+	path = FS_Watch_JoinPath( dir->path, event->name );
+	if ( ( event->mask & IN_ISDIR ) && ( event->mask & ( IN_CREATE | IN_MOVED_TO ) ) ) {
+		FS_Watch_AddDirectory( dir->source_dir_id, path, 1, qtrue );
+	}
+	FS_Watch_AddDirty( dir->source_dir_id, path );
+	Z_Free( path );
+}
+
+/*
+=================
+FS_Watch_ProcessEvents
+
+Reads all pending events from the inotify queue.
+=================
+*/
+static void FS_Watch_ProcessEvents( void ) {
+	char buffer[16384] __attribute__( ( aligned( __alignof__( struct inotify_event ) ) ) );
+
+	while ( fs_watch.enabled && fs_watch.fd >= 0 ) {
+		ssize_t length = read( fs_watch.fd, buffer, sizeof( buffer ) );
+		char *position = buffer;
+
+		if ( length <= 0 ) {
+			if ( length < 0 && errno == EINTR ) {
+				continue;
+			}
+			break;
+		}
+
+		while ( position < buffer + length ) {
+			const struct inotify_event *event = (const struct inotify_event *)position;
+			FS_Watch_ProcessEvent( event );
+			position += sizeof( struct inotify_event ) + event->len;
+		}
+	}
+}
+
+/*
+=================
+FS_Watch_Init
+
+Called at the end of filesystem startup, after the initial refresh.
+=================
+*/
+void FS_Watch_Init( void ) {
+	fs_watch.fd = -1;
+	fs_watch.enabled = fs.cvar.fs_watch->integer ? qtrue : qfalse;
+	if ( fs_watch.enabled ) {
+		FS_Watch_Rebuild();
+		if ( fs_watch.enabled ) {
+			Com_Printf( "Watching source directories for changes.\n" );
+		}
+	}
+}
+
+/*
+=================
+FS_Watch_BeginFullRefresh
+
+Called at the start of a full refresh. Discards pending changes since the full refresh will pick
+them up anyway, and rebuilds the watches if they are no longer reliable.
+=================
+*/
+void FS_Watch_BeginFullRefresh( void ) {
+	if ( !fs_watch.enabled ) {
+		return;
+	}
+	FS_Watch_ProcessEvents();
+	FS_Watch_ClearDirty();
+	if ( fs_watch.enabled && !fs_watch.valid ) {
+		FS_Watch_Rebuild();
+	}
+}
+
+/*
+=================
+FS_Watch_AutoRefresh
+
+Updates the index for any paths that changed since the last refresh. Returns qtrue if the index
+is up to date, or qfalse if a full refresh is needed.
+=================
+*/
+qboolean FS_Watch_AutoRefresh( void ) {
+	const char *paths[FS_WATCH_MAX_DIRTY];
+	int source_dir_ids[FS_WATCH_MAX_DIRTY];
+	int i;
+
+	if ( !fs_watch.enabled ) {
+		return qfalse;
+	}
+	FS_Watch_ProcessEvents();
+	if ( !fs_watch.valid ) {
+		return qfalse;
+	}
+
+	if ( !fs_watch.dirty_count ) {
+		if ( fs.cvar.fs_debug_refresh->integer ) {
+			Com_Printf( "Skipping fs auto refresh due to no changed files.\n" );
+		}
+		return qtrue;
+	}
+
+	for ( i = 0; i < fs_watch.dirty_count; ++i ) {
+		paths[i] = fs_watch.dirty[i].path;
+		source_dir_ids[i] = fs_watch.dirty[i].source_dir_id;
+	}
+	FS_RefreshPaths( paths, source_dir_ids, fs_watch.dirty_count );
+	FS_Watch_ClearDirty();
+	return qtrue;
+}
+
+#endif	// STEF_FS_INOTIFY_REFRESH
+#endif	// NEW_FILESYSTEM
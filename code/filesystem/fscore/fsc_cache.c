@@ -447,12 +447,13 @@ static fsc_boolean FSC_CacheExportStream( fsc_filesystem_t *source_fs, fsc_strea
 FSC_CacheImportStream
 
 Imports filesystem from stream. Returns true on error, false on success.
+The general stack uses the stream data in place, so it must remain valid while the filesystem is in use.
 =================
 */
 static fsc_boolean FSC_CacheImportStream( fsc_stream_t *stream, fsc_filesystem_t *target_fs ) {
 	FSC_Memset( target_fs, 0, sizeof( *target_fs ) );
 
-	if( FSC_StackImport( &target_fs->general_stack, stream ) ||
+	if( FSC_StackImportInPlace( &target_fs->general_stack, stream ) ||
 			FSC_HashtableImport( &target_fs->string_repository, &target_fs->general_stack, stream ) ||
 			FSC_HashtableImport( &target_fs->files, &target_fs->general_stack, stream ) ||
 			FSC_HashtableImport( &target_fs->directories, &target_fs->general_stack, stream ) ||
@@ -472,6 +473,10 @@ static fsc_boolean FSC_CacheImportStream( fsc_stream_t *stream, fsc_filesystem_t
 
 #define VERSION_STRING_LENGTH ( sizeof( FSC_CACHE_VERSION ) - 1 )
 
+// Stream data starts at an aligned offset so the stack can be used in place from a file mapping
+#define CACHE_DATA_OFFSET ( ( sizeof( fscache_header_t ) + VERSION_STRING_LENGTH + FSC_STACK_EXPORT_ALIGNMENT - 1 ) \
+		& ~( FSC_STACK_EXPORT_ALIGNMENT - 1 ) )
+
 /*
 =================
 FSC_CacheExportFileRawPath
@@ -504,6 +509,12 @@ fsc_boolean FSC_CacheExportFileRawPath( fsc_filesystem_t *source_fs, fsc_ospath_
 	FSC_FWrite( &header, sizeof( header ), fp );
 	FSC_FWrite( FSC_CACHE_VERSION, VERSION_STRING_LENGTH, fp );
 
+	// Write padding to data offset
+	{
+		static const char zeros[FSC_STACK_EXPORT_ALIGNMENT] = { 0 };
+		FSC_FWrite( zeros, CACHE_DATA_OFFSET - sizeof( header ) - VERSION_STRING_LENGTH, fp );
+	}
+
 	// Write the data
 	FSC_FWrite( stream.data, header.dataSize, fp );
 
@@ -527,62 +538,124 @@ fsc_boolean FSC_CacheExportFile( fsc_filesystem_t *source_fs, const char *path )
 	return result;
 }
 
+/*
+=================
+FSC_CacheReadFileRaw
+
+Reads entire file into memory. Returns buffer on success, null on error.
+=================
+*/
+static char *FSC_CacheReadFileRaw( fsc_ospath_t *os_path, unsigned int *size_out ) {
+	fsc_filehandle_t *fp;
+	unsigned int size;
+	char *buffer;
+
+	fp = FSC_FOpenRaw( os_path, "rb" );
+	if ( !fp ) {
+		return FSC_NULL;
+	}
+
+	FSC_FSeek( fp, 0, FSC_SEEK_END );
+	size = FSC_FTell( fp );
+	FSC_FSeek( fp, 0, FSC_SEEK_SET );
+
+	buffer = (char *)FSC_Malloc( size ? size : 1 );
+	if ( FSC_FRead( buffer, size, fp ) != size ) {
+		FSC_Free( buffer );
+		FSC_FClose( fp );
+		return FSC_NULL;
+	}
+
+	FSC_FClose( fp );
+	*size_out = size;
+	return buffer;
+}
+
 /*
 =================
 FSC_CacheImportFileRawPath
 
 Imports filesystem from file. Returns true on error, false on success.
+
+The stack data is used in place rather than copied. If map_file is set, the file is mapped
+copy-on-write, so pages which are not modified by later refreshes stay shared with other
+processes using the same cache file. Otherwise the file is read into a single buffer. In either
+case the file must not be modified in place while the filesystem is in use; rewrites should
+replace the file instead.
 =================
 */
-fsc_boolean FSC_CacheImportFileRawPath( fsc_ospath_t *os_path, fsc_filesystem_t *target_fs ) {
-	fsc_filehandle_t *fp;
+fsc_boolean FSC_CacheImportFileRawPath( fsc_ospath_t *os_path, fsc_filesystem_t *target_fs, fsc_boolean map_file ) {
+	fsc_filemap_t map;
+	char *buffer = FSC_NULL;
+	const char *data;
+	unsigned int size = 0;
 	fscache_header_t header;
 	fsc_stream_t stream;
-	char versionBuffer[256];
-	FSC_ASSERT( sizeof( versionBuffer ) >= VERSION_STRING_LENGTH );
+	const char *error = FSC_NULL;
 
-	// Open the input file
-	fp = FSC_FOpenRaw( os_path, "rb" );
-	if ( !fp ) {
-		FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_GENERAL, "failed to open input file", FSC_NULL );
-		return fsc_true;
+	// Load the input file
+	if ( map_file ) {
+		if ( FSC_MapFileRaw( os_path, &map, fsc_true ) ) {
+			FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_GENERAL, "failed to map input file", FSC_NULL );
+			return fsc_true;
+		}
+		data = map.data;
+		size = map.size;
+	} else {
+		buffer = FSC_CacheReadFileRaw( os_path, &size );
+		if ( !buffer ) {
+			FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_GENERAL, "failed to read input file", FSC_NULL );
+			return fsc_true;
+		}
+		data = buffer;
 	}
 
 	// Read header
-	if ( FSC_FRead( &header, sizeof( header ), fp ) != sizeof( header ) ) {
-		FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_GENERAL, "failed to read cache file header", FSC_NULL );
-		FSC_FClose( fp );
-		return fsc_true;
+	if ( size < sizeof( header ) ) {
+		error = "failed to read cache file header";
+		goto error;
 	}
+	FSC_Memcpy( &header, data, sizeof( header ) );
 
-	// Read and verify version string
-	if ( header.versionSize != VERSION_STRING_LENGTH ||
-			FSC_FRead( &versionBuffer, VERSION_STRING_LENGTH, fp ) != VERSION_STRING_LENGTH ||
-			FSC_Memcmp( versionBuffer, FSC_CACHE_VERSION, VERSION_STRING_LENGTH ) ) {
-		FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_GENERAL, "cache file has wrong version", FSC_NULL );
-		FSC_FClose( fp );
-		return fsc_true;
+	// Verify version string
+	if ( header.versionSize != VERSION_STRING_LENGTH || size < CACHE_DATA_OFFSET ||
+			FSC_Memcmp( data + sizeof( header ), FSC_CACHE_VERSION, VERSION_STRING_LENGTH ) ) {
+		error = "cache file has wrong version";
+		goto error;
 	}
 
-	// Read data and close file
-	stream.data = (char *)FSC_Malloc( header.dataSize );
-	if ( FSC_FRead( stream.data, header.dataSize, fp ) != header.dataSize ) {
-		FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_GENERAL, "error reading cache file data", FSC_NULL );
-		return fsc_true;
+	// Verify data size
+	if ( header.dataSize > size - CACHE_DATA_OFFSET ) {
+		error = "error reading cache file data";
+		goto error;
 	}
-	FSC_FClose( fp );
 
 	// Load data into filesystem
+	stream.data = (char *)data + CACHE_DATA_OFFSET;
 	stream.position = 0;
 	stream.size = header.dataSize;
+	stream.overflowed = fsc_false;
 	if ( FSC_CacheImportStream( &stream, target_fs ) ) {
-		FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_GENERAL, "error loading cache data", FSC_NULL );
-		return fsc_true;
+		error = "error loading cache data";
+		goto error;
 	}
 
-	// Free the data
-	FSC_Free( stream.data );
+	// Filesystem now owns the data
+	if ( map_file ) {
+		target_fs->general_stack.external_map = map;
+	} else {
+		target_fs->general_stack.external_data = buffer;
+	}
 	return fsc_false;
+
+	error:
+	FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_GENERAL, error, FSC_NULL );
+	if ( map_file ) {
+		FSC_UnmapFile( &map );
+	} else {
+		FSC_Free( buffer );
+	}
+	return fsc_true;
 }
 
 /*
@@ -592,9 +665,9 @@ FSC_CacheImportFile
 Standard string path wrapper for FSC_CacheImportFileRawPath.
 =================
 */
-fsc_boolean FSC_CacheImportFile( const char *path, fsc_filesystem_t *target_fs ) {
+fsc_boolean FSC_CacheImportFile( const char *path, fsc_filesystem_t *target_fs, fsc_boolean map_file ) {
 	fsc_ospath_t *os_path = FSC_StringToOSPath( path );
-	fsc_boolean result = FSC_CacheImportFileRawPath( os_path, target_fs );
+	fsc_boolean result = FSC_CacheImportFileRawPath( os_path, target_fs, map_file );
 	FSC_Free( os_path );
 	return result;
 }
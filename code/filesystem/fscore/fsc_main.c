@@ -290,6 +290,49 @@ static void FSC_MergeStats( const fsc_stats_t *source, fsc_stats_t *target ) {
 	target->cacheable_file_count += source->cacheable_file_count;
 }
 
+/*
+=================
+FSC_SubtractStats
+=================
+*/
+static void FSC_SubtractStats( const fsc_stats_t *source, fsc_stats_t *target ) {
+	target->valid_pk3_count -= source->valid_pk3_count;
+	target->pk3_subfile_count -= source->pk3_subfile_count;
+	target->shader_file_count -= source->shader_file_count;
+	target->shader_count -= source->shader_count;
+	target->total_file_count -= source->total_file_count;
+	target->cacheable_file_count -= source->cacheable_file_count;
+}
+
+/*
+=================
+FSC_GetFileStats
+
+Gets stats contributed by a file on disk, including pk3 contents.
+=================
+*/
+static void FSC_GetFileStats( const fsc_file_direct_t *file, fsc_stats_t *stats ) {
+	FSC_Memset( stats, 0, sizeof( *stats ) );
+
+	stats->total_file_count = 1 + file->pk3_subfile_count;
+
+	stats->cacheable_file_count = file->pk3_subfile_count;
+	if ( file->shader_count || file->pk3_subfile_count ) {
+		++stats->cacheable_file_count;
+	}
+
+	stats->pk3_subfile_count = file->pk3_subfile_count;
+
+	// By design, this field records only *valid* pk3s with a nonzero hash.
+	// Perhaps create another field that includes invalid pk3s?
+	if ( file->pk3_hash ) {
+		stats->valid_pk3_count = 1;
+	}
+
+	stats->shader_file_count = file->shader_file_count;
+	stats->shader_count = file->shader_count;
+}
+
 /*
 =================
 FSC_RegisterFile
@@ -375,31 +418,22 @@ static int FSC_NullStringCompare( const char *s1, const char *s2 ) {
 
 /*
 =================
-FSC_LoadFile
+FSC_FindDirectFile
 
-Registers a file on disk into the filesystem index.
+Searches filesystem to see if a sufficiently equivalent entry already exists. If allow_reuse
+is set, an entry that differs only by size or timestamp may be updated and returned.
+Returns file pointer, or null if not found.
 =================
 */
-void FSC_LoadFile( int source_dir_id, const fsc_ospath_t *os_path, const char *mod_dir, const char *pk3dir_name,
+static fsc_stackptr_t FSC_FindDirectFile( const fsc_ospath_t *os_path, const char *mod_dir, const char *pk3dir_name,
 		const char *qp_dir, const char *qp_name, const char *qp_ext, unsigned int os_timestamp,
-		unsigned int filesize, fsc_filesystem_t *fs ) {
+		unsigned int filesize, fsc_boolean allow_reuse, fsc_filesystem_t *fs ) {
 	fsc_stackptr_t file_ptr;
-	fsc_file_direct_t *file = FSC_NULL;
 	fsc_hashtable_iterator_t hti;
-	unsigned int fs_hash = FSC_StringHash( qp_name, qp_dir );
-	fsc_boolean unindexed_file = fsc_false;		// File was not present in the index at all
-	fsc_boolean new_file = fsc_false;			// File was not present in last refresh, but may have been in the index
-
-	FSC_ASSERT( os_path );
-	FSC_ASSERT( qp_dir );
-	FSC_ASSERT( qp_name );
-	FSC_ASSERT( qp_ext );
-	FSC_ASSERT( fs );
 
-	// Search filesystem to see if a sufficiently equivalent entry already exists.
-	FSC_HashtableIterateBegin( &fs->files, fs_hash, &hti );
+	FSC_HashtableIterateBegin( &fs->files, FSC_StringHash( qp_name, qp_dir ), &hti );
 	while ( ( file_ptr = FSC_HashtableIterateNext( &hti ) ) ) {
-		file = (fsc_file_direct_t *)STACKPTR( file_ptr );
+		fsc_file_direct_t *file = (fsc_file_direct_t *)STACKPTR( file_ptr );
 		if ( file->f.sourcetype != FSC_SOURCETYPE_DIRECT )
 			continue;
 		if ( FSC_Strcmp( (char *)STACKPTR( file->f.qp_name_ptr ), qp_name ) )
@@ -415,7 +449,7 @@ void FSC_LoadFile( int source_dir_id, const fsc_ospath_t *os_path, const char *m
 		if ( file->os_path_ptr && FSC_OSPathCompare( (const fsc_ospath_t *)STACKPTR( file->os_path_ptr ), os_path ) )
 			continue;
 		if ( file->f.filesize != filesize || file->os_timestamp != os_timestamp ) {
-			if ( file->os_path_ptr && !( file->f.flags & FSC_FILEFLAG_LINKED_CONTENT ) && !file->f.contents_cache ) {
+			if ( allow_reuse && file->os_path_ptr && !( file->f.flags & FSC_FILEFLAG_LINKED_CONTENT ) && !file->f.contents_cache ) {
 				// Reuse the same file object to save memory (this prevents files actively written
 				// by the game such as logs generating a new file object every refresh)
 				file->f.filesize = filesize;
@@ -429,6 +463,71 @@ void FSC_LoadFile( int source_dir_id, const fsc_ospath_t *os_path, const char *m
 		break;
 	}
 
+	return file_ptr;
+}
+
+/*
+=================
+FSC_SpecialPk3Flags
+
+Returns special pk3 type flags for a file on disk.
+=================
+*/
+static int FSC_SpecialPk3Flags( const char *qp_dir, const char *qp_ext ) {
+	if ( !FSC_Stricmp( qp_ext, ".pk3" ) ) {
+		if ( !FSC_Stricmp( qp_dir, "downloads/" ) ) {
+			return FSC_FILEFLAG_DLPK3;
+		} else if ( !FSC_Stricmp( qp_dir, "refonly/" ) ) {
+			return FSC_FILEFLAG_REFONLY_PK3;
+		} else if ( !FSC_Stricmp( qp_dir, "nolist/" ) ) {
+			return FSC_FILEFLAG_NOLIST_PK3;
+		}
+	}
+	return 0;
+}
+
+/*
+=================
+FSC_IsIndexedPk3
+
+Returns true if file is a pk3 that has its contents indexed when loaded.
+=================
+*/
+static fsc_boolean FSC_IsIndexedPk3( const char *qp_dir, const char *qp_ext ) {
+	if ( !FSC_Stricmp( qp_ext, ".pk3" ) && ( !*qp_dir || FSC_SpecialPk3Flags( qp_dir, qp_ext ) ) ) {
+		return fsc_true;
+	}
+	return fsc_false;
+}
+
+/*
+=================
+FSC_LoadFileInternal
+
+Registers a file on disk into the filesystem index. If pk3_directory is set, it is used
+instead of reading the pk3 central directory from disk, and its data is released.
+=================
+*/
+static void FSC_LoadFileInternal( int source_dir_id, const fsc_ospath_t *os_path, const char *mod_dir,
+		const char *pk3dir_name, const char *qp_dir, const char *qp_name, const char *qp_ext, unsigned int os_timestamp,
+		unsigned int filesize, fsc_pk3_directory_t *pk3_directory, fsc_filesystem_t *fs ) {
+	fsc_stackptr_t file_ptr;
+	fsc_file_direct_t *file = FSC_NULL;
+	fsc_boolean unindexed_file = fsc_false;		// File was not present in the index at all
+	fsc_boolean new_file = fsc_false;			// File was not present in last refresh, but may have been in the index
+
+	FSC_ASSERT( os_path );
+	FSC_ASSERT( qp_dir );
+	FSC_ASSERT( qp_name );
+	FSC_ASSERT( qp_ext );
+	FSC_ASSERT( fs );
+
+	file_ptr = FSC_FindDirectFile( os_path, mod_dir, pk3dir_name, qp_dir, qp_name, qp_ext,
+			os_timestamp, filesize, fsc_true, fs );
+	if ( file_ptr ) {
+		file = (fsc_file_direct_t *)STACKPTR( file_ptr );
+	}
+
 	if ( file_ptr ) {
 		// Have existing entry
 		if ( file->refresh_count == fs->refresh_count ) {
@@ -467,15 +566,7 @@ void FSC_LoadFile( int source_dir_id, const fsc_ospath_t *os_path, const char *m
 	// Update source dir and pk3 type flags
 	file->source_dir_id = source_dir_id;
 	file->f.flags &= ~FSC_FILEFLAGS_SPECIAL_PK3;
-	if ( !FSC_Stricmp( qp_ext, ".pk3" ) ) {
-		if ( !FSC_Stricmp( qp_dir, "downloads/" ) ) {
-			file->f.flags |= FSC_FILEFLAG_DLPK3;
-		} else if ( !FSC_Stricmp( qp_dir, "refonly/" ) ) {
-			file->f.flags |= FSC_FILEFLAG_REFONLY_PK3;
-		} else if ( !FSC_Stricmp( qp_dir, "nolist/" ) ) {
-			file->f.flags |= FSC_FILEFLAG_NOLIST_PK3;
-		}
-	}
+	file->f.flags |= FSC_SpecialPk3Flags( qp_dir, qp_ext );
 
 	// Save os path. This happens on loading a new file, and also when first activating an entry that was loaded from cache.
 	if ( !file->os_path_ptr ) {
@@ -487,9 +578,12 @@ void FSC_LoadFile( int source_dir_id, const fsc_ospath_t *os_path, const char *m
 	// Register file and load contents
 	if ( unindexed_file ) {
 		FSC_RegisterFile( file_ptr, FSC_NULL, fs );
-		if ( !FSC_Stricmp( qp_ext, ".pk3" ) &&
-				( !*qp_dir || ( file->f.flags & FSC_FILEFLAGS_SPECIAL_PK3 ) ) ) {
-			FSC_LoadPk3( (fsc_ospath_t *)STACKPTR( file->os_path_ptr ), fs, file_ptr, FSC_NULL, FSC_NULL );
+		if ( FSC_IsIndexedPk3( qp_dir, qp_ext ) ) {
+			if ( pk3_directory ) {
+				FSC_LoadPk3Directory( pk3_directory, fs, file_ptr, FSC_NULL, FSC_NULL );
+			} else {
+				FSC_LoadPk3( (fsc_ospath_t *)STACKPTR( file->os_path_ptr ), fs, file_ptr, FSC_NULL, FSC_NULL );
+			}
 			file->f.flags |= FSC_FILEFLAG_LINKED_CONTENT;
 		}
 	}
@@ -497,25 +591,7 @@ void FSC_LoadFile( int source_dir_id, const fsc_ospath_t *os_path, const char *m
 	// Update stats
 	{
 		fsc_stats_t stats;
-		FSC_Memset( &stats, 0, sizeof( stats ) );
-
-		stats.total_file_count = 1 + file->pk3_subfile_count;
-
-		stats.cacheable_file_count = file->pk3_subfile_count;
-		if ( file->shader_count || file->pk3_subfile_count ) {
-			++stats.cacheable_file_count;
-		}
-
-		stats.pk3_subfile_count = file->pk3_subfile_count;
-
-		// By design, this field records only *valid* pk3s with a nonzero hash.
-		// Perhaps create another field that includes invalid pk3s?
-		if ( file->pk3_hash ) {
-			stats.valid_pk3_count = 1;
-		}
-
-		stats.shader_file_count = file->shader_file_count;
-		stats.shader_count = file->shader_count;
+		FSC_GetFileStats( file, &stats );
 
 		FSC_MergeStats( &stats, &fs->active_stats );
 		if ( unindexed_file ) {
@@ -527,6 +603,20 @@ void FSC_LoadFile( int source_dir_id, const fsc_ospath_t *os_path, const char *m
 	}
 }
 
+/*
+=================
+FSC_LoadFile
+
+Registers a file on disk into the filesystem index.
+=================
+*/
+void FSC_LoadFile( int source_dir_id, const fsc_ospath_t *os_path, const char *mod_dir, const char *pk3dir_name,
+		const char *qp_dir, const char *qp_name, const char *qp_ext, unsigned int os_timestamp,
+		unsigned int filesize, fsc_filesystem_t *fs ) {
+	FSC_LoadFileInternal( source_dir_id, os_path, mod_dir, pk3dir_name, qp_dir, qp_name, qp_ext,
+			os_timestamp, filesize, FSC_NULL, fs );
+}
+
 /*
 =================
 FSC_HasAppExtension
@@ -543,53 +633,82 @@ static fsc_boolean FSC_HasAppExtension( const char *name ) {
 	return fsc_false;
 }
 
+typedef struct {
+	char qp_mod[FSC_MAX_MODDIR];
+	char pk3dir_buffer[FSC_MAX_QPATH];
+	fsc_boolean file_in_pk3dir;
+	fsc_qpath_buffer_t qpath_split;
+} game_path_t;
+
 /*
 =================
-FSC_LoadFileFromPath
+FSC_ParseGamePath
 
-Registers a file on disk into the filesystem index. Performs some additional path parsing
-compared to the base FSC_LoadFile function.
+Splits a path relative to the source directory into mod directory, pk3dir, and qpath components.
+Returns true on success, false if the file should not be indexed.
 =================
 */
-void FSC_LoadFileFromPath( int source_dir_id, const fsc_ospath_t *os_path, const char *game_path,
-		unsigned int os_timestamp, unsigned int filesize, fsc_filesystem_t *fs ) {
-	char qp_mod[FSC_MAX_MODDIR];
+static fsc_boolean FSC_ParseGamePath( const char *game_path, game_path_t *output ) {
 	const char *qpath_start = FSC_NULL;
-	fsc_boolean file_in_pk3dir = fsc_false;
-	char pk3dir_buffer[FSC_MAX_QPATH];
 	const char *pk3dir_remainder = FSC_NULL;
-	fsc_qpath_buffer_t qpath_split;
 
 	// Process mod directory prefix
-	if ( !FSC_SplitLeadingDirectory( game_path, qp_mod, sizeof( qp_mod ), &qpath_start ) ) {
-		return;
+	if ( !FSC_SplitLeadingDirectory( game_path, output->qp_mod, sizeof( output->qp_mod ), &qpath_start ) ) {
+		return fsc_false;
 	}
 	if ( !qpath_start ) {
-		return;
+		return fsc_false;
 	}
-	if ( FSC_HasAppExtension( qp_mod ) ) {
+	if ( FSC_HasAppExtension( output->qp_mod ) ) {
 		// Don't index mac app bundles as mods
-		return;
+		return fsc_false;
 	}
 
 	// Process pk3dir prefix
-	if ( FSC_SplitLeadingDirectory( qpath_start, pk3dir_buffer, sizeof( pk3dir_buffer ), &pk3dir_remainder ) ) {
+	output->file_in_pk3dir = fsc_false;
+	if ( FSC_SplitLeadingDirectory( qpath_start, output->pk3dir_buffer, sizeof( output->pk3dir_buffer ), &pk3dir_remainder ) ) {
 		if ( pk3dir_remainder ) {
-			int length = FSC_Strlen( pk3dir_buffer );
-			if ( length >= 7 && !FSC_Stricmp( pk3dir_buffer + length - 7, ".pk3dir" ) ) {
-				pk3dir_buffer[length - 7] = '\0';
-				file_in_pk3dir = fsc_true;
+			int length = FSC_Strlen( output->pk3dir_buffer );
+			if ( length >= 7 && !FSC_Stricmp( output->pk3dir_buffer + length - 7, ".pk3dir" ) ) {
+				output->pk3dir_buffer[length - 7] = '\0';
+				output->file_in_pk3dir = fsc_true;
 				qpath_start = pk3dir_remainder;
 			}
 		}
 	}
 
 	// Process qpath
-	FSC_SplitQpath( qpath_start, &qpath_split, fsc_false );
+	FSC_SplitQpath( qpath_start, &output->qpath_split, fsc_false );
+	return fsc_true;
+}
+
+/*
+=================
+FSC_LoadFileFromPathInternal
+=================
+*/
+static void FSC_LoadFileFromPathInternal( int source_dir_id, const fsc_ospath_t *os_path, const char *game_path,
+		unsigned int os_timestamp, unsigned int filesize, fsc_pk3_directory_t *pk3_directory, fsc_filesystem_t *fs ) {
+	game_path_t path;
+	if ( !FSC_ParseGamePath( game_path, &path ) ) {
+		return;
+	}
+
+	FSC_LoadFileInternal( source_dir_id, os_path, path.qp_mod, path.file_in_pk3dir ? path.pk3dir_buffer : FSC_NULL,
+			path.qpath_split.dir, path.qpath_split.name, path.qpath_split.ext, os_timestamp, filesize, pk3_directory, fs );
+}
 
-	// Load file
-	FSC_LoadFile( source_dir_id, os_path, qp_mod, file_in_pk3dir ? pk3dir_buffer : FSC_NULL, qpath_split.dir,
-				  qpath_split.name, qpath_split.ext, os_timestamp, filesize, fs );
+/*
+=================
+FSC_LoadFileFromPath
+
+Registers a file on disk into the filesystem index. Performs some additional path parsing
+compared to the base FSC_LoadFile function.
+=================
+*/
+void FSC_LoadFileFromPath( int source_dir_id, const fsc_ospath_t *os_path, const char *game_path,
+		unsigned int os_timestamp, unsigned int filesize, fsc_filesystem_t *fs ) {
+	FSC_LoadFileFromPathInternal( source_dir_id, os_path, game_path, os_timestamp, filesize, FSC_NULL, fs );
 }
 
 typedef struct {
@@ -658,15 +777,172 @@ void FSC_FilesystemReset( fsc_filesystem_t *fs ) {
 	FSC_Memset( &fs->new_stats, 0, sizeof( fs->new_stats ) );
 }
 
+/*
+###############################################################################################
+
+Parallel Directory Indexing
+
+Directory contents are first collected into a list. Then in batches, the central directories
+of pk3s that will need their contents indexed are read on worker threads, and each file is
+registered on the calling thread in the original directory order. The resulting index is the
+same as loading each file in sequence.
+
+###############################################################################################
+*/
+
+// Maximum number of pk3 central directories held in memory at once
+#define FSC_PK3_PRELOAD_BATCH 128
+
+typedef struct {
+	fsc_ospath_t *os_path;
+	char *qpath_with_mod_dir;
+	unsigned int os_timestamp;
+	unsigned int filesize;
+	fsc_boolean pk3_preloaded;
+	fsc_pk3_directory_t pk3_directory;
+} directory_entry_t;
+
+typedef struct {
+	directory_entry_t *entries;
+	int count;
+	int allocated;
+} directory_entry_list_t;
+
+/*
+=================
+FSC_CollectFileFromIteration
+=================
+*/
+static void FSC_CollectFileFromIteration( iterate_data_t *file_data, void *iterate_context ) {
+	directory_entry_list_t *list = (directory_entry_list_t *)iterate_context;
+	directory_entry_t *entry;
+	int os_path_size = FSC_OSPathSize( file_data->os_path );
+	int qpath_size = FSC_Strlen( file_data->qpath_with_mod_dir ) + 1;
+
+	if ( list->count >= list->allocated ) {
+		int new_allocated = list->allocated ? list->allocated * 2 : 1024;
+		directory_entry_t *new_entries = (directory_entry_t *)FSC_Malloc( new_allocated * sizeof( *new_entries ) );
+		if ( list->entries ) {
+			FSC_Memcpy( new_entries, list->entries, list->count * sizeof( *new_entries ) );
+			FSC_Free( list->entries );
+		}
+		list->entries = new_entries;
+		list->allocated = new_allocated;
+	}
+
+	entry = &list->entries[list->count++];
+	FSC_Memset( entry, 0, sizeof( *entry ) );
+	entry->os_path = (fsc_ospath_t *)FSC_Malloc( os_path_size );
+	FSC_Memcpy( entry->os_path, file_data->os_path, os_path_size );
+	entry->qpath_with_mod_dir = (char *)FSC_Malloc( qpath_size );
+	FSC_Memcpy( entry->qpath_with_mod_dir, file_data->qpath_with_mod_dir, qpath_size );
+	entry->os_timestamp = file_data->os_timestamp;
+	entry->filesize = file_data->filesize;
+}
+
+/*
+=================
+FSC_NeedsPk3Preload
+
+Returns true if loading the file is expected to index pk3 contents, meaning it is a pk3 that
+isn't already in the index. Only used to decide which pk3s to read in advance, since files that
+are registered without a preloaded central directory will still read it directly.
+=================
+*/
+static fsc_boolean FSC_NeedsPk3Preload( const directory_entry_t *entry, fsc_filesystem_t *fs ) {
+	game_path_t path;
+	if ( !FSC_ParseGamePath( entry->qpath_with_mod_dir, &path ) ) {
+		return fsc_false;
+	}
+	if ( !FSC_IsIndexedPk3( path.qpath_split.dir, path.qpath_split.ext ) ) {
+		return fsc_false;
+	}
+	if ( FSC_FindDirectFile( entry->os_path, path.qp_mod, path.file_in_pk3dir ? path.pk3dir_buffer : FSC_NULL,
+			path.qpath_split.dir, path.qpath_split.name, path.qpath_split.ext, entry->os_timestamp,
+			entry->filesize, fsc_false, fs ) ) {
+		return fsc_false;
+	}
+	return fsc_true;
+}
+
+/*
+=================
+FSC_PreloadPk3Job
+
+Reads the central directory for one pk3. Runs on worker threads, so must not access the index.
+=================
+*/
+static void FSC_PreloadPk3Job( int index, void *context ) {
+	directory_entry_t *entry = ( (directory_entry_t **)context )[index];
+	FSC_ReadPk3CentralDirectory( entry->os_path, &entry->pk3_directory );
+}
+
+/*
+=================
+FSC_LoadDirectoryParallel
+=================
+*/
+static void FSC_LoadDirectoryParallel( fsc_filesystem_t *fs, fsc_ospath_t *os_path, int source_dir_id,
+		fsc_jobs_handler_t jobs_handler ) {
+	directory_entry_list_t list;
+	directory_entry_t *preload[FSC_PK3_PRELOAD_BATCH];
+	int position = 0;
+
+	FSC_Memset( &list, 0, sizeof( list ) );
+	FSC_IterateDirectory( os_path, FSC_CollectFileFromIteration, &list );
+
+	while ( position < list.count ) {
+		int batch_start = position;
+		int preload_count = 0;
+		int i;
+
+		// Select pk3s in this batch to read in advance
+		while ( position < list.count && preload_count < FSC_PK3_PRELOAD_BATCH ) {
+			directory_entry_t *entry = &list.entries[position++];
+			if ( FSC_NeedsPk3Preload( entry, fs ) ) {
+				entry->pk3_preloaded = fsc_true;
+				preload[preload_count++] = entry;
+			}
+		}
+
+		// Read central directories
+		if ( preload_count ) {
+			jobs_handler( preload_count, FSC_PreloadPk3Job, preload );
+		}
+
+		// Register files in original order
+		for ( i = batch_start; i < position; ++i ) {
+			directory_entry_t *entry = &list.entries[i];
+			FSC_LoadFileFromPathInternal( source_dir_id, entry->os_path, entry->qpath_with_mod_dir, entry->os_timestamp,
+					entry->filesize, entry->pk3_preloaded ? &entry->pk3_directory : FSC_NULL, fs );
+			if ( entry->pk3_directory.data ) {
+				FSC_Free( entry->pk3_directory.data );
+			}
+			FSC_Free( entry->os_path );
+			FSC_Free( entry->qpath_with_mod_dir );
+		}
+	}
+
+	if ( list.entries ) {
+		FSC_Free( list.entries );
+	}
+}
+
 /*
 =================
 FSC_LoadDirectoryRawPath
 
 Scans the given game directory for files and registers them into the file index.
+If jobs_handler is set, it is used to read pk3 central directories in parallel.
 =================
 */
-void FSC_LoadDirectoryRawPath( fsc_filesystem_t *fs, fsc_ospath_t *os_path, int source_dir_id ) {
+void FSC_LoadDirectoryRawPath( fsc_filesystem_t *fs, fsc_ospath_t *os_path, int source_dir_id,
+		fsc_jobs_handler_t jobs_handler ) {
 	iterate_context_t context;
+	if ( jobs_handler ) {
+		FSC_LoadDirectoryParallel( fs, os_path, source_dir_id, jobs_handler );
+		return;
+	}
 	context.source_dir_id = source_dir_id;
 	context.fs = fs;
 	FSC_IterateDirectory( os_path, FSC_LoadFileFromIteration, &context );
@@ -679,10 +955,126 @@ FSC_LoadDirectory
 Standard string path wrapper for FSC_LoadDirectoryRawPath.
 =================
 */
-void FSC_LoadDirectory( fsc_filesystem_t *fs, const char *path, int source_dir_id ) {
+void FSC_LoadDirectory( fsc_filesystem_t *fs, const char *path, int source_dir_id, fsc_jobs_handler_t jobs_handler ) {
 	fsc_ospath_t *os_path = FSC_StringToOSPath( path );
-	FSC_LoadDirectoryRawPath( fs, os_path, source_dir_id );
+	FSC_LoadDirectoryRawPath( fs, os_path, source_dir_id, jobs_handler );
 	FSC_Free( os_path );
 }
 
+/*
+###############################################################################################
+
+Partial Refresh
+
+###############################################################################################
+*/
+
+typedef struct {
+	int source_dir_id;
+	const char *path_prefix;
+	fsc_filesystem_t *fs;
+} partial_refresh_context_t;
+
+/*
+=================
+FSC_JoinPath
+
+Returns "base/name", or just name if base is empty. Result must be freed by caller via FSC_Free.
+=================
+*/
+static char *FSC_JoinPath( const char *base, const char *name ) {
+	int base_length = FSC_Strlen( base );
+	int name_length = FSC_Strlen( name );
+	char *result = (char *)FSC_Malloc( base_length + name_length + 2 );
+	if ( base_length ) {
+		FSC_Memcpy( result, base, base_length );
+		result[base_length++] = '/';
+	}
+	FSC_Memcpy( result + base_length, name, name_length + 1 );
+	return result;
+}
+
+/*
+=================
+FSC_LoadFileFromPartialIteration
+=================
+*/
+static void FSC_LoadFileFromPartialIteration( iterate_data_t *file_data, void *iterate_context ) {
+	partial_refresh_context_t *context = (partial_refresh_context_t *)iterate_context;
+	char *game_path = FSC_JoinPath( context->path_prefix, file_data->qpath_with_mod_dir );
+	FSC_LoadFileFromPath( context->source_dir_id, file_data->os_path, game_path,
+			file_data->os_timestamp, file_data->filesize, context->fs );
+	FSC_Free( game_path );
+}
+
+/*
+=================
+FSC_RefreshPaths
+
+Updates the index for specific files or directories in a source directory that may have changed,
+without rescanning the rest of the source directory. Active files at or under each path are
+deactivated, then anything currently on disk at the path is loaded again. Paths are relative to
+the source directory and use forward slashes.
+
+Unlike a full refresh, files elsewhere stay active and the refresh count is not advanced.
+=================
+*/
+void FSC_RefreshPaths( fsc_filesystem_t *fs, const char *source_path, int source_dir_id,
+		const char *const *paths, int path_count ) {
+	fsc_ospath_t **os_paths = (fsc_ospath_t **)FSC_Malloc( path_count * sizeof( *os_paths ) );
+	int bucket;
+	int i;
+
+	FSC_Memset( &fs->new_stats, 0, sizeof( fs->new_stats ) );
+
+	for ( i = 0; i < path_count; ++i ) {
+		char *full_path = FSC_JoinPath( source_path, paths[i] );
+		os_paths[i] = FSC_StringToOSPath( full_path );
+		FSC_Free( full_path );
+	}
+
+	// Deactivate existing files. Deactivated files are assigned the previous refresh count, so if they
+	// are loaded again they aren't counted as new.
+	for ( bucket = 0; bucket < fs->files.bucket_count; ++bucket ) {
+		fsc_hashtable_iterator_t hti;
+		fsc_stackptr_t file_ptr;
+		FSC_HashtableIterateBegin( &fs->files, bucket, &hti );
+		while ( ( file_ptr = FSC_HashtableIterateNext( &hti ) ) ) {
+			fsc_file_direct_t *file = (fsc_file_direct_t *)STACKPTR( file_ptr );
+			if ( file->f.sourcetype != FSC_SOURCETYPE_DIRECT || file->refresh_count != fs->refresh_count ||
+					file->source_dir_id != source_dir_id || !file->os_path_ptr ) {
+				continue;
+			}
+			for ( i = 0; i < path_count; ++i ) {
+				if ( FSC_OSPathIsWithin( (const fsc_ospath_t *)STACKPTR( file->os_path_ptr ), os_paths[i] ) ) {
+					fsc_stats_t stats;
+					FSC_GetFileStats( file, &stats );
+					FSC_SubtractStats( &stats, &fs->active_stats );
+					file->refresh_count = fs->refresh_count - 1;
+					break;
+				}
+			}
+		}
+	}
+
+	// Load current contents
+	for ( i = 0; i < path_count; ++i ) {
+		unsigned int os_timestamp = 0;
+		unsigned int filesize = 0;
+		fsc_pathtype_t type = FSC_GetPathInfoRaw( os_paths[i], &os_timestamp, &filesize );
+		if ( type == FSC_PATHTYPE_FILE ) {
+			FSC_LoadFileFromPath( source_dir_id, os_paths[i], paths[i], os_timestamp, filesize, fs );
+		} else if ( type == FSC_PATHTYPE_DIRECTORY ) {
+			partial_refresh_context_t context;
+			context.source_dir_id = source_dir_id;
+			context.path_prefix = paths[i];
+			context.fs = fs;
+			FSC_IterateDirectory( os_paths[i], FSC_LoadFileFromPartialIteration, &context );
+		}
+		FSC_Free( os_paths[i] );
+	}
+
+	FSC_Free( os_paths );
+}
+
 #endif	// NEW_FILESYSTEM
@@ -190,6 +190,7 @@ FSC_StackInitialize
 */
 void FSC_StackInitialize( fsc_stack_t *stack ) {
 	FSC_ASSERT( stack );
+	FSC_Memset( stack, 0, sizeof( *stack ) );
 	stack->buckets_position = -1;	// FSC_StackAddBucket will increment to 0
 	stack->buckets_size = STACK_INITIAL_BUCKETS;
 	stack->buckets = (fsc_stack_bucket_t **)FSC_Malloc( stack->buckets_size * sizeof( fsc_stack_bucket_t * ) );
@@ -267,7 +268,7 @@ void FSC_StackFree( fsc_stack_t *stack ) {
 	FSC_ASSERT( stack );
 
 	if ( stack->buckets ) {
-		for ( i = 0; i <= stack->buckets_position; ++i ) {
+		for ( i = stack->external_buckets; i <= stack->buckets_position; ++i ) {
 			if ( stack->buckets[i] ) {
 				FSC_Free( stack->buckets[i] );
 			}
@@ -275,8 +276,20 @@ void FSC_StackFree( fsc_stack_t *stack ) {
 		FSC_Free( stack->buckets );
 		stack->buckets = FSC_NULL;
 	}
+
+	// Release imported image
+	if ( stack->external_data ) {
+		FSC_Free( stack->external_data );
+	}
+	if ( stack->external_map.data ) {
+		FSC_UnmapFile( &stack->external_map );
+	}
+	stack->external_buckets = 0;
+	stack->external_data = FSC_NULL;
 }
 
+#define STACK_EXPORT_ALIGN( size ) ( ( (size) + FSC_STACK_EXPORT_ALIGNMENT - 1 ) & ~( FSC_STACK_EXPORT_ALIGNMENT - 1 ) )
+
 /*
 =================
 FSC_StackExportSize
@@ -285,23 +298,39 @@ Returns the precise number of bytes required to export the stack via FSC_StackEx
 =================
 */
 unsigned int FSC_StackExportSize( fsc_stack_t *stack ) {
-	unsigned int size = 4; // 4 bytes for bucket count field
+	unsigned int size = STACK_EXPORT_ALIGN( 4 ); // 4 bytes for bucket count field
 	int i;
 	FSC_ASSERT( stack );
 
-	// Then add the actual length of each bucket + 4 bytes for position field
+	// Then add the aligned image size of each bucket (position field followed by data)
 	for ( i = 0; i <= stack->buckets_position; ++i ) {
-		size += stack->buckets[i]->position + 4;
+		size += STACK_EXPORT_ALIGN( sizeof( fsc_stack_bucket_t ) + stack->buckets[i]->position );
 	}
 
 	return size;
 }
 
+/*
+=================
+FSC_StackExportPadding
+
+Writes zero padding up to the next export alignment boundary. Returns true on error, false on success.
+=================
+*/
+static fsc_boolean FSC_StackExportPadding( fsc_stream_t *stream ) {
+	static const char zeros[FSC_STACK_EXPORT_ALIGNMENT] = { 0 };
+	unsigned int padding = STACK_EXPORT_ALIGN( stream->position ) - stream->position;
+	return padding ? FSC_StreamWriteData( stream, zeros, padding ) : fsc_false;
+}
+
 /*
 =================
 FSC_StackExport
 
 Writes stack contents to stream. Returns true on error, false on success.
+
+Each bucket is written as an aligned image of the bucket in memory, so a stream which begins
+on an aligned address can be used in place by FSC_StackImportInPlace.
 =================
 */
 fsc_boolean FSC_StackExport( fsc_stack_t *stack, fsc_stream_t *stream ) {
@@ -310,17 +339,16 @@ fsc_boolean FSC_StackExport( fsc_stack_t *stack, fsc_stream_t *stream ) {
 	FSC_ASSERT( stream );
 
 	// Write the number of buckets
-	if ( FSC_StreamWriteData( stream, &stack->buckets_position, 4 ) ) {
+	if ( FSC_StreamWriteData( stream, &stack->buckets_position, 4 ) || FSC_StackExportPadding( stream ) ) {
 		return fsc_true;
 	}
 
 	// Write each bucket (current position followed by data)
 	for ( i = 0; i <= stack->buckets_position; ++i ) {
-		if ( FSC_StreamWriteData( stream, &stack->buckets[i]->position, 4 ) ) {
+		if ( FSC_StreamWriteData( stream, stack->buckets[i], sizeof( fsc_stack_bucket_t ) + stack->buckets[i]->position ) ) {
 			return fsc_true;
 		}
-		if ( FSC_StreamWriteData( stream, (char *)stack->buckets[i] + sizeof( fsc_stack_bucket_t ),
-				stack->buckets[i]->position ) ) {
+		if ( FSC_StackExportPadding( stream ) ) {
 			return fsc_true;
 		}
 	}
@@ -330,46 +358,56 @@ fsc_boolean FSC_StackExport( fsc_stack_t *stack, fsc_stream_t *stream ) {
 
 /*
 =================
-FSC_StackImport
+FSC_StackImportInPlace
+
+Imports stack from stream, using the bucket images directly from the stream data instead of
+copying them. Stream data must be aligned to FSC_STACK_EXPORT_ALIGNMENT, writable, and remain
+valid until the stack is freed. New allocations are made in an additional bucket so the
+imported buckets are only modified by writes to existing entries.
 
-Imports stack from stream. Returns true on error, false on success.
+Returns true on error, false on success.
 =================
 */
-fsc_boolean FSC_StackImport( fsc_stack_t *stack, fsc_stream_t *stream ) {
+fsc_boolean FSC_StackImportInPlace( fsc_stack_t *stack, fsc_stream_t *stream ) {
 	int i;
 	FSC_ASSERT( stack );
 	FSC_ASSERT( stream );
+	FSC_Memset( stack, 0, sizeof( *stack ) );
 
 	// Read number of active buckets
 	if ( FSC_StreamReadData( stream, &stack->buckets_position, 4 ) ) {
 		return fsc_true;
 	}
-	if ( stack->buckets_position < 0 || stack->buckets_position >= STACK_MAX_BUCKETS ) {
+	if ( stack->buckets_position < 0 || stack->buckets_position >= STACK_MAX_BUCKETS - 1 ) {
 		return fsc_true;
 	}
+	stream->position = STACK_EXPORT_ALIGN( stream->position );
 
-	// Allocate bucket array
-	stack->buckets_size = stack->buckets_position + 1;
+	// Allocate bucket array, leaving space for the overlay bucket
+	stack->buckets_size = stack->buckets_position + 2;
 	if ( stack->buckets_size < STACK_INITIAL_BUCKETS ) {
 		stack->buckets_size = STACK_INITIAL_BUCKETS;
 	}
 	stack->buckets = (fsc_stack_bucket_t **)FSC_Calloc( stack->buckets_size * sizeof( fsc_stack_bucket_t * ) );
+	stack->external_buckets = stack->buckets_position + 1;
 
-	// Read data for each bucket
+	// Locate each bucket image
 	for ( i = 0; i <= stack->buckets_position; ++i ) {
-		stack->buckets[i] = (fsc_stack_bucket_t *)FSC_Calloc( STACK_BUCKET_SIZE );
-		if ( FSC_StreamReadData( stream, &stack->buckets[i]->position, 4 ) ) {
-			goto error;
-		}
-		if ( stack->buckets[i]->position >= STACK_BUCKET_SIZE ) {
+		fsc_stack_bucket_t *bucket = (fsc_stack_bucket_t *)( stream->data + stream->position );
+		if ( stream->position + sizeof( fsc_stack_bucket_t ) > stream->size ||
+				bucket->position > STACK_BUCKET_DATA_SIZE ||
+				bucket->position > stream->size - stream->position - sizeof( fsc_stack_bucket_t ) ) {
 			goto error;
 		}
-		if ( FSC_StreamReadData( stream, (char *)stack->buckets[i] + sizeof( fsc_stack_bucket_t ),
-				stack->buckets[i]->position ) ) {
+		stack->buckets[i] = bucket;
+		stream->position = STACK_EXPORT_ALIGN( stream->position + sizeof( fsc_stack_bucket_t ) + bucket->position );
+		if ( stream->position > stream->size ) {
 			goto error;
 		}
 	}
 
+	// Start the overlay bucket for new allocations
+	FSC_StackAddBucket( stack );
 	return fsc_false;
 
 	error:
@@ -46,6 +46,9 @@ Headers & Definitions
 #include <dirent.h>
 #include <ctype.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 // Common defines
 #include <stdio.h>
@@ -170,6 +173,36 @@ int FSC_OSPathCompare( const fsc_ospath_t *path1, const fsc_ospath_t *path2 ) {
 #endif
 }
 
+/*
+=================
+FSC_OSPathIsWithin
+
+Returns true if path equals base_path or is located in the directory base_path, false otherwise.
+=================
+*/
+fsc_boolean FSC_OSPathIsWithin( const fsc_ospath_t *path, const fsc_ospath_t *base_path ) {
+	FSC_ASSERT( path && base_path );
+	{
+		const FSC_CHAR *path_typed = (const FSC_CHAR *)path;
+		const FSC_CHAR *base_typed = (const FSC_CHAR *)base_path;
+		while ( *base_typed ) {
+			if ( *path_typed != *base_typed ) {
+				return fsc_false;
+			}
+			++path_typed;
+			++base_typed;
+		}
+#ifdef _WIN32
+		if ( *path_typed && *path_typed != '\\' && *path_typed != '/' ) {
+#else
+		if ( *path_typed && *path_typed != '/' ) {
+#endif
+			return fsc_false;
+		}
+		return fsc_true;
+	}
+}
+
 /*
 ###############################################################################################
 
@@ -415,6 +448,130 @@ unsigned int FSC_FTell( fsc_filehandle_t *fp ) {
 	}
 }
 
+/*
+=================
+FSC_GetPathInfoRaw
+
+Returns type of file or directory at path in OS path format. For files, also writes timestamp
+and size using the same conventions as directory iteration. Files greater than 4GB are not
+currently supported, and are reported as nonexistent.
+=================
+*/
+fsc_pathtype_t FSC_GetPathInfoRaw( const fsc_ospath_t *os_path, unsigned int *os_timestamp, unsigned int *filesize ) {
+	FSC_ASSERT( os_path );
+	{
+#ifdef _WIN32
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if ( !GetFileAttributesEx( (LPCTSTR)os_path, GetFileExInfoStandard, &data ) ) {
+			return FSC_PATHTYPE_NONE;
+		}
+		if ( data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) {
+			return FSC_PATHTYPE_DIRECTORY;
+		}
+		if ( data.nFileSizeHigh ) {
+			return FSC_PATHTYPE_NONE;
+		}
+		*os_timestamp = data.ftLastWriteTime.dwLowDateTime;
+		*filesize = data.nFileSizeLow;
+#else
+		struct stat st;
+		if ( stat( (const char *)os_path, &st ) == -1 ) {
+			return FSC_PATHTYPE_NONE;
+		}
+		if ( S_ISDIR( st.st_mode ) ) {
+			return FSC_PATHTYPE_DIRECTORY;
+		}
+		if ( st.st_size > 4294967295u ) {
+			return FSC_PATHTYPE_NONE;
+		}
+		*os_timestamp = (unsigned int)st.st_mtime;
+		*filesize = (unsigned int)st.st_size;
+#endif
+		return FSC_PATHTYPE_FILE;
+	}
+}
+
+/*
+=================
+FSC_MapFileRaw
+
+Maps entire file in OS path format into memory for reading. Returns true on error, false on success.
+On success mapping must be released by FSC_UnmapFile.
+
+If copy_on_write is set the mapping is also writable, with modified pages becoming private to the process.
+=================
+*/
+fsc_boolean FSC_MapFileRaw( const fsc_ospath_t *os_path, fsc_filemap_t *map, fsc_boolean copy_on_write ) {
+	FSC_ASSERT( os_path );
+	FSC_ASSERT( map );
+	FSC_Memset( map, 0, sizeof( *map ) );
+	{
+#ifdef _WIN32
+		LARGE_INTEGER size;
+		HANDLE mapping;
+		void *data;
+		HANDLE file = CreateFile( (LPCTSTR)os_path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0,
+				OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0 );
+		if ( file == INVALID_HANDLE_VALUE ) {
+			return fsc_true;
+		}
+		if ( !GetFileSizeEx( file, &size ) || !size.QuadPart || size.QuadPart > 4294967295u ) {
+			CloseHandle( file );
+			return fsc_true;
+		}
+		mapping = CreateFileMapping( file, 0, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, 0 );
+		CloseHandle( file );
+		if ( !mapping ) {
+			return fsc_true;
+		}
+		data = MapViewOfFile( mapping, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0 );
+		if ( !data ) {
+			CloseHandle( mapping );
+			return fsc_true;
+		}
+		map->data = (const char *)data;
+		map->size = (unsigned int)size.QuadPart;
+		map->os_handle = mapping;
+#else
+		struct stat st;
+		void *data;
+		int fd = open( (const char *)os_path, O_RDONLY );
+		if ( fd == -1 ) {
+			return fsc_true;
+		}
+		if ( fstat( fd, &st ) == -1 || !S_ISREG( st.st_mode ) || st.st_size <= 0 || st.st_size > 4294967295u ) {
+			close( fd );
+			return fsc_true;
+		}
+		data = mmap( 0, (size_t)st.st_size, copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ,
+				copy_on_write ? MAP_PRIVATE : MAP_SHARED, fd, 0 );
+		close( fd );
+		if ( data == MAP_FAILED ) {
+			return fsc_true;
+		}
+		map->data = (const char *)data;
+		map->size = (unsigned int)st.st_size;
+#endif
+	}
+	return fsc_false;
+}
+
+/*
+=================
+FSC_UnmapFile
+=================
+*/
+void FSC_UnmapFile( fsc_filemap_t *map ) {
+	FSC_ASSERT( map && map->data );
+#ifdef _WIN32
+	UnmapViewOfFile( map->data );
+	CloseHandle( (HANDLE)map->os_handle );
+#else
+	munmap( (void *)map->data, map->size );
+#endif
+	FSC_Memset( map, 0, sizeof( *map ) );
+}
+
 /*
 ###############################################################################################
 
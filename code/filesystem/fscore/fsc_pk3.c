@@ -35,17 +35,158 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 /*
 ###############################################################################################
 
-PK3 File Indexing
+PK3 Mapping
+
+Pk3 files can optionally be mapped into memory, in which case central directories, local
+headers, and file data are read from the mapping instead of through file handles. Mappings
+for file reads are kept open in a small cache until released by FSC_Pk3MapReset.
+
+Mapped pk3s must not be modified in place while the mapping is open. Replacing the file
+(such as by rename) is safe.
+
+Apart from central directory reads during indexing, which use temporary mappings, these
+functions are not thread safe.
 
 ###############################################################################################
 */
 
-typedef struct {
-	char *data;
-	int cd_length;
-	unsigned int zip_offset;
-	int entry_count;
-} central_directory_t;
+#define FSC_PK3_MAP_SLOTS 64
+
+struct fsc_pk3map_s {
+	fsc_filemap_t map;
+	fsc_ospath_t *os_path;
+	unsigned int os_timestamp;
+	int lock_count;
+	fsc_boolean stale;		// free when no longer locked
+	unsigned int last_used;
+};
+
+static fsc_pk3map_t pk3_maps[FSC_PK3_MAP_SLOTS];
+static fsc_boolean pk3_maps_enabled;
+static unsigned int pk3_map_counter;
+
+/*
+=================
+FSC_Pk3MapFree
+=================
+*/
+static void FSC_Pk3MapFree( fsc_pk3map_t *pk3map ) {
+	FSC_UnmapFile( &pk3map->map );
+	FSC_Free( pk3map->os_path );
+	FSC_Memset( pk3map, 0, sizeof( *pk3map ) );
+}
+
+/*
+=================
+FSC_Pk3MapAcquire
+
+Returns mapping for the given pk3, or null if mapping is disabled or not available.
+Mapping must be released by FSC_Pk3MapRelease.
+=================
+*/
+fsc_pk3map_t *FSC_Pk3MapAcquire( const fsc_file_direct_t *pk3, const fsc_filesystem_t *fs ) {
+	const fsc_ospath_t *os_path;
+	fsc_pk3map_t *target = FSC_NULL;
+	int os_path_size;
+	int i;
+
+	if ( !pk3_maps_enabled || !pk3->os_path_ptr ) {
+		return FSC_NULL;
+	}
+	os_path = (const fsc_ospath_t *)STACKPTR( pk3->os_path_ptr );
+
+	// Check for existing mapping
+	for ( i = 0; i < FSC_PK3_MAP_SLOTS; ++i ) {
+		fsc_pk3map_t *pk3map = &pk3_maps[i];
+		if ( pk3map->map.data && !pk3map->stale && pk3map->os_timestamp == pk3->os_timestamp &&
+				pk3map->map.size == pk3->f.filesize && !FSC_OSPathCompare( pk3map->os_path, os_path ) ) {
+			++pk3map->lock_count;
+			pk3map->last_used = ++pk3_map_counter;
+			return pk3map;
+		}
+	}
+
+	// Use empty slot, or replace least recently used mapping that isn't locked
+	for ( i = 0; i < FSC_PK3_MAP_SLOTS; ++i ) {
+		fsc_pk3map_t *pk3map = &pk3_maps[i];
+		if ( !pk3map->map.data ) {
+			target = pk3map;
+			break;
+		}
+		if ( !pk3map->lock_count && ( !target || pk3map->last_used < target->last_used ) ) {
+			target = pk3map;
+		}
+	}
+	if ( !target ) {
+		return FSC_NULL;
+	}
+	if ( target->map.data ) {
+		FSC_Pk3MapFree( target );
+	}
+
+	if ( FSC_MapFileRaw( os_path, &target->map, fsc_false ) ) {
+		return FSC_NULL;
+	}
+	if ( target->map.size != pk3->f.filesize ) {
+		// File changed since it was indexed; leave it to the regular read path
+		FSC_UnmapFile( &target->map );
+		return FSC_NULL;
+	}
+
+	os_path_size = FSC_OSPathSize( os_path );
+	target->os_path = (fsc_ospath_t *)FSC_Malloc( os_path_size );
+	FSC_Memcpy( target->os_path, os_path, os_path_size );
+	target->os_timestamp = pk3->os_timestamp;
+	target->lock_count = 1;
+	target->stale = fsc_false;
+	target->last_used = ++pk3_map_counter;
+	return target;
+}
+
+/*
+=================
+FSC_Pk3MapRelease
+=================
+*/
+void FSC_Pk3MapRelease( fsc_pk3map_t *pk3map ) {
+	FSC_ASSERT( pk3map && pk3map->lock_count > 0 );
+	--pk3map->lock_count;
+	if ( pk3map->stale && !pk3map->lock_count ) {
+		FSC_Pk3MapFree( pk3map );
+	}
+}
+
+/*
+=================
+FSC_Pk3MapReset
+
+Releases cached mappings, and sets whether pk3s are mapped for subsequent reads. Mappings
+still in use by open handles are released when the handles are closed.
+=================
+*/
+void FSC_Pk3MapReset( fsc_boolean enabled ) {
+	int i;
+	pk3_maps_enabled = enabled;
+	for ( i = 0; i < FSC_PK3_MAP_SLOTS; ++i ) {
+		fsc_pk3map_t *pk3map = &pk3_maps[i];
+		if ( !pk3map->map.data ) {
+			continue;
+		}
+		if ( pk3map->lock_count ) {
+			pk3map->stale = fsc_true;
+		} else {
+			FSC_Pk3MapFree( pk3map );
+		}
+	}
+}
+
+/*
+###############################################################################################
+
+PK3 File Indexing
+
+###############################################################################################
+*/
 
 /*
 =================
@@ -117,59 +258,40 @@ static fsc_boolean FSC_Pk3SeekSet( fsc_filehandle_t *fp, unsigned int offset ) {
 
 /*
 =================
-FSC_ReadPk3CentralDirectoryFP
+FSC_FindPk3Eocd
 
-Loads pk3 central directory to output structure. Returns true on error, false on success.
+Searches the last search_length bytes before data_end for the End Of Central Directory Record (EOCD).
+Returns offset from data_end of the record, or 0 if not found.
 =================
 */
-static fsc_boolean FSC_ReadPk3CentralDirectoryFP( fsc_filehandle_t *fp, unsigned int file_length, central_directory_t *output ) {
-	int pass;
-	char buffer[66000];
-	int buffer_read_size = 0;	// Offset from end of file/buffer of data that has been successfully read to buffer
-	int eocd_position = 0;		// Offset from end of file/buffer of the EOCD record
-	unsigned int cd_position;	// Offset from beginning of file of central directory
-
-	// End Of Central Directory Record (EOCD) can start anywhere in the last 65KB or so of the zip file,
-	// determined by the presence of a magic number. For performance purposes first scan the last 4KB of the file,
-	// and if the magic number isn't found do a second pass for the whole 65KB.
-
-	for ( pass = 0; pass < 2; ++pass ) {
-		// Get buffer_read_target, which is the offset from end of file/buffer that we are tring to read to buffer
-		int i;
-		int buffer_read_target = pass == 0 ? 4096 : sizeof( buffer );
-		if ( (unsigned int)buffer_read_target > file_length ) {
-			buffer_read_target = file_length;
-		}
-		if ( buffer_read_target <= buffer_read_size ) {
-			return fsc_true;
+static int FSC_FindPk3Eocd( const char *data_end, int search_length ) {
+	int i;
+
+	// EOCD cannot start less than 22 bytes from end of file, because it is 22 bytes long
+	for ( i = 22; i < search_length; ++i ) {
+		const char *string = data_end - i;
+		if ( string[0] == 0x50 && string[1] == 0x4b && string[2] == 0x05 && string[3] == 0x06 ) {
+			return i;
 		}
+	}
 
-		// Read the data
-		FSC_Pk3SeekSet( fp, file_length - buffer_read_target );
-		FSC_FRead( buffer + sizeof( buffer ) - buffer_read_target, buffer_read_target - buffer_read_size, fp );
-
-		// Search for magic number
-		// EOCD cannot start less than 22 bytes from end of file, because it is 22 bytes long
-		for ( i = 22; i < buffer_read_target; ++i ) {
-			char *string = buffer + sizeof( buffer ) - i;
-			if ( string[0] == 0x50 && string[1] == 0x4b && string[2] == 0x05 && string[3] == 0x06 ) {
-				eocd_position = i;
-				break;
-			}
-		}
+	return 0;
+}
 
-		buffer_read_size = buffer_read_target;
-		if ( eocd_position ) {
-			break;
-		}
-	}
+/*
+=================
+FSC_ParsePk3Eocd
 
-	if ( !eocd_position ) {
-		return fsc_true;
-	}
+Reads central directory parameters from EOCD record located eocd_position bytes from end of file.
+Returns true on error, false on success.
+=================
+*/
+static fsc_boolean FSC_ParsePk3Eocd( const char *eocd, int eocd_position, unsigned int file_length,
+		fsc_pk3_directory_t *output, unsigned int *cd_position_out ) {
+	unsigned int cd_position;	// Offset from beginning of file of central directory
 
-	#define EOCD_SHORT( offset ) FSC_ConvertLittleEndianShort( *(unsigned short *)( buffer + sizeof( buffer ) - eocd_position + offset ) )
-	#define EOCD_INT( offset ) FSC_ConvertLittleEndianInt( *(unsigned int *)( buffer + sizeof( buffer ) - eocd_position + offset ) )
+	#define EOCD_SHORT( offset ) FSC_ConvertLittleEndianShort( *(unsigned short *)( eocd + offset ) )
+	#define EOCD_INT( offset ) FSC_ConvertLittleEndianInt( *(unsigned int *)( eocd + offset ) )
 
 	output->entry_count = EOCD_SHORT( 8 );
 	output->cd_length = EOCD_INT( 12 );
@@ -207,6 +329,59 @@ static fsc_boolean FSC_ReadPk3CentralDirectoryFP( fsc_filehandle_t *fp, unsigned
 		output->zip_offset = cd_position - cd_position_reported;
 	}
 
+	*cd_position_out = cd_position;
+	return fsc_false;
+}
+
+/*
+=================
+FSC_ReadPk3CentralDirectoryFP
+
+Loads pk3 central directory to output structure. Returns true on error, false on success.
+=================
+*/
+static fsc_boolean FSC_ReadPk3CentralDirectoryFP( fsc_filehandle_t *fp, unsigned int file_length, fsc_pk3_directory_t *output ) {
+	int pass;
+	char buffer[66000];
+	int buffer_read_size = 0;	// Offset from end of file/buffer of data that has been successfully read to buffer
+	int eocd_position = 0;		// Offset from end of file/buffer of the EOCD record
+	unsigned int cd_position;	// Offset from beginning of file of central directory
+
+	// End Of Central Directory Record (EOCD) can start anywhere in the last 65KB or so of the zip file,
+	// determined by the presence of a magic number. For performance purposes first scan the last 4KB of the file,
+	// and if the magic number isn't found do a second pass for the whole 65KB.
+
+	for ( pass = 0; pass < 2; ++pass ) {
+		// Get buffer_read_target, which is the offset from end of file/buffer that we are tring to read to buffer
+		int buffer_read_target = pass == 0 ? 4096 : sizeof( buffer );
+		if ( (unsigned int)buffer_read_target > file_length ) {
+			buffer_read_target = file_length;
+		}
+		if ( buffer_read_target <= buffer_read_size ) {
+			return fsc_true;
+		}
+
+		// Read the data
+		FSC_Pk3SeekSet( fp, file_length - buffer_read_target );
+		FSC_FRead( buffer + sizeof( buffer ) - buffer_read_target, buffer_read_target - buffer_read_size, fp );
+
+		// Search for magic number
+		eocd_position = FSC_FindPk3Eocd( buffer + sizeof( buffer ), buffer_read_target );
+
+		buffer_read_size = buffer_read_target;
+		if ( eocd_position ) {
+			break;
+		}
+	}
+
+	if ( !eocd_position ) {
+		return fsc_true;
+	}
+
+	if ( FSC_ParsePk3Eocd( buffer + sizeof( buffer ) - eocd_position, eocd_position, file_length, output, &cd_position ) ) {
+		return fsc_true;
+	}
+
 	output->data = (char *)FSC_Malloc( output->cd_length );
 
 	// Read central directory to output, but try to use already buffered data if available
@@ -235,22 +410,74 @@ static fsc_boolean FSC_ReadPk3CentralDirectoryFP( fsc_filehandle_t *fp, unsigned
 	return fsc_false;
 }
 
+/*
+=================
+FSC_ReadPk3CentralDirectoryMapped
+
+Loads pk3 central directory to output structure from a mapped pk3. Locates the same EOCD record
+as FSC_ReadPk3CentralDirectoryFP. Returns true on error, false on success.
+=================
+*/
+static fsc_boolean FSC_ReadPk3CentralDirectoryMapped( const fsc_filemap_t *map, fsc_pk3_directory_t *output ) {
+	int search_length = map->size < 66000 ? (int)map->size : 66000;
+	int eocd_position = FSC_FindPk3Eocd( map->data + map->size, search_length );
+	unsigned int cd_position;
+
+	if ( !eocd_position ) {
+		return fsc_true;
+	}
+
+	if ( FSC_ParsePk3Eocd( map->data + map->size - eocd_position, eocd_position, map->size, output, &cd_position ) ) {
+		return fsc_true;
+	}
+
+	output->data = (char *)FSC_Malloc( output->cd_length );
+	FSC_Memcpy( output->data, map->data + cd_position, output->cd_length );
+	return fsc_false;
+}
+
 /*
 =================
 FSC_ReadPk3CentralDirectory
 
 Loads pk3 central directory to output structure with source pk3 specified by path.
-Returns true on error, false on success.
+Returns true on error, false on success. On error, output->error is set to a message
+for the caller to report.
+
+Doesn't access the filesystem index, so it can be called from worker threads.
 =================
 */
-static fsc_boolean FSC_ReadPk3CentralDirectory( fsc_ospath_t *os_path, central_directory_t *output, fsc_file_direct_t *source_file ) {
+fsc_boolean FSC_ReadPk3CentralDirectory( const fsc_ospath_t *os_path, fsc_pk3_directory_t *output ) {
 	fsc_filehandle_t *fp = FSC_NULL;
 	unsigned int length;
 
+	FSC_Memset( output, 0, sizeof( *output ) );
+
+	// Read from a temporary mapping if enabled, otherwise fall through to the regular path
+	// which also handles generating the error messages
+	if ( pk3_maps_enabled ) {
+		fsc_filemap_t map;
+		if ( !FSC_MapFileRaw( os_path, &map, fsc_false ) ) {
+			if ( map.size <= FSC_MAX_PK3_SIZE ) {
+				fsc_boolean result = FSC_ReadPk3CentralDirectoryMapped( &map, output );
+				FSC_UnmapFile( &map );
+				if ( result ) {
+					if ( output->data ) {
+						FSC_Free( output->data );
+						output->data = FSC_NULL;
+					}
+					output->error = "error retrieving pk3 central directory";
+				}
+				return result;
+			}
+			FSC_UnmapFile( &map );
+		}
+	}
+
 	// Open file
 	fp = FSC_FOpenRaw( os_path, "rb" );
 	if ( !fp ) {
-		FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_PK3FILE, "error opening pk3", source_file );
+		output->error = "error opening pk3";
 		return fsc_true;
 	}
 
@@ -259,19 +486,23 @@ static fsc_boolean FSC_ReadPk3CentralDirectory( fsc_ospath_t *os_path, central_d
 	length = FSC_FTell( fp );
 	if ( !length ) {
 		FSC_FClose( fp );
-		FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_PK3FILE, "zero size pk3", source_file );
+		output->error = "zero size pk3";
 		return fsc_true;
 	}
 	if ( length > FSC_MAX_PK3_SIZE ) {
 		FSC_FClose( fp );
-		FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_PK3FILE, "excessively large pk3", source_file );
+		output->error = "excessively large pk3";
 		return fsc_true;
 	}
 
 	// Get central directory
 	if ( FSC_ReadPk3CentralDirectoryFP( fp, length, output ) ) {
 		FSC_FClose( fp );
-		FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_PK3FILE, "error retrieving pk3 central directory", source_file );
+		if ( output->data ) {
+			FSC_Free( output->data );
+			output->data = FSC_NULL;
+		}
+		output->error = "error retrieving pk3 central directory";
 		return fsc_true;
 	}
 	FSC_FClose( fp );
@@ -339,17 +570,19 @@ static void FSC_RegisterPk3Subfile( fsc_filesystem_t *fs, char *filename, int fi
 
 /*
 =================
-FSC_LoadPk3
+FSC_LoadPk3Directory
 
-Registers a pk3 file and all subcontents into the filesystem index.
+Registers all subcontents of a pk3 into the filesystem index from a central directory
+previously read by FSC_ReadPk3CentralDirectory. Reports the read error if there was one.
+Takes ownership of the central directory data.
 
 Can also be called with receive_hash_data set to extract pk3 hash checksums without indexing anything.
 =================
 */
-void FSC_LoadPk3( fsc_ospath_t *os_path, fsc_filesystem_t *fs, fsc_stackptr_t sourcefile_ptr,
+void FSC_LoadPk3Directory( fsc_pk3_directory_t *directory, fsc_filesystem_t *fs, fsc_stackptr_t sourcefile_ptr,
 		void ( *receive_hash_data )( void *context, char *data, int size ), void *receive_hash_data_context ) {
 	fsc_file_direct_t *sourcefile = fs ? (fsc_file_direct_t *)STACKPTRN( sourcefile_ptr ) : FSC_NULL;
-	central_directory_t cd;
+	fsc_pk3_directory_t cd = *directory;
 	int entry_position = 0;		// Position of current entry relative to central directory data
 	int entry_counter;			// Number of current entry
 
@@ -364,6 +597,14 @@ void FSC_LoadPk3( fsc_ospath_t *os_path, fsc_filesystem_t *fs, fsc_stackptr_t so
 	int crcs_for_hash_count = 0;
 
 	fsc_sanity_limit_t sanity_limit;
+
+	directory->data = FSC_NULL;
+	if ( cd.error ) {
+		FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_PK3FILE, cd.error, sourcefile );
+		return;
+	}
+	FSC_ASSERT( cd.data );
+
 	FSC_Memset( &sanity_limit, 0, sizeof( sanity_limit ) );
 
 	if ( !receive_hash_data ) {
@@ -379,11 +620,6 @@ void FSC_LoadPk3( fsc_ospath_t *os_path, fsc_filesystem_t *fs, fsc_stackptr_t so
 		sanity_limit.pk3file = sourcefile;
 	}
 
-	// Load central directory
-	if ( FSC_ReadPk3CentralDirectory( os_path, &cd, sourcefile ) ) {
-		return;
-	}
-
 	// Try to use the stack buffer, but if it's not big enough resort to malloc
 	if ( cd.entry_count > sizeof( crcs_for_hash_buffer ) / sizeof( *crcs_for_hash_buffer ) ) {
 		crcs_for_hash = (int *)FSC_Malloc( ( cd.entry_count + 1 ) * 4 );
@@ -470,6 +706,22 @@ void FSC_LoadPk3( fsc_ospath_t *os_path, fsc_filesystem_t *fs, fsc_stackptr_t so
 	}
 }
 
+/*
+=================
+FSC_LoadPk3
+
+Registers a pk3 file and all subcontents into the filesystem index.
+
+Can also be called with receive_hash_data set to extract pk3 hash checksums without indexing anything.
+=================
+*/
+void FSC_LoadPk3( fsc_ospath_t *os_path, fsc_filesystem_t *fs, fsc_stackptr_t sourcefile_ptr,
+		void ( *receive_hash_data )( void *context, char *data, int size ), void *receive_hash_data_context ) {
+	fsc_pk3_directory_t cd;
+	FSC_ReadPk3CentralDirectory( os_path, &cd );
+	FSC_LoadPk3Directory( &cd, fs, sourcefile_ptr, receive_hash_data, receive_hash_data_context );
+}
+
 /*
 =================
 FSC_GetPk3HashCallback
@@ -517,7 +769,11 @@ PK3 Handle Operations
 typedef struct fsc_pk3handle_s {
 	fsc_filehandle_t *input_handle;
 	int compression_method;
-	unsigned int input_remaining;	// Remaining to be read from input handle
+	unsigned int input_remaining;	// Remaining to be read from input handle or mapping
+
+	// For mapped pk3s only
+	fsc_pk3map_t *pk3map;
+	const char *map_position;
 
 	// For zlib streams only
 	unsigned int input_buffer_size;
@@ -537,18 +793,30 @@ static int FSC_Pk3HandleLoad( fsc_pk3handle_t *handle, const fsc_file_frompk3_t
 	char localheader[30];
 	unsigned int data_position;
 
-	// Open the file
-	handle->input_handle = FSC_FOpenRaw( (const fsc_ospath_t *)STACKPTR( source_pk3->os_path_ptr ), "rb" );
-	if ( !handle->input_handle ) {
-		FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_EXTRACT, "pk3_handle_open - failed to open pk3 file", FSC_NULL );
-		return fsc_true;
+	// Use mapping if available, otherwise open the file
+	handle->pk3map = FSC_Pk3MapAcquire( source_pk3, fs );
+	if ( !handle->pk3map ) {
+		handle->input_handle = FSC_FOpenRaw( (const fsc_ospath_t *)STACKPTR( source_pk3->os_path_ptr ), "rb" );
+		if ( !handle->input_handle ) {
+			FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_EXTRACT, "pk3_handle_open - failed to open pk3 file", FSC_NULL );
+			return fsc_true;
+		}
 	}
 
 	// Read the local header to get data position
-	FSC_Pk3SeekSet( handle->input_handle, file->header_position );
-	if ( FSC_FRead( localheader, 30, handle->input_handle ) != 30 ) {
-		FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_EXTRACT, "pk3_handle_open - failed to read local header", FSC_NULL );
-		return fsc_true;
+	if ( handle->pk3map ) {
+		const fsc_filemap_t *map = &handle->pk3map->map;
+		if ( map->size < 30 || file->header_position > map->size - 30 ) {
+			FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_EXTRACT, "pk3_handle_open - failed to read local header", FSC_NULL );
+			return fsc_true;
+		}
+		FSC_Memcpy( localheader, map->data + file->header_position, 30 );
+	} else {
+		FSC_Pk3SeekSet( handle->input_handle, file->header_position );
+		if ( FSC_FRead( localheader, 30, handle->input_handle ) != 30 ) {
+			FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_EXTRACT, "pk3_handle_open - failed to read local header", FSC_NULL );
+			return fsc_true;
+		}
 	}
 	if ( localheader[0] != 0x50 || localheader[1] != 0x4b || localheader[2] != 0x03 || localheader[3] != 0x04 ) {
 		FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_EXTRACT, "pk3_handle_open - incorrect signature in local header", FSC_NULL );
@@ -559,7 +827,16 @@ static int FSC_Pk3HandleLoad( fsc_pk3handle_t *handle, const fsc_file_frompk3_t
 	data_position = file->header_position + LH_SHORT( 26 ) + LH_SHORT( 28 ) + 30;
 
 	// Seek to data start position
-	FSC_Pk3SeekSet( handle->input_handle, data_position );
+	if ( handle->pk3map ) {
+		const fsc_filemap_t *map = &handle->pk3map->map;
+		if ( data_position > map->size || file->compressed_size > map->size - data_position ) {
+			FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_EXTRACT, "pk3_handle_open - file data exceeds pk3 size", FSC_NULL );
+			return fsc_true;
+		}
+		handle->map_position = map->data + data_position;
+	} else {
+		FSC_Pk3SeekSet( handle->input_handle, data_position );
+	}
 
 	// Configure the handle
 	handle->input_remaining = file->compressed_size;
@@ -570,8 +847,15 @@ static int FSC_Pk3HandleLoad( fsc_pk3handle_t *handle, const fsc_file_frompk3_t
 		}
 
 		handle->compression_method = 8;
-		handle->input_buffer_size = input_buffer_size;
-		handle->input_buffer = (char *)FSC_Malloc( input_buffer_size );
+		if ( handle->pk3map ) {
+			// Inflate directly from the mapping
+			handle->zlib_stream.next_in = (Bytef *)handle->map_position;
+			handle->zlib_stream.avail_in = handle->input_remaining;
+			handle->input_remaining = 0;
+		} else {
+			handle->input_buffer_size = input_buffer_size;
+			handle->input_buffer = (char *)FSC_Malloc( input_buffer_size );
+		}
 	} else if ( file->compression_method != 0 ) {
 		FSC_ReportError( FSC_ERRORLEVEL_WARNING, FSC_ERROR_EXTRACT, "pk3_handle_open - unknown compression method", FSC_NULL );
 		return fsc_true;
@@ -594,6 +878,9 @@ fsc_pk3handle_t *FSC_Pk3HandleOpen( const fsc_file_frompk3_t *file, int input_bu
 		if ( handle->input_handle ) {
 			FSC_FClose( handle->input_handle );
 		}
+		if ( handle->pk3map ) {
+			FSC_Pk3MapRelease( handle->pk3map );
+		}
 		FSC_Free( handle );
 		return FSC_NULL;
 	}
@@ -609,9 +896,12 @@ FSC_Pk3HandleClose
 void FSC_Pk3HandleClose( fsc_pk3handle_t *handle ) {
 	if ( handle->input_handle )
 		FSC_FClose( handle->input_handle );
+	if ( handle->pk3map )
+		FSC_Pk3MapRelease( handle->pk3map );
 
 	if ( handle->compression_method == 8 ) {
-		FSC_Free( handle->input_buffer );
+		if ( handle->input_buffer )
+			FSC_Free( handle->input_buffer );
 		inflateEnd( &handle->zlib_stream );
 	}
 
@@ -656,11 +946,37 @@ unsigned int FSC_Pk3HandleRead( fsc_pk3handle_t *handle, char *buffer, unsigned
 
 		return length - handle->zlib_stream.avail_out;
 
+	} else if ( handle->pk3map ) {
+		if ( length > handle->input_remaining ) {
+			length = handle->input_remaining;
+		}
+		FSC_Memcpy( buffer, handle->map_position, length );
+		handle->map_position += length;
+		handle->input_remaining -= length;
+		return length;
+
 	} else {
 		return FSC_FRead( buffer, length, handle->input_handle );
 	}
 }
 
+/*
+=================
+FSC_Pk3HandleMappedData
+
+If the handle is reading an uncompressed file from a mapped pk3, returns a pointer to the
+unread file data in the mapping and writes the size to size_out. Otherwise returns null.
+Data remains valid until the handle is closed.
+=================
+*/
+const char *FSC_Pk3HandleMappedData( fsc_pk3handle_t *handle, unsigned int *size_out ) {
+	if ( !handle->pk3map || handle->compression_method != 0 ) {
+		return FSC_NULL;
+	}
+	*size_out = handle->input_remaining;
+	return handle->map_position;
+}
+
 /*
 ###############################################################################################
 
@@ -26,7 +26,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 // If the version in the cache file does not match this string, the cache will be rebuilt.
 // This version should always be incremented when anything affecting the cache file format changes.
-#define FSC_CACHE_VERSION "quake3e-fs-v14"
+#define FSC_CACHE_VERSION "quake3e-fs-v15"
 
 #define FSC_MAX_QPATH 256	// Buffer size including null terminator
 #define FSC_MAX_MODDIR 32	// Buffer size including null terminator
@@ -52,6 +52,18 @@ typedef struct {
 	int _unused;
 } fsc_ospath_t;
 
+typedef struct {
+	const char *data;
+	unsigned int size;
+	void *os_handle;
+} fsc_filemap_t;
+
+typedef enum {
+	FSC_PATHTYPE_NONE,
+	FSC_PATHTYPE_FILE,
+	FSC_PATHTYPE_DIRECTORY
+} fsc_pathtype_t;
+
 typedef struct {
 	char *data;
 	unsigned int position;
@@ -68,8 +80,17 @@ typedef struct {
 	fsc_stack_bucket_t **buckets;
 	int buckets_position;
 	int buckets_size;
+
+	// Leading buckets imported in place from an exported image, which are not individually allocated.
+	// The image is released along with the stack.
+	int external_buckets;
+	char *external_data;			// image buffer, if read into memory
+	fsc_filemap_t external_map;		// image mapping, if mapped from file
 } fsc_stack_t;
 
+// Exported stack buckets are aligned to this relative to the start of the export stream
+#define FSC_STACK_EXPORT_ALIGNMENT 16
+
 typedef unsigned int fsc_stackptr_t;
 
 #define FSC_STACK_RETRIEVE( stack, pointer, allow_null ) \
@@ -127,6 +148,10 @@ typedef struct {
 	unsigned int filesize;
 } iterate_data_t;
 
+// Runs func once for each index from 0 to count - 1, potentially on multiple threads.
+// Must not return until all calls have completed.
+typedef void ( *fsc_jobs_handler_t )( int count, void ( *func )( int index, void *context ), void *context );
+
 typedef enum {
 	FSC_SEEK_SET,
 	FSC_SEEK_CUR,
@@ -359,8 +384,11 @@ void FSC_LoadFileFromPath( int source_dir_id, const fsc_ospath_t *os_path, const
 void FSC_FilesystemInitialize( fsc_filesystem_t *fs );
 void FSC_FilesystemFree( fsc_filesystem_t *fs );
 void FSC_FilesystemReset( fsc_filesystem_t *fs );
-void FSC_LoadDirectoryRawPath( fsc_filesystem_t *fs, fsc_ospath_t *os_path, int source_dir_id );
-void FSC_LoadDirectory( fsc_filesystem_t *fs, const char *path, int source_dir_id );
+void FSC_LoadDirectoryRawPath( fsc_filesystem_t *fs, fsc_ospath_t *os_path, int source_dir_id,
+		fsc_jobs_handler_t jobs_handler );
+void FSC_LoadDirectory( fsc_filesystem_t *fs, const char *path, int source_dir_id, fsc_jobs_handler_t jobs_handler );
+void FSC_RefreshPaths( fsc_filesystem_t *fs, const char *source_path, int source_dir_id,
+		const char *const *paths, int path_count );
 
 /* ******************************************************************************** */
 // Misc (fsc_misc.c)
@@ -383,7 +411,7 @@ void *FSC_StackRetrieve( const fsc_stack_t *stack, const fsc_stackptr_t pointer,
 void FSC_StackFree( fsc_stack_t *stack );
 unsigned int FSC_StackExportSize( fsc_stack_t *stack );
 fsc_boolean FSC_StackExport( fsc_stack_t *stack, fsc_stream_t *stream );
-fsc_boolean FSC_StackImport( fsc_stack_t *stack, fsc_stream_t *stream );
+fsc_boolean FSC_StackImportInPlace( fsc_stack_t *stack, fsc_stream_t *stream );
 
 // ***** Hashtable *****
 
@@ -442,6 +470,7 @@ fsc_ospath_t *FSC_StringToOSPath( const char *path ); // WARNING: Result must be
 char *FSC_OSPathToString( const fsc_ospath_t *os_path ); // WARNING: Result must be freed by caller using FSC_Free!!!
 int FSC_OSPathSize( const fsc_ospath_t *os_path );
 int FSC_OSPathCompare( const fsc_ospath_t *path1, const fsc_ospath_t *path2 );
+fsc_boolean FSC_OSPathIsWithin( const fsc_ospath_t *path, const fsc_ospath_t *base_path );
 
 void FSC_IterateDirectory( fsc_ospath_t *search_os_path, void( operation )( iterate_data_t *file_data,
 		void *iterate_context ), void *iterate_context );
@@ -460,6 +489,9 @@ unsigned int FSC_FWrite( const void *src, int size, fsc_filehandle_t *fp );
 void FSC_FFlush( fsc_filehandle_t *fp );
 int FSC_FSeek( fsc_filehandle_t *fp, int offset, fsc_seek_type_t type );
 unsigned int FSC_FTell( fsc_filehandle_t *fp );
+fsc_pathtype_t FSC_GetPathInfoRaw( const fsc_ospath_t *os_path, unsigned int *os_timestamp, unsigned int *filesize );
+fsc_boolean FSC_MapFileRaw( const fsc_ospath_t *os_path, fsc_filemap_t *map, fsc_boolean copy_on_write );
+void FSC_UnmapFile( fsc_filemap_t *map );
 void FSC_Memcpy( void *dst, const void *src, unsigned int size );
 int FSC_Memcmp( const void *str1, const void *str2, unsigned int size );
 void FSC_Memset( void *dst, int value, unsigned int size );
@@ -476,18 +508,35 @@ void FSC_Free( void *allocation );
 // PK3 Handling (fsc_pk3.c)
 /* ******************************************************************************** */
 
+typedef struct {
+	char *data;
+	int cd_length;
+	unsigned int zip_offset;
+	int entry_count;
+	const char *error;		// null if central directory was read successfully
+} fsc_pk3_directory_t;
+
 // receive_hash_data is used for standalone hash calculation operations,
 // and should be nulled during normal filesystem loading
+fsc_boolean FSC_ReadPk3CentralDirectory( const fsc_ospath_t *os_path, fsc_pk3_directory_t *output );
+void FSC_LoadPk3Directory( fsc_pk3_directory_t *directory, fsc_filesystem_t *fs, fsc_stackptr_t sourcefile_ptr,
+		void ( *receive_hash_data )( void *context, char *data, int size ), void *receive_hash_data_context );
 void FSC_LoadPk3( fsc_ospath_t *os_path, fsc_filesystem_t *fs, fsc_stackptr_t sourcefile_ptr,
 		void ( *receive_hash_data )( void *context, char *data, int size ), void *receive_hash_data_context );
 unsigned int FSC_GetPk3HashRawPath( fsc_ospath_t *os_path );
 unsigned int FSC_GetPk3Hash( const char *path );
 void FSC_RegisterPk3HashLookup( fsc_stackptr_t pk3_file_ptr, fsc_hashtable_t *pk3_hash_lookup, fsc_stack_t *stack );
 
+typedef struct fsc_pk3map_s fsc_pk3map_t;
+fsc_pk3map_t *FSC_Pk3MapAcquire( const fsc_file_direct_t *pk3, const fsc_filesystem_t *fs );
+void FSC_Pk3MapRelease( fsc_pk3map_t *pk3map );
+void FSC_Pk3MapReset( fsc_boolean enabled );
+
 typedef struct fsc_pk3handle_s fsc_pk3handle_t;
 fsc_pk3handle_t *FSC_Pk3HandleOpen( const fsc_file_frompk3_t *file, int input_buffer_size, const fsc_filesystem_t *fs );
 void FSC_Pk3HandleClose( fsc_pk3handle_t *handle );
 unsigned int FSC_Pk3HandleRead( fsc_pk3handle_t *handle, char *buffer, unsigned int length );
+const char *FSC_Pk3HandleMappedData( fsc_pk3handle_t *handle, unsigned int *size_out );
 extern fsc_sourcetype_t pk3_sourcetype;
 
 /* ******************************************************************************** */
@@ -528,5 +577,5 @@ fsc_boolean FSC_ShaderIteratorAdvance( fsc_shader_iterator_t *it );
 
 fsc_boolean FSC_CacheExportFileRawPath( fsc_filesystem_t *source_fs, fsc_ospath_t *os_path );
 fsc_boolean FSC_CacheExportFile( fsc_filesystem_t *source_fs, const char *path );
-fsc_boolean FSC_CacheImportFileRawPath( fsc_ospath_t *os_path, fsc_filesystem_t *target_fs );
-fsc_boolean FSC_CacheImportFile( const char *path, fsc_filesystem_t *target_fs );
+fsc_boolean FSC_CacheImportFileRawPath( fsc_ospath_t *os_path, fsc_filesystem_t *target_fs, fsc_boolean map_file );
+fsc_boolean FSC_CacheImportFile( const char *path, fsc_filesystem_t *target_fs, fsc_boolean map_file );
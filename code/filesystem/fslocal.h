@@ -117,6 +117,15 @@ typedef struct {
 	cvar_t *fs_full_pure_validation;
 	cvar_t *fs_download_mode;
 	cvar_t *fs_auto_refresh_enabled;
+	#ifdef STEF_FS_PARALLEL_INDEX
+	cvar_t *fs_index_threads;
+	#endif
+	#ifdef STEF_FS_PK3_MMAP
+	cvar_t *fs_pk3_mmap;
+	#endif
+	#ifdef STEF_FS_INOTIFY_REFRESH
+	cvar_t *fs_watch;
+	#endif
 	#ifdef FS_SERVERCFG_ENABLED
 	cvar_t *fs_servercfg;
 	cvar_t *fs_servercfg_listlimit;
@@ -157,6 +157,9 @@ DEF_PUBLIC( void FS_SetFilenameCallback( fnamecallback_f func ) )
 
 // Filesystem Refresh
 DEF_LOCAL( void FS_Refresh( qboolean quiet ) )
+#ifdef STEF_FS_INOTIFY_REFRESH
+DEF_LOCAL( void FS_RefreshPaths( const char *const *paths, const int *source_dir_ids, int count ) )
+#endif
 DEF_LOCAL( qboolean FS_RecentlyRefreshed( void ) )
 DEF_PUBLIC( void FS_AutoRefresh( void ) )
 
@@ -206,7 +209,9 @@ DEF_PUBLIC( qboolean FS_FileExists( const char *file ) )
 
 // File read cache
 DEF_PUBLIC( void FS_ReadCache_Initialize( void ) )
-DEF_PUBLIC( void FS_ReadCache_AdvanceStage( void ) )
+DEF_LOCAL( qboolean FS_ReadCache_IsCached( const fsc_file_t *file ) )
+DEF_LOCAL( void FS_ReadCache_PrintStats( void ) )
+DEF_LOCAL( void FS_ReadCache_ResetStats( void ) )
 DEF_LOCAL( void FS_ReadCache_Debug( void ) )
 
 // Data reading
@@ -389,3 +394,13 @@ DEF_LOCAL( void FS_CheckCorePaks( void ) )
 /* ******************************************************************************** */
 
 DEF_LOCAL( qboolean FS_CheckTrustedVMHash( unsigned char *hash ) )
+
+/* ******************************************************************************** */
+// Filesystem Watch (fs_watch.c)
+/* ******************************************************************************** */
+
+#ifdef STEF_FS_INOTIFY_REFRESH
+DEF_LOCAL( void FS_Watch_Init( void ) )
+DEF_LOCAL( void FS_Watch_BeginFullRefresh( void ) )
+DEF_LOCAL( qboolean FS_Watch_AutoRefresh( void ) )
+#endif
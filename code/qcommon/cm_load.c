@@ -772,6 +772,13 @@ int CM_NumClusters( void ) {
 }
 
 
+#ifdef STEF_SNAPSHOT_VIS_INDEX
+int CM_NumAreas( void ) {
+	return cm.numAreas;
+}
+#endif
+
+
 int CM_NumInlineModels( void ) {
 	return cm.numSubModels;
 }
@@ -4157,6 +4157,9 @@ void Com_Init( char *commandLine ) {
 
 	Cmd_AddCommand( "quit", Com_Quit_f );
 	Cmd_AddCommand( "changeVectors", MSG_ReportChangeVectors_f );
+#ifdef STEF_HUFFMAN_WHOLE_CODES
+	Cmd_AddCommand( "huffman_benchmark", Huffman_Benchmark_f );
+#endif
 	Cmd_AddCommand( "writeconfig", Com_WriteConfig_f );
 	Cmd_SetCommandCompletionFunc( "writeconfig", Cmd_CompleteWriteCfgName );
 	Cmd_AddCommand( "game_restart", Com_GameRestart_f );
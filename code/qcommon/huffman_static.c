@@ -175,6 +175,79 @@ void HuffmanPutBit( byte* fout, int32_t bitIndex, int bit )
 }
 
 
+#ifdef STEF_HUFFMAN_WHOLE_CODES
+/*
+==================
+HuffmanPutBits
+
+Writes multiple bits at once with the same output as calling HuffmanPutBit for each
+bit: the first byte is merged if the write starts partway into it, and any following
+bytes are overwritten. Count plus the bit offset within the first byte must not exceed 64.
+==================
+*/
+static void HuffmanPutBits( byte* fout, uint32_t offset, uint64_t bits, int count )
+{
+	byte *out = fout + ( offset >> 3 );
+	const int shift = offset & 7;
+	int i;
+
+	if ( count <= 0 )
+		return;
+
+	bits = ( bits & ( ( (uint64_t)1 << count ) - 1 ) ) << shift;
+	count += shift;
+
+	if ( shift )
+		out[0] |= (byte)bits;
+	else
+		out[0] = (byte)bits;
+
+	for ( i = 1; i * 8 < count; ++i )
+		out[i] = (byte)( bits >> ( i * 8 ) );
+}
+
+
+int HuffmanPutSymbol( byte* fout, uint32_t offset, int symbol )
+{
+	const uint16_t result = HuffmanEncoderTable[ symbol ];
+	const uint16_t bitCount = result & 15;
+	const uint16_t code = (result >> 4) & 0x7FF;
+
+	HuffmanPutBits( fout, offset, code, bitCount );
+
+	return bitCount;
+}
+
+
+/*
+==================
+HuffmanPutValue
+
+Writes a MSG_WriteBits value: the low (bits & 7) bits raw, followed by a huffman
+symbol for each remaining byte. All codes are combined and stored in a single write.
+Returns number of bits written.
+==================
+*/
+int HuffmanPutValue( byte* fout, uint32_t offset, uint32_t value, int bits )
+{
+	const int rawBits = bits & 7;
+	uint64_t out = value & ( ( 1u << rawBits ) - 1 );
+	int outBits = rawBits;
+	int i;
+
+	value >>= rawBits;
+	for ( i = rawBits; i < bits; i += 8 )
+	{
+		const uint16_t result = HuffmanEncoderTable[ value & 0xFF ];
+		out |= (uint64_t)( ( result >> 4 ) & 0x7FF ) << outBits;
+		outBits += result & 15;
+		value >>= 8;
+	}
+
+	HuffmanPutBits( fout, offset, out, outBits );
+	return outBits;
+}
+#else
 int HuffmanPutSymbol( byte* fout, uint32_t offset, int symbol )
 {
 	int32_t bits;
@@ -192,6 +265,7 @@ int HuffmanPutSymbol( byte* fout, uint32_t offset, int symbol )
 
 	return bitCount;
 }
+#endif
 
 
 int HuffmanGetBit( const byte* buffer, int bitIndex )
@@ -209,3 +283,210 @@ int HuffmanGetSymbol( unsigned int* symbol, const byte* buffer, int bitIndex )
 
 	return (int)(entry >> 8);
 }
+
+#ifdef STEF_HUFFMAN_WHOLE_CODES
+/*
+==================
+HuffmanGetValue
+
+Reads a value written by HuffmanPutValue, with the raw bits extracted in one step and
+each symbol decoded with a single table lookup. Stores number of bits read in bitsRead.
+==================
+*/
+uint32_t HuffmanGetValue( const byte* buffer, int bitIndex, int bits, int* bitsRead )
+{
+	const int rawBits = bits & 7;
+	const int startIndex = bitIndex;
+	uint32_t value = 0;
+	int i;
+
+	if ( rawBits )
+	{
+		value = ( buffer[bitIndex >> 3] | ( buffer[( bitIndex >> 3 ) + 1] << 8 ) ) >> ( bitIndex & 7 );
+		value &= ( 1u << rawBits ) - 1;
+		bitIndex += rawBits;
+	}
+
+	for ( i = rawBits; i < bits; i += 8 )
+	{
+		const uint16_t code = ((*(const uint32_t*)(buffer + (bitIndex >> 3))) >> ((uint32_t)bitIndex & 7)) & 0x7FF;
+		const uint16_t entry = HuffmanDecoderTable[ code ];
+		value |= (uint32_t)( entry & 0xFF ) << i;
+		bitIndex += entry >> 8;
+	}
+
+	*bitsRead = bitIndex - startIndex;
+	return value;
+}
+
+/* ******************************************************************************** */
+// Benchmark
+/* ******************************************************************************** */
+
+#define HUFFMAN_BENCHMARK_VALUES 4096
+#define HUFFMAN_BENCHMARK_BUFFER ( HUFFMAN_BENCHMARK_VALUES * 6 + 16 )
+
+/*
+==================
+HuffmanBenchmark_PutValueBitwise
+
+Reference encoder matching the original MSG_WriteBits loop, which writes each bit
+individually.
+==================
+*/
+static int HuffmanBenchmark_PutValueBitwise( byte* fout, uint32_t offset, uint32_t value, int bits )
+{
+	const int rawBits = bits & 7;
+	const uint32_t start = offset;
+	int i, j;
+
+	for ( i = 0; i < rawBits; ++i )
+	{
+		HuffmanPutBit( fout, offset++, value & 1 );
+		value >>= 1;
+	}
+
+	for ( i = rawBits; i < bits; i += 8 )
+	{
+		const uint16_t result = HuffmanEncoderTable[ value & 0xFF ];
+		int code = (result >> 4) & 0x7FF;
+		for ( j = 0; j < ( result & 15 ); ++j )
+		{
+			HuffmanPutBit( fout, offset++, code & 1 );
+			code >>= 1;
+		}
+		value >>= 8;
+	}
+
+	return (int)( offset - start );
+}
+
+/*
+==================
+HuffmanBenchmark_GetValueBitwise
+
+Reference decoder matching the original MSG_ReadBits loop.
+==================
+*/
+static uint32_t HuffmanBenchmark_GetValueBitwise( const byte* buffer, int bitIndex, int bits, int* bitsRead )
+{
+	const int rawBits = bits & 7;
+	const int startIndex = bitIndex;
+	uint32_t value = 0;
+	unsigned int sym;
+	int i;
+
+	for ( i = 0; i < rawBits; ++i )
+	{
+		value |= HuffmanGetBit( buffer, bitIndex++ ) << i;
+	}
+
+	for ( i = rawBits; i < bits; i += 8 )
+	{
+		bitIndex += HuffmanGetSymbol( &sym, buffer, bitIndex );
+		value |= sym << i;
+	}
+
+	*bitsRead = bitIndex - startIndex;
+	return value;
+}
+
+/*
+==================
+Huffman_Benchmark_f
+
+Compares the whole code encoder and decoder against the bitwise reference versions
+on a set of values with typical network field sizes, and verifies identical output.
+==================
+*/
+void Huffman_Benchmark_f( void )
+{
+	static const int fieldBits[] = { 1, 8, 32, 16, 10, 7, 24, 19, 32, 4, 8, 2 };
+	static uint32_t values[HUFFMAN_BENCHMARK_VALUES];
+	static int sizes[HUFFMAN_BENCHMARK_VALUES];
+	static byte reference[HUFFMAN_BENCHMARK_BUFFER];
+	static byte output[HUFFMAN_BENCHMARK_BUFFER];
+	int iterations = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 1000;
+	int64_t start, timeEncodeRef, timeEncode, timeDecodeRef, timeDecode;
+	uint32_t seed = 0x12345678;
+	int i, iter, offset, refBits = 0, bits = 0, count;
+	uint32_t check = 0;
+
+	if ( iterations < 1 )
+		iterations = 1;
+
+	// low byte values are weighted similar to real traffic, which is dominated by zeros
+	for ( i = 0; i < HUFFMAN_BENCHMARK_VALUES; ++i )
+	{
+		seed = seed * 1664525 + 1013904223;
+		sizes[i] = fieldBits[i % ARRAY_LEN( fieldBits )];
+		values[i] = ( seed >> 8 ) & ( ( seed & 3 ) ? 0xFF : 0xFFFFFF );
+		if ( sizes[i] < 32 )
+			values[i] &= ( 1u << sizes[i] ) - 1;
+	}
+
+	Com_Memset( reference, 0xAA, sizeof( reference ) );
+	Com_Memset( output, 0x55, sizeof( output ) );
+
+	start = Sys_Microseconds();
+	for ( iter = 0; iter < iterations; ++iter )
+	{
+		for ( i = 0, offset = 0; i < HUFFMAN_BENCHMARK_VALUES; ++i )
+			offset += HuffmanBenchmark_PutValueBitwise( reference, offset, values[i], sizes[i] );
+		refBits = offset;
+	}
+	timeEncodeRef = Sys_Microseconds() - start;
+
+	start = Sys_Microseconds();
+	for ( iter = 0; iter < iterations; ++iter )
+	{
+		for ( i = 0, offset = 0; i < HUFFMAN_BENCHMARK_VALUES; ++i )
+			offset += HuffmanPutValue( output, offset, values[i], sizes[i] );
+		bits = offset;
+	}
+	timeEncode = Sys_Microseconds() - start;
+
+	if ( bits != refBits || memcmp( reference, output, ( bits + 7 ) >> 3 ) )
+	{
+		Com_Printf( "huffman_benchmark: encoder output mismatch\n" );
+		return;
+	}
+
+	start = Sys_Microseconds();
+	for ( iter = 0; iter < iterations; ++iter )
+	{
+		for ( i = 0, offset = 0; i < HUFFMAN_BENCHMARK_VALUES; ++i )
+		{
+			check += HuffmanBenchmark_GetValueBitwise( reference, offset, sizes[i], &count );
+			offset += count;
+		}
+	}
+	timeDecodeRef = Sys_Microseconds() - start;
+
+	start = Sys_Microseconds();
+	for ( iter = 0; iter < iterations; ++iter )
+	{
+		for ( i = 0, offset = 0; i < HUFFMAN_BENCHMARK_VALUES; ++i )
+		{
+			check -= HuffmanGetValue( reference, offset, sizes[i], &count );
+			offset += count;
+		}
+	}
+	timeDecode = Sys_Microseconds() - start;
+
+	for ( i = 0, offset = 0; i < HUFFMAN_BENCHMARK_VALUES; ++i )
+	{
+		if ( HuffmanGetValue( reference, offset, sizes[i], &count ) != values[i] )
+		{
+			Com_Printf( "huffman_benchmark: decoder output mismatch\n" );
+			return;
+		}
+		offset += count;
+	}
+
+	Com_Printf( "%i values x %i iterations, %i bytes per pass (checksum %u)\n", HUFFMAN_BENCHMARK_VALUES,
+			iterations, ( bits + 7 ) >> 3, check );
+	Com_Printf( "encode: bitwise %i usec, whole codes %i usec\n", (int)timeEncodeRef, (int)timeEncode );
+	Com_Printf( "decode: bitwise %i usec, whole codes %i usec\n", (int)timeDecodeRef, (int)timeDecode );
+}
+#endif
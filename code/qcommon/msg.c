@@ -85,6 +85,56 @@ void MSG_Copy(msg_t *buf, byte *data, int length, const msg_t *src)
 	Com_Memcpy(buf->data, src->data, src->cursize);
 }
 
+#if defined( STEF_SNAPSHOT_ENTITY_CACHE ) || defined( STEF_RECORD_SPECTATOR_CACHE )
+/*
+==================
+MSG_WriteBitStream
+
+Appends bits that were written starting at bit 0 of a separate buffer with the same
+write mode. Only valid for huffman and compat modes, where written bits don't depend
+on their position in the message.
+==================
+*/
+void MSG_WriteBitStream( msg_t *msg, const byte *data, int bits ) {
+	int shift, bytes, lastByte, i;
+	byte *dst;
+
+	if ( msg->overflowed || bits <= 0 ) {
+		return;
+	}
+
+	if ( msg->bit + bits > msg->maxbits ) {
+		msg->overflowed = qtrue;
+		return;
+	}
+
+	shift = msg->bit & 7;
+	bytes = ( bits + 7 ) >> 3;
+	dst = msg->data + ( msg->bit >> 3 );
+
+	if ( !shift ) {
+		Com_Memcpy( dst, data, bytes );
+	} else {
+		// unused bits above the current position are always zero
+		lastByte = ( shift + bits - 1 ) >> 3;
+		for ( i = 0; i < bytes; i++ ) {
+			dst[i] |= (byte)( data[i] << shift );
+			if ( i + 1 <= lastByte ) {
+				dst[i + 1] = (byte)( data[i] >> ( 8 - shift ) );
+			}
+		}
+	}
+
+	msg->bit += bits;
+#ifdef ELITEFORCE
+	if ( msg->compat ) {
+		msg->cursize = ( msg->bit >> 3 ) + ( ( msg->bit & 7 ) ? 1 : 0 );
+	} else
+#endif
+	msg->cursize = ( msg->bit >> 3 ) + 1;
+}
+#endif
+
 /*
 =============================================================================
 
@@ -104,7 +154,9 @@ void MSG_RoundBits(msg_t *msg)
 
 // negative bit values include signs
 void MSG_WriteBits( msg_t *msg, int value, int bits ) {
+#ifndef STEF_HUFFMAN_WHOLE_CODES
 	int	i;
+#endif
 
 	if ( bits == 0 || bits < -31 || bits > 32 ) {
 		Com_Error( ERR_DROP, "MSG_WriteBits: bad bits %i", bits );
@@ -173,6 +225,9 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 #endif
 	} else {
 		value &= (0xffffffff>>(32-bits));
+#ifdef STEF_HUFFMAN_WHOLE_CODES
+		msg->bit += HuffmanPutValue( msg->data, msg->bit, value, bits );
+#else
 		if ( bits & 7 ) {
 			int nbits;
 			nbits = bits&7;
@@ -189,6 +244,7 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 				value = (value>>8);
 			}
 		}
+#endif
 		msg->cursize = (msg->bit>>3)+1;
 	}
 
@@ -202,7 +258,9 @@ static int MSG_ReadBits( msg_t *msg, int bits ) {
 	int		value;
 	qboolean	sgn;
 	int		i;
+#ifndef STEF_HUFFMAN_WHOLE_CODES
 	unsigned int	sym;
+#endif
 	const byte *buffer = msg->data; // dereference optimization
 
 	if ( msg->bit >= msg->maxbits )
@@ -272,6 +330,13 @@ static int MSG_ReadBits( msg_t *msg, int bits ) {
 		}
 #endif
 	} else {
+#ifdef STEF_HUFFMAN_WHOLE_CODES
+		int bitsRead;
+		value = (int)HuffmanGetValue( buffer, msg->bit, bits, &bitsRead );
+		msg->bit += bitsRead;
+		msg->readcount = (msg->bit >> 3) + 1;
+		bits -= bits & 7; // match sign handling of original loop
+#else
 		const int nbits = bits & 7;
 		int bitIndex = msg->bit; // dereference optimization
 		if ( nbits )
@@ -292,6 +357,7 @@ static int MSG_ReadBits( msg_t *msg, int bits ) {
 		}
 		msg->bit = bitIndex;
 		msg->readcount = (bitIndex >> 3) + 1;
+#endif
 	}
 
 	if ( sgn && bits < 32 ) {
@@ -1032,6 +1098,132 @@ static const netField_t entityStateFields[] =
 #define	FLOAT_INT_BITS	13
 #define	FLOAT_INT_BIAS	(1<<(FLOAT_INT_BITS-1))
 
+#ifdef STEF_MSG_FIELD_MASK
+/*
+=============================================================================
+
+Changed field masks
+
+The delta functions compare both states in one vectorized pass over the raw
+structures, producing a bitmask with one bit for each 32-bit word that differs.
+Field loops then only need to test bits instead of loading and comparing values.
+
+=============================================================================
+*/
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define MSG_FIELD_MASK_SSE2
+#elif arm64 && ( defined( __ARM_NEON ) || defined( _M_ARM64 ) )
+#include <arm_neon.h>
+#define MSG_FIELD_MASK_NEON
+#endif
+
+#define FIELD_MASK_WORDS( type ) ( ( sizeof( type ) / 4 + 31 ) / 32 )
+#define FIELD_MASK_TEST( mask, word ) ( ( mask )[( word ) >> 5] & ( 1u << ( ( word ) & 31 ) ) )
+
+/*
+==================
+MSG_GetChangedWords
+
+Sets bit n in mask if word n differs between a and b.
+==================
+*/
+static void MSG_GetChangedWords( const int *a, const int *b, int words, uint32_t *mask ) {
+	int i = 0;
+
+	Com_Memset( mask, 0, ( ( words + 31 ) / 32 ) * sizeof( *mask ) );
+
+#if defined( MSG_FIELD_MASK_SSE2 )
+	for ( ; i + 4 <= words; i += 4 ) {
+		__m128i eq = _mm_cmpeq_epi32( _mm_loadu_si128( (const __m128i *)( a + i ) ),
+				_mm_loadu_si128( (const __m128i *)( b + i ) ) );
+		mask[i >> 5] |= (uint32_t)( ~_mm_movemask_ps( _mm_castsi128_ps( eq ) ) & 15 ) << ( i & 31 );
+	}
+#elif defined( MSG_FIELD_MASK_NEON )
+	{
+		static const uint32_t laneBits[4] = { 1, 2, 4, 8 };
+		const uint32x4_t lanes = vld1q_u32( laneBits );
+		for ( ; i + 4 <= words; i += 4 ) {
+			uint32x4_t ne = vmvnq_u32( vceqq_s32( vld1q_s32( a + i ), vld1q_s32( b + i ) ) );
+			mask[i >> 5] |= vaddvq_u32( vandq_u32( ne, lanes ) ) << ( i & 31 );
+		}
+	}
+#endif
+
+	for ( ; i < words; i++ ) {
+		if ( a[i] != b[i] ) {
+			mask[i >> 5] |= 1u << ( i & 31 );
+		}
+	}
+}
+
+/*
+==================
+MSG_MaskIsEmpty
+==================
+*/
+static qboolean MSG_MaskIsEmpty( const uint32_t *mask, int maskWords ) {
+	int i;
+	for ( i = 0; i < maskWords; i++ ) {
+		if ( mask[i] ) {
+			return qfalse;
+		}
+	}
+	return qtrue;
+}
+
+/*
+==================
+MSG_GetMaskBits
+
+Returns count (up to 32) consecutive mask bits starting at word.
+==================
+*/
+static int MSG_GetMaskBits( const uint32_t *mask, int word, int count ) {
+	uint64_t bits = mask[word >> 5];
+	if ( ( word & 31 ) + count > 32 ) {
+		bits |= (uint64_t)mask[( word >> 5 ) + 1] << 32;
+	}
+	bits >>= word & 31;
+	return (int)( bits & ( ( (uint64_t)1 << count ) - 1 ) );
+}
+
+/*
+==================
+MSG_LastChangedField
+
+Returns index + 1 of the last field in the list that is set in the mask, or 0 if
+no fields are changed.
+==================
+*/
+static int MSG_LastChangedField( const netField_t *fields, int numFields, const uint32_t *mask ) {
+	int i;
+	for ( i = numFields - 1; i >= 0; i-- ) {
+		if ( FIELD_MASK_TEST( mask, fields[i].offset >> 2 ) ) {
+			return i + 1;
+		}
+	}
+	return 0;
+}
+
+/*
+==================
+MSG_WriteZeroBits
+
+Writes a run of unchanged field markers. Writes are split into 7 bit chunks, which
+produce the same output as single bit writes in huffman mode.
+==================
+*/
+static void MSG_WriteZeroBits( msg_t *msg, int count ) {
+	while ( count > 0 ) {
+		int bits = count > 7 ? 7 : count;
+		MSG_WriteBits( msg, 0, bits );
+		count -= bits;
+	}
+}
+#endif
+
 /*
 ==================
 MSG_WriteDeltaEntity
@@ -1049,11 +1241,19 @@ void MSG_WriteDeltaEntity( msg_t *msg, const entityState_t *from, const entitySt
 	const netField_t *field;
 	int			trunc;
 	float		fullFloat;
+#ifdef STEF_MSG_FIELD_MASK
+	const int	*toF;
+#else
 	const int	*fromF, *toF;
+#endif
 #ifdef ELITEFORCE
 	byte		vector[PVECTOR_BYTES];
 	int			vectorIndex = -1;
 #endif
+#ifdef STEF_MSG_FIELD_MASK
+	uint32_t	changed[FIELD_MASK_WORDS( entityState_t )];
+	int			zeroBits = 0;
+#endif
 
 	numFields = ARRAY_LEN( entityStateFields );
 
@@ -1083,6 +1283,21 @@ void MSG_WriteDeltaEntity( msg_t *msg, const entityState_t *from, const entitySt
 #endif
 
 	lc = 0;
+#ifdef STEF_MSG_FIELD_MASK
+	MSG_GetChangedWords( (const int *)from, (const int *)to, sizeof( *to ) / 4, changed );
+	if ( !MSG_MaskIsEmpty( changed, ARRAY_LEN( changed ) ) ) {
+#ifdef ELITEFORCE
+		if ( msg->compat ) {
+			for ( i = 0, field = entityStateFields ; i < numFields ; i++, field++ ) {
+				if ( FIELD_MASK_TEST( changed, field->offset >> 2 ) ) {
+					vector[i >> 3] |= 1 << (i & 0x07);
+				}
+			}
+		} else
+#endif
+		lc = MSG_LastChangedField( entityStateFields, numFields, changed );
+	}
+#else
 	// build the change vector as bytes so it is endian independent
 	for ( i = 0, field = entityStateFields ; i < numFields ; i++, field++ ) {
 		fromF = (int *)( (byte *)from + field->offset );
@@ -1096,6 +1311,7 @@ void MSG_WriteDeltaEntity( msg_t *msg, const entityState_t *from, const entitySt
 			lc = i+1;
 		}
 	}
+#endif
 
 #ifdef ELITEFORCE
 	if((msg->compat && !((int *) vector)[0] && !((int *) vector)[1]) || (!msg->compat && !lc)) {
@@ -1156,9 +1372,21 @@ void MSG_WriteDeltaEntity( msg_t *msg, const entityState_t *from, const entitySt
 #else
 	for ( i = 0, field = entityStateFields ; i < lc ; i++, field++ ) {
 #endif
-		fromF = (int *)( (byte *)from + field->offset );
 		toF = (int *)( (byte *)to + field->offset );
 
+#ifdef STEF_MSG_FIELD_MASK
+		if ( !FIELD_MASK_TEST( changed, field->offset >> 2 ) ) {
+#ifdef ELITEFORCE
+			if(!msg->compat)
+#endif
+			zeroBits++;		// no change
+			continue;
+		}
+
+		MSG_WriteZeroBits( msg, zeroBits );
+		zeroBits = 0;
+#else
+		fromF = (int *)( (byte *)from + field->offset );
 		if ( *fromF == *toF ) {
 #ifdef ELITEFORCE
 			if(!msg->compat)
@@ -1166,6 +1394,7 @@ void MSG_WriteDeltaEntity( msg_t *msg, const entityState_t *from, const entitySt
 			MSG_WriteBits( msg, 0, 1 );	// no change
 			continue;
 		}
+#endif
 
 #ifdef ELITEFORCE
 		if(!msg->compat)
@@ -1535,9 +1764,17 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, const playerState_t *from, const pla
 	int				powerupbits;
 	int				numFields;
 	const netField_t *field;
+#ifdef STEF_MSG_FIELD_MASK
+	const int		*toF;
+#else
 	const int		*fromF, *toF;
+#endif
 	float			fullFloat;
 	int				trunc, lc;
+#ifdef STEF_MSG_FIELD_MASK
+	uint32_t		changed[FIELD_MASK_WORDS( playerState_t )];
+	int				zeroBits = 0;
+#endif
 
 	if ( !from ) {
 		from = &dummy;
@@ -1545,11 +1782,18 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, const playerState_t *from, const pla
 
 	numFields = ARRAY_LEN( playerStateFields );
 
+#ifdef STEF_MSG_FIELD_MASK
+	MSG_GetChangedWords( (const int *)from, (const int *)to, sizeof( *to ) / 4, changed );
+#endif
+
 	lc = 0;
 #ifdef ELITEFORCE
 	if(!msg->compat)
 	{
 #endif
+#ifdef STEF_MSG_FIELD_MASK
+	lc = MSG_LastChangedField( playerStateFields, numFields, changed );
+#else
 	for ( i = 0, field = playerStateFields ; i < numFields ; i++, field++ ) {
 		fromF = (const int *)( (byte *)from + field->offset );
 		toF = (const int *)( (byte *)to + field->offset );
@@ -1557,6 +1801,7 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, const playerState_t *from, const pla
 			lc = i+1;
 		}
 	}
+#endif
 
 	MSG_WriteByte( msg, lc );	// # of changes
 #ifdef ELITEFORCE
@@ -1568,13 +1813,23 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, const playerState_t *from, const pla
 #else
 	for ( i = 0, field = playerStateFields ; i < lc ; i++, field++ ) {
 #endif
-		fromF = (const int *)( (byte *)from + field->offset );
 		toF = (const int *)( (byte *)to + field->offset );
 
+#ifdef STEF_MSG_FIELD_MASK
+		if ( !FIELD_MASK_TEST( changed, field->offset >> 2 ) ) {
+			zeroBits++;		// no change
+			continue;
+		}
+
+		MSG_WriteZeroBits( msg, zeroBits );
+		zeroBits = 0;
+#else
+		fromF = (const int *)( (byte *)from + field->offset );
 		if ( *fromF == *toF ) {
 			MSG_WriteBits( msg, 0, 1 );	// no change
 			continue;
 		}
+#endif
 
 		MSG_WriteBits( msg, 1, 1 );	// changed
 //		pcount[i]++;
@@ -1601,9 +1856,20 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, const playerState_t *from, const pla
 	}
 
 
+#ifdef STEF_MSG_FIELD_MASK
+	// trailing unchanged fields only occur in compat mode
+	MSG_WriteZeroBits( msg, zeroBits );
+#endif
+
 	//
 	// send the arrays
 	//
+#ifdef STEF_MSG_FIELD_MASK
+	statsbits = MSG_GetMaskBits( changed, offsetof( playerState_t, stats ) / 4, MAX_STATS );
+	persistantbits = MSG_GetMaskBits( changed, offsetof( playerState_t, persistant ) / 4, MAX_PERSISTANT );
+	ammobits = MSG_GetMaskBits( changed, offsetof( playerState_t, ammo ) / 4, MAX_WEAPONS );
+	powerupbits = MSG_GetMaskBits( changed, offsetof( playerState_t, powerups ) / 4, MAX_POWERUPS );
+#else
 	statsbits = 0;
 	for (i=0 ; i<MAX_STATS ; i++) {
 		if (to->stats[i] != from->stats[i]) {
@@ -1628,6 +1894,7 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, const playerState_t *from, const pla
 			powerupbits |= 1<<i;
 		}
 	}
+#endif
 
 #ifdef ELITEFORCE
 	if (!msg->compat && !statsbits && !persistantbits && !ammobits && !powerupbits) {
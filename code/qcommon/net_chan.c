@@ -794,7 +794,13 @@ void NET_QueuePacket( netsrc_t sock, int length, const void *data, const netadr_
 
 void NET_FlushPacketQueue( int time_diff )
 {
+#ifdef STEF_NET_BATCHED_SEND
+	Sys_BeginPacketBatch();
 	packetQueue = list_process( packetQueue, time_diff );
+	Sys_FlushPacketBatch();
+#else
+	packetQueue = list_process( packetQueue, time_diff );
+#endif
 }
 
 
@@ -20,6 +20,11 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 ===========================================================================
 */
 
+#if ( defined( STEF_NET_BATCHED_RECEIVE ) || defined( STEF_NET_BATCHED_SEND ) ) && !defined( _GNU_SOURCE )
+// for recvmmsg and sendmmsg
+#define _GNU_SOURCE
+#endif
+
 #include "../qcommon/q_shared.h"
 #include "../qcommon/qcommon.h"
 
@@ -93,6 +98,11 @@ static qboolean	winsockInitialized = qfalse;
 #		include <sys/filio.h>
 #	endif
 
+#	ifdef STEF_NET_BATCHED_RECEIVE
+#		include <sys/epoll.h>
+#		include <sys/syscall.h>
+#	endif
+
 typedef int SOCKET;
 #	define INVALID_SOCKET		-1
 #	define SOCKET_ERROR			-1
@@ -764,6 +774,169 @@ static qboolean NET_GetPacket( netadr_t *net_from, msg_t *net_message, const fd_
 //=============================================================================
 
 
+#ifdef STEF_NET_BATCHED_SEND
+/*
+=============================================================================
+
+Batched send
+
+While a batch is active, plain UDP packets are copied into a buffer and sent with
+one sendmmsg call per socket when the batch is flushed.
+
+=============================================================================
+*/
+
+#define NET_SEND_BATCH_PACKETS 128
+#define NET_SEND_BATCH_DATA ( 256 * 1024 )
+
+typedef struct {
+	qboolean active;
+	int count;
+	int dataUsed;
+	struct mmsghdr msgs[NET_SEND_BATCH_PACKETS];
+	struct iovec iov[NET_SEND_BATCH_PACKETS];
+	sockaddr_t addrs[NET_SEND_BATCH_PACKETS];
+	SOCKET sockets[NET_SEND_BATCH_PACKETS];
+	byte data[NET_SEND_BATCH_DATA];
+} netSendBatch_t;
+
+static netSendBatch_t netSendBatch;
+
+/*
+==================
+NET_SendBatchError
+
+Error handling equivalent to Sys_SendPacket.
+==================
+*/
+static void NET_SendBatchError( void ) {
+	int err = socketError;
+
+	// wouldblock is silent
+	if( err == EAGAIN ) {
+		return;
+	}
+
+	Com_Printf( "Sys_SendPacket: %s\n", NET_ErrorString() );
+}
+
+/*
+==================
+NET_SendBatchSocket
+
+Sends all queued packets for one socket, in order.
+==================
+*/
+static void NET_SendBatchSocket( SOCKET sock ) {
+	struct mmsghdr msgs[NET_SEND_BATCH_PACKETS];
+	int count = 0;
+	int sent = 0;
+	int i;
+
+	for ( i = 0; i < netSendBatch.count; ++i ) {
+		if ( netSendBatch.sockets[i] == sock ) {
+			msgs[count++] = netSendBatch.msgs[i];
+		}
+	}
+
+	while ( sent < count ) {
+		int ret = sendmmsg( sock, msgs + sent, count - sent, 0 );
+		if ( ret == SOCKET_ERROR ) {
+			if ( socketError == EINTR ) {
+				continue;
+			}
+			// skip the failed packet and continue with the rest
+			NET_SendBatchError();
+			++sent;
+		} else {
+			sent += ret;
+		}
+	}
+}
+
+/*
+==================
+Sys_BeginPacketBatch
+
+Starts collecting packets sent by Sys_SendPacket until Sys_FlushPacketBatch is called.
+==================
+*/
+void Sys_BeginPacketBatch( void ) {
+	if ( !net_batchedSend->integer ) {
+		return;
+	}
+	netSendBatch.active = qtrue;
+}
+
+/*
+==================
+Sys_FlushPacketBatch
+
+Sends all pending packets and ends the current batch.
+==================
+*/
+void Sys_FlushPacketBatch( void ) {
+	netSendBatch.active = qfalse;
+
+	if ( !netSendBatch.count ) {
+		return;
+	}
+
+	if ( ip_socket != INVALID_SOCKET ) {
+		NET_SendBatchSocket( ip_socket );
+	}
+#ifdef USE_IPV6
+	if ( ip6_socket != INVALID_SOCKET ) {
+		NET_SendBatchSocket( ip6_socket );
+	}
+#endif
+
+	netSendBatch.count = 0;
+	netSendBatch.dataUsed = 0;
+}
+
+/*
+==================
+NET_SendBatchAdd
+
+Returns qtrue if packet was added to the current batch.
+==================
+*/
+static qboolean NET_SendBatchAdd( SOCKET sock, int length, const void *data, const sockaddr_t *addr, int addrlen ) {
+	struct mmsghdr *msg;
+
+	if ( !netSendBatch.active ) {
+		return qfalse;
+	}
+
+	if ( netSendBatch.count >= NET_SEND_BATCH_PACKETS || netSendBatch.dataUsed + length > NET_SEND_BATCH_DATA ) {
+		Sys_FlushPacketBatch();
+		netSendBatch.active = qtrue;
+		if ( length > NET_SEND_BATCH_DATA ) {
+			return qfalse;
+		}
+	}
+
+	Com_Memcpy( netSendBatch.data + netSendBatch.dataUsed, data, length );
+	netSendBatch.addrs[netSendBatch.count] = *addr;
+	netSendBatch.sockets[netSendBatch.count] = sock;
+	netSendBatch.iov[netSendBatch.count].iov_base = netSendBatch.data + netSendBatch.dataUsed;
+	netSendBatch.iov[netSendBatch.count].iov_len = length;
+
+	msg = &netSendBatch.msgs[netSendBatch.count];
+	Com_Memset( msg, 0, sizeof( *msg ) );
+	msg->msg_hdr.msg_name = &netSendBatch.addrs[netSendBatch.count];
+	msg->msg_hdr.msg_namelen = addrlen;
+	msg->msg_hdr.msg_iov = &netSendBatch.iov[netSendBatch.count];
+	msg->msg_hdr.msg_iovlen = 1;
+
+	netSendBatch.dataUsed += length;
+	netSendBatch.count++;
+	return qtrue;
+}
+#endif
+
+
 /*
 ==================
 Sys_SendPacket
@@ -817,6 +990,18 @@ void Sys_SendPacket( int length, const void *data, const netadr_t *to ) {
 		}
 	}
 	else {
+#ifdef STEF_NET_BATCHED_SEND
+		if ( to->type != NA_BROADCAST ) {
+			if ( addr.ss.ss_family == AF_INET &&
+					NET_SendBatchAdd( ip_socket, length, data, &addr, sizeof( struct sockaddr_in ) ) )
+				return;
+#ifdef USE_IPV6
+			if ( addr.ss.ss_family == AF_INET6 &&
+					NET_SendBatchAdd( ip6_socket, length, data, &addr, sizeof( struct sockaddr_in6 ) ) )
+				return;
+#endif
+		}
+#endif
 		if ( addr.ss.ss_family == AF_INET )
 			ret = sendto( ip_socket, data, length, 0, (struct sockaddr *) &addr, sizeof(struct sockaddr_in) );
 #ifdef USE_IPV6
@@ -1686,6 +1871,278 @@ static qboolean NET_GetCvars( void ) {
 }
 
 
+#ifdef STEF_NET_BATCHED_RECEIVE
+/*
+=============================================================================
+
+Batched receive
+
+Waits on sockets with epoll and drains up to NET_BATCH_SIZE datagrams per recvmmsg
+call, instead of a select and recvfrom call for every packet.
+
+=============================================================================
+*/
+
+#define NET_BATCH_SIZE 32
+
+typedef struct {
+	int epollFd;
+	qboolean epollFailed;
+	qboolean pwait2Unavailable;
+
+	struct mmsghdr msgs[NET_BATCH_SIZE];
+	struct iovec iov[NET_BATCH_SIZE];
+	sockaddr_t addrs[NET_BATCH_SIZE];
+	byte data[NET_BATCH_SIZE][MAX_MSGLEN_BUF];
+} netBatch_t;
+
+static netBatch_t netBatch = { -1 };
+
+/*
+====================
+NET_BatchCloseEpoll
+
+Called when sockets are closed. The epoll set is recreated on the next NET_Sleep.
+====================
+*/
+static void NET_BatchCloseEpoll( void ) {
+	if ( netBatch.epollFd != -1 ) {
+		close( netBatch.epollFd );
+		netBatch.epollFd = -1;
+	}
+}
+
+/*
+====================
+NET_BatchOpenEpoll
+
+Returns qtrue if epoll set is available.
+====================
+*/
+static qboolean NET_BatchOpenEpoll( void ) {
+	struct epoll_event ev;
+
+	if ( netBatch.epollFd != -1 ) {
+		return qtrue;
+	}
+	if ( netBatch.epollFailed ) {
+		return qfalse;
+	}
+
+	netBatch.epollFd = epoll_create1( EPOLL_CLOEXEC );
+	if ( netBatch.epollFd == -1 ) {
+		Com_Printf( "WARNING: epoll_create1 failed: %s\n", NET_ErrorString() );
+		netBatch.epollFailed = qtrue;
+		return qfalse;
+	}
+
+	if ( ip_socket != INVALID_SOCKET ) {
+		ev.events = EPOLLIN;
+		ev.data.u32 = 0;
+		if ( epoll_ctl( netBatch.epollFd, EPOLL_CTL_ADD, ip_socket, &ev ) == -1 ) {
+			goto error;
+		}
+	}
+
+#ifdef USE_IPV6
+	if ( ip6_socket != INVALID_SOCKET ) {
+		ev.events = EPOLLIN;
+		ev.data.u32 = 1;
+		if ( epoll_ctl( netBatch.epollFd, EPOLL_CTL_ADD, ip6_socket, &ev ) == -1 ) {
+			goto error;
+		}
+	}
+#endif
+
+	return qtrue;
+
+error:
+	Com_Printf( "WARNING: epoll_ctl failed: %s\n", NET_ErrorString() );
+	NET_BatchCloseEpoll();
+	netBatch.epollFailed = qtrue;
+	return qfalse;
+}
+
+/*
+====================
+NET_BatchWait
+
+Waits up to timeout microseconds for incoming packets. Sets ready[0] for the IPv4 socket
+and ready[1] for the IPv6 socket. Returns number of ready sockets, or -1 if epoll can't
+be used and the caller should fall back to select.
+====================
+*/
+static int NET_BatchWait( int timeout, qboolean *ready ) {
+	struct epoll_event events[2];
+	int count = -1;
+	int i;
+
+	ready[0] = ready[1] = qfalse;
+
+	if ( !NET_BatchOpenEpoll() ) {
+		return -1;
+	}
+
+	// epoll_wait only has millisecond resolution, so use epoll_pwait2 when available
+	// to avoid disrupting frame timing
+	if ( timeout % 1000 == 0 || netBatch.pwait2Unavailable ) {
+		if ( netBatch.pwait2Unavailable && timeout % 1000 != 0 ) {
+			return -1;
+		}
+		count = epoll_wait( netBatch.epollFd, events, ARRAY_LEN( events ), timeout / 1000 );
+	} else {
+#ifdef SYS_epoll_pwait2
+		struct timespec ts;
+		ts.tv_sec = timeout / 1000000;
+		ts.tv_nsec = ( timeout % 1000000 ) * 1000;
+		count = syscall( SYS_epoll_pwait2, netBatch.epollFd, events, ARRAY_LEN( events ), &ts, NULL, 0 );
+		if ( count == -1 && errno == ENOSYS ) {
+			netBatch.pwait2Unavailable = qtrue;
+			return -1;
+		}
+#else
+		netBatch.pwait2Unavailable = qtrue;
+		return -1;
+#endif
+	}
+
+	if ( count == -1 ) {
+		if ( errno != EINTR ) {
+			Com_Printf( S_COLOR_YELLOW "Warning: epoll_wait() syscall failed: %s\n", NET_ErrorString() );
+		}
+		return 0;
+	}
+
+	for ( i = 0; i < count; ++i ) {
+		ready[events[i].data.u32 ? 1 : 0] = qtrue;
+	}
+	return count;
+}
+
+/*
+====================
+NET_BatchDispatch
+
+Equivalent to the packet handling in NET_Event.
+====================
+*/
+static void NET_BatchDispatch( netadr_t *from, msg_t *netmsg ) {
+	if ( net_dropsim->value > 0.0f && net_dropsim->value <= 100.0f )
+	{
+		// com_dropsim->value percent of incoming packets get dropped.
+		if ( rand() < (int) (((double) RAND_MAX) / 100.0 * (double) net_dropsim->value) )
+			return; // drop this packet
+	}
+
+#ifdef DEDICATED
+	Com_RunAndTimeServerPacket( from, netmsg );
+#else
+	if ( com_sv_running->integer || com_dedicated->integer )
+		Com_RunAndTimeServerPacket( from, netmsg );
+	else
+		CL_PacketEvent( from, netmsg );
+#endif
+}
+
+/*
+====================
+NET_BatchReceive
+
+Reads and dispatches all pending packets from socket. Equivalent to the NET_GetPacket
+handling for the socket, except oversize packets don't stop further processing.
+====================
+*/
+static void NET_BatchReceive( const SOCKET *socketPtr ) {
+	const SOCKET sock = *socketPtr;
+	netadr_t from;
+	msg_t netmsg;
+	int count;
+	int i;
+
+	// the socket can be closed by a packet handler (e.g. net_restart via rcon)
+	while ( sock != INVALID_SOCKET && *socketPtr == sock ) {
+		for ( i = 0; i < NET_BATCH_SIZE; ++i ) {
+			netBatch.iov[i].iov_base = netBatch.data[i];
+			netBatch.iov[i].iov_len = MAX_MSGLEN;
+			Com_Memset( &netBatch.msgs[i].msg_hdr, 0, sizeof( netBatch.msgs[i].msg_hdr ) );
+			netBatch.msgs[i].msg_hdr.msg_name = &netBatch.addrs[i];
+			netBatch.msgs[i].msg_hdr.msg_namelen = sizeof( netBatch.addrs[i] );
+			netBatch.msgs[i].msg_hdr.msg_iov = &netBatch.iov[i];
+			netBatch.msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		count = recvmmsg( sock, netBatch.msgs, NET_BATCH_SIZE, MSG_DONTWAIT, NULL );
+		if ( count == SOCKET_ERROR ) {
+			int err = socketError;
+			if ( err != EAGAIN && err != ECONNRESET && err != EINTR )
+				Com_Printf( "NET_GetPacket: %s\n", NET_ErrorString() );
+			return;
+		}
+
+		for ( i = 0; i < count; ++i ) {
+			sockaddr_t *addr = &netBatch.addrs[i];
+			int length = netBatch.msgs[i].msg_len;
+
+			MSG_Init( &netmsg, netBatch.data[i], MAX_MSGLEN );
+
+			if ( addr->ss.ss_family == AF_INET ) {
+				memset( &addr->v4.sin_zero, 0, sizeof( addr->v4.sin_zero ) );
+			}
+
+			if ( sock == ip_socket && usingSocks &&
+					memcmp( addr, &socksRelayAddr, netBatch.msgs[i].msg_hdr.msg_namelen ) == 0 ) {
+				if ( length < 10 || netmsg.data[0] != 0 || netmsg.data[1] != 0 || netmsg.data[2] != 0 || netmsg.data[3] != 1 ) {
+					continue;
+				}
+				from.type = NA_IP;
+				from.ipv._4[0] = netmsg.data[4];
+				from.ipv._4[1] = netmsg.data[5];
+				from.ipv._4[2] = netmsg.data[6];
+				from.ipv._4[3] = netmsg.data[7];
+				from.port = *(uint16_t *)&netmsg.data[8];
+				netmsg.readcount = 10;
+			}
+			else {
+				from.type = NA_BAD;
+				SockadrToNetadr( addr, &from );
+				netmsg.readcount = 0;
+			}
+
+			if ( length >= netmsg.maxsize ) {
+				Com_Printf( "Oversize packet from %s\n", NET_AdrToString( &from ) );
+				continue;
+			}
+
+			netmsg.cursize = length;
+			NET_BatchDispatch( &from, &netmsg );
+		}
+
+		if ( count < NET_BATCH_SIZE ) {
+			return;
+		}
+	}
+}
+
+/*
+====================
+NET_BatchEvent
+
+Batched equivalent of NET_Event.
+====================
+*/
+static void NET_BatchEvent( const qboolean *ready ) {
+	if ( ready[0] ) {
+		NET_BatchReceive( &ip_socket );
+	}
+#ifdef USE_IPV6
+	if ( ready[1] ) {
+		NET_BatchReceive( &ip6_socket );
+	}
+#endif
+}
+#endif
+
+
 /*
 ====================
 NET_Config
@@ -1731,6 +2188,12 @@ static void NET_Config( qboolean enableNetworking ) {
 	}
 
 	if( stop ) {
+#ifdef STEF_NET_BATCHED_SEND
+		Sys_FlushPacketBatch();
+#endif
+#ifdef STEF_NET_BATCHED_RECEIVE
+		NET_BatchCloseEpoll();
+#endif
 		if ( ip_socket != INVALID_SOCKET ) {
 			closesocket( ip_socket );
 			ip_socket = INVALID_SOCKET;
@@ -1873,6 +2336,11 @@ qboolean NET_Sleep( int timeout )
 	if ( timeout < 0 )
 		timeout = 0;
 
+#ifdef STEF_NET_BATCHED_SEND
+	// make sure nothing is left over, e.g. if an error interrupted the frame
+	Sys_FlushPacketBatch();
+#endif
+
 	FD_ZERO( &fdr );
 
 	if ( ip_socket != INVALID_SOCKET )
@@ -1907,12 +2375,39 @@ qboolean NET_Sleep( int timeout )
 #endif
 	}
 
+#ifdef STEF_NET_BATCHED_RECEIVE
+	if ( net_batchedReceive->integer ) {
+		qboolean ready[2];
+		retval = NET_BatchWait( timeout, ready );
+		if ( retval > 0 ) {
+			NET_BatchEvent( ready );
+			return qfalse;
+		}
+		if ( retval == 0 ) {
+			return qtrue;
+		}
+	}
+#endif
+
 	tv.tv_sec = timeout / 1000000;
 	tv.tv_usec = timeout - tv.tv_sec * 1000000;
 
 	retval = select( highestfd + 1, &fdr, NULL, NULL, &tv );
 
 	if ( retval > 0 ) {
+#ifdef STEF_NET_BATCHED_RECEIVE
+		if ( net_batchedReceive->integer ) {
+			qboolean ready[2];
+			ready[0] = ip_socket != INVALID_SOCKET && FD_ISSET( ip_socket, &fdr ) ? qtrue : qfalse;
+#ifdef USE_IPV6
+			ready[1] = ip6_socket != INVALID_SOCKET && FD_ISSET( ip6_socket, &fdr ) ? qtrue : qfalse;
+#else
+			ready[1] = qfalse;
+#endif
+			NET_BatchEvent( ready );
+			return qfalse;
+		}
+#endif
 		NET_Event( &fdr );
 		return qfalse;
 	}
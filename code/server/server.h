@@ -405,6 +405,20 @@ void SV_SendClientSnapshot( client_t *client );
 void SV_InitSnapshotStorage( void );
 void SV_IssueNewSnapshot( void );
 
+#ifdef STEF_SNAPSHOT_VIS_CACHE
+// skip SVF_CLIENTMASK entities for clientNum >= 32 instead of raising an error
+#define SV_VIS_IGNORE_CLIENTMASK_ERROR 1
+
+typedef struct {
+	int				areabytes;
+	byte			areabits[MAX_MAP_AREA_BYTES];		// inverted, as in clientSnapshot_t
+	int				num_entities;
+	entityState_t	*ents[ MAX_SNAPSHOT_ENTITIES ];
+} svClientVisibility_t;
+
+const svClientVisibility_t *SV_GetClientVisibility( int clientNum, int flags );
+#endif
+
 int SV_RemainingGameState( void );
 
 //
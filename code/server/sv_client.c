@@ -948,6 +948,9 @@ void SV_DropClient( client_t *drop, const char *reason ) {
 		drop->state = CS_FREE;
 	} else {
 		Q_strncpyz( drop->name, name, sizeof( name ) );
+#ifdef STEF_STATUS_CACHE
+		SV_StatusCache_Invalidate();
+#endif
 		SV_PrintClientStateChange( drop, CS_ZOMBIE );
 		drop->state = CS_ZOMBIE;		// become free in a few seconds
 	}
@@ -2102,6 +2105,9 @@ void SV_UserinfoChanged( client_t *cl, qboolean updateUserinfo, qboolean runFilt
 		val = buf;
 	}
 	Q_strncpyz( cl->name, val, sizeof( cl->name ) );
+#ifdef STEF_STATUS_CACHE
+	SV_StatusCache_Invalidate();
+#endif
 
 	val = Info_ValueForKey( cl->userinfo, "handicap" );
 	if ( val[0] ) {
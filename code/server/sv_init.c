@@ -142,6 +142,9 @@ void SV_SetConfigstring (int index, const char *val) {
 	// change the string in sv
 	Z_Free( sv.configstrings[index] );
 	sv.configstrings[index] = CopyString( val );
+#ifdef STEF_STATUS_CACHE
+	SV_StatusCache_Invalidate();
+#endif
 
 	// send it to all the clients if we aren't
 	// spawning a new server
@@ -763,6 +766,9 @@ void SV_SpawnServer( const char *mapname, qboolean killBots ) {
 
 	SV_SetConfigstring( CS_SERVERINFO, Cvar_InfoString( CVAR_SERVERINFO, NULL ) );
 	cvar_modifiedFlags &= ~CVAR_SERVERINFO;
+#ifdef STEF_STATUS_CACHE
+	SV_StatusCache_Invalidate();
+#endif
 
 #ifdef STEF_SERVER_ALT_SWAP_SUPPORT
 	// unlatch cvar
@@ -986,6 +992,9 @@ void SV_Init( void )
 #ifdef STEF_SERVER_RECORD
 	Record_Initialize();
 #endif
+#ifdef STEF_SV_PERF
+	SV_Perf_Init();
+#endif
 }
 
 
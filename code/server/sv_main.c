@@ -652,6 +652,276 @@ void SVC_RateDropAddress( const netadr_t *from, int burst, int period ) {
 }
 
 
+/*
+================
+SV_GetStatusInfo
+
+Retrieves serverinfo string for status response, not including the challenge.
+================
+*/
+static void SV_GetStatusInfo( char *infostring, int size, qboolean hasChallenge ) {
+	Q_strncpyz( infostring, Cvar_InfoString( CVAR_SERVERINFO, NULL ), size );
+
+#ifdef STEF_GETSTATUS_FIXES
+	// Echelon server browser expects "v1.20" in version string.
+	Info_SetValueForKey( infostring, "version_cmod", Q3_VERSION " " PLATFORM_STRING " " __DATE__ );
+	Info_SetValueForKey( infostring, "version", "cMod HM v1.20 compatible" );
+
+	// Qtracker may expect "baseEF" value for gamename. Only perform this adjustment for
+	// queries with a challenge parameter to minimize any effect on visible info.
+	if ( hasChallenge ) {
+		Info_SetValueForKey( infostring, "gamename", "baseEF" );
+	}
+#endif
+}
+
+
+/*
+================
+SV_AddStatusChallenge
+================
+*/
+static void SV_AddStatusChallenge( char *infostring, const char *challenge ) {
+#ifdef STEF_GETSTATUS_FIXES
+	// Make sure challenge is at beginning of info string for compatibility with Raven master
+	if ( *challenge ) {
+		Q_strncpyz( infostring, va( "\\challenge\\%s%s", challenge, infostring ), MAX_INFO_STRING );
+	}
+#else
+	// echo back the parameter to status. so master servers can use it as a challenge
+	// to prevent timed spoofed reply packets that add ghost servers
+	Info_SetValueForKey( infostring, "challenge", challenge );
+#endif
+}
+
+
+/*
+================
+SV_GetInfoString
+
+Generates info response string. If challenge is empty it is left out, and the result
+can be reused for any request by prepending the challenge key.
+================
+*/
+static void SV_GetInfoString( char *infostring, const char *challenge ) {
+	int		i, count, humans;
+	const char	*gamedir;
+
+	// don't count privateclients
+	count = humans = 0;
+	for ( i = sv_privateClients->integer; i < sv.maxclients; i++ ) {
+		if ( svs.clients[i].state >= CS_CONNECTED ) {
+			count++;
+			if (svs.clients[i].netchan.remoteAddress.type != NA_BOT) {
+				humans++;
+			}
+		}
+	}
+
+	infostring[0] = '\0';
+
+	// echo back the parameter to status. so servers can use it as a challenge
+	// to prevent timed spoofed reply packets that add ghost servers
+	Info_SetValueForKey( infostring, "challenge", challenge );
+
+	Info_SetValueForKey( infostring, "protocol", va( "%i", com_protocol->integer ) );
+	Info_SetValueForKey( infostring, "hostname", sv_hostname->string );
+	Info_SetValueForKey( infostring, "mapname", sv_mapname->string );
+	Info_SetValueForKey( infostring, "clients", va("%i", count) );
+	Info_SetValueForKey( infostring, "g_humanplayers", va( "%i", humans ) );
+	Info_SetValueForKey( infostring, "sv_maxclients", va( "%i", sv.maxclients - sv_privateClients->integer ) );
+	Info_SetValueForKey( infostring, "gametype", va( "%i", sv_gametype->integer ) );
+	Info_SetValueForKey( infostring, "pure", va( "%i", sv.pure ) );
+	Info_SetValueForKey( infostring, "g_needpass", va( "%d", Cvar_VariableIntegerValue( "g_needpass" ) ) );
+	gamedir = Cvar_VariableString( "fs_game" );
+	if ( *gamedir != '\0' ) {
+		Info_SetValueForKey( infostring, "game", gamedir );
+	}
+}
+
+
+#ifdef STEF_STATUS_CACHE
+/*
+====================
+
+Status Cache
+
+Keeps the formatted getstatus and getinfo response bodies, so queries only need to
+add the challenge and copy the cached text. Serverinfo, configstring, and player name
+changes invalidate the whole cache through SV_StatusCache_Invalidate. Scores and pings
+are written by the game module and SV_CalcPings every frame, so they are compared
+against the cached values on each query and only changed player lines are reformatted.
+
+====================
+*/
+
+typedef struct {
+	qboolean	listed;		// state >= CS_CONNECTED
+	qboolean	bot;
+	int			score;
+	int			ping;
+	int			lineLength;
+	char		line[MAX_NAME_LENGTH + 32]; // score + ping + name
+} statusCachePlayer_t;
+
+static struct {
+	qboolean	valid;
+	int			maxclients;
+	int			protocolModificationCount;
+	statusCachePlayer_t players[MAX_CLIENTS];
+
+	// serverinfo for queries without and with challenge
+	char		statusInfo[2][MAX_INFO_STRING+160];
+
+	// info response without challenge
+	char		info[MAX_INFO_STRING];
+	int			infoLength;
+} statusCache;
+
+
+/*
+================
+SV_StatusCache_Invalidate
+
+Called when anything other than client scores, pings, and connection states
+may have changed the status and info responses.
+================
+*/
+void SV_StatusCache_Invalidate( void ) {
+	statusCache.valid = qfalse;
+}
+
+
+/*
+================
+SV_StatusCache_Update
+================
+*/
+static void SV_StatusCache_Update( void ) {
+	qboolean	clientsChanged = qfalse;
+	int			i;
+
+	// serverinfo cvar changes are only pushed to the configstring on the next frame
+	if ( ( cvar_modifiedFlags & ( CVAR_SERVERINFO | CVAR_SYSTEMINFO ) ) || sv.maxclients != statusCache.maxclients
+			|| com_protocol->modificationCount != statusCache.protocolModificationCount ) {
+		statusCache.valid = qfalse;
+	}
+
+	for ( i = 0; i < sv.maxclients; i++ ) {
+		const client_t *cl = &svs.clients[i];
+		statusCachePlayer_t *player = &statusCache.players[i];
+		qboolean listed = cl->state >= CS_CONNECTED ? qtrue : qfalse;
+		qboolean bot = listed && cl->netchan.remoteAddress.type == NA_BOT ? qtrue : qfalse;
+		int score = 0;
+		int ping = 0;
+
+		if ( listed ) {
+			const playerState_t *ps = SV_GameClientNum( i );
+#ifdef STEF_SUPPORT_STATUS_SCORES_OVERRIDE
+			score = SV_StatusScoresOverride_AdjustScore( ps->persistant[ PERS_SCORE ], i );
+#else
+			score = ps->persistant[ PERS_SCORE ];
+#endif
+			ping = cl->ping;
+		}
+
+		if ( !statusCache.valid || listed != player->listed || bot != player->bot ) {
+			clientsChanged = qtrue;
+		}
+
+		if ( !statusCache.valid || listed != player->listed || score != player->score || ping != player->ping ) {
+			player->listed = listed;
+			player->score = score;
+			player->ping = ping;
+			player->lineLength = listed ? Com_sprintf( player->line, sizeof( player->line ),
+					"%i %i \"%s\"\n", score, ping, cl->name ) : 0;
+		}
+		player->bot = bot;
+	}
+
+	if ( !statusCache.valid ) {
+		SV_GetStatusInfo( statusCache.statusInfo[0], sizeof( statusCache.statusInfo[0] ), qfalse );
+		SV_GetStatusInfo( statusCache.statusInfo[1], sizeof( statusCache.statusInfo[1] ), qtrue );
+	}
+
+	if ( !statusCache.valid || clientsChanged ) {
+		SV_GetInfoString( statusCache.info, "" );
+		statusCache.infoLength = strlen( statusCache.info );
+	}
+
+	statusCache.maxclients = sv.maxclients;
+	statusCache.protocolModificationCount = com_protocol->modificationCount;
+	statusCache.valid = qtrue;
+}
+
+
+/*
+================
+SV_StatusCache_SendStatus
+================
+*/
+static void SV_StatusCache_SendStatus( const netadr_t *from, const char *challenge ) {
+	char	status[MAX_PACKETLEN];
+	char	infostring[MAX_INFO_STRING+160];
+	int		statusLength;
+	int		offset = 0;
+	int		i;
+
+	SV_StatusCache_Update();
+
+	Q_strncpyz( infostring, statusCache.statusInfo[*challenge ? 1 : 0], sizeof( infostring ) );
+	SV_AddStatusChallenge( infostring, challenge );
+
+	statusLength = strlen( infostring ) + 16; // strlen( "statusResponse\n\n" )
+
+	for ( i = 0; i < sv.maxclients; i++ ) {
+		const statusCachePlayer_t *player = &statusCache.players[i];
+		if ( player->listed ) {
+			if ( statusLength + player->lineLength >= MAX_PACKETLEN-4 )
+				break; // can't hold any more
+
+			Com_Memcpy( status + offset, player->line, player->lineLength );
+			offset += player->lineLength;
+			statusLength += player->lineLength;
+		}
+	}
+	status[offset] = '\0';
+
+	NET_OutOfBandPrint( NS_SERVER, from, "statusResponse\n%s\n%s", infostring, status );
+}
+
+
+/*
+================
+SV_StatusCache_SendInfo
+================
+*/
+static void SV_StatusCache_SendInfo( const netadr_t *from, const char *challenge ) {
+	char	infostring[MAX_INFO_STRING];
+	int		length;
+
+	SV_StatusCache_Update();
+
+	infostring[0] = '\0';
+	Info_SetValueForKey( infostring, "challenge", challenge );
+	length = strlen( infostring );
+
+	if ( length + statusCache.infoLength < MAX_INFO_STRING ) {
+		Com_Memcpy( infostring + length, statusCache.info, statusCache.infoLength + 1 );
+	} else {
+		// keys may have been dropped for length with the challenge added, so build normally
+		SV_GetInfoString( infostring, challenge );
+	}
+
+#ifdef ELITEFORCE
+	NET_OutOfBandPrint( NS_SERVER, from, "infoResponse \"%s\"", infostring );
+#else
+	NET_OutOfBandPrint( NS_SERVER, from, "infoResponse\n%s", infostring );
+#endif
+}
+#endif
+
+
 /*
 ================
 SVC_Status
@@ -662,6 +932,7 @@ the simple info query.
 ================
 */
 static void SVC_Status( const netadr_t *from ) {
+#ifndef STEF_STATUS_CACHE
 	char	player[MAX_NAME_LENGTH + 32]; // score + ping + name
 	char	status[MAX_PACKETLEN];
 	char	*s;
@@ -671,6 +942,7 @@ static void SVC_Status( const netadr_t *from ) {
 	int		statusLength;
 	int		playerLength;
 	char	infostring[MAX_INFO_STRING+160]; // add some space for challenge string
+#endif
 
 	// ignore if we are in single player
 #ifndef DEDICATED
@@ -701,28 +973,11 @@ static void SVC_Status( const netadr_t *from ) {
 	if ( strlen( Cmd_Argv( 1 ) ) > 128 )
 		return;
 
-	Q_strncpyz( infostring, Cvar_InfoString( CVAR_SERVERINFO, NULL ), sizeof( infostring ) );
-
-#ifdef STEF_GETSTATUS_FIXES
-	// Echelon server browser expects "v1.20" in version string.
-	Info_SetValueForKey( infostring, "version_cmod", Q3_VERSION " " PLATFORM_STRING " " __DATE__ );
-	Info_SetValueForKey( infostring, "version", "cMod HM v1.20 compatible" );
-
-	// Qtracker may expect "baseEF" value for gamename. Only perform this adjustment for
-	// queries with a challenge parameter to minimize any effect on visible info.
-	if ( *Cmd_Argv( 1 ) ) {
-		Info_SetValueForKey( infostring, "gamename", "baseEF" );
-	}
-
-	// Make sure challenge is at beginning of info string for compatibility with Raven master
-	if ( *Cmd_Argv( 1 ) ) {
-		Q_strncpyz( infostring, va( "\\challenge\\%s%s", Cmd_Argv( 1 ), infostring ), MAX_INFO_STRING );
-	}
+#ifdef STEF_STATUS_CACHE
+	SV_StatusCache_SendStatus( from, Cmd_Argv( 1 ) );
 #else
-	// echo back the parameter to status. so master servers can use it as a challenge
-	// to prevent timed spoofed reply packets that add ghost servers
-	Info_SetValueForKey( infostring, "challenge", Cmd_Argv( 1 ) );
-#endif
+	SV_GetStatusInfo( infostring, sizeof( infostring ), *Cmd_Argv( 1 ) ? qtrue : qfalse );
+	SV_AddStatusChallenge( infostring, Cmd_Argv( 1 ) );
 
 	s = status;
 	status[0] = '\0';
@@ -749,6 +1004,7 @@ static void SVC_Status( const netadr_t *from ) {
 	}
 
 	NET_OutOfBandPrint( NS_SERVER, from, "statusResponse\n%s\n%s", infostring, status );
+#endif
 }
 
 
@@ -761,9 +1017,9 @@ if a user is interested in a server to do a full status
 ================
 */
 static void SVC_Info( const netadr_t *from ) {
-	int		i, count, humans;
-	const char	*gamedir;
+#ifndef STEF_STATUS_CACHE
 	char	infostring[MAX_INFO_STRING];
+#endif
 
 	// ignore if we are in single player
 #ifndef DEDICATED
@@ -799,42 +1055,17 @@ static void SVC_Info( const netadr_t *from ) {
 	if ( strlen( Cmd_Argv( 1 ) ) > 128 )
 		return;
 
-	// don't count privateclients
-	count = humans = 0;
-	for ( i = sv_privateClients->integer; i < sv.maxclients; i++ ) {
-		if ( svs.clients[i].state >= CS_CONNECTED ) {
-			count++;
-			if (svs.clients[i].netchan.remoteAddress.type != NA_BOT) {
-				humans++;
-			}
-		}
-	}
-
-	infostring[0] = '\0';
-
-	// echo back the parameter to status. so servers can use it as a challenge
-	// to prevent timed spoofed reply packets that add ghost servers
-	Info_SetValueForKey( infostring, "challenge", Cmd_Argv(1) );
-
-	Info_SetValueForKey( infostring, "protocol", va( "%i", com_protocol->integer ) );
-	Info_SetValueForKey( infostring, "hostname", sv_hostname->string );
-	Info_SetValueForKey( infostring, "mapname", sv_mapname->string );
-	Info_SetValueForKey( infostring, "clients", va("%i", count) );
-	Info_SetValueForKey( infostring, "g_humanplayers", va( "%i", humans ) );
-	Info_SetValueForKey( infostring, "sv_maxclients", va( "%i", sv.maxclients - sv_privateClients->integer ) );
-	Info_SetValueForKey( infostring, "gametype", va( "%i", sv_gametype->integer ) );
-	Info_SetValueForKey( infostring, "pure", va( "%i", sv.pure ) );
-	Info_SetValueForKey( infostring, "g_needpass", va( "%d", Cvar_VariableIntegerValue( "g_needpass" ) ) );
-	gamedir = Cvar_VariableString( "fs_game" );
-	if ( *gamedir != '\0' ) {
-		Info_SetValueForKey( infostring, "game", gamedir );
-	}
+#ifdef STEF_STATUS_CACHE
+	SV_StatusCache_SendInfo( from, Cmd_Argv( 1 ) );
+#else
+	SV_GetInfoString( infostring, Cmd_Argv( 1 ) );
 
 #ifdef ELITEFORCE
 	NET_OutOfBandPrint( NS_SERVER, from, "infoResponse \"%s\"", infostring );
 #else
 	NET_OutOfBandPrint( NS_SERVER, from, "infoResponse\n%s", infostring );
 #endif
+#endif
 }
 
 
@@ -989,6 +1220,16 @@ static void SV_ConnectionlessPacket( const netadr_t *from, msg_t *msg ) {
 	}
 
 	if ( !com_sv_running->integer ) {
+#ifdef STEF_RECORD_RELAY
+		// relay process only accepts spectator connections
+		if ( Record_RelayModeActive() ) {
+			if ( !Q_stricmp( c, "getchallenge" ) ) {
+				SV_GetChallenge( from );
+			} else if ( !Q_stricmp( c, "connect" ) ) {
+				SV_DirectConnect( from );
+			}
+		}
+#endif
 		return;
 	}
 
@@ -1038,6 +1279,14 @@ void SV_PacketEvent( const netadr_t *from, msg_t *msg ) {
 	}
 
 	if ( sv.state == SS_DEAD ) {
+#ifdef STEF_RECORD_RELAY
+		if ( Record_RelayModeActive() ) {
+			MSG_BeginReadingOOB( msg );
+			MSG_ReadLong( msg ); // sequence number
+			qport = MSG_ReadShort( msg ) & 0xffff;
+			Record_ProcessPacketEvent( from, msg, qport );
+		}
+#endif
 		return;
 	}
 
@@ -1373,6 +1622,9 @@ void SV_Frame( int msec ) {
 	int		frameMsec;
 	int		startTime;
 	int		i;
+#ifdef STEF_SV_PERF
+	int		gameFrames;
+#endif
 
 	if ( Cvar_CheckGroup( CVG_SERVER ) )
 		SV_TrackCvarChanges(); // update rate settings, etc.
@@ -1386,6 +1638,11 @@ void SV_Frame( int msec ) {
 
 	if ( !com_sv_running->integer )
 	{
+#ifdef STEF_RECORD_RELAY
+		if ( Record_ProcessRelayFrame( msec ) ) {
+			return;
+		}
+#endif
 		if ( com_dedicated->integer )
 		{
 			// Block indefinitely until something interesting happens
@@ -1413,14 +1670,25 @@ void SV_Frame( int msec ) {
 
 	sv.timeResidual += msec;
 
+#ifdef STEF_SV_PERF
+	SV_Perf_BeginFrame();
+	SV_Perf_Begin( SV_PERF_FRAME );
+	SV_Perf_Begin( SV_PERF_BOTS );
+#endif
 	if ( !com_dedicated->integer )
 		SV_BotFrame( sv.time + sv.timeResidual );
+#ifdef STEF_SV_PERF
+	SV_Perf_End( SV_PERF_BOTS );
+#endif
 
 	// if time is about to hit the 32nd bit, kick all clients
 	// and clear sv.time, rather
 	// than checking for negative time wraparound everywhere.
 	// 2giga-milliseconds = 23 days, so it won't be too often
 	if ( sv.time > 0x78000000 ) {
+#ifdef STEF_SV_PERF
+		SV_Perf_End( SV_PERF_FRAME );
+#endif
 		SV_Restart( "Restarting server due to time wrapping" );
 		return;
 	}
@@ -1435,6 +1703,9 @@ void SV_Frame( int msec ) {
 				}
 			}
 			if ( i == sv.maxclients ) {
+#ifdef STEF_SV_PERF
+				SV_Perf_End( SV_PERF_FRAME );
+#endif
 				SV_Restart( "Restarting server" );
 				return;
 			}
@@ -1444,6 +1715,9 @@ void SV_Frame( int msec ) {
 	if ( sv.restartTime && sv.time - sv.restartTime >= 0 ) {
 		sv.restartTime = 0;
 		Cbuf_AddText( "map_restart 0\n" );
+#ifdef STEF_SV_PERF
+		SV_Perf_End( SV_PERF_FRAME );
+#endif
 		return;
 	}
 
@@ -1451,10 +1725,16 @@ void SV_Frame( int msec ) {
 	if ( cvar_modifiedFlags & CVAR_SERVERINFO ) {
 		SV_SetConfigstring( CS_SERVERINFO, Cvar_InfoString( CVAR_SERVERINFO, NULL ) );
 		cvar_modifiedFlags &= ~CVAR_SERVERINFO;
+#ifdef STEF_STATUS_CACHE
+		SV_StatusCache_Invalidate();
+#endif
 	}
 	if ( cvar_modifiedFlags & CVAR_SYSTEMINFO ) {
 		SV_SetConfigstring( CS_SYSTEMINFO, Cvar_InfoString_Big( CVAR_SYSTEMINFO, NULL ) );
 		cvar_modifiedFlags &= ~CVAR_SYSTEMINFO;
+#ifdef STEF_STATUS_CACHE
+		SV_StatusCache_Invalidate();
+#endif
 	}
 
 	if ( com_speeds->integer ) {
@@ -1464,9 +1744,22 @@ void SV_Frame( int msec ) {
 	}
 
 	// update ping based on the all received frames
+#ifdef STEF_SV_PERF
+	SV_Perf_Begin( SV_PERF_PINGS );
 	SV_CalcPings();
+	SV_Perf_End( SV_PERF_PINGS );
 
+	SV_Perf_Begin( SV_PERF_BOTS );
 	if (com_dedicated->integer) SV_BotFrame (sv.time);
+	SV_Perf_End( SV_PERF_BOTS );
+
+	gameFrames = 0;
+	SV_Perf_Begin( SV_PERF_GAME );
+#else
+	SV_CalcPings();
+
+	if (com_dedicated->integer) SV_BotFrame (sv.time);
+#endif
 
 	// run the game simulation in chunks
 	while ( sv.timeResidual >= frameMsec ) {
@@ -1476,7 +1769,13 @@ void SV_Frame( int msec ) {
 
 		// let everything in the world think and move
 		VM_Call( gvm, 1, GAME_RUN_FRAME, sv.time );
+#ifdef STEF_SV_PERF
+		++gameFrames;
+#endif
 	}
+#ifdef STEF_SV_PERF
+	SV_Perf_End( SV_PERF_GAME );
+#endif
 
 	if ( com_speeds->integer ) {
 		time_game = Sys_Milliseconds () - startTime;
@@ -1488,11 +1787,33 @@ void SV_Frame( int msec ) {
 	// reset current and build new snapshot on first query
 	SV_IssueNewSnapshot();
 
+#ifdef STEF_NET_BATCHED_SEND
+	Sys_BeginPacketBatch();
+#endif
+
 	// send messages back to the clients
 	SV_SendClientMessages();
 
+#ifdef STEF_NET_BATCHED_SEND
+	// flush before the heartbeat, which can block on resolving the master address
+#ifdef STEF_SV_PERF
+	SV_Perf_Begin( SV_PERF_TRANSMIT );
+#endif
+	Sys_FlushPacketBatch();
+#ifdef STEF_SV_PERF
+	SV_Perf_End( SV_PERF_TRANSMIT );
+#endif
+#endif
+
 	// send a heartbeat to the master if needed
 	SV_MasterHeartbeat(HEARTBEAT_FOR_MASTER);
+
+#ifdef STEF_SV_PERF
+	SV_Perf_End( SV_PERF_FRAME );
+	if ( gameFrames ) {
+		SV_Perf_CommitFrame();
+	}
+#endif
 }
 
 
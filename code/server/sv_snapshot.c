@@ -45,6 +45,179 @@ A normal server packet will look like:
 =============================================================================
 */
 
+#ifdef STEF_SNAPSHOT_ENTITY_CACHE
+/*
+=============================================================================
+
+Entity delta cache
+
+Clients that see the same entity update within a snapshot frame usually delta it from
+the same source state, so the encoded bits can be reused. Entries are keyed by source
+and target entityState_t pointers, which stay valid and unmodified until the next
+common snapshot is built. The bit encodings used for snapshots don't depend on the
+position in the message, so cached bits can be spliced into any message.
+
+=============================================================================
+*/
+
+#define ENTITY_CACHE_SLOT_ENTRIES 4
+#define ENTITY_CACHE_DATA_SIZE ( 512 * 1024 )
+#define ENTITY_CACHE_MAX_ENTRY_BYTES 1024
+
+typedef struct {
+	const entityState_t *from;
+	const entityState_t *to;
+	qboolean compat;
+	qboolean force;
+	int dataOffset;
+	int bits;
+} entityCacheEntry_t;
+
+typedef struct {
+	int generation;
+	int count;
+	entityCacheEntry_t entries[ ENTITY_CACHE_SLOT_ENTRIES ];
+} entityCacheSlot_t;
+
+typedef struct {
+	int generation;
+	int dataUsed;
+	entityCacheSlot_t slots[ MAX_GENTITIES ];
+	byte data[ ENTITY_CACHE_DATA_SIZE ];
+#ifdef STEF_SNAPSHOT_THREADS
+	stef_mutex_t *mutex;
+	qboolean threaded;
+#endif
+} entityCache_t;
+
+static entityCache_t entityCache;
+
+// used as cache key for deltas from the null baseline
+static const entityState_t entityCacheNullBaseline;
+
+#ifdef STEF_SNAPSHOT_THREADS
+#define ENTITY_CACHE_LOCK if ( entityCache.threaded ) Stef_Mutex_Lock( entityCache.mutex );
+#define ENTITY_CACHE_UNLOCK if ( entityCache.threaded ) Stef_Mutex_Unlock( entityCache.mutex );
+#else
+#define ENTITY_CACHE_LOCK
+#define ENTITY_CACHE_UNLOCK
+#endif
+
+/*
+=============
+SV_ResetEntityCache
+
+Called when a new common snapshot is built.
+=============
+*/
+static void SV_ResetEntityCache( void ) {
+	entityCache.generation++;
+	entityCache.dataUsed = 0;
+}
+
+#ifdef STEF_SNAPSHOT_THREADS
+/*
+=============
+SV_SetEntityCacheThreaded
+
+Enables locking while snapshots are being written on worker threads.
+=============
+*/
+static void SV_SetEntityCacheThreaded( qboolean threaded ) {
+	if ( threaded && !entityCache.mutex ) {
+		entityCache.mutex = Stef_Mutex_Create();
+	}
+	entityCache.threaded = threaded;
+}
+#endif
+
+/*
+=============
+SV_WriteCachedDeltaEntity
+
+Equivalent to MSG_WriteDeltaEntity, but reuses the encoding from other clients in the
+current snapshot frame if possible. 'from' must point to snapshot storage, a baseline,
+or entityCacheNullBaseline, and 'to' must point to current frame snapshot storage.
+=============
+*/
+static void SV_WriteCachedDeltaEntity( msg_t *msg, const entityState_t *from, const entityState_t *to, qboolean force ) {
+	entityCacheSlot_t *slot;
+	const entityCacheEntry_t *entry = NULL;
+	byte buffer[ ENTITY_CACHE_MAX_ENTRY_BYTES ];
+	msg_t encoded;
+	qboolean compat = qfalse;
+	int i;
+
+#ifdef ELITEFORCE
+	compat = msg->compat;
+#endif
+	if ( !sv_snapshotEntityCache->integer || ( msg->oob && !compat ) || msg->overflowed ) {
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+
+	// check for existing entry
+	slot = &entityCache.slots[ to->number ];
+	ENTITY_CACHE_LOCK
+	if ( slot->generation == entityCache.generation ) {
+		for ( i = 0; i < slot->count; i++ ) {
+			if ( slot->entries[i].from == from && slot->entries[i].to == to &&
+					slot->entries[i].compat == compat && slot->entries[i].force == force ) {
+				entry = &slot->entries[i];
+				break;
+			}
+		}
+	}
+	ENTITY_CACHE_UNLOCK
+
+	// entries and their data aren't modified until the next reset, which doesn't
+	// happen while snapshots are being written
+	if ( entry ) {
+		MSG_WriteBitStream( msg, entityCache.data + entry->dataOffset, entry->bits );
+		return;
+	}
+
+	// write to temporary buffer
+	if ( compat ) {
+		MSG_InitOOB( &encoded, buffer, sizeof( buffer ) );
+#ifdef ELITEFORCE
+		encoded.compat = qtrue;
+#endif
+	} else {
+		MSG_Init( &encoded, buffer, sizeof( buffer ) );
+	}
+	encoded.allowoverflow = qtrue;
+	MSG_WriteDeltaEntity( &encoded, from, to, force );
+	if ( encoded.overflowed ) {
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+	MSG_WriteBitStream( msg, buffer, encoded.bit );
+
+	// add new entry
+	ENTITY_CACHE_LOCK
+	if ( slot->generation != entityCache.generation ) {
+		slot->generation = entityCache.generation;
+		slot->count = 0;
+	}
+	if ( slot->count < ENTITY_CACHE_SLOT_ENTRIES &&
+			entityCache.dataUsed + encoded.cursize <= ENTITY_CACHE_DATA_SIZE ) {
+		entityCacheEntry_t *newEntry = &slot->entries[ slot->count ];
+		newEntry->from = from;
+		newEntry->to = to;
+		newEntry->compat = compat;
+		newEntry->force = force;
+		newEntry->dataOffset = entityCache.dataUsed;
+		newEntry->bits = encoded.bit;
+		Com_Memcpy( entityCache.data + entityCache.dataUsed, buffer, encoded.cursize );
+		entityCache.dataUsed += encoded.cursize;
+		slot->count++;
+	}
+	ENTITY_CACHE_UNLOCK
+}
+#endif
+
+
 /*
 =============
 SV_EmitPacketEntities
@@ -92,7 +265,11 @@ static void SV_EmitPacketEntities( const clientSnapshot_t *from, const clientSna
 			// delta update from old position
 			// because the force parm is qfalse, this will not result
 			// in any bytes being emitted if the entity has not changed at all
+#ifdef STEF_SNAPSHOT_ENTITY_CACHE
+			SV_WriteCachedDeltaEntity( msg, oldent, newent, qfalse );
+#else
 			MSG_WriteDeltaEntity (msg, oldent, newent, qfalse );
+#endif
 			oldindex++;
 			newindex++;
 			continue;
@@ -103,13 +280,21 @@ static void SV_EmitPacketEntities( const clientSnapshot_t *from, const clientSna
 #ifdef STEF_GAMESTATE_OVERFLOW_FIX
 			if ( newnum > maxEntityBaseline ) {
 				// Treat baselines excluded from gamestate as null
+#ifdef STEF_SNAPSHOT_ENTITY_CACHE
+				SV_WriteCachedDeltaEntity( msg, &entityCacheNullBaseline, newent, qtrue );
+#else
 				entityState_t null_baseline;
 				Com_Memset( &null_baseline, 0, sizeof( null_baseline ) );
 				MSG_WriteDeltaEntity( msg, &null_baseline, newent, qtrue );
+#endif
 			}
 			else
 #endif
+#ifdef STEF_SNAPSHOT_ENTITY_CACHE
+			SV_WriteCachedDeltaEntity( msg, &sv.svEntities[newnum].baseline, newent, qtrue );
+#else
 			MSG_WriteDeltaEntity (msg, &sv.svEntities[newnum].baseline, newent, qtrue );
+#endif
 			newindex++;
 			continue;
 		}
@@ -128,18 +313,15 @@ static void SV_EmitPacketEntities( const clientSnapshot_t *from, const clientSna
 
 /*
 ==================
-SV_WriteSnapshotToClient
+SV_SelectDeltaFrame
+
+Returns the previous frame to use as the source for delta compressing the current
+snapshot, or NULL to send a full snapshot.
 ==================
 */
-static void SV_WriteSnapshotToClient( const client_t *client, msg_t *msg ) {
+static const clientSnapshot_t *SV_SelectDeltaFrame( const client_t *client, int *lastframePtr ) {
 	const clientSnapshot_t	*oldframe;
-	const clientSnapshot_t	*frame;
 	int					lastframe;
-	int					i;
-	int					snapFlags;
-
-	// this is the snapshot we are creating
-	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
 
 	// try to use a previous frame as the source for delta compressing the snapshot
 	if ( /* client->deltaMessage <= 0 || */ client->state != CS_ACTIVE ) {
@@ -167,6 +349,26 @@ static void SV_WriteSnapshotToClient( const client_t *client, msg_t *msg ) {
 		}
 	}
 
+	*lastframePtr = lastframe;
+	return oldframe;
+}
+
+
+/*
+==================
+SV_WriteSnapshotFrame
+
+Writes the current snapshot using the delta source from SV_SelectDeltaFrame.
+==================
+*/
+static void SV_WriteSnapshotFrame( const client_t *client, const clientSnapshot_t *oldframe, int lastframe, msg_t *msg ) {
+	const clientSnapshot_t	*frame;
+	int					i;
+	int					snapFlags;
+
+	// this is the snapshot we are creating
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+
 	MSG_WriteByte( msg, svc_snapshot );
 
 	// NOTE, MRE: now sent at the start of every message from server to client
@@ -240,6 +442,20 @@ static void SV_WriteSnapshotToClient( const client_t *client, msg_t *msg ) {
 }
 
 
+/*
+==================
+SV_WriteSnapshotToClient
+==================
+*/
+static void SV_WriteSnapshotToClient( const client_t *client, msg_t *msg ) {
+	const clientSnapshot_t	*oldframe;
+	int					lastframe;
+
+	oldframe = SV_SelectDeltaFrame( client, &lastframe );
+	SV_WriteSnapshotFrame( client, oldframe, lastframe, msg );
+}
+
+
 /*
 ==================
 SV_UpdateServerCommandsToClient
@@ -275,6 +491,14 @@ typedef struct {
 	int		numSnapshotEntities;
 	entityNum_t	snapshotEntities[ MAX_SNAPSHOT_ENTITIES ];
 	qboolean unordered;
+#ifdef STEF_SNAPSHOT_THREADS
+	// used to prevent double adding from portal views, in place of the shared
+	// svEntity_t snapshotCounter so snapshots can be built on multiple threads
+	unsigned int addedEntities[ MAX_GENTITIES / 32 ];
+#endif
+#ifdef STEF_SNAPSHOT_VIS_CACHE
+	int flags;
+#endif
 } snapshotEntityNumbers_t;
 
 
@@ -315,7 +539,12 @@ SV_AddIndexToSnapshot
 */
 static void SV_AddIndexToSnapshot( svEntity_t *svEnt, int index, snapshotEntityNumbers_t *eNums ) {
 
+#ifdef STEF_SNAPSHOT_THREADS
+	int entityNum = svEnt - sv.svEntities;
+	eNums->addedEntities[ entityNum >> 5 ] |= 1u << ( entityNum & 31 );
+#else
 	svEnt->snapshotCounter = sv.snapshotCounter;
+#endif
 
 	// if we are full, silently discard entities
 	if ( eNums->numSnapshotEntities >= MAX_SNAPSHOT_ENTITIES ) {
@@ -327,6 +556,263 @@ static void SV_AddIndexToSnapshot( svEntity_t *svEnt, int index, snapshotEntityN
 }
 
 
+#ifdef STEF_SNAPSHOT_VIS_INDEX
+/*
+=============================================================================
+
+Snapshot visibility index
+
+Built along with the common snapshot, this maps each occupied PVS cluster and area
+to a bitset of common snapshot entity indices. The candidate set for a viewpoint
+is the union of visible clusters intersected with the union of connected areas,
+plus entities that always need the full check (broadcast, overflow clusters).
+Candidates are then checked with the normal per-entity logic, so the result is
+the same as checking every entity.
+
+The index is invalidated once SV_SendClientMessages has finished sending snapshots
+and processing server-side recording for the current frame, since game code can
+relink entities after that point.
+
+=============================================================================
+*/
+
+#define VIS_INDEX_WORDS ( MAX_GENTITIES / 32 )
+
+typedef unsigned int visIndexBits_t[ VIS_INDEX_WORDS ];
+
+typedef struct {
+	int count;
+	int capacity;
+	int *slotForValue;		// value -> slot + 1, 0 if unoccupied
+	int *valueForSlot;
+	visIndexBits_t *bits;
+} visIndexMap_t;
+
+typedef struct {
+	qboolean valid;
+	visIndexMap_t clusters;
+	visIndexMap_t areas;
+	int numClusters;
+	int numAreas;
+	visIndexBits_t alwaysCheck;
+	visIndexBits_t clientMask;
+} visIndex_t;
+
+static visIndex_t visIndex;
+
+#define VIS_INDEX_SET( bits, index ) ( (bits)[ (index) >> 5 ] |= 1u << ( (index) & 31 ) )
+
+/*
+===============
+SV_VisIndexAllocMap
+===============
+*/
+static void SV_VisIndexAllocMap( visIndexMap_t *map, int newSize ) {
+	if ( map->slotForValue ) {
+		Z_Free( map->slotForValue );
+		Z_Free( map->valueForSlot );
+		Z_Free( map->bits );
+	}
+	map->count = 0;
+	map->capacity = 0;
+	map->slotForValue = NULL;
+	map->valueForSlot = NULL;
+	map->bits = NULL;
+	if ( newSize ) {
+		// Z_Malloc memory is zeroed
+		map->slotForValue = (int *)Z_Malloc( sizeof( *map->slotForValue ) * newSize );
+		map->capacity = newSize < 256 ? newSize : 256;
+		map->valueForSlot = (int *)Z_Malloc( sizeof( *map->valueForSlot ) * map->capacity );
+		map->bits = (visIndexBits_t *)Z_Malloc( sizeof( *map->bits ) * map->capacity );
+	}
+}
+
+/*
+===============
+SV_VisIndexGrowMap
+
+Occupied slots are usually a small fraction of the map's clusters, so slot storage
+starts small and grows as needed.
+===============
+*/
+static void SV_VisIndexGrowMap( visIndexMap_t *map ) {
+	int newCapacity = map->capacity * 2;
+	int *valueForSlot = (int *)Z_Malloc( sizeof( *valueForSlot ) * newCapacity );
+	visIndexBits_t *bits = (visIndexBits_t *)Z_Malloc( sizeof( *bits ) * newCapacity );
+
+	Com_Memcpy( valueForSlot, map->valueForSlot, sizeof( *valueForSlot ) * map->count );
+	Com_Memcpy( bits, map->bits, sizeof( *bits ) * map->count );
+	Z_Free( map->valueForSlot );
+	Z_Free( map->bits );
+	map->valueForSlot = valueForSlot;
+	map->bits = bits;
+	map->capacity = newCapacity;
+}
+
+/*
+===============
+SV_VisIndexResetMap
+===============
+*/
+static void SV_VisIndexResetMap( visIndexMap_t *map ) {
+	int i;
+	for ( i = 0; i < map->count; i++ ) {
+		map->slotForValue[ map->valueForSlot[ i ] ] = 0;
+	}
+	map->count = 0;
+}
+
+/*
+===============
+SV_VisIndexAdd
+===============
+*/
+static void SV_VisIndexAdd( visIndexMap_t *map, int value, int index ) {
+	int slot = map->slotForValue[ value ] - 1;
+	if ( slot < 0 ) {
+		if ( map->count >= map->capacity ) {
+			SV_VisIndexGrowMap( map );
+		}
+		slot = map->count++;
+		map->slotForValue[ value ] = slot + 1;
+		map->valueForSlot[ slot ] = value;
+		Com_Memset( map->bits[ slot ], 0, sizeof( map->bits[ slot ] ) );
+	}
+	VIS_INDEX_SET( map->bits[ slot ], index );
+}
+
+/*
+===============
+SV_BuildVisIndex
+
+Called after the common snapshot has been built.
+===============
+*/
+static void SV_BuildVisIndex( void ) {
+	int numClusters = sv.state == SS_DEAD ? 0 : CM_NumClusters();
+	int numAreas = sv.state == SS_DEAD ? 0 : CM_NumAreas();
+	int e, i;
+
+	if ( numClusters != visIndex.numClusters ) {
+		SV_VisIndexAllocMap( &visIndex.clusters, numClusters );
+		visIndex.numClusters = numClusters;
+	}
+	if ( numAreas != visIndex.numAreas ) {
+		SV_VisIndexAllocMap( &visIndex.areas, numAreas );
+		visIndex.numAreas = numAreas;
+	}
+
+	SV_VisIndexResetMap( &visIndex.clusters );
+	SV_VisIndexResetMap( &visIndex.areas );
+	Com_Memset( visIndex.alwaysCheck, 0, sizeof( visIndex.alwaysCheck ) );
+	Com_Memset( visIndex.clientMask, 0, sizeof( visIndex.clientMask ) );
+
+	for ( e = 0; e < svs.currFrame->count; e++ ) {
+		int num = svs.currFrame->ents[ e ]->number;
+		const svEntity_t *svEnt = &sv.svEntities[ num ];
+		const sharedEntity_t *ent = SV_GentityNum( num );
+		qboolean alwaysCheck = qfalse;
+
+		if ( ent->r.svFlags & SVF_BROADCAST ) {
+			alwaysCheck = qtrue;
+		}
+		if ( ent->r.svFlags & SVF_CLIENTMASK ) {
+			VIS_INDEX_SET( visIndex.clientMask, e );
+		}
+		if ( svEnt->lastCluster ) {
+			alwaysCheck = qtrue;
+		}
+
+		for ( i = 0; i < svEnt->numClusters; i++ ) {
+			int cluster = svEnt->clusternums[ i ];
+			if ( cluster >= 0 && cluster < numClusters ) {
+				SV_VisIndexAdd( &visIndex.clusters, cluster, e );
+			} else {
+				alwaysCheck = qtrue;
+			}
+		}
+
+		if ( svEnt->areanum >= numAreas || svEnt->areanum2 >= numAreas ) {
+			alwaysCheck = qtrue;
+		} else {
+			if ( svEnt->areanum >= 0 ) {
+				SV_VisIndexAdd( &visIndex.areas, svEnt->areanum, e );
+			}
+			if ( svEnt->areanum2 >= 0 ) {
+				SV_VisIndexAdd( &visIndex.areas, svEnt->areanum2, e );
+			}
+		}
+
+		if ( alwaysCheck ) {
+			VIS_INDEX_SET( visIndex.alwaysCheck, e );
+		}
+	}
+
+	visIndex.valid = qtrue;
+}
+
+/*
+===============
+SV_GetVisIndexCandidates
+
+Sets bits for common snapshot entity indices that need to be checked for visibility
+from the given point. Returns qfalse if the index is not available.
+===============
+*/
+static qboolean SV_GetVisIndexCandidates( int clientarea, const byte *clientpvs, int clientNum, unsigned int *out ) {
+	int slot, i;
+
+	if ( !visIndex.valid ) {
+		return qfalse;
+	}
+
+	Com_Memset( out, 0, sizeof( visIndexBits_t ) );
+
+	// entities touching visible clusters
+	for ( slot = 0; slot < visIndex.clusters.count; slot++ ) {
+		int cluster = visIndex.clusters.valueForSlot[ slot ];
+		if ( clientpvs[ cluster >> 3 ] & ( 1 << ( cluster & 7 ) ) ) {
+			const unsigned int *bits = visIndex.clusters.bits[ slot ];
+			for ( i = 0; i < VIS_INDEX_WORDS; i++ ) {
+				out[ i ] |= bits[ i ];
+			}
+		}
+	}
+
+	// entities in connected areas; CM_AreasConnected only accepts a negative area
+	// when all areas are treated as connected (cm_noAreas)
+	if ( !CM_AreasConnected( clientarea, -1 ) ) {
+		visIndexBits_t areaMask;
+		Com_Memset( areaMask, 0, sizeof( areaMask ) );
+		for ( slot = 0; slot < visIndex.areas.count; slot++ ) {
+			if ( CM_AreasConnected( clientarea, visIndex.areas.valueForSlot[ slot ] ) ) {
+				const unsigned int *bits = visIndex.areas.bits[ slot ];
+				for ( i = 0; i < VIS_INDEX_WORDS; i++ ) {
+					areaMask[ i ] |= bits[ i ];
+				}
+			}
+		}
+		for ( i = 0; i < VIS_INDEX_WORDS; i++ ) {
+			out[ i ] &= areaMask[ i ];
+		}
+	}
+
+	for ( i = 0; i < VIS_INDEX_WORDS; i++ ) {
+		out[ i ] |= visIndex.alwaysCheck[ i ];
+	}
+
+	// make sure the SVF_CLIENTMASK error check still happens
+	if ( clientNum >= 32 ) {
+		for ( i = 0; i < VIS_INDEX_WORDS; i++ ) {
+			out[ i ] |= visIndex.clientMask[ i ];
+		}
+	}
+
+	return qtrue;
+}
+#endif
+
+
 /*
 ===============
 SV_AddEntitiesVisibleFromPoint
@@ -343,6 +829,10 @@ static void SV_AddEntitiesVisibleFromPoint( const vec3_t origin, clientSnapshot_
 	int		leafnum;
 	byte	*clientpvs;
 	byte	*bitvector;
+#ifdef STEF_SNAPSHOT_VIS_INDEX
+	visIndexBits_t candidates;
+	qboolean useCandidates;
+#endif
 
 	// during an error shutdown message we may need to transmit
 	// the shutdown message after the server has shutdown, so
@@ -360,7 +850,20 @@ static void SV_AddEntitiesVisibleFromPoint( const vec3_t origin, clientSnapshot_
 
 	clientpvs = CM_ClusterPVS (clientcluster);
 
+#ifdef STEF_SNAPSHOT_VIS_INDEX
+	useCandidates = SV_GetVisIndexCandidates( clientarea, clientpvs, frame->ps.clientNum, candidates );
+#endif
+
 	for ( e = 0 ; e < svs.currFrame->count; e++ ) {
+#ifdef STEF_SNAPSHOT_VIS_INDEX
+		if ( useCandidates && !( candidates[ e >> 5 ] & ( 1u << ( e & 31 ) ) ) ) {
+			if ( !candidates[ e >> 5 ] ) {
+				// skip to next word
+				e |= 31;
+			}
+			continue;
+		}
+#endif
 		es = svs.currFrame->ents[ e ];
 		ent = SV_GentityNum( es->number );
 
@@ -378,8 +881,13 @@ static void SV_AddEntitiesVisibleFromPoint( const vec3_t origin, clientSnapshot_
 		}
 		// entities can be flagged to be sent to a given mask of clients
 		if ( ent->r.svFlags & SVF_CLIENTMASK ) {
-			if (frame->ps.clientNum >= 32)
+			if (frame->ps.clientNum >= 32) {
+#ifdef STEF_SNAPSHOT_VIS_CACHE
+				if ( eNums->flags & SV_VIS_IGNORE_CLIENTMASK_ERROR )
+					continue;
+#endif
 				Com_Error( ERR_DROP, "SVF_CLIENTMASK: clientNum >= 32" );
+			}
 			if (~ent->r.singleClient & (1 << frame->ps.clientNum))
 				continue;
 		}
@@ -387,9 +895,15 @@ static void SV_AddEntitiesVisibleFromPoint( const vec3_t origin, clientSnapshot_
 		svEnt = &sv.svEntities[ es->number ];
 
 		// don't double add an entity through portals
+#ifdef STEF_SNAPSHOT_THREADS
+		if ( eNums->addedEntities[ es->number >> 5 ] & ( 1u << ( es->number & 31 ) ) ) {
+			continue;
+		}
+#else
 		if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
 			continue;
 		}
+#endif
 
 		// broadcast entities are always sent
 		if ( ent->r.svFlags & SVF_BROADCAST ) {
@@ -468,6 +982,82 @@ static void SV_AddEntitiesVisibleFromPoint( const vec3_t origin, clientSnapshot_
 }
 
 
+#ifdef STEF_SNAPSHOT_VIS_CACHE
+/*
+=============================================================================
+
+Snapshot visibility cache
+
+Holds the visibility result for each client against the current common snapshot,
+so the server-side recording system can use the same result as SV_BuildClientSnapshot
+instead of walking the PVS again. Entries are keyed by client and common snapshot
+frame number. Playerstates can't change between building snapshots and record
+processing, since both happen in SV_SendClientMessages.
+
+=============================================================================
+*/
+
+typedef struct {
+	int frameNum;		// common snapshot frame, or -1 if not set
+	svClientVisibility_t vis;
+} visCacheEntry_t;
+
+static visCacheEntry_t visCache[ MAX_CLIENTS ];
+
+
+/*
+===============
+SV_ResetVisCache
+===============
+*/
+static void SV_ResetVisCache( void ) {
+	int i;
+	for ( i = 0; i < MAX_CLIENTS; i++ ) {
+		visCache[ i ].frameNum = -1;
+	}
+}
+
+
+/*
+===============
+SV_ReadVisCache
+
+Copies cached visibility to frame. Returns qfalse if there is no entry for the
+current common snapshot.
+===============
+*/
+static qboolean SV_ReadVisCache( int clientNum, clientSnapshot_t *frame ) {
+	const visCacheEntry_t *entry = &visCache[ clientNum ];
+
+	if ( entry->frameNum != svs.currFrame->frameNum ) {
+		return qfalse;
+	}
+
+	frame->areabytes = entry->vis.areabytes;
+	Com_Memcpy( frame->areabits, entry->vis.areabits, sizeof( frame->areabits ) );
+	frame->num_entities = entry->vis.num_entities;
+	Com_Memcpy( frame->ents, entry->vis.ents, sizeof( *frame->ents ) * entry->vis.num_entities );
+	return qtrue;
+}
+
+
+/*
+===============
+SV_WriteVisCache
+===============
+*/
+static void SV_WriteVisCache( int clientNum, const clientSnapshot_t *frame ) {
+	visCacheEntry_t *entry = &visCache[ clientNum ];
+
+	entry->vis.areabytes = frame->areabytes;
+	Com_Memcpy( entry->vis.areabits, frame->areabits, sizeof( entry->vis.areabits ) );
+	entry->vis.num_entities = frame->num_entities;
+	Com_Memcpy( entry->vis.ents, frame->ents, sizeof( *frame->ents ) * frame->num_entities );
+	entry->frameNum = svs.currFrame->frameNum;
+}
+#endif
+
+
 /*
 ===============
 SV_InitSnapshotStorage
@@ -485,6 +1075,12 @@ void SV_InitSnapshotStorage( void )
 	svs.lastValidFrame = 0;
 
 	svs.currFrame = NULL;
+#ifdef STEF_SNAPSHOT_VIS_INDEX
+	visIndex.valid = qfalse;
+#endif
+#ifdef STEF_SNAPSHOT_VIS_CACHE
+	SV_ResetVisCache();
+#endif
 }
 
 
@@ -498,6 +1094,9 @@ This should be called before any new client snaphot built
 void SV_IssueNewSnapshot( void ) 
 {
 	svs.currFrame = NULL;
+#ifdef STEF_SNAPSHOT_VIS_INDEX
+	visIndex.valid = qfalse;
+#endif
 	
 	// value that clients can use even for their empty frames
 	// as it will not increment on new snapshot built
@@ -590,6 +1189,10 @@ static void SV_BuildCommonSnapshot( void )
 
 	svs.currFrame = sf; // clients can refer to this
 
+#ifdef STEF_SNAPSHOT_ENTITY_CACHE
+	SV_ResetEntityCache();
+#endif
+
 	// setup start index
 	index = sf->start;
 	for ( i = 0 ; i < count ; i++, index = (index+1) % svs.numSnapshotEntities ) {
@@ -597,28 +1200,24 @@ static void SV_BuildCommonSnapshot( void )
 		svs.snapshotEntities[ index ] = list[ i ]->s;
 		sf->ents[ i ] = &svs.snapshotEntities[ index ];
 	}
+
+#ifdef STEF_SNAPSHOT_VIS_INDEX
+	SV_BuildVisIndex();
+#endif
 }
 
 
 /*
 =============
-SV_BuildClientSnapshot
-
-Decides which entities are going to be visible to the client, and
-copies off the playerstate and areabits.
-
-This properly handles multiple recursive portals, but the render
-currently doesn't.
+SV_BeginClientSnapshot
 
-For viewing through other player's eyes, clent can be something other than client->gentity
+Copies off the playerstate and prepares the common snapshot. Returns qtrue if
+SV_AddClientSnapshotEntities needs to be called to complete the snapshot.
 =============
 */
-static void SV_BuildClientSnapshot( client_t *client ) {
-	vec3_t						org;
+static qboolean SV_BeginClientSnapshot( client_t *client ) {
 	clientSnapshot_t			*frame;
-	snapshotEntityNumbers_t		entityNumbers;
-	int							i, cl;
-	svEntity_t					*svEnt;
+	int							cl;
 	int							clientNum;
 	playerState_t				*ps;
 
@@ -635,7 +1234,7 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 	frame->frameNum = svs.currentSnapshotFrame;
 	
 	if ( client->state == CS_ZOMBIE )
-		return;
+		return qfalse;
 
 	// grab the current playerState_t
 	ps = SV_GameClientNum( cl );
@@ -650,7 +1249,7 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 	// so don't send any packetentities changes until CS_PRIMED
 	// because new gamestate will invalidate them anyway
 	if ( !client->gentity ) {
-		return;
+		return qfalse;
 	}
 
 	if ( svs.currFrame == NULL ) {
@@ -658,22 +1257,54 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 		SV_BuildCommonSnapshot();
 	}
 
-	// bump the counter used to prevent double adding
-	sv.snapshotCounter++;
+	frame->frameNum = svs.currFrame->frameNum;
+	return qtrue;
+}
+
+
+/*
+=============
+SV_AddFrameEntities
+
+Decides which entities are going to be visible from the frame playerstate, and
+copies off the areabits.
+
+This properly handles multiple recursive portals, but the render
+currently doesn't.
+=============
+*/
+static void SV_AddFrameEntities( clientSnapshot_t *frame, int flags ) {
+	vec3_t						org;
+	snapshotEntityNumbers_t		entityNumbers;
+	int							i;
+	int							clientNum;
+
+	clientNum = frame->ps.clientNum;
 
 	// empty entities before visibility check
 	entityNumbers.numSnapshotEntities = 0;
+#ifdef STEF_SNAPSHOT_VIS_CACHE
+	entityNumbers.flags = flags;
+#endif
 
-	frame->frameNum = svs.currFrame->frameNum;
+#ifdef STEF_SNAPSHOT_THREADS
+	Com_Memset( entityNumbers.addedEntities, 0, sizeof( entityNumbers.addedEntities ) );
 
 	// never send client's own entity, because it can
 	// be regenerated from the playerstate
-	svEnt = &sv.svEntities[ clientNum ];
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	entityNumbers.addedEntities[ clientNum >> 5 ] |= 1u << ( clientNum & 31 );
+#else
+	// bump the counter used to prevent double adding
+	sv.snapshotCounter++;
+
+	// never send client's own entity, because it can
+	// be regenerated from the playerstate
+	sv.svEntities[ clientNum ].snapshotCounter = sv.snapshotCounter;
+#endif
 
 	// find the client's viewpoint
-	VectorCopy( ps->origin, org );
-	org[2] += ps->viewheight;
+	VectorCopy( frame->ps.origin, org );
+	org[2] += frame->ps.viewheight;
 
 	// add all the entities directly visible to the eye, which
 	// may include portal entities that merge other viewpoints
@@ -703,6 +1334,83 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 }
 
 
+/*
+=============
+SV_AddClientSnapshotEntities
+
+Decides which entities are going to be visible to the client, and
+copies off the areabits.
+=============
+*/
+static void SV_AddClientSnapshotEntities( client_t *client ) {
+	clientSnapshot_t *frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+
+#ifdef STEF_SNAPSHOT_VIS_CACHE
+	if ( SV_ReadVisCache( client - svs.clients, frame ) ) {
+		return;
+	}
+#endif
+
+	SV_AddFrameEntities( frame, 0 );
+
+#ifdef STEF_SNAPSHOT_VIS_CACHE
+	SV_WriteVisCache( client - svs.clients, frame );
+#endif
+}
+
+
+#ifdef STEF_SNAPSHOT_VIS_CACHE
+/*
+=============
+SV_GetClientVisibility
+
+Returns visibility for client against the current common snapshot, using the result
+from SV_BuildClientSnapshot if the client was sent a snapshot this frame. Returns
+NULL if the server isn't running.
+=============
+*/
+const svClientVisibility_t *SV_GetClientVisibility( int clientNum, int flags ) {
+	static clientSnapshot_t frame;
+
+	if ( sv.state != SS_GAME || clientNum < 0 || clientNum >= sv.maxclients ) {
+		return NULL;
+	}
+
+	if ( svs.currFrame == NULL ) {
+		SV_BuildCommonSnapshot();
+	}
+
+	if ( visCache[ clientNum ].frameNum != svs.currFrame->frameNum ) {
+		Com_Memset( frame.areabits, 0, sizeof( frame.areabits ) );
+		frame.areabytes = 0;
+		frame.ps = *SV_GameClientNum( clientNum );
+		frame.frameNum = svs.currFrame->frameNum;
+		SV_AddFrameEntities( &frame, flags );
+		SV_WriteVisCache( clientNum, &frame );
+	}
+
+	return &visCache[ clientNum ].vis;
+}
+#endif
+
+
+/*
+=============
+SV_BuildClientSnapshot
+
+Decides which entities are going to be visible to the client, and
+copies off the playerstate and areabits.
+
+For viewing through other player's eyes, clent can be something other than client->gentity
+=============
+*/
+static void SV_BuildClientSnapshot( client_t *client ) {
+	if ( SV_BeginClientSnapshot( client ) ) {
+		SV_AddClientSnapshotEntities( client );
+	}
+}
+
+
 /*
 =======================
 SV_SendMessageToClient
@@ -735,7 +1443,13 @@ void SV_SendClientSnapshot( client_t *client ) {
 	msg_t		msg;
 
 	// build the snapshot
+#ifdef STEF_SV_PERF
+	SV_Perf_Begin( SV_PERF_SNAPSHOT_BUILD );
+	SV_BuildClientSnapshot( client );
+	SV_Perf_End( SV_PERF_SNAPSHOT_BUILD );
+#else
 	SV_BuildClientSnapshot( client );
+#endif
 
 	// bots need to have their snapshots build, but
 	// the query them directly without needing to be sent
@@ -743,6 +1457,10 @@ void SV_SendClientSnapshot( client_t *client ) {
 		return;
 	}
 
+#ifdef STEF_SV_PERF
+	SV_Perf_Begin( SV_PERF_SNAPSHOT_ENCODE );
+#endif
+
 #ifdef ELITEFORCE
 	if(client->compat)
 	{
@@ -768,16 +1486,200 @@ void SV_SendClientSnapshot( client_t *client ) {
 	// and the playerState_t
 	SV_WriteSnapshotToClient( client, &msg );
 
+#ifdef STEF_SV_PERF
+	SV_Perf_End( SV_PERF_SNAPSHOT_ENCODE );
+#endif
+
 	// check for overflow
 	if ( msg.overflowed ) {
 		Com_Printf( "WARNING: msg overflowed for %s\n", client->name );
 		MSG_Clear( &msg );
 	}
 
+#ifdef STEF_SV_PERF
+	SV_Perf_Begin( SV_PERF_TRANSMIT );
 	SV_SendMessageToClient( &msg, client );
+	SV_Perf_End( SV_PERF_TRANSMIT );
+#else
+	SV_SendMessageToClient( &msg, client );
+#endif
+}
+
+
+#ifdef STEF_SNAPSHOT_THREADS
+/*
+=============================================================================
+
+Threaded snapshot building
+
+Work that can print or error (playerstate copy, common snapshot, delta frame
+selection, server commands) is done on the main thread in client order. The
+visibility check and snapshot encoding for each client run on the worker pool,
+and the finished messages are sent on the main thread in client order, so the
+output is the same as SV_SendClientSnapshot.
+
+=============================================================================
+*/
+
+typedef struct {
+	client_t *client;
+	qboolean addEntities;
+	const clientSnapshot_t *oldframe;
+	int lastframe;
+	msg_t msg;
+	byte msgBuf[ MAX_MSGLEN_BUF ];
+} snapshotJob_t;
+
+static snapshotJob_t snapshotJobs[ MAX_CLIENTS ];
+
+
+/*
+=======================
+SV_CheckSnapshotClientMask
+
+Raises the SVF_CLIENTMASK error from SV_AddEntitiesVisibleFromPoint on the main thread,
+since it can't be raised from a worker thread.
+=======================
+*/
+static void SV_CheckSnapshotClientMask( const clientSnapshot_t *frame ) {
+	int e;
+
+	if ( frame->ps.clientNum < 32 || sv.state == SS_DEAD ) {
+		return;
+	}
+
+	for ( e = 0; e < svs.currFrame->count; e++ ) {
+		const sharedEntity_t *ent = SV_GentityNum( svs.currFrame->ents[ e ]->number );
+		if ( ( ent->r.svFlags & SVF_SINGLECLIENT ) && ent->r.singleClient != frame->ps.clientNum ) {
+			continue;
+		}
+		if ( ( ent->r.svFlags & SVF_NOTSINGLECLIENT ) && ent->r.singleClient == frame->ps.clientNum ) {
+			continue;
+		}
+		if ( ent->r.svFlags & SVF_CLIENTMASK ) {
+			Com_Error( ERR_DROP, "SVF_CLIENTMASK: clientNum >= 32" );
+		}
+	}
 }
 
 
+/*
+=======================
+SV_SnapshotJob
+=======================
+*/
+static void SV_SnapshotJob( int index, void *context ) {
+	snapshotJob_t *job = &( (snapshotJob_t *)context )[ index ];
+
+	if ( job->addEntities ) {
+		SV_AddClientSnapshotEntities( job->client );
+	}
+
+	if ( job->client->netchan.remoteAddress.type != NA_BOT ) {
+		SV_WriteSnapshotFrame( job->client, job->oldframe, job->lastframe, &job->msg );
+	}
+}
+
+
+/*
+=======================
+SV_SendClientSnapshotsThreaded
+
+Equivalent to calling SV_SendClientSnapshot for each client in order.
+=======================
+*/
+static void SV_SendClientSnapshotsThreaded( client_t **clients, int count ) {
+	int i;
+
+	for ( i = 0; i < count; i++ ) {
+		snapshotJob_t *job = &snapshotJobs[ i ];
+		client_t *client = clients[ i ];
+
+		job->client = client;
+#ifdef STEF_SV_PERF
+		SV_Perf_Begin( SV_PERF_SNAPSHOT_BUILD );
+#endif
+		job->addEntities = SV_BeginClientSnapshot( client );
+		if ( job->addEntities ) {
+			SV_CheckSnapshotClientMask( &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ] );
+		}
+#ifdef STEF_SV_PERF
+		SV_Perf_End( SV_PERF_SNAPSHOT_BUILD );
+#endif
+
+		if ( client->netchan.remoteAddress.type == NA_BOT ) {
+			continue;
+		}
+
+#ifdef ELITEFORCE
+		if(client->compat)
+		{
+			MSG_InitOOB(&job->msg, job->msgBuf, MAX_MSGLEN);
+			job->msg.compat = qtrue;
+		}
+		else
+#endif
+		MSG_Init( &job->msg, job->msgBuf, MAX_MSGLEN );
+		job->msg.allowoverflow = qtrue;
+
+#ifdef ELITEFORCE
+		if(!client->compat)
+#endif
+		MSG_WriteLong( &job->msg, client->lastClientCommand );
+
+#ifdef STEF_SV_PERF
+		SV_Perf_Begin( SV_PERF_SNAPSHOT_ENCODE );
+#endif
+		SV_UpdateServerCommandsToClient( client, &job->msg );
+
+		job->oldframe = SV_SelectDeltaFrame( client, &job->lastframe );
+#ifdef STEF_SV_PERF
+		SV_Perf_End( SV_PERF_SNAPSHOT_ENCODE );
+#endif
+	}
+
+	// worker time covers both entity visibility and encoding, and is counted
+	// as snapshot building
+#ifdef STEF_SV_PERF
+	SV_Perf_Begin( SV_PERF_SNAPSHOT_BUILD );
+#endif
+#ifdef STEF_SNAPSHOT_ENTITY_CACHE
+	SV_SetEntityCacheThreaded( qtrue );
+#endif
+	Stef_Jobs_Run( count, SV_SnapshotJob, snapshotJobs, sv_snapshotThreads->integer );
+#ifdef STEF_SNAPSHOT_ENTITY_CACHE
+	SV_SetEntityCacheThreaded( qfalse );
+#endif
+#ifdef STEF_SV_PERF
+	SV_Perf_End( SV_PERF_SNAPSHOT_BUILD );
+#endif
+
+	for ( i = 0; i < count; i++ ) {
+		snapshotJob_t *job = &snapshotJobs[ i ];
+		client_t *client = clients[ i ];
+
+		if ( client->netchan.remoteAddress.type != NA_BOT ) {
+			if ( job->msg.overflowed ) {
+				Com_Printf( "WARNING: msg overflowed for %s\n", client->name );
+				MSG_Clear( &job->msg );
+			}
+
+#ifdef STEF_SV_PERF
+			SV_Perf_Begin( SV_PERF_TRANSMIT );
+			SV_SendMessageToClient( &job->msg, client );
+			SV_Perf_End( SV_PERF_TRANSMIT );
+#else
+			SV_SendMessageToClient( &job->msg, client );
+#endif
+		}
+
+		client->lastSnapshotTime = svs.time;
+		client->rateDelayed = qfalse;
+	}
+}
+#endif
+
+
 /*
 =======================
 SV_SendClientMessages
@@ -787,6 +1689,11 @@ void SV_SendClientMessages( void )
 {
 	int		i;
 	client_t	*c;
+#ifdef STEF_SNAPSHOT_THREADS
+	client_t	*threadedClients[ MAX_CLIENTS ];
+	int			threadedCount = 0;
+	qboolean	threaded = sv_snapshotThreads->integer > 1 ? qtrue : qfalse;
+#endif
 
 	svs.msgTime = Sys_Milliseconds();
 
@@ -861,12 +1768,33 @@ void SV_SendClientMessages( void )
 		}
 #endif
 
+#ifdef STEF_SNAPSHOT_THREADS
+		if ( threaded ) {
+			threadedClients[ threadedCount++ ] = c;
+			continue;
+		}
+#endif
+
 		// generate and send a new message
 		SV_SendClientSnapshot( c );
 		c->lastSnapshotTime = svs.time;
 		c->rateDelayed = qfalse;
 	}
+#ifdef STEF_SNAPSHOT_THREADS
+	if ( threadedCount ) {
+		SV_SendClientSnapshotsThreaded( threadedClients, threadedCount );
+	}
+#endif
 #ifdef STEF_SERVER_RECORD
+#ifdef STEF_SV_PERF
+	SV_Perf_Begin( SV_PERF_RECORD );
 	Record_ProcessSnapshot();
+	SV_Perf_End( SV_PERF_RECORD );
+#else
+	Record_ProcessSnapshot();
+#endif
+#endif
+#ifdef STEF_SNAPSHOT_VIS_INDEX
+	visIndex.valid = qfalse;
 #endif
 }
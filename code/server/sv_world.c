@@ -173,6 +173,10 @@ void SV_UnlinkEntity( sharedEntity_t *gEnt ) {
 
 	gEnt->r.linked = qfalse;
 
+#ifdef STEF_RECORD_ENTITY_TRACKER
+	Record_ProcessEntityLink( SV_NumForGentity( gEnt ) );
+#endif
+
 	ws = ent->worldSector;
 	if ( !ws ) {
 		return;		// not linked in anywhere
@@ -423,6 +427,10 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 	node->entities = ent;
 
 	gEnt->r.linked = qtrue;
+
+#ifdef STEF_RECORD_ENTITY_TRACKER
+	Record_ProcessEntityLink( SV_NumForGentity( gEnt ) );
+#endif
 }
 
 /*